@@ -0,0 +1,8 @@
+TEMPLATE = subdirs
+
+SUBDIRS += \
+    cachedatabase \
+    offlinecompression \
+    rendering \
+    stylechanges \
+    tilearchive
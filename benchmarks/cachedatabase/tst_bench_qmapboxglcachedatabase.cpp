@@ -0,0 +1,167 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Copyright (C) 2017 Mapbox, Inc.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the QtLocation module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL3$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or later as published by the Free
+** Software Foundation and appearing in the file LICENSE.GPL included in
+** the packaging of this file. Please review the following information to
+** ensure the GNU General Public License version 2.0 requirements will be
+** met: http://www.gnu.org/licenses/gpl-2.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qmapboxglcachedatabase_p.h"
+
+#include <QtCore/QFile>
+#include <QtCore/QRandomGenerator>
+#include <QtCore/QTemporaryDir>
+#include <QtSql/QSqlQuery>
+#include <QtTest/QtTest>
+
+Q_DECLARE_METATYPE(QMapboxGLCacheDatabase::Tuning)
+
+namespace {
+
+const int tileCount = 1000;
+const int tileSize = 16 * 1024;
+const int readsPerRound = 100;
+
+} // namespace
+
+// Measures random tile reads from a cache database with the SQLite tuning
+// the engine parameters can ask for. Every row reads its own copy of the
+// same file, so persistent settings do not leak into the next row. The
+// file is small enough to stay in the page cache: this compares SQLite
+// overhead, not disk access.
+class tst_QMapboxGLCacheDatabase : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+
+    void readTiles_data();
+    void readTiles();
+
+private:
+    QTemporaryDir m_dir;
+    QString m_template;
+};
+
+void tst_QMapboxGLCacheDatabase::initTestCase()
+{
+    QVERIFY(m_dir.isValid());
+    m_template = m_dir.filePath(QStringLiteral("template.db"));
+
+    QMapboxGLCacheDatabase database(m_template);
+    QVERIFY(database.open());
+    QVERIFY(database.ensureSchema());
+
+    QSqlDatabase db = database.database();
+    QVERIFY(db.transaction());
+
+    QSqlQuery query(db);
+    query.prepare(QStringLiteral("INSERT INTO tiles (url_template, pixel_ratio, z, x, y, data, accessed) "
+                                 "VALUES ('mapbox://tiles/{z}/{x}/{y}', 1, 14, ?, ?, ?, 0)"));
+
+    // Random bytes, roughly what compressed vector tiles look like to SQLite.
+    QRandomGenerator random(1);
+    QByteArray data(tileSize, Qt::Uninitialized);
+
+    for (int i = 0; i < tileCount; ++i) {
+        random.fillRange(reinterpret_cast<quint32 *>(data.data()), tileSize / 4);
+        query.bindValue(0, i % 100);
+        query.bindValue(1, i / 100);
+        query.bindValue(2, data);
+        QVERIFY(query.exec());
+    }
+
+    QVERIFY(db.commit());
+}
+
+void tst_QMapboxGLCacheDatabase::readTiles_data()
+{
+    QTest::addColumn<QMapboxGLCacheDatabase::Tuning>("tuning");
+
+    QMapboxGLCacheDatabase::Tuning tuning;
+    QTest::newRow("defaults") << tuning;
+
+    tuning = QMapboxGLCacheDatabase::Tuning();
+    tuning.journalMode = QStringLiteral("wal");
+    QTest::newRow("wal") << tuning;
+
+    tuning = QMapboxGLCacheDatabase::Tuning();
+    tuning.pageSize = 16384;
+    QTest::newRow("page_size 16384") << tuning;
+
+    tuning = QMapboxGLCacheDatabase::Tuning();
+    tuning.cacheSize = -64 * 1024;
+    QTest::newRow("cache_size 64 MiB") << tuning;
+
+    tuning = QMapboxGLCacheDatabase::Tuning();
+    tuning.mmapSize = 256 * 1024 * 1024;
+    QTest::newRow("mmap_size 256 MiB") << tuning;
+
+    tuning.journalMode = QStringLiteral("wal");
+    tuning.pageSize = 16384;
+    tuning.cacheSize = -64 * 1024;
+    QTest::newRow("all") << tuning;
+}
+
+void tst_QMapboxGLCacheDatabase::readTiles()
+{
+    QFETCH(QMapboxGLCacheDatabase::Tuning, tuning);
+
+    const QString path = m_dir.filePath(QStringLiteral("%1.db").arg(QTest::currentDataTag()));
+    QFile::remove(path);
+    QVERIFY(QFile::copy(m_template, path));
+
+    QMapboxGLCacheDatabase database(path);
+    QVERIFY(database.open(tuning));
+    QVERIFY(database.applyPersistentTuning(tuning));
+
+    QSqlQuery query(database.database());
+    query.setForwardOnly(true);
+    query.prepare(QStringLiteral("SELECT data FROM tiles WHERE id = ?"));
+
+    QRandomGenerator random(2);
+
+    QBENCHMARK {
+        for (int i = 0; i < readsPerRound; ++i) {
+            query.bindValue(0, random.bounded(tileCount) + 1);
+            QVERIFY(query.exec());
+            QVERIFY(query.next());
+            QCOMPARE(query.value(0).toByteArray().size(), tileSize);
+            query.finish();
+        }
+    }
+}
+
+QTEST_MAIN(tst_QMapboxGLCacheDatabase)
+
+#include "tst_bench_qmapboxglcachedatabase.moc"
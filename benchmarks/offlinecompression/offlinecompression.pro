@@ -0,0 +1,18 @@
+TARGET = tst_bench_qmapboxglofflinecompression
+
+CONFIG += benchmark
+
+QT += \
+    testlib \
+    sql
+
+INCLUDEPATH += $$PWD/../..
+
+HEADERS += \
+    ../../qmapboxglcachedatabase_p.h
+
+SOURCES += \
+    tst_bench_qmapboxglofflinecompression.cpp \
+    ../../qmapboxglcachedatabase.cpp
+
+include(../../mapboxgl_dependency.pri)
@@ -0,0 +1,255 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Copyright (C) 2017 Mapbox, Inc.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the QtLocation module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL3$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or later as published by the Free
+** Software Foundation and appearing in the file LICENSE.GPL included in
+** the packaging of this file. Please review the following information to
+** ensure the GNU General Public License version 2.0 requirements will be
+** met: http://www.gnu.org/licenses/gpl-2.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qmapboxglcachedatabase_p.h"
+
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QJsonObject>
+#include <QtCore/QRandomGenerator>
+#include <QtTest/QtTest>
+
+namespace {
+
+void appendVarint(QByteArray *data, quint64 value)
+{
+    while (value >= 0x80) {
+        data->append(char(value | 0x80));
+        value >>= 7;
+    }
+    data->append(char(value));
+}
+
+void appendField(QByteArray *data, int field, const QByteArray &value)
+{
+    appendVarint(data, quint64(field) << 3 | 2);
+    appendVarint(data, quint64(value.size()));
+    data->append(value);
+}
+
+quint32 zigzag(int value)
+{
+    return (quint32(value) << 1) ^ quint32(value >> 31);
+}
+
+// A Mapbox Vector Tile with one layer of tagged line strings, each one a
+// random walk. Close enough to a road layer for zlib.
+QByteArray vectorTile(int features)
+{
+    QRandomGenerator random(1);
+    QByteArray layer;
+
+    appendVarint(&layer, 15 << 3);
+    appendVarint(&layer, 2);
+    appendField(&layer, 1, "road");
+
+    for (int i = 0; i < features; ++i) {
+        QByteArray tags;
+        appendVarint(&tags, 0);
+        appendVarint(&tags, random.bounded(8));
+        appendVarint(&tags, 1);
+        appendVarint(&tags, 8 + random.bounded(4));
+
+        const int vertices = 2 + random.bounded(30);
+        QByteArray geometry;
+        appendVarint(&geometry, 1 << 3 | 1);
+        appendVarint(&geometry, zigzag(random.bounded(4096)));
+        appendVarint(&geometry, zigzag(random.bounded(4096)));
+        appendVarint(&geometry, quint64(vertices - 1) << 3 | 2);
+        for (int v = 1; v < vertices; ++v) {
+            appendVarint(&geometry, zigzag(random.bounded(-64, 64)));
+            appendVarint(&geometry, zigzag(random.bounded(-64, 64)));
+        }
+
+        QByteArray feature;
+        appendVarint(&feature, 1 << 3);
+        appendVarint(&feature, quint64(i + 1));
+        appendField(&feature, 2, tags);
+        appendVarint(&feature, 3 << 3);
+        appendVarint(&feature, 2);
+        appendField(&feature, 4, geometry);
+
+        appendField(&layer, 2, feature);
+    }
+
+    appendField(&layer, 3, "class");
+    appendField(&layer, 3, "layer");
+
+    static const char *const classes[] = {
+        "motorway", "trunk", "primary", "secondary", "tertiary", "street", "path", "service"
+    };
+    for (const char *value : classes) {
+        QByteArray string;
+        appendField(&string, 1, value);
+        appendField(&layer, 4, string);
+    }
+    for (int value = 0; value < 4; ++value) {
+        QByteArray integer;
+        appendVarint(&integer, 4 << 3);
+        appendVarint(&integer, quint64(value));
+        appendField(&layer, 4, integer);
+    }
+
+    appendVarint(&layer, 5 << 3);
+    appendVarint(&layer, 4096);
+
+    QByteArray tile;
+    appendField(&tile, 3, layer);
+
+    return tile;
+}
+
+// A style with the given number of line layers, which repeat most of their
+// keys the way real styles do.
+QByteArray style(int layers)
+{
+    QJsonArray array;
+    for (int i = 0; i < layers; ++i) {
+        array.append(QJsonObject {
+            { QStringLiteral("id"), QStringLiteral("road-%1").arg(i) },
+            { QStringLiteral("type"), QStringLiteral("line") },
+            { QStringLiteral("source"), QStringLiteral("composite") },
+            { QStringLiteral("source-layer"), QStringLiteral("road") },
+            { QStringLiteral("filter"), QJsonArray { QStringLiteral("=="), QStringLiteral("class"), QStringLiteral("class-%1").arg(i % 8) } },
+            { QStringLiteral("paint"), QJsonObject {
+                { QStringLiteral("line-color"), QStringLiteral("hsl(%1, 50%, 60%)").arg(i * 7 % 360) },
+                { QStringLiteral("line-width"), QJsonArray { QStringLiteral("interpolate"), QJsonArray { QStringLiteral("exponential"), 1.5 },
+                                                             QJsonArray { QStringLiteral("zoom") }, 5, 0.5 + i % 3, 18, 12 + i % 5 } } } }
+        });
+    }
+
+    const QJsonObject root {
+        { QStringLiteral("version"), 8 },
+        { QStringLiteral("sources"), QJsonObject {
+            { QStringLiteral("composite"), QJsonObject {
+                { QStringLiteral("type"), QStringLiteral("vector") },
+                { QStringLiteral("url"), QStringLiteral("mapbox://mapbox.mapbox-streets-v8") } } } } },
+        { QStringLiteral("layers"), array }
+    };
+
+    return QJsonDocument(root).toJson(QJsonDocument::Compact);
+}
+
+} // namespace
+
+// What mapboxgl.mapping.offline.compression.level costs and saves: the
+// downloader deflates every entry once when storing it, Mapbox GL inflates
+// it on every read. The stored size of one entry is reported as the result
+// of the footprint benchmark.
+class tst_QMapboxGLOfflineCompression : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void footprint_data();
+    void footprint();
+    void deflate_data();
+    void deflate();
+    void inflate_data();
+    void inflate();
+};
+
+void tst_QMapboxGLOfflineCompression::footprint_data()
+{
+    QTest::addColumn<QByteArray>("data");
+    QTest::addColumn<int>("level");
+
+    const QByteArray tile = vectorTile(500);
+    const QByteArray json = style(200);
+
+    QTest::newRow("vector tile, uncompressed") << tile << 0;
+    for (int level : { 1, 6, 9 })
+        QTest::newRow(qPrintable(QStringLiteral("vector tile, level %1").arg(level))) << tile << level;
+
+    QTest::newRow("style, uncompressed") << json << 0;
+    for (int level : { 1, 6, 9 })
+        QTest::newRow(qPrintable(QStringLiteral("style, level %1").arg(level))) << json << level;
+}
+
+void tst_QMapboxGLOfflineCompression::footprint()
+{
+    QFETCH(QByteArray, data);
+    QFETCH(int, level);
+
+    const QByteArray stored = level ? QMapboxGLCacheDatabase::deflate(data, level) : data;
+    QVERIFY(!stored.isEmpty());
+
+    QTest::setBenchmarkResult(stored.size(), QTest::BytesAllocated);
+}
+
+void tst_QMapboxGLOfflineCompression::deflate_data()
+{
+    footprint_data();
+}
+
+void tst_QMapboxGLOfflineCompression::deflate()
+{
+    QFETCH(QByteArray, data);
+    QFETCH(int, level);
+
+    if (!level)
+        QSKIP("Nothing to compress.");
+
+    QBENCHMARK {
+        QMapboxGLCacheDatabase::deflate(data, level);
+    }
+}
+
+void tst_QMapboxGLOfflineCompression::inflate_data()
+{
+    footprint_data();
+}
+
+void tst_QMapboxGLOfflineCompression::inflate()
+{
+    QFETCH(QByteArray, data);
+    QFETCH(int, level);
+
+    if (!level)
+        QSKIP("Nothing to inflate.");
+
+    const QByteArray stored = QMapboxGLCacheDatabase::deflate(data, level);
+    QCOMPARE(QMapboxGLCacheDatabase::inflate(stored), data);
+
+    QBENCHMARK {
+        QMapboxGLCacheDatabase::inflate(stored);
+    }
+}
+
+QTEST_MAIN(tst_QMapboxGLOfflineCompression)
+
+#include "tst_bench_qmapboxglofflinecompression.moc"
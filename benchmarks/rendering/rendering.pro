@@ -0,0 +1,25 @@
+TARGET = tst_bench_qmapboxglrendering
+
+CONFIG += benchmark
+
+QT += \
+    testlib \
+    network \
+    qml \
+    quick \
+    location-private \
+    positioning \
+    sql
+
+INCLUDEPATH += $$PWD/../..
+
+HEADERS += \
+    ../../qmapboxglbatchrenderer.h \
+    ../../qmapboxgloffscreencontext_p.h
+
+SOURCES += \
+    tst_bench_qmapboxglrendering.cpp \
+    ../../qmapboxglbatchrenderer.cpp \
+    ../../qmapboxgloffscreencontext.cpp
+
+include(../../mapboxgl_dependency.pri)
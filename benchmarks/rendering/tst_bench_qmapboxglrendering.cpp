@@ -0,0 +1,353 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Copyright (C) 2017 Mapbox, Inc.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the QtLocation module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL3$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or later as published by the Free
+** Software Foundation and appearing in the file LICENSE.GPL included in
+** the packaging of this file. Please review the following information to
+** ensure the GNU General Public License version 2.0 requirements will be
+** met: http://www.gnu.org/licenses/gpl-2.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qmapboxglbatchrenderer.h"
+#include "qmapboxgloffscreencontext_p.h"
+
+#include <QtCore/QBuffer>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QScopedPointer>
+#include <QtCore/QTemporaryDir>
+#include <QtGui/QImage>
+#include <QtGui/QOpenGLContext>
+#include <QtGui/QOpenGLFramebufferObject>
+#include <QtGui/QOpenGLFunctions>
+#include <QtLocation/QGeoServiceProvider>
+#include <QtLocation/private/qdeclarativegeomap_p.h>
+#include <QtLocation/private/qgeomap_p.h>
+#include <QtPositioning/QGeoCoordinate>
+#include <QtQml/QQmlComponent>
+#include <QtQml/QQmlEngine>
+#include <QtQuick/QQuickItem>
+#include <QtQuick/QQuickRenderControl>
+#include <QtQuick/QQuickWindow>
+#include <QtSql/QSqlDatabase>
+#include <QtSql/QSqlQuery>
+#include <QtTest/QtTest>
+
+#include <cmath>
+
+namespace {
+
+// Local style with a single line, so nothing goes to the network.
+const QByteArray lineStyle =
+    "{\"version\": 8,"
+    " \"sources\": {\"line\": {\"type\": \"geojson\", \"data\": {\"type\": \"Feature\", \"properties\": {},"
+    "   \"geometry\": {\"type\": \"LineString\", \"coordinates\": [[24.90, 60.15], [24.94, 60.17], [24.98, 60.16]]}}}},"
+    " \"layers\": ["
+    "  {\"id\": \"background\", \"type\": \"background\", \"paint\": {\"background-color\": \"#eeeeee\"}},"
+    "  {\"id\": \"line\", \"type\": \"line\", \"source\": \"line\", \"paint\": {\"line-color\": \"#3388ff\", \"line-width\": 4}}]}";
+
+QMapboxGLCameraOptions camera(int step)
+{
+    // Circles around the line, like a map panned back and forth.
+    const double angle = step * 0.05;
+
+    QMapboxGLCameraOptions options;
+    options.center = QVariant::fromValue(QMapbox::Coordinate(60.16 + 0.01 * std::sin(angle), 24.94 + 0.02 * std::cos(angle)));
+    options.zoom = 12.0 + std::sin(angle * 0.5);
+    options.bearing = 0.0;
+    options.pitch = 0.0;
+
+    return options;
+}
+
+// Raster tiles up to this zoom level, served by the plugin from a local
+// MBTiles archive.
+const int archiveMaximumZoom = 5;
+
+// A Map of the plugin showing the archive's default style.
+const char *mapQml =
+    "import QtQuick 2.0\n"
+    "import QtLocation 5.9\n"
+    "Map {\n"
+    "    plugin: Plugin {\n"
+    "        name: \"mapboxgl\"\n"
+    "        PluginParameter { name: \"mapboxgl.mapping.additional_style_urls\"; value: \"%1\" }\n"
+    "        PluginParameter { name: \"mapboxgl.mapping.cache.memory\"; value: true }\n"
+    "    }\n"
+    "}\n";
+
+enum CameraField {
+    CenterField = 0x1,
+    ZoomField = 0x2,
+    BearingAndTiltField = 0x4
+};
+
+} // namespace
+
+// Measures the cost of camera updates on a map of the plugin, and still
+// images rendered end to end by the offscreen batch renderer.
+class tst_QMapboxGLRendering : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+
+    void cameraSync_data();
+    void cameraSync();
+    void offscreenRendering_data();
+    void offscreenRendering();
+
+private:
+    QMapboxGLSettings settings() const;
+    void writeArchive(const QString &fileName);
+
+    QTemporaryDir m_directory;
+    QString m_styleUrl;
+    QString m_archiveUrl;
+};
+
+void tst_QMapboxGLRendering::initTestCase()
+{
+    QVERIFY(m_directory.isValid());
+
+    QFile style(m_directory.filePath(QStringLiteral("style.json")));
+    QVERIFY(style.open(QIODevice::WriteOnly));
+    style.write(lineStyle);
+    style.close();
+
+    m_styleUrl = QUrl::fromLocalFile(style.fileName()).toString();
+
+    const QString archive = m_directory.filePath(QStringLiteral("tiles.mbtiles"));
+    writeArchive(archive);
+    m_archiveUrl = QStringLiteral("mbtiles://") + archive;
+}
+
+void tst_QMapboxGLRendering::writeArchive(const QString &fileName)
+{
+    const QString connectionName = QStringLiteral("bench-rendering");
+
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), connectionName);
+        db.setDatabaseName(fileName);
+        QVERIFY(db.open());
+
+        QSqlQuery query(db);
+        QVERIFY(query.exec(QStringLiteral("CREATE TABLE metadata (name TEXT, value TEXT)")));
+        QVERIFY(query.exec(QStringLiteral("INSERT INTO metadata VALUES ('format', 'png')")));
+        QVERIFY(query.exec(QStringLiteral("INSERT INTO metadata VALUES ('maxzoom', '%1')").arg(archiveMaximumZoom)));
+        QVERIFY(query.exec(QStringLiteral("CREATE TABLE tiles (zoom_level INTEGER, tile_column INTEGER, tile_row INTEGER, tile_data BLOB)")));
+
+        QVERIFY(db.transaction());
+        query.prepare(QStringLiteral("INSERT INTO tiles VALUES (?, ?, ?, ?)"));
+
+        // A checkerboard with a color per zoom level, so every tile has to
+        // be decoded and uploaded for real.
+        QImage image(256, 256, QImage::Format_RGB32);
+        for (int z = 0; z <= archiveMaximumZoom; ++z) {
+            for (int x = 0; x < (1 << z); ++x) {
+                for (int y = 0; y < (1 << z); ++y) {
+                    image.fill(QColor::fromHsv(z * 60, (x + y) % 2 ? 80 : 160, 240));
+
+                    QByteArray png;
+                    QBuffer buffer(&png);
+                    buffer.open(QIODevice::WriteOnly);
+                    image.save(&buffer, "PNG");
+
+                    query.bindValue(0, z);
+                    query.bindValue(1, x);
+                    query.bindValue(2, y);
+                    query.bindValue(3, png);
+                    QVERIFY(query.exec());
+                }
+            }
+        }
+
+        QVERIFY(db.commit());
+        db.close();
+    }
+    QSqlDatabase::removeDatabase(connectionName);
+}
+
+QMapboxGLSettings tst_QMapboxGLRendering::settings() const
+{
+    QMapboxGLSettings settings;
+    settings.setCacheDatabasePath(QStringLiteral(":memory:"));
+
+    return settings;
+}
+
+void tst_QMapboxGLRendering::cameraSync_data()
+{
+    QTest::addColumn<int>("fields");
+
+    QTest::newRow("center") << int(CenterField);
+    QTest::newRow("zoom") << int(ZoomField);
+    QTest::newRow("bearing and tilt") << int(BearingAndTiltField);
+    QTest::newRow("all") << int(CenterField | ZoomField | BearingAndTiltField);
+}
+
+// Camera changes made on a QML Map of the plugin, each followed by one
+// frame rendered through the scene graph. The changes go through QGeoMap
+// to the camera sync of the plugin, which only applies the fields that
+// changed since the last frame.
+void tst_QMapboxGLRendering::cameraSync()
+{
+    QFETCH(int, fields);
+
+    if (!QGeoServiceProvider::availableServiceProviders().contains(QStringLiteral("mapboxgl")))
+        QSKIP("The mapboxgl plugin is not installed.");
+
+    QMapboxGLOffscreenContext context;
+    if (!context.makeCurrent())
+        QSKIP("No offscreen OpenGL context available.");
+
+    const QSize size(512, 512);
+    QOpenGLFramebufferObject fbo(size, QOpenGLFramebufferObject::CombinedDepthStencil);
+
+    QScopedPointer<QQuickRenderControl> control(new QQuickRenderControl);
+    QScopedPointer<QQuickWindow> window(new QQuickWindow(control.data()));
+    window->setGeometry(QRect(QPoint(), size));
+    window->setRenderTarget(&fbo);
+
+    QQmlEngine engine;
+    QQmlComponent component(&engine);
+    component.setData(QByteArray(mapQml).replace("%1", m_archiveUrl.toUtf8()), QUrl());
+
+    QScopedPointer<QQuickItem> item(qobject_cast<QQuickItem *>(component.create()));
+    QVERIFY2(item, qPrintable(component.errorString()));
+    item->setSize(size);
+    item->setParentItem(window->contentItem());
+
+    control->initialize(context.context());
+
+    QOpenGLFunctions *f = context.context()->functions();
+    auto renderFrame = [&] {
+        control->polishItems();
+        control->sync();
+        control->render();
+        f->glFinish();
+    };
+
+    QDeclarativeGeoMap *declarativeMap = qobject_cast<QDeclarativeGeoMap *>(item.data());
+    QVERIFY(declarativeMap);
+
+    item->setProperty("center", QVariant::fromValue(QGeoCoordinate(60.16, 24.94)));
+    item->setProperty("zoomLevel", 4.0);
+
+    QTRY_VERIFY_WITH_TIMEOUT((renderFrame(), item->property("mapReady").toBool()), 10000);
+
+    QGeoMap *map = declarativeMap->map();
+    QVERIFY(map);
+
+    // Let the style and the visible tiles load before measuring.
+    QElapsedTimer loading;
+    loading.start();
+    while (loading.elapsed() < 2000) {
+        renderFrame();
+        QTest::qWait(16);
+    }
+
+    QVariantMap before;
+    QVERIFY(QMetaObject::invokeMethod(map, "renderStatistics", Q_RETURN_ARG(QVariantMap, before)));
+
+    int step = 0;
+
+    QBENCHMARK {
+        const double angle = ++step * 0.05;
+
+        if (fields & CenterField)
+            item->setProperty("center", QVariant::fromValue(QGeoCoordinate(60.16 + 2.0 * std::sin(angle), 24.94 + 4.0 * std::cos(angle))));
+        if (fields & ZoomField)
+            item->setProperty("zoomLevel", 4.0 + 0.5 * std::sin(angle * 0.5));
+        if (fields & BearingAndTiltField) {
+            item->setProperty("bearing", std::fmod(step * 2.0, 360.0));
+            item->setProperty("tilt", 20.0 + 20.0 * std::sin(angle));
+        }
+
+        renderFrame();
+    }
+
+    QVariantMap after;
+    QVERIFY(QMetaObject::invokeMethod(map, "renderStatistics", Q_RETURN_ARG(QVariantMap, after)));
+
+    const int syncs = after.value(QStringLiteral("cameraSyncs")).toInt() - before.value(QStringLiteral("cameraSyncs")).toInt();
+    QVERIFY(syncs > 0);
+    qInfo("%d camera syncs, %.0f ns on average", syncs, after.value(QStringLiteral("cameraSyncTime")).toDouble());
+
+    item.reset();
+    window.reset();
+    control.reset();
+    context.doneCurrent();
+}
+
+void tst_QMapboxGLRendering::offscreenRendering_data()
+{
+    QTest::addColumn<QSize>("size");
+    QTest::addColumn<int>("images");
+
+    QTest::newRow("256x256") << QSize(256, 256) << 20;
+    QTest::newRow("512x512") << QSize(512, 512) << 20;
+    QTest::newRow("1024x1024") << QSize(1024, 1024) << 10;
+}
+
+void tst_QMapboxGLRendering::offscreenRendering()
+{
+    QFETCH(QSize, size);
+    QFETCH(int, images);
+
+    QMapboxGLBatchRenderer renderer(settings());
+    QSignalSpy finished(&renderer, &QMapboxGLBatchRenderer::finished);
+    QSignalSpy failed(&renderer, &QMapboxGLBatchRenderer::jobFailed);
+
+    int step = 0;
+
+    QBENCHMARK {
+        for (int i = 0; i < images; ++i) {
+            QMapboxGLBatchRenderer::Job job;
+            job.styleUrl = m_styleUrl;
+            job.camera = camera(++step);
+            job.size = size;
+            renderer.enqueue(job);
+        }
+
+        QVERIFY(finished.wait(60000));
+    }
+
+    QCOMPARE(failed.count(), 0);
+
+    const QVariantMap statistics = renderer.statistics();
+    qInfo("%.2f images/s, %.1f ms per image",
+          statistics.value(QStringLiteral("imagesPerSecond")).toDouble(),
+          statistics.value(QStringLiteral("averageRenderTime")).toDouble());
+}
+
+QTEST_MAIN(tst_QMapboxGLRendering)
+
+#include "tst_bench_qmapboxglrendering.moc"
@@ -0,0 +1,26 @@
+TARGET = tst_bench_qmapboxglstylechanges
+
+CONFIG += benchmark
+
+QT += \
+    testlib \
+    quick-private \
+    location-private \
+    positioning-private \
+    network \
+    sql
+
+INCLUDEPATH += $$PWD/../..
+
+HEADERS += \
+    ../../qmapboxgloffscreencontext_p.h \
+    ../../qmapboxglstylechange_p.h \
+    ../../qmapboxgltrace_p.h
+
+SOURCES += \
+    tst_bench_qmapboxglstylechanges.cpp \
+    ../../qmapboxgloffscreencontext.cpp \
+    ../../qmapboxglstylechange.cpp \
+    ../../qmapboxgltrace.cpp
+
+include(../../mapboxgl_dependency.pri)
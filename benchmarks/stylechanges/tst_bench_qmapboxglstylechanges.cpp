@@ -0,0 +1,269 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Copyright (C) 2017 Mapbox, Inc.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the QtLocation module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL3$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or later as published by the Free
+** Software Foundation and appearing in the file LICENSE.GPL included in
+** the packaging of this file. Please review the following information to
+** ensure the GNU General Public License version 2.0 requirements will be
+** met: http://www.gnu.org/licenses/gpl-2.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qmapboxgloffscreencontext_p.h"
+#include "qmapboxglstylechange_p.h"
+
+#include <QtCore/QScopedPointer>
+#include <QtLocation/private/qdeclarativecirclemapitem_p.h>
+#include <QtLocation/private/qdeclarativepolygonmapitem_p.h>
+#include <QtLocation/private/qdeclarativepolylinemapitem_p.h>
+#include <QtLocation/private/qgeomapparameter_p.h>
+#include <QtPositioning/QGeoPath>
+#include <QtPositioning/QGeoPolygon>
+#include <QtTest/QtTest>
+
+namespace {
+
+const QString backgroundStyle = QStringLiteral(
+    "{\"version\": 8, \"sources\": {}, \"layers\": ["
+    "{\"id\": \"background\", \"type\": \"background\", \"paint\": {\"background-color\": \"#eeeeee\"}}]}");
+
+// A line wandering east from Helsinki, one vertex every ~100 m.
+QList<QGeoCoordinate> path(int vertices)
+{
+    QList<QGeoCoordinate> coordinates;
+    for (int i = 0; i < vertices; ++i)
+        coordinates << QGeoCoordinate(60.17 + 0.001 * (i % 2), 24.94 + 0.002 * i);
+
+    return coordinates;
+}
+
+QByteArray pointsGeoJson(int points)
+{
+    QByteArray geoJson = "{\"type\": \"FeatureCollection\", \"features\": [";
+    for (int i = 0; i < points; ++i) {
+        if (i)
+            geoJson += ',';
+        geoJson += "{\"type\": \"Feature\", \"properties\": {}, \"geometry\": {\"type\": \"Point\", \"coordinates\": ["
+                + QByteArray::number(24.94 + 0.0001 * i) + ", 60.17]}}";
+    }
+    geoJson += "]}";
+
+    return geoJson;
+}
+
+} // namespace
+
+// Measures the GUI thread side of managed map items and parameters, and
+// the render thread side of applying the resulting style changes.
+class tst_QMapboxGLStyleChanges : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void featureFromPolyline_data();
+    void featureFromPolyline();
+    void featureFromPolygon_data();
+    void featureFromPolygon();
+    void circleTessellation_data();
+    void circleTessellation();
+    void addMapParameter_data();
+    void addMapParameter();
+    void syncStyleChanges_data();
+    void syncStyleChanges();
+
+private:
+    QMapboxGLOffscreenContext m_context;
+    QScopedPointer<QMapboxGL> m_map;
+};
+
+void tst_QMapboxGLStyleChanges::initTestCase()
+{
+    if (!m_context.makeCurrent())
+        QSKIP("No offscreen OpenGL context available.");
+
+    QMapboxGLSettings settings;
+    settings.setCacheDatabasePath(QStringLiteral(":memory:"));
+
+    m_map.reset(new QMapboxGL(nullptr, settings, QSize(512, 512)));
+    m_map->setStyleJson(backgroundStyle);
+}
+
+void tst_QMapboxGLStyleChanges::cleanupTestCase()
+{
+    if (m_context.makeCurrent())
+        m_map.reset();
+}
+
+void tst_QMapboxGLStyleChanges::featureFromPolyline_data()
+{
+    QTest::addColumn<int>("vertices");
+
+    QTest::newRow("10") << 10;
+    QTest::newRow("1000") << 1000;
+    QTest::newRow("100000") << 100000;
+}
+
+void tst_QMapboxGLStyleChanges::featureFromPolyline()
+{
+    QFETCH(int, vertices);
+
+    QDeclarativePolylineMapItem item;
+    item.setGeoShape(QGeoPath(path(vertices)));
+
+    QBENCHMARK {
+        QMapboxGLStyleAddSource::fromMapItem(&item);
+    }
+}
+
+void tst_QMapboxGLStyleChanges::featureFromPolygon_data()
+{
+    featureFromPolyline_data();
+}
+
+void tst_QMapboxGLStyleChanges::featureFromPolygon()
+{
+    QFETCH(int, vertices);
+
+    QDeclarativePolygonMapItem item;
+    item.setGeoShape(QGeoPolygon(path(vertices)));
+
+    QBENCHMARK {
+        QMapboxGLStyleAddSource::fromMapItem(&item);
+    }
+}
+
+void tst_QMapboxGLStyleChanges::circleTessellation_data()
+{
+    QTest::addColumn<QGeoCoordinate>("center");
+    QTest::addColumn<qreal>("radius");
+
+    QTest::newRow("city") << QGeoCoordinate(60.17, 24.94) << qreal(5000);
+    QTest::newRow("dateline") << QGeoCoordinate(0.0, 179.9) << qreal(50000);
+    QTest::newRow("pole") << QGeoCoordinate(89.0, 0.0) << qreal(500000);
+}
+
+void tst_QMapboxGLStyleChanges::circleTessellation()
+{
+    QFETCH(QGeoCoordinate, center);
+    QFETCH(qreal, radius);
+
+    QDeclarativeCircleMapItem item;
+    item.setCenter(center);
+    item.setRadius(radius);
+
+    QBENCHMARK {
+        QMapboxGLStyleAddSource::fromMapItem(&item);
+    }
+}
+
+void tst_QMapboxGLStyleChanges::addMapParameter_data()
+{
+    QTest::addColumn<QString>("type");
+    QTest::addColumn<QVariantMap>("properties");
+
+    QVariantMap paint;
+    paint[QStringLiteral("layer")] = QStringLiteral("background");
+    paint[QStringLiteral("background-color")] = QStringLiteral("#ff0000");
+    QTest::newRow("paint") << QStringLiteral("paint") << paint;
+
+    QVariantMap layer;
+    layer[QStringLiteral("name")] = QStringLiteral("points");
+    layer[QStringLiteral("layerType")] = QStringLiteral("circle");
+    layer[QStringLiteral("source")] = QStringLiteral("points");
+    QTest::newRow("layer") << QStringLiteral("layer") << layer;
+
+    for (int points : { 100, 10000 }) {
+        QVariantMap source;
+        source[QStringLiteral("name")] = QStringLiteral("points");
+        source[QStringLiteral("sourceType")] = QStringLiteral("geojson");
+        source[QStringLiteral("data")] = QString::fromLatin1(pointsGeoJson(points));
+        QTest::newRow(qPrintable(QStringLiteral("geojson source, %1 points").arg(points)))
+                << QStringLiteral("source") << source;
+    }
+}
+
+void tst_QMapboxGLStyleChanges::addMapParameter()
+{
+    QFETCH(QString, type);
+    QFETCH(QVariantMap, properties);
+
+    QGeoMapParameter param;
+    param.setType(type);
+    for (auto it = properties.constBegin(); it != properties.constEnd(); ++it)
+        param.setProperty(it.key().toLatin1().constData(), it.value());
+
+    QBENCHMARK {
+        QMapboxGLStyleChange::addMapParameter(&param);
+    }
+}
+
+void tst_QMapboxGLStyleChanges::syncStyleChanges_data()
+{
+    QTest::addColumn<int>("items");
+
+    QTest::newRow("1") << 1;
+    QTest::newRow("100") << 100;
+    QTest::newRow("1000") << 1000;
+}
+
+void tst_QMapboxGLStyleChanges::syncStyleChanges()
+{
+    QFETCH(int, items);
+
+    if (!m_map)
+        QSKIP("No offscreen OpenGL context available.");
+
+    QList<QSharedPointer<QDeclarativePolylineMapItem>> polylines;
+    QList<QSharedPointer<QMapboxGLStyleChange>> added;
+    QList<QSharedPointer<QMapboxGLStyleChange>> removed;
+
+    for (int i = 0; i < items; ++i) {
+        QSharedPointer<QDeclarativePolylineMapItem> item(new QDeclarativePolylineMapItem);
+        item->setGeoShape(QGeoPath(path(100)));
+        polylines << item;
+
+        added << QMapboxGLStyleChange::addMapItem(item.data(), QString());
+        removed << QMapboxGLStyleChange::removeMapItem(item.data());
+    }
+
+    // Added and removed again, so every round starts from the same style.
+    QBENCHMARK {
+        for (const auto &change : qAsConst(added))
+            change->apply(m_map.data());
+        for (const auto &change : qAsConst(removed))
+            change->apply(m_map.data());
+    }
+}
+
+QTEST_MAIN(tst_QMapboxGLStyleChanges)
+
+#include "tst_bench_qmapboxglstylechanges.moc"
@@ -0,0 +1,18 @@
+TARGET = tst_bench_qmapboxgltilearchive
+
+CONFIG += benchmark
+
+QT += \
+    testlib \
+    sql
+
+INCLUDEPATH += $$PWD/../..
+
+HEADERS += \
+    ../../qmapboxgltilearchive_p.h
+
+SOURCES += \
+    tst_bench_qmapboxgltilearchive.cpp \
+    ../../qmapboxgltilearchive.cpp
+
+include(../../mapboxgl_dependency.pri)
@@ -0,0 +1,247 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Copyright (C) 2017 Mapbox, Inc.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the QtLocation module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL3$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or later as published by the Free
+** Software Foundation and appearing in the file LICENSE.GPL included in
+** the packaging of this file. Please review the following information to
+** ensure the GNU General Public License version 2.0 requirements will be
+** met: http://www.gnu.org/licenses/gpl-2.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qmapboxgltilearchive_p.h"
+
+#include <QtCore/QFile>
+#include <QtCore/QRandomGenerator>
+#include <QtCore/QTemporaryDir>
+#include <QtSql/QSqlDatabase>
+#include <QtSql/QSqlQuery>
+#include <QtTest/QtTest>
+
+namespace {
+
+// Every tile up to zoom level 7, read back at random from zoom level 7.
+const int maximumZoom = 7;
+const int tileSize = 1024;
+const int leafSize = 4096;
+const int readsPerRound = 1000;
+
+void appendVarint(QByteArray *bytes, quint64 value)
+{
+    while (value >= 0x80) {
+        bytes->append(char((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    bytes->append(char(value));
+}
+
+void appendLittleEndian(QByteArray *bytes, quint64 value, int size)
+{
+    for (int i = 0; i < size; ++i)
+        bytes->append(char((value >> (8 * i)) & 0xff));
+}
+
+// Consecutive tile ids, each with a tile of its own stored right after
+// the previous one.
+QByteArray encodeLeaf(quint64 firstId, quint64 count, quint64 firstOffset)
+{
+    QByteArray bytes;
+    appendVarint(&bytes, count);
+    for (quint64 i = 0; i < count; ++i)
+        appendVarint(&bytes, i == 0 ? firstId : 1);
+    for (quint64 i = 0; i < count; ++i)
+        appendVarint(&bytes, 1);
+    for (quint64 i = 0; i < count; ++i)
+        appendVarint(&bytes, tileSize);
+    for (quint64 i = 0; i < count; ++i)
+        appendVarint(&bytes, i == 0 ? firstOffset + 1 : 0);
+    return bytes;
+}
+
+} // namespace
+
+// Measures random tile reads from local PMTiles and MBTiles archives
+// holding the same tiles. The files stay in the page cache, so this
+// compares directory lookups and SQLite overhead rather than disk access.
+class tst_QMapboxGLTileArchive : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+
+    void readTiles_data();
+    void readTiles();
+
+private:
+    void writePMTiles(const QString &fileName, const QByteArray &data);
+    void writeMBTiles(const QString &fileName, const QByteArray &data);
+
+    QTemporaryDir m_dir;
+};
+
+void tst_QMapboxGLTileArchive::initTestCase()
+{
+    QVERIFY(m_dir.isValid());
+
+    // Random bytes, roughly what compressed vector tiles look like.
+    QRandomGenerator random(1);
+    QByteArray data(tileSize, Qt::Uninitialized);
+    random.fillRange(reinterpret_cast<quint32 *>(data.data()), tileSize / 4);
+
+    writePMTiles(m_dir.filePath(QStringLiteral("tiles.pmtiles")), data);
+    writeMBTiles(m_dir.filePath(QStringLiteral("tiles.mbtiles")), data);
+}
+
+void tst_QMapboxGLTileArchive::writePMTiles(const QString &fileName, const QByteArray &data)
+{
+    const quint64 tileCount = ((quint64(1) << (2 * (maximumZoom + 1))) - 1) / 3;
+
+    // The tiles are all alike but stored separately, as in a real archive.
+    QByteArray leaves;
+    QVector<quint64> leafLengths;
+    for (quint64 first = 0; first < tileCount; first += leafSize) {
+        const quint64 count = qMin<quint64>(leafSize, tileCount - first);
+        const QByteArray leaf = encodeLeaf(first, count, first * tileSize);
+        leafLengths.append(quint64(leaf.size()));
+        leaves.append(leaf);
+    }
+
+    QByteArray root;
+    appendVarint(&root, quint64(leafLengths.size()));
+    for (int i = 0; i < leafLengths.size(); ++i)
+        appendVarint(&root, i == 0 ? 0 : leafSize);
+    for (int i = 0; i < leafLengths.size(); ++i)
+        appendVarint(&root, 0);
+    for (quint64 length : leafLengths)
+        appendVarint(&root, length);
+    for (int i = 0; i < leafLengths.size(); ++i)
+        appendVarint(&root, i == 0 ? 1 : 0);
+
+    const QByteArray metadata("{}");
+
+    const quint64 rootOffset = 127;
+    const quint64 metadataOffset = rootOffset + quint64(root.size());
+    const quint64 leavesOffset = metadataOffset + quint64(metadata.size());
+    const quint64 tileDataOffset = leavesOffset + quint64(leaves.size());
+
+    QByteArray header("PMTiles");
+    header.append(char(3));
+    for (quint64 value : { rootOffset, quint64(root.size()), metadataOffset, quint64(metadata.size()),
+                           leavesOffset, quint64(leaves.size()), tileDataOffset, tileCount * tileSize,
+                           tileCount, tileCount, tileCount })
+        appendLittleEndian(&header, value, 8);
+    header.append(char(1));                     // clustered
+    header.append(char(1));                     // no directory compression
+    header.append(char(1));                     // no tile compression
+    header.append(char(1));                     // vector tiles
+    header.append(char(0));
+    header.append(char(maximumZoom));
+    header.append(QByteArray(127 - header.size(), '\0'));
+
+    QFile file(fileName);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write(header + root + metadata + leaves);
+    for (quint64 i = 0; i < tileCount; ++i)
+        file.write(data);
+}
+
+void tst_QMapboxGLTileArchive::writeMBTiles(const QString &fileName, const QByteArray &data)
+{
+    const QString connectionName = QStringLiteral("bench-mbtiles");
+
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), connectionName);
+        db.setDatabaseName(fileName);
+        QVERIFY(db.open());
+
+        // The unique index tile writers create along with the table.
+        QSqlQuery query(db);
+        QVERIFY(query.exec(QStringLiteral("CREATE TABLE metadata (name TEXT, value TEXT)")));
+        QVERIFY(query.exec(QStringLiteral("INSERT INTO metadata VALUES ('format', 'pbf')")));
+        QVERIFY(query.exec(QStringLiteral("CREATE TABLE tiles (zoom_level INTEGER, tile_column INTEGER, tile_row INTEGER, tile_data BLOB)")));
+        QVERIFY(query.exec(QStringLiteral("CREATE UNIQUE INDEX tile_index ON tiles (zoom_level, tile_column, tile_row)")));
+
+        QVERIFY(db.transaction());
+        query.prepare(QStringLiteral("INSERT INTO tiles VALUES (?, ?, ?, ?)"));
+        for (int z = 0; z <= maximumZoom; ++z) {
+            for (int x = 0; x < (1 << z); ++x) {
+                for (int y = 0; y < (1 << z); ++y) {
+                    query.bindValue(0, z);
+                    query.bindValue(1, x);
+                    query.bindValue(2, y);
+                    query.bindValue(3, data);
+                    QVERIFY(query.exec());
+                }
+            }
+        }
+        QVERIFY(db.commit());
+
+        db.close();
+    }
+    QSqlDatabase::removeDatabase(connectionName);
+}
+
+void tst_QMapboxGLTileArchive::readTiles_data()
+{
+    QTest::addColumn<QString>("url");
+
+    QTest::newRow("pmtiles") << QStringLiteral("pmtiles://") + m_dir.filePath(QStringLiteral("tiles.pmtiles"));
+    QTest::newRow("mbtiles") << QStringLiteral("mbtiles://") + m_dir.filePath(QStringLiteral("tiles.mbtiles"));
+}
+
+void tst_QMapboxGLTileArchive::readTiles()
+{
+    QFETCH(QString, url);
+
+    QScopedPointer<QMapboxGLTileArchive> archive(QMapboxGLTileArchive::open(url));
+    QVERIFY(archive);
+
+    // The same tiles for every row, all of them in the archive.
+    QRandomGenerator random(2);
+    QVector<QPoint> tiles;
+    for (int i = 0; i < readsPerRound; ++i)
+        tiles.append(QPoint(random.bounded(1 << maximumZoom), random.bounded(1 << maximumZoom)));
+
+    QByteArray data;
+    bool gzipped = false;
+
+    QBENCHMARK {
+        for (const QPoint &tile : tiles) {
+            if (!archive->tile(maximumZoom, tile.x(), tile.y(), &data, &gzipped))
+                QFAIL("Missing tile");
+        }
+    }
+
+    QCOMPARE(data.size(), tileSize);
+}
+
+QTEST_MAIN(tst_QMapboxGLTileArchive)
+
+#include "tst_bench_qmapboxgltilearchive.moc"
@@ -12,36 +12,58 @@ HEADERS += \
     qgeomappingmanagerenginemapboxgl.h \
     qgeomapmapboxgl.h \
     qgeomapmapboxgl_p.h \
+    qmapboxglcachedatabase_p.h \
+    qmapboxglcachemaintainer_p.h \
+    qmapboxglcachewarmer_p.h \
+    qmapboxglcameraanimation_p.h \
+    qmapboxglframereader_p.h \
+    qmapboxglframetiming_p.h \
+    qmapboxgloffscreencontext_p.h \
+    qmapboxglmappool_p.h \
+    qmapboxglmarkerlayer_p.h \
+    qmapboxglofflinedownloader.h \
+    qmapboxglprefetcher_p.h \
+    qmapboxglrequestscheduler_p.h \
+    qmapboxglsessionrecorder_p.h \
+    qmapboxglsharedresources_p.h \
     qmapboxglstylechange_p.h \
+    qmapboxglstyleresources_p.h \
+    qmapboxgltilearchive_p.h \
+    qmapboxgltileserver_p.h \
+    qmapboxgltrace_p.h \
     qsgmapboxglnode.h
 
 SOURCES += \
     qgeoserviceproviderpluginmapboxgl.cpp \
     qgeomappingmanagerenginemapboxgl.cpp \
     qgeomapmapboxgl.cpp \
+    qmapboxglcachedatabase.cpp \
+    qmapboxglcachemaintainer.cpp \
+    qmapboxglcachewarmer.cpp \
+    qmapboxglcameraanimation.cpp \
+    qmapboxglframereader.cpp \
+    qmapboxglframetiming.cpp \
+    qmapboxgloffscreencontext.cpp \
+    qmapboxglmappool.cpp \
+    qmapboxglmarkerlayer.cpp \
+    qmapboxglofflinedownloader.cpp \
+    qmapboxglprefetcher.cpp \
+    qmapboxglrequestscheduler.cpp \
+    qmapboxglsessionrecorder.cpp \
+    qmapboxglsharedresources.cpp \
     qmapboxglstylechange.cpp \
+    qmapboxglstyleresources.cpp \
+    qmapboxgltilearchive.cpp \
+    qmapboxgltileserver.cpp \
+    qmapboxgltrace.cpp \
     qsgmapboxglnode.cpp
 
-# Mapbox GL Native is always a static
-# library linked to this plugin
-QMAKE_CXXFLAGS += \
-    -DQT_MAPBOXGL_STATIC
-
 RESOURCES += mapboxgl.qrc
 
 OTHER_FILES += \
     mapboxgl_plugin.json
 
-INCLUDEPATH += ../../../3rdparty/mapbox-gl-native/platform/qt/include
-
-include(../../../3rdparty/zlib_dependency.pri)
-
-load(qt_build_paths)
-LIBS_PRIVATE += -L$$MODULE_BASE_OUTDIR/lib -lqmapboxgl$$qtPlatformTargetSuffix()
-
-qtConfig(icu) {
-    QMAKE_USE_PRIVATE += icu
-}
+include(mapboxgl_dependency.pri)
 
 PLUGIN_TYPE = geoservices
 PLUGIN_CLASS_NAME = QGeoServiceProviderFactoryMapboxGL
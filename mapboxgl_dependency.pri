@@ -0,0 +1,15 @@
+# Mapbox GL Native is always a static library, linked to the plugin and
+# to the tests and tools built from its sources.
+QMAKE_CXXFLAGS += \
+    -DQT_MAPBOXGL_STATIC
+
+INCLUDEPATH += $$PWD/../../../3rdparty/mapbox-gl-native/platform/qt/include
+
+include($$PWD/../../../3rdparty/zlib_dependency.pri)
+
+load(qt_build_paths)
+LIBS_PRIVATE += -L$$MODULE_BASE_OUTDIR/lib -lqmapboxgl$$qtPlatformTargetSuffix()
+
+qtConfig(icu) {
+    QMAKE_USE_PRIVATE += icu
+}
@@ -38,19 +38,35 @@
 #include "qgeomapmapboxgl.h"
 #include "qgeomapmapboxgl_p.h"
 #include "qsgmapboxglnode.h"
+#include "qmapboxglcameraanimation_p.h"
+#include "qmapboxglframetiming_p.h"
+#include "qmapboxglmappool_p.h"
+#include "qmapboxglmarkerlayer_p.h"
+#include "qmapboxglprefetcher_p.h"
+#include "qmapboxglrequestscheduler_p.h"
+#include "qmapboxglsessionrecorder_p.h"
 #include "qmapboxglstylechange_p.h"
+#include "qmapboxgltrace_p.h"
 
 #include <QtCore/QByteArray>
 #include <QtCore/QCoreApplication>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtGui/QImageReader>
 #include <QtGui/QOpenGLContext>
 #include <QtGui/QOpenGLFramebufferObject>
 #include <QtLocation/private/qdeclarativecirclemapitem_p.h>
 #include <QtLocation/private/qdeclarativegeomapitembase_p.h>
+#include <QtLocation/private/qdeclarativegeomapquickitem_p.h>
 #include <QtLocation/private/qdeclarativepolygonmapitem_p.h>
 #include <QtLocation/private/qdeclarativepolylinemapitem_p.h>
 #include <QtLocation/private/qdeclarativerectanglemapitem_p.h>
 #include <QtLocation/private/qgeomapparameter_p.h>
 #include <QtLocation/private/qgeoprojection_p.h>
+#include <QtPositioning/QGeoPath>
+#include <QtPositioning/QGeoPolygon>
+#include <QtPositioning/private/qwebmercator_p.h>
+#include <QtQml/QQmlFile>
 #include <QtQuick/QQuickWindow>
 #include <QtQuick/QSGImageNode>
 #include <QtQuick/private/qsgtexture_p.h>
@@ -63,6 +79,31 @@
 // FIXME: Expose from Mapbox GL constants
 #define MBGL_TILE_SIZE 512.0
 
+// Interval of the polling timer that used to drive threaded rendering,
+// kept as the reference for counting the renders we no longer issue.
+#define LEGACY_REFRESH_INTERVAL 250
+#define FALLBACK_REFRESH_INTERVAL_MIN 250
+#define FALLBACK_REFRESH_INTERVAL_MAX 4000
+
+// Time without camera changes after which the camera is considered settled.
+#define CAMERA_SETTLE_INTERVAL 150
+
+// Camera samples further apart than this do not give a usable velocity.
+#define CAMERA_MOTION_MAX_SAMPLE_INTERVAL 500
+
+// Memory accounting is refreshed at most this often.
+#define MEMORY_UPDATE_INTERVAL 500
+
+// Rough bookkeeping cost of one source or layer inside Mapbox GL, plus the
+// size of one coordinate pair, used to estimate the managed style content.
+#define MANAGED_SOURCE_OVERHEAD 4096
+#define MANAGED_LAYER_OVERHEAD 1024
+#define COORDINATE_BYTES 16
+
+// Rough cost of the tiles a standby map keeps loaded, per pixel of the
+// framebuffer it renders into.
+#define STANDBY_MAP_BYTES_PER_PIXEL 8
+
 namespace {
 
 // WARNING! The development token is subject to Mapbox Terms of Services
@@ -90,6 +131,76 @@ static double zoomLevelFrom256(double zoomLevelFor256, double tileSize)
     return std::log(std::pow(2.0, zoomLevelFor256) * 256.0 / tileSize) * invLog2;
 }
 
+/**
+ * @brief 估算图元生成的GeoJSON数据源的大小，只统计顶点数，不做转换
+ * 
+ * @param item 
+ * @return qint64 
+ */
+static qint64 estimateMapItemBytes(QDeclarativeGeoMapItemBase *item)
+{
+    int vertices = 0;
+
+    switch (item->itemType()) {
+    case QGeoMap::MapRectangle:
+        vertices = 5;
+        break;
+    case QGeoMap::MapCircle:
+        vertices = 129;     // 128个采样点加闭合点
+        break;
+    case QGeoMap::MapPolygon: {
+        const QGeoPolygon *polygon = static_cast<const QGeoPolygon *>(&item->geoShape());
+        vertices = polygon->path().size() + 1;
+        for (int i = 0; i < polygon->holesCount(); ++i)
+            vertices += polygon->holePath(i).size() + 1;
+    } break;
+    case QGeoMap::MapPolyline:
+        vertices = static_cast<const QGeoPath *>(&item->geoShape())->path().size();
+        break;
+    default:
+        return 0;
+    }
+
+    return MANAGED_SOURCE_OVERHEAD + MANAGED_LAYER_OVERHEAD + qint64(vertices) * COORDINATE_BYTES;
+}
+
+/**
+ * @brief 估算参数创建的数据源、图层或图片的大小
+ * 
+ * @param param 
+ * @param sources 数据源计数
+ * @param layers 图层计数
+ * @return qint64 
+ */
+static qint64 estimateMapParameterBytes(QGeoMapParameter *param, int *sources, int *layers)
+{
+    const QString type = param->property("type").toString();
+
+    if (type == QStringLiteral("source")) {
+        ++*sources;
+
+        qint64 bytes = MANAGED_SOURCE_OVERHEAD;
+        if (param->property("sourceType").toString() == QStringLiteral("geojson")) {
+            const QString data = param->property("data").toString();
+            bytes += data.startsWith(QLatin1Char(':')) ? QFileInfo(data).size() : data.size();
+        }
+        return bytes;
+    }
+
+    if (type == QStringLiteral("layer")) {
+        ++*layers;
+        return MANAGED_LAYER_OVERHEAD;
+    }
+
+    if (type == QStringLiteral("image")) {
+        // 只读取图片头，解码后按RGBA计算
+        const QSize size = QImageReader(param->property("sprite").toString()).size();
+        return size.isValid() ? qint64(size.width()) * size.height() * 4 : 0;
+    }
+
+    return 0;
+}
+
 } // namespace
 
 /**
@@ -108,6 +219,8 @@ QGeoMapMapboxGLPrivate::QGeoMapMapboxGLPrivate(QGeoMappingManagerEngineMapboxGL
  */
 QGeoMapMapboxGLPrivate::~QGeoMapMapboxGLPrivate()
 {
+    if (m_requestScheduler)
+        m_requestScheduler->removeViewport(this);
 }
 
 
@@ -123,13 +236,33 @@ QSGNode *QGeoMapMapboxGLPrivate::updateSceneGraph(QSGNode *node, QQuickWindow *w
 {
     Q_Q(QGeoMapMapboxGL);
 
+    // 上一帧的各阶段耗时在这里提交，本帧的总耗时随函数返回记录
+    QMapboxGLFrameTiming *timing = m_frameTiming.data();
+    if (timing)
+        timing->commitFrame();
+
+    QMapboxGLFrameTiming::Scope totalScope(timing, QMapboxGLFrameTiming::Total);
+
     if (m_viewportSize.isEmpty()) {     // 为空的话退出
+        if (node && m_mapPool) {
+            // 地图隐藏时保留 QMapboxGL，重新显示时不必重新加载样式和瓦片
+            QMapboxGL *released = (m_useFBO) ? static_cast<QSGMapboxGLTextureNode *>(node)->takeMap()
+                                             : static_cast<QSGMapboxGLRenderNode *>(node)->takeMap();
+            QObject::disconnect(released, nullptr, q, nullptr);
+            m_mapPool->release(q, released, m_pixelRatio, m_styleLoaded, window);
+        }
+
         delete node;
+        m_framebufferBytes = 0;
+        m_standbyMaps = 0;
+        m_standbyMapBytes = 0;
         return 0;
     }
 
     QMapboxGL *map = 0;                                                     // 定义了一个QMapboxGL对象
     if (!node) {
+        QMapboxGLFrameTiming::Scope scope(timing, QMapboxGLFrameTiming::NodeCreation);
+
         QOpenGLContext *currentCtx = QOpenGLContext::currentContext();      //获取上下文
         if (!currentCtx) {                                                  // 获取上下文失败
             qWarning("QOpenGLContext is NULL!");
@@ -140,51 +273,139 @@ QSGNode *QGeoMapMapboxGLPrivate::updateSceneGraph(QSGNode *node, QQuickWindow *w
 
             return node;
         }
+
+        bool warm = false;
+        QMapboxGL *pooled = m_mapPool ? m_mapPool->acquire(q, window->devicePixelRatio(), &warm) : nullptr;
+        if (pooled && !warm) {
+            // 别的地图用过的实例：先清空样式，保证之后的 setStyleUrl 重新加载并重新添加地图元素
+            pooled->setStyleJson(QStringLiteral("{\"version\": 8, \"sources\": {}, \"layers\": []}"));
+        }
+
+        // 复用的地图保留了自己的样式，新建或清空的地图还没有样式，不能当作备用地图换出去
+        m_styleUrl = warm ? pooled->styleUrl() : QString();
+
         if (m_useFBO) { // 使用帧缓存对象，OpenGL帧缓存对象(FBO：Frame Buffer Object)
-            QSGMapboxGLTextureNode *mbglNode = new QSGMapboxGLTextureNode(m_settings, m_viewportSize, window->devicePixelRatio(), q);
+            QSGMapboxGLTextureNode *mbglNode = new QSGMapboxGLTextureNode(m_settings, m_viewportSize, window->devicePixelRatio(), q, pooled);
+            QObject::connect(mbglNode->map(), &QMapboxGL::needsRendering, q, &QGeoMapMapboxGL::onMapNeedsRendering);
             QObject::connect(mbglNode->map(), &QMapboxGL::mapChanged, q, &QGeoMapMapboxGL::onMapChanged);  // 当地图发生变化时调用地图变化的槽函数
-            m_syncState = MapTypeSync | CameraDataSync | ViewportSync | VisibleAreaSync;    // 同步设置
+            if (m_prefetchers)
+                mbglNode->setPrefetcher(m_prefetchers->acquire(currentCtx, m_settings, window->devicePixelRatio()));
+            mbglNode->setFrameTiming(timing, m_gpuTiming);
+
+            // 预加载的样式各用一个备用地图实例，切换地图类型时直接换过来
+            for (const QString &styleUrl : qAsConst(m_preloadedStyles)) {
+                if (styleUrl == m_activeMapType.name())
+                    continue;
+
+                QMapboxGL *standby = new QMapboxGL(nullptr, m_settings, m_viewportSize.expandedTo(QSize(64, 64)), window->devicePixelRatio());
+                standby->setStyleUrl(styleUrl);
+                mbglNode->addStandbyMap(styleUrl, standby);
+            }
+            m_standbyRefresh = mbglNode->standbyMapCount() > 0;
+
+            m_syncState = m_syncState | (warm ? NoSync : MapTypeSync) | CameraDataSync | ViewportSync | VisibleAreaSync;    // 同步设置
+            m_cameraApplied = false;
+            m_appliedMargins = QMargins();
             node = mbglNode;
         } else { // 不使用帧缓存对象，调用QSGMapboxGLRenderNode
-            QSGMapboxGLRenderNode *mbglNode = new QSGMapboxGLRenderNode(m_settings, m_viewportSize, window->devicePixelRatio(), q);
+            QSGMapboxGLRenderNode *mbglNode = new QSGMapboxGLRenderNode(m_settings, m_viewportSize, window->devicePixelRatio(), q, pooled);
+            QObject::connect(mbglNode->map(), &QMapboxGL::needsRendering, q, &QGeoMapMapboxGL::onMapNeedsRendering);
             QObject::connect(mbglNode->map(), &QMapboxGL::mapChanged, q, &QGeoMapMapboxGL::onMapChanged);
-            m_syncState = MapTypeSync | CameraDataSync | ViewportSync | VisibleAreaSync;
+            m_syncState = m_syncState | (warm ? NoSync : MapTypeSync) | CameraDataSync | ViewportSync | VisibleAreaSync;
+            m_cameraApplied = false;
+            m_appliedMargins = QMargins();
             node = mbglNode;
         }
     }
     map = (m_useFBO) ? static_cast<QSGMapboxGLTextureNode *>(node)->map()
                      : static_cast<QSGMapboxGLRenderNode *>(node)->map();
 
+    QMapboxGLPrefetcher *prefetcher = (m_useFBO) ? static_cast<QSGMapboxGLTextureNode *>(node)->prefetcher() : nullptr;
+
+    // 上一帧以来所有标记的变化只生成一次数据源更新，样式加载完之前保持未同步状态
+    if (m_styleLoaded && m_markers->isDirty())
+        enqueueStyleChanges(m_markers->takeChanges(m_mapItemsBefore));
+
+    const bool changed = m_syncState != NoSync || !m_styleChanges.isEmpty() || !m_cameraAnimation.isNull();
+
+    // 回放时需要先知道像素比才能创建地图，所以视口最先记录
+    if (m_recorder && m_syncState & ViewportSync)
+        m_recorder->recordViewport(m_viewportSize, window->devicePixelRatio());
+
     if (m_syncState & MapTypeSync) {
+        QMapboxGLFrameTiming::Scope scope(timing, QMapboxGLFrameTiming::StyleSync);
+
         m_developmentMode = m_activeMapType.name().startsWith("mapbox://")
             && m_settings.accessToken() == developmentToken;
 
-        map->setStyleUrl(m_activeMapType.name());  // 设置风格样式
+        const QString styleUrl = m_activeMapType.name();
+        if (m_useFBO && switchToStandbyMap(static_cast<QSGMapboxGLTextureNode *>(node), styleUrl)) {
+            map = static_cast<QSGMapboxGLTextureNode *>(node)->map();
+            ++m_instantStyleSwitches;
+        } else {
+            map->setStyleUrl(styleUrl);  // 设置风格样式
+        }
+        m_styleUrl = styleUrl;
+        ++m_styleSwitches;
+
+        if (m_recorder)
+            m_recorder->recordStyleUrl(m_activeMapType.name());
     }
 
     if (m_syncState & VisibleAreaSync) {
-        if (m_visibleArea.isEmpty()) {
-            map->setMargins(QMargins());
-        } else {
+        QMargins margins;
+        if (!m_visibleArea.isEmpty()) {
             // QMargins定义了矩形的四个外边距量，left,top,right和bottom，描述围绕矩形的边框宽度。
-            QMargins margins(m_visibleArea.x(),                                                     // left
-                             m_visibleArea.y(),                                                     // top
-                             m_viewportSize.width() - m_visibleArea.width() - m_visibleArea.x(),    // right
-                             m_viewportSize.height() - m_visibleArea.height() - m_visibleArea.y()); // bottom
+            margins = QMargins(m_visibleArea.x(),                                                     // left
+                               m_visibleArea.y(),                                                     // top
+                               m_viewportSize.width() - m_visibleArea.width() - m_visibleArea.x(),    // right
+                               m_viewportSize.height() - m_visibleArea.height() - m_visibleArea.y()); // bottom
+        }
+
+        if (margins != m_appliedMargins) {
+            // The margins are only stored by QMapboxGL and take effect
+            // with the next camera jump, which must then recenter the map.
             map->setMargins(margins);
+            m_appliedMargins = margins;
+            m_cameraApplied = false;
+
+            if (m_recorder)
+                m_recorder->recordMargins(margins);
         }
     }
 
-    if (m_syncState & CameraDataSync || m_syncState & VisibleAreaSync) {
-        map->setZoom(zoomLevelFrom256(m_cameraData.zoomLevel() , MBGL_TILE_SIZE));      // 设置缩放
-        map->setBearing(m_cameraData.bearing());                                        // 设置角度
-        map->setPitch(m_cameraData.tilt());                                             // 设置地图的俯仰（倾斜）
+    if (m_cameraAnimation) {
+        QMapboxGLFrameTiming::Scope scope(timing, QMapboxGLFrameTiming::CameraSync);
+
+        // Interpolated here, once per rendered frame, so the animation
+        // does not depend on camera updates coming from the GUI thread.
+        syncCamera(map, m_cameraAnimation->cameraData());
+        m_lastCameraChange.start();
 
-        QGeoCoordinate coordinate = m_cameraData.center();                              // QGeoCoordinate 由纬度、经度和可选的海拔高度定义。这里应该是中心的地理位置
-        map->setCoordinate(QMapbox::Coordinate(coordinate.latitude(), coordinate.longitude()));     // 设置地理位置
+        // Every rendered frame is also published to QGeoMap, so gestures and
+        // bindings on the GUI thread start from what is on screen.
+        if (m_cameraAnimation->isFinished()) {
+            QMetaObject::invokeMethod(q, "onCameraAnimationFinished", Qt::QueuedConnection);
+        } else {
+            QMetaObject::invokeMethod(q, "onCameraAnimationSync", Qt::QueuedConnection);
+            emit q->sgNodeChanged();
+        }
+    } else if (m_syncState & CameraDataSync || m_syncState & VisibleAreaSync) {
+        QMapboxGLFrameTiming::Scope scope(timing, QMapboxGLFrameTiming::CameraSync);
+
+        syncCamera(map, m_cameraData);
+    }
+
+    if (prefetcher && (m_cameraAnimation || m_syncState & CameraDataSync)) {
+        updatePrefetchStatistics(m_cameraAnimation ? m_cameraAnimation->cameraData() : m_cameraData);
     }
 
     if (m_syncState & ViewportSync) {
+        QMapboxGLFrameTiming::Scope scope(timing, QMapboxGLFrameTiming::Resize);
+        QMapboxGLTrace::Scope trace("resize", "render");
+
+        m_pixelRatio = window->devicePixelRatio();
+
         if (m_useFBO) {
             static_cast<QSGMapboxGLTextureNode *>(node)->resize(m_viewportSize, window->devicePixelRatio());
         } else {
@@ -193,11 +414,55 @@ QSGNode *QGeoMapMapboxGLPrivate::updateSceneGraph(QSGNode *node, QQuickWindow *w
     }
 
     if (m_styleLoaded) {
+        QMapboxGLFrameTiming::Scope scope(timing, QMapboxGLFrameTiming::StyleSync);
+
+        if (prefetcher)
+            prefetcher->applyStyleChanges(q, m_styleUrl, m_styleChanges);
         syncStyleChanges(map);
     }
 
+    if (m_useFBO && !throttleRender(map, changed)) {
+        QSGMapboxGLTextureNode *mbglNode = static_cast<QSGMapboxGLTextureNode *>(node);
+        if (m_adaptiveResolution)
+            updateRenderScale(mbglNode);
+
+        // 样式加载完并且风格变化都已同步，预取地图才能拿到完整的样式
+        if (prefetcher && m_styleLoaded && mbglNode->isStyleLoaded(map))
+            schedulePrefetch(prefetcher);
+
+        // 相机停下来后让备用地图也加载当前视野的瓦片，切换过去时不用再等
+        if (m_standbyRefresh && !m_cameraAnimation) {
+            QMapboxGLTrace::Scope trace("standbyMaps", "render");
+
+            QMapboxGLCameraOptions camera;
+            camera.center = QVariant::fromValue(QMapbox::Coordinate(m_cameraData.center().latitude(), m_cameraData.center().longitude()));
+            camera.zoom = zoomLevelFrom256(m_cameraData.zoomLevel(), MBGL_TILE_SIZE);
+            camera.bearing = m_cameraData.bearing();
+            camera.pitch = m_cameraData.tilt();
+
+            mbglNode->renderStandbyMaps(window, camera, m_appliedMargins);
+            m_standbyRefresh = false;
+        }
+
+        QElapsedTimer frameTimer;
+        frameTimer.start();
+        mbglNode->render(window);
+        m_lastFrameTime = frameTimer.nsecsElapsed();
+
+        if (m_recorder)
+            m_recorder->recordFrame();
+    } else if (!m_useFBO && m_recorder) {
+        // 渲染节点在同步之后的渲染阶段绘制，每次同步都对应一帧
+        m_recorder->recordFrame();
+    }
+
     if (m_useFBO) {
-        static_cast<QSGMapboxGLTextureNode *>(node)->render(window);
+        QSGMapboxGLTextureNode *mbglNode = static_cast<QSGMapboxGLTextureNode *>(node);
+        captureFrames(mbglNode);
+        m_framebufferBytes = mbglNode->framebufferBytes();
+        m_standbyMaps = mbglNode->standbyMapCount();
+        m_standbyMapBytes = qint64(m_standbyMaps) * m_viewportSize.width() * m_viewportSize.height()
+                * m_pixelRatio * m_pixelRatio * STANDBY_MAP_BYTES_PER_PIXEL;
     }
 
     threadedRenderingHack(window, map);
@@ -220,8 +485,25 @@ void QGeoMapMapboxGLPrivate::addParameter(QGeoMapParameter *param)
     QObject::connect(param, &QGeoMapParameter::propertyUpdated, q,
         &QGeoMapMapboxGL::onParameterPropertyUpdated);
 
+    if (param->type() == QStringLiteral("camera")) {
+        applyCameraParameter(param);
+        return;
+    }
+
+    if (param->type() == QStringLiteral("memoryUsage")) {
+        publishMemoryUsage(param);
+        return;
+    }
+
+    if (param->type() == QStringLiteral("markers")) {
+        applyMarkersParameter(param);
+        return;
+    }
+
+    updateParameterBytes(param);
+
     if (m_styleLoaded) {
-        m_styleChanges << QMapboxGLStyleChange::addMapParameter(param);
+        enqueueStyleChanges(QMapboxGLStyleChange::addMapParameter(param));
         emit q->sgNodeChanged();
     }
 }
@@ -238,12 +520,88 @@ void QGeoMapMapboxGLPrivate::removeParameter(QGeoMapParameter *param)
 
     q->disconnect(param);
 
+    if (m_parameterBytes.remove(param))
+        scheduleMemoryUpdate();
+
+    if (param->type() == QStringLiteral("markers")) {
+        m_markers->removePoints(param);
+        return;
+    }
+
     if (m_styleLoaded) {
-        m_styleChanges << QMapboxGLStyleChange::removeMapParameter(param);
+        enqueueStyleChanges(QMapboxGLStyleChange::removeMapParameter(param));
         emit q->sgNodeChanged();
     }
 }
 
+/**
+ * @brief 按 camera 类型参数的属性启动相机动画，QML 通过修改参数属性移动相机
+ *
+ * 参数可以声明 animation（"easeTo" 或 "flyTo"）、coordinate、zoomLevel、
+ * bearing、tilt、duration 和 easing（Easing 枚举），没有声明的相机属性保持不变
+ *
+ * @param param
+ */
+void QGeoMapMapboxGLPrivate::applyCameraParameter(QGeoMapParameter *param)
+{
+    Q_Q(QGeoMapMapboxGL);
+
+    QGeoCameraData cameraData = m_cameraData;
+
+    const QGeoCoordinate coordinate = param->property("coordinate").value<QGeoCoordinate>();
+    if (coordinate.isValid())
+        cameraData.setCenter(coordinate);
+
+    const QVariant zoomLevel = param->property("zoomLevel");
+    if (zoomLevel.isValid())
+        cameraData.setZoomLevel(zoomLevel.toDouble());
+
+    const QVariant bearing = param->property("bearing");
+    if (bearing.isValid())
+        cameraData.setBearing(bearing.toDouble());
+
+    const QVariant tilt = param->property("tilt");
+    if (tilt.isValid())
+        cameraData.setTilt(tilt.toDouble());
+
+    const QVariant easing = param->property("easing");
+    const QEasingCurve curve(easing.isValid() ? QEasingCurve::Type(easing.toInt()) : QEasingCurve::InOutQuad);
+
+    const QVariant duration = param->property("duration");
+    if (param->property("animation").toString() == QStringLiteral("flyTo"))
+        q->flyTo(cameraData, duration.isValid() ? duration.toInt() : -1, curve);
+    else
+        q->easeTo(cameraData, duration.isValid() ? duration.toInt() : 0, curve);
+}
+
+/**
+ * @brief 把 markers 类型参数的 GeoJSON 点交给标记图层，和 MapQuickItem 标记
+ * 一起绘制和聚合，每个点不需要单独的 QQuickItem
+ *
+ * 参数声明 data（GeoJSON 文本，以 ":" 开头时为文件）和 icon（图标图片）
+ *
+ * @param param
+ */
+void QGeoMapMapboxGLPrivate::applyMarkersParameter(QGeoMapParameter *param)
+{
+    QByteArray data;
+    const QString dataProperty = param->property("data").toString();
+    if (dataProperty.startsWith(QLatin1Char(':'))) {
+        QFile geojson(dataProperty);
+        if (!geojson.open(QIODevice::ReadOnly)) {
+            qWarning() << "Unable to read markers data" << dataProperty;
+            m_markers->removePoints(param);
+            return;
+        }
+        data = geojson.readAll();
+    } else {
+        data = dataProperty.toUtf8();
+    }
+
+    const QString icon = QQmlFile::urlToLocalFileOrQrc(param->property("icon").toString());
+    m_markers->setPoints(param, data, icon);
+}
+
 /**
  * @brief 支持的地图图元类型类型
  * 
@@ -251,7 +609,11 @@ void QGeoMapMapboxGLPrivate::removeParameter(QGeoMapParameter *param)
  */
 QGeoMap::ItemTypes QGeoMapMapboxGLPrivate::supportedMapItemTypes() const
 {
-    return QGeoMap::MapRectangle | QGeoMap::MapCircle | QGeoMap::MapPolygon | QGeoMap::MapPolyline;
+    QGeoMap::ItemTypes types = QGeoMap::MapRectangle | QGeoMap::MapCircle | QGeoMap::MapPolygon | QGeoMap::MapPolyline;
+    if (m_quickItemsAsSymbols)
+        types |= QGeoMap::MapQuickItem;
+
+    return types;
 }
 
 
@@ -266,9 +628,13 @@ void QGeoMapMapboxGLPrivate::addMapItem(QDeclarativeGeoMapItemBase *item)
 
     switch (item->itemType()) {
     case QGeoMap::NoItem:
-    case QGeoMap::MapQuickItem:
     case QGeoMap::CustomMapItem:
         return;
+    case QGeoMap::MapQuickItem:
+        // 标记由共用的符号图层绘制，变化合并到每帧一次的数据源更新
+        if (m_quickItemsAsSymbols)
+            m_markers->addItem(static_cast<QDeclarativeGeoMapQuickItem *>(item));
+        return;
     case QGeoMap::MapRectangle: {
         QDeclarativeRectangleMapItem *mapItem = static_cast<QDeclarativeRectangleMapItem *>(item);
         QObject::connect(mapItem, &QQuickItem::visibleChanged, q, &QGeoMapMapboxGL::onMapItemPropertyChanged);
@@ -310,7 +676,7 @@ void QGeoMapMapboxGLPrivate::addMapItem(QDeclarativeGeoMapItemBase *item)
 
     QObject::connect(item, &QDeclarativeGeoMapItemBase::mapItemOpacityChanged, q, &QGeoMapMapboxGL::onMapItemPropertyChanged);
 
-    m_styleChanges << QMapboxGLStyleChange::addMapItem(item, m_mapItemsBefore);
+    enqueueStyleChanges(QMapboxGLStyleChange::addMapItem(item, m_mapItemsBefore));
 
     emit q->sgNodeChanged();
 }
@@ -326,9 +692,12 @@ void QGeoMapMapboxGLPrivate::removeMapItem(QDeclarativeGeoMapItemBase *item)
 
     switch (item->itemType()) {
     case QGeoMap::NoItem:
-    case QGeoMap::MapQuickItem:
     case QGeoMap::CustomMapItem:
         return;
+    case QGeoMap::MapQuickItem:
+        if (m_quickItemsAsSymbols)
+            m_markers->removeItem(static_cast<QDeclarativeGeoMapQuickItem *>(item));
+        return;
     case QGeoMap::MapRectangle:
         q->disconnect(static_cast<QDeclarativeRectangleMapItem *>(item)->border());
         break;
@@ -345,7 +714,7 @@ void QGeoMapMapboxGLPrivate::removeMapItem(QDeclarativeGeoMapItemBase *item)
 
     q->disconnect(item);
 
-    m_styleChanges << QMapboxGLStyleChange::removeMapItem(item);
+    enqueueStyleChanges(QMapboxGLStyleChange::removeMapItem(item));
 
     emit q->sgNodeChanged();
 }
@@ -360,15 +729,64 @@ void QGeoMapMapboxGLPrivate::changeViewportSize(const QSize &)
     Q_Q(QGeoMapMapboxGL);
 
     m_syncState = m_syncState | ViewportSync;
+    scheduleMemoryUpdate();
+    publishViewport();
     emit q->sgNodeChanged();
 }
 
+/**
+ * @brief 把当前视野告诉请求调度器，瓦片请求按离视野中心的远近排序
+ */
+void QGeoMapMapboxGLPrivate::publishViewport()
+{
+    if (!m_requestScheduler)
+        return;
+
+    m_requestScheduler->setViewport(this, m_cameraData.center(),
+                                    zoomLevelFrom256(m_cameraData.zoomLevel(), MBGL_TILE_SIZE), m_viewportSize);
+}
+
 
 
 void QGeoMapMapboxGLPrivate::changeCameraData(const QGeoCameraData &)
 {
     Q_Q(QGeoMapMapboxGL);
 
+    // Camera changes not coming from the animation itself, e.g. user
+    // gestures or QML bindings, take over from a running animation. The
+    // animation may have moved on since the frame the change was made
+    // against, so its current camera is published first and only the
+    // fields the change actually touched are kept.
+    if (m_cameraAnimation && !m_applyingAnimatedCamera) {
+        QGeoCameraData camera = m_cameraAnimation->cameraData();
+        if (m_cameraData.center() != m_publishedCamera.center())
+            camera.setCenter(m_cameraData.center());
+        if (m_cameraData.zoomLevel() != m_publishedCamera.zoomLevel())
+            camera.setZoomLevel(m_cameraData.zoomLevel());
+        if (m_cameraData.bearing() != m_publishedCamera.bearing())
+            camera.setBearing(m_cameraData.bearing());
+        if (m_cameraData.tilt() != m_publishedCamera.tilt())
+            camera.setTilt(m_cameraData.tilt());
+
+        stopCameraAnimation(true);
+
+        if (camera != m_cameraData) {
+            // Comes back through here with the animation already stopped.
+            publishCameraData(camera);
+            return;
+        }
+    }
+
+    if (m_adaptiveResolution || !m_preloadedStyles.isEmpty()) {
+        m_lastCameraChange.start();
+        m_cameraSettle.start(CAMERA_SETTLE_INTERVAL);
+    }
+
+    if (m_prefetchers)
+        trackCameraMotion();
+
+    publishViewport();
+
     m_syncState = m_syncState | CameraDataSync;
     emit q->sgNodeChanged();
 }
@@ -413,157 +831,1160 @@ QRectF QGeoMapMapboxGLPrivate::visibleArea() const
 
 
 /**
- * @brief 同步风格变化
+ * @brief 把风格变化加入待同步队列
  * 
- * @param map 
+ * @param changes 
  */
-void QGeoMapMapboxGLPrivate::syncStyleChanges(QMapboxGL *map)
+void QGeoMapMapboxGLPrivate::enqueueStyleChanges(const QList<QSharedPointer<QMapboxGLStyleChange>> &changes)
 {
-    for (const auto& change : m_styleChanges) {
-        change->apply(map);
+    if (QMapboxGLTrace::isEnabled()) {
+        for (const auto& change : changes)
+            QMapboxGLTrace::instant(change->kind(), "style.enqueue");
     }
 
-    m_styleChanges.clear();
-}
+    m_styleChanges << changes;
 
+    scheduleMemoryUpdate();
+}
 
 /**
- * @brief 渲染
- * 
- * @param window 
- * @param map 
+ * @brief 重新估算参数占用的内存，只在参数添加或属性变化时读取图片和文件
+ *
+ * @param param
  */
-void QGeoMapMapboxGLPrivate::threadedRenderingHack(QQuickWindow *window, QMapboxGL *map)
+void QGeoMapMapboxGLPrivate::updateParameterBytes(QGeoMapParameter *param)
 {
-    // FIXME: Optimal support for threaded rendering needs core changes
-    // in Mapbox GL Native. Meanwhile we need to set a timer to update
-    // the map until all the resources are loaded, which is not exactly
-    // battery friendly, because might trigger more paints than we need.
-    if (!m_warned) {
-        m_threadedRendering = window->openglContext()->thread() != QCoreApplication::instance()->thread();
-
-        if (m_threadedRendering) {
-            qWarning() << "Threaded rendering is not optimal in the Mapbox GL plugin.";
-        }
-
-        m_warned = true;
-    }
+    ParameterBytes estimate;
+    estimate.bytes = estimateMapParameterBytes(param, &estimate.sources, &estimate.layers);
+    m_parameterBytes.insert(param, estimate);
 
-    if (m_threadedRendering) {
-        if (!map->isFullyLoaded()) {
-            QMetaObject::invokeMethod(&m_refresh, "start", Qt::QueuedConnection);       // invokeMethod()方法用来调用一个对象的信号、槽、可调用的方法，这是一个静态方法
-                                                                                        // 第一个参数是被调用对象的指针；
-                                                                                        // 第二个参数是方法的名字；
-                                                                                        // 第三个参数是连接类型。可以指定连接类型，来决定是同步还是异步调用。
-                                                                                        // 如果type是Qt :: QueuedConnection，则会发送一个QEvent，并在应用程序进入主事件循环后立即调用该成员。
-                                                                                        // m_refresh为一个定时器，这里是启动或者停止定时器
-                                                                                        // 不是完全加载的时候才会启动定时器
-        } else {
-            QMetaObject::invokeMethod(&m_refresh, "stop", Qt::QueuedConnection);
-        }
-    }
+    scheduleMemoryUpdate();
 }
 
-/*
- * QGeoMapMapboxGL implementation
+/**
+ * @brief 把最近一次的内存统计写入 memoryUsage 类型参数中声明了的同名属性，
+ * 声明了 usage 属性时写入整个统计，QML 通过参数属性读取内存统计
+ *
+ * @param param
  */
-
-QGeoMapMapboxGL::QGeoMapMapboxGL(QGeoMappingManagerEngineMapboxGL *engine, QObject *parent)
-    :   QGeoMap(*new QGeoMapMapboxGLPrivate(engine), parent), m_engine(engine)
+void QGeoMapMapboxGLPrivate::publishMemoryUsage(QGeoMapParameter *param)
 {
-    Q_D(QGeoMapMapboxGL);
+    const QMetaObject *metaObject = param->metaObject();
 
-    connect(&d->m_refresh, &QTimer::timeout, this, &QGeoMap::sgNodeChanged);
-    d->m_refresh.setInterval(250);
-}
+    if (metaObject->indexOfProperty("usage") >= 0)
+        param->setProperty("usage", m_memoryUsage);
 
-QGeoMapMapboxGL::~QGeoMapMapboxGL()
-{
+    for (auto it = m_memoryUsage.constBegin(); it != m_memoryUsage.constEnd(); ++it) {
+        const QByteArray name = it.key().toLatin1();
+        if (metaObject->indexOfProperty(name.constData()) >= 0)
+            param->setProperty(name.constData(), it.value());
+    }
 }
 
-
 /**
- * @brief 样式表
+ * @brief 延迟刷新内存统计，短时间内的多次变化只刷新一次
  * 
- * @return QString 
  */
-QString QGeoMapMapboxGL::copyrightsStyleSheet() const
+void QGeoMapMapboxGLPrivate::scheduleMemoryUpdate()
 {
-    return QStringLiteral("* { vertical-align: middle; font-weight: normal }");
+    if (!m_memoryUpdate.isActive())
+        m_memoryUpdate.start();
 }
 
-
 /**
- * @brief 设置mapboxgl设置
+ * @brief 切换到已经加载了目标样式的备用地图，当前地图去掉地图元素后转为备用
  * 
- * @param settings 
- * @param useChinaEndpoint 
+ * @param node 
+ * @param styleUrl 
+ * @return true 切换成功
  */
-void QGeoMapMapboxGL::setMapboxGLSettings(const QMapboxGLSettings& settings, bool useChinaEndpoint)
+bool QGeoMapMapboxGLPrivate::switchToStandbyMap(QSGMapboxGLTextureNode *node, const QString &styleUrl)
 {
-    Q_D(QGeoMapMapboxGL);
+    Q_Q(QGeoMapMapboxGL);
 
-    d->m_settings = settings;
+    if (m_styleUrl.isEmpty() || styleUrl == m_styleUrl || !node->hasStandbyMap(styleUrl))
+        return false;
 
-    // If the access token is not set, use the development access token. 使用开发者token
-    // This will only affect mapbox:// styles.
-    // Mapbox China requires a China-specific access token. // 中国需要特殊的token
-    if (d->m_settings.accessToken().isEmpty()) {
-        if (useChinaEndpoint) {         
-            qWarning("Mapbox China requires an access token: https://www.mapbox.com/contact/sales");
-        } else {
-            d->m_settings.setAccessToken(developmentToken);
+    QMapboxGL *previous = node->map();
+
+    // 备用地图只保留样式本身，地图元素在切换到新地图后重新添加
+    if (m_styleLoaded) {
+        syncStyleChanges(previous);
+
+        for (QDeclarativeGeoMapItemBase *item : qAsConst(m_mapItems)) {
+            for (const auto &change : QMapboxGLStyleChange::removeMapItem(item))
+                change->apply(previous);
+        }
+
+        for (QGeoMapParameter *param : qAsConst(m_mapParameters)) {
+            for (const auto &change : QMapboxGLStyleChange::removeMapParameter(param))
+                change->apply(previous);
         }
+
+        for (const auto &change : m_markers->removeChanges())
+            change->apply(previous);
     }
-}
 
-void QGeoMapMapboxGL::setUseFBO(bool useFBO)
-{
-    Q_D(QGeoMapMapboxGL);
-    d->m_useFBO = useFBO;
-}
+    node->swapMap(styleUrl, m_styleUrl, m_styleLoaded);
+    QMapboxGL *map = node->map();
 
-void QGeoMapMapboxGL::setMapItemsBefore(const QString &before)
-{
-    Q_D(QGeoMapMapboxGL);
-    d->m_mapItemsBefore = before;
-}
+    QObject::disconnect(previous, nullptr, q, nullptr);
+    QObject::connect(map, &QMapboxGL::needsRendering, q, &QGeoMapMapboxGL::onMapNeedsRendering);
+    QObject::connect(map, &QMapboxGL::mapChanged, q, &QGeoMapMapboxGL::onMapChanged);
 
-QGeoMap::Capabilities QGeoMapMapboxGL::capabilities() const
-{
-    return Capabilities(SupportsVisibleRegion
-                        | SupportsSetBearing
-                        | SupportsAnchoringCoordinate
-                        | SupportsVisibleArea );
+    m_styleLoaded = node->isStyleLoaded(map);
+    m_styleChanges.clear();
+
+    for (QDeclarativeGeoMapItemBase *item : qAsConst(m_mapItems))
+        enqueueStyleChanges(QMapboxGLStyleChange::addMapItem(item, m_mapItemsBefore));
+
+    for (QGeoMapParameter *param : qAsConst(m_mapParameters))
+        enqueueStyleChanges(QMapboxGLStyleChange::addMapParameter(param));
+
+    m_markers->reset();
+
+    // 新地图的相机和边距停留在上次同步时的状态
+    m_cameraApplied = false;
+    m_appliedMargins = QMargins();
+    m_syncState = m_syncState | CameraDataSync | VisibleAreaSync;
+    m_renderPending = true;
+
+    return true;
 }
 
-QSGNode *QGeoMapMapboxGL::updateSceneGraph(QSGNode *oldNode, QQuickWindow *window)
+/**
+ * @brief 同步风格变化
+ * 
+ * @param map 
+ */
+void QGeoMapMapboxGLPrivate::syncStyleChanges(QMapboxGL *map)
 {
-    Q_D(QGeoMapMapboxGL);
-    return d->updateSceneGraph(oldNode, window);
+    if (m_recorder)
+        m_recorder->recordStyleChanges(m_styleChanges);
+
+    for (const auto& change : m_styleChanges) {
+        QMapboxGLTrace::Scope trace(change->kind(), "style.apply");
+        change->apply(map);
+    }
+
+    m_styleChanges.clear();
 }
 
 
 /**
- * @brief 当地图发生变化时执行的槽函数
+ * @brief 同步相机，只把变化了的中心、缩放、角度和俯仰合并成一次 jumpTo
  * 
- * @param change 
+ * @param map 
+ * @param cameraData 
  */
-void QGeoMapMapboxGL::onMapChanged(QMapboxGL::MapChange change)
+void QGeoMapMapboxGLPrivate::syncCamera(QMapboxGL *map, const QGeoCameraData &cameraData)
 {
-    Q_D(QGeoMapMapboxGL);
+    QElapsedTimer timer;
+    timer.start();
+
+    const double zoom = zoomLevelFrom256(cameraData.zoomLevel(), MBGL_TILE_SIZE);
+    const QGeoCoordinate center = cameraData.center();
+    const double bearing = cameraData.bearing();
+    const double pitch = cameraData.tilt();
+
+    QMapboxGLCameraOptions camera;
+    if (!m_cameraApplied || center != m_appliedCenter)
+        camera.center = QVariant::fromValue(QMapbox::Coordinate(center.latitude(), center.longitude()));
+    if (!m_cameraApplied || zoom != m_appliedZoom)
+        camera.zoom = zoom;
+    if (!m_cameraApplied || bearing != m_appliedBearing)
+        camera.bearing = bearing;
+    if (!m_cameraApplied || pitch != m_appliedPitch)
+        camera.pitch = pitch;
+
+    if (!camera.center.isValid() && !camera.zoom.isValid() && !camera.bearing.isValid() && !camera.pitch.isValid()) {
+        ++m_cameraSyncsSkipped;
+        return;
+    }
 
-    if (change == QMapboxGL::MapChangeDidFinishLoadingStyle || change == QMapboxGL::MapChangeDidFailLoadingMap) {
-        d->m_styleLoaded = true;
-    } else if (change == QMapboxGL::MapChangeWillStartLoadingMap) {
-        d->m_styleLoaded = false;
-        d->m_styleChanges.clear();
+    map->jumpTo(camera);
 
-        for (QDeclarativeGeoMapItemBase *item : d->m_mapItems)
-            d->m_styleChanges << QMapboxGLStyleChange::addMapItem(item, d->m_mapItemsBefore);
+    if (m_recorder)
+        m_recorder->recordCamera(center.latitude(), center.longitude(), zoom, bearing, pitch);
 
-        for (QGeoMapParameter *param : d->m_mapParameters)
-            d->m_styleChanges << QMapboxGLStyleChange::addMapParameter(param);
+    m_appliedCenter = center;
+    m_appliedZoom = zoom;
+    m_appliedBearing = bearing;
+    m_appliedPitch = pitch;
+    m_cameraApplied = true;
+
+    ++m_cameraSyncs;
+    m_cameraSyncTime += timer.nsecsElapsed();
+}
+
+/**
+ * @brief 开始相机动画，替换正在进行的动画
+ * 
+ * @param animation 
+ */
+void QGeoMapMapboxGLPrivate::startCameraAnimation(QMapboxGLCameraAnimation *animation)
+{
+    Q_Q(QGeoMapMapboxGL);
+
+    if (m_cameraAnimation)
+        stopCameraAnimation(true);
+
+    m_cameraAnimation.reset(animation);
+    m_cameraAnimation->start();
+    m_publishedCamera = m_cameraData;
+
+    m_renderPending = true;
+    emit q->sgNodeChanged();
+}
+
+/**
+ * @brief 结束相机动画，把最终（或者取消时的）相机状态写回 QGeoMap
+ * 
+ * @param cancelled 
+ */
+void QGeoMapMapboxGLPrivate::stopCameraAnimation(bool cancelled)
+{
+    Q_Q(QGeoMapMapboxGL);
+
+    if (!m_cameraAnimation)
+        return;
+
+    QSharedPointer<QMapboxGLCameraAnimation> animation = m_cameraAnimation;
+    m_cameraAnimation.reset();
+
+    if (!cancelled)
+        publishCameraData(animation->targetCameraData());
+
+    emit q->cameraAnimationFinished(cancelled);
+}
+
+/**
+ * @brief 把动画的相机状态同步给 QGeoMap，不会取消动画
+ * 
+ * @param cameraData 
+ */
+void QGeoMapMapboxGLPrivate::publishCameraData(const QGeoCameraData &cameraData)
+{
+    Q_Q(QGeoMapMapboxGL);
+
+    m_publishedCamera = cameraData;
+    m_applyingAnimatedCamera = true;
+    q->setCameraData(cameraData);
+    m_applyingAnimatedCamera = false;
+}
+
+/**
+ * @brief 根据连续的相机变化估计相机的移动速度（墨卡托坐标/毫秒）
+ * 
+ */
+void QGeoMapMapboxGLPrivate::trackCameraMotion()
+{
+    const QDoubleVector2D position = QWebMercator::coordToMercator(m_cameraData.center());
+    const double zoom = m_cameraData.zoomLevel();
+
+    const qint64 interval = m_cameraMotionClock.isValid() ? m_cameraMotionClock.elapsed() : -1;
+
+    // 同一毫秒内的多次更新不采样, 保留之前的速度, 由下一次采样一并计入
+    if (interval == 0)
+        return;
+
+    m_cameraMotionClock.start();
+    if (interval < 0 || interval > CAMERA_MOTION_MAX_SAMPLE_INTERVAL) {
+        m_cameraVelocity = QDoubleVector2D();
+        m_zoomVelocity = 0.0;
+    } else {
+        QDoubleVector2D delta = position - m_cameraPosition;
+        if (delta.x() > 0.5)
+            delta.setX(delta.x() - 1.0);
+        else if (delta.x() < -0.5)
+            delta.setX(delta.x() + 1.0);
+
+        // Smooth out the jitter of gesture driven updates.
+        m_cameraVelocity = m_cameraVelocity * 0.5 + delta / interval * 0.5;
+        m_zoomVelocity = m_zoomVelocity * 0.5 + (zoom - m_cameraZoom) / interval * 0.5;
+    }
+
+    m_cameraPosition = position;
+    m_cameraZoom = zoom;
+}
+
+/**
+ * @brief 预测 lookahead 毫秒后的相机，相机没有移动或者移动太少时返回 false
+ * 
+ * @param predicted 
+ * @return bool 
+ */
+bool QGeoMapMapboxGLPrivate::predictCameraData(QGeoCameraData *predicted) const
+{
+    QGeoCameraData current;
+
+    if (m_cameraAnimation) {
+        current = m_cameraAnimation->cameraData();
+        *predicted = m_cameraAnimation->cameraDataAhead(m_prefetchLookahead);
+    } else {
+        if (!m_cameraMotionClock.isValid() || m_cameraMotionClock.elapsed() > CAMERA_SETTLE_INTERVAL)
+            return false;
+
+        current = m_cameraData;
+
+        QDoubleVector2D position = QWebMercator::coordToMercator(m_cameraData.center()) + m_cameraVelocity * m_prefetchLookahead;
+        position.setX(position.x() - std::floor(position.x()));
+        position.setY(qBound(0.0, position.y(), 1.0));
+
+        *predicted = m_cameraData;
+        predicted->setCenter(QWebMercator::mercatorToCoord(position));
+        predicted->setZoomLevel(qMax(0.0, m_cameraData.zoomLevel() + m_zoomVelocity * m_prefetchLookahead));
+    }
+
+    // Only worth it when the predicted viewport is not mostly on screen already.
+    const double worldSize = 256.0 * std::pow(2.0, current.zoomLevel());
+    const double distance = (QWebMercator::coordToMercator(predicted->center())
+                             - QWebMercator::coordToMercator(current.center())).length() * worldSize;
+
+    return distance > 0.25 * qMax(m_viewportSize.width(), m_viewportSize.height())
+        || qAbs(predicted->zoomLevel() - current.zoomLevel()) > 0.5;
+}
+
+/**
+ * @brief 在预算允许的范围内让预取地图加载预测视口的瓦片，预取地图换到本地图或者换了样式时重新添加所有地图元素和参数
+ * 
+ * @param prefetcher 
+ */
+void QGeoMapMapboxGLPrivate::schedulePrefetch(QMapboxGLPrefetcher *prefetcher)
+{
+    Q_Q(QGeoMapMapboxGL);
+
+    if (m_prefetchBudget <= 0)
+        return;
+
+    if (m_lastPrefetch.isValid() && m_lastPrefetch.elapsed() < 1000 / m_prefetchBudget)
+        return;
+
+    QGeoCameraData predicted;
+    if (!predictCameraData(&predicted))
+        return;
+
+    const QGeoCoordinate center = predicted.center();
+
+    QMapboxGLCameraOptions camera;
+    camera.center = QVariant::fromValue(QMapbox::Coordinate(center.latitude(), center.longitude()));
+    camera.zoom = zoomLevelFrom256(predicted.zoomLevel(), MBGL_TILE_SIZE);
+    camera.bearing = predicted.bearing();
+    camera.pitch = predicted.tilt();
+
+    if (prefetcher->setOwner(q, m_styleUrl)) {
+        QList<QSharedPointer<QMapboxGLStyleChange>> changes;
+
+        for (QDeclarativeGeoMapItemBase *item : qAsConst(m_mapItems))
+            changes << QMapboxGLStyleChange::addMapItem(item, m_mapItemsBefore);
+
+        for (QGeoMapParameter *param : qAsConst(m_mapParameters))
+            changes << QMapboxGLStyleChange::addMapParameter(param);
+
+        changes << m_markers->addChanges(m_mapItemsBefore);
+
+        prefetcher->applyStyleChanges(q, m_styleUrl, changes);
+    }
+
+    prefetcher->prefetch(m_viewportSize, m_appliedMargins, camera);
+    m_lastPrefetch.start();
+    ++m_prefetches;
+
+    if (!m_prefetchClock.isValid())
+        m_prefetchClock.start();
+
+    PrefetchPrediction prediction;
+    prediction.position = QWebMercator::coordToMercator(center);
+    prediction.zoom = predicted.zoomLevel();
+    prediction.deadline = m_prefetchClock.elapsed() + 2 * m_prefetchLookahead;
+    m_prefetchPredictions.append(prediction);
+}
+
+/**
+ * @brief 统计预测命中率：相机在期限内到达预测的视口为命中，否则为未命中
+ * 
+ * @param cameraData 
+ */
+void QGeoMapMapboxGLPrivate::updatePrefetchStatistics(const QGeoCameraData &cameraData)
+{
+    if (m_prefetchPredictions.isEmpty())
+        return;
+
+    const QDoubleVector2D position = QWebMercator::coordToMercator(cameraData.center());
+    const double worldSize = 256.0 * std::pow(2.0, cameraData.zoomLevel());
+    const double tolerance = 0.5 * qMax(m_viewportSize.width(), m_viewportSize.height()) / worldSize;
+    const qint64 now = m_prefetchClock.elapsed();
+
+    for (auto it = m_prefetchPredictions.begin(); it != m_prefetchPredictions.end();) {
+        if ((it->position - position).length() < tolerance && qAbs(it->zoom - cameraData.zoomLevel()) < 0.5) {
+            ++m_prefetchHits;
+            it = m_prefetchPredictions.erase(it);
+        } else if (now > it->deadline) {
+            ++m_prefetchMisses;
+            it = m_prefetchPredictions.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+/**
+ * @brief 读取请求的帧并发出已经读回的帧，读回是异步的，一般晚一到两帧
+ * 
+ * @param node 
+ */
+void QGeoMapMapboxGLPrivate::captureFrames(QSGMapboxGLTextureNode *node)
+{
+    Q_Q(QGeoMapMapboxGL);
+
+    if (m_captureRequested) {
+        node->capture();
+        m_captureRequested = false;
+    }
+
+    // 这里是渲染线程，帧排队交给 GUI 线程发出
+    const QList<QImage> frames = node->takeCapturedFrames();
+    for (const QImage &frame : frames)
+        QMetaObject::invokeMethod(q, "frameCaptured", Qt::QueuedConnection, Q_ARG(QImage, frame));
+
+    // Keep frames coming until the pending reads are through.
+    if (node->hasPendingCaptures())
+        emit q->sgNodeChanged();
+}
+
+/**
+ * @brief 帧率限制，返回 true 时跳过本帧渲染，继续显示上一帧的 FBO 图像
+ * 
+ * @param map 
+ * @param changed 本帧是否有视口、相机、地图类型或者风格的变化
+ * @return bool 
+ */
+bool QGeoMapMapboxGLPrivate::throttleRender(QMapboxGL *map, bool changed)
+{
+    Q_Q(QGeoMapMapboxGL);
+
+    if (changed || !map->isFullyLoaded())
+        m_lastActivity.start();
+
+    if (changed)
+        m_renderPending = true;
+
+    // The FBO is recreated on resize and must always be painted.
+    if (m_syncState & ViewportSync || !m_lastRender.isValid())
+        m_renderPending = true;
+    else if (!m_renderPending)
+        return true;
+
+    int frameRate = m_maximumFrameRate;
+    if (m_idleTimeout > 0 && m_lastActivity.isValid() && m_lastActivity.elapsed() > m_idleTimeout) {
+        if (m_idleFrameRate == 0) {
+            // Nothing is repainted on its own while idle, but a frame the
+            // map asked for is still drawn once. The pending flag is kept
+            // so skipped repaints are caught up when activity resumes.
+            if (!m_renderRequested) {
+                ++m_throttledFrames;
+                return true;
+            }
+        } else {
+            frameRate = frameRate > 0 ? qMin(frameRate, m_idleFrameRate) : m_idleFrameRate;
+        }
+    }
+
+    if (frameRate > 0 && !(m_syncState & ViewportSync) && m_lastRender.isValid()) {
+        const qint64 remaining = 1000 / frameRate - m_lastRender.elapsed();
+        if (remaining > 0) {
+            ++m_throttledFrames;
+            QMetaObject::invokeMethod(q, "scheduleThrottledRender", Qt::QueuedConnection, Q_ARG(int, int(remaining)));
+            return true;
+        }
+    }
+
+    m_lastRender.start();
+    m_renderPending = false;
+    m_renderRequested = false;
+
+    return false;
+}
+
+/**
+ * @brief 相机移动时根据上一帧的渲染时间降低 FBO 的渲染分辨率，相机停止后恢复
+ * 
+ * @param node 
+ */
+void QGeoMapMapboxGLPrivate::updateRenderScale(QSGMapboxGLTextureNode *node)
+{
+    const bool cameraMoving = m_lastCameraChange.isValid() && m_lastCameraChange.elapsed() < CAMERA_SETTLE_INTERVAL;
+    const qint64 targetFrameTime = qint64(m_targetFrameTime) * 1000000;
+
+    if (!cameraMoving) {
+        m_renderScale = 1.0;
+    } else if (m_lastFrameTime > targetFrameTime) {
+        m_renderScale = qMax(m_minimumRenderScale, m_renderScale * 0.8);
+    } else if (m_lastFrameTime < targetFrameTime / 2) {
+        m_renderScale = qMin(qreal(1.0), m_renderScale * 1.1);
+    }
+
+    node->setRenderScale(m_renderScale);
+}
+
+/**
+ * @brief 渲染
+ * 
+ * @param window 
+ * @param map 
+ */
+void QGeoMapMapboxGLPrivate::threadedRenderingHack(QQuickWindow *window, QMapboxGL *map)
+{
+    // FIXME: Optimal support for threaded rendering needs core changes
+    // in Mapbox GL Native. The map is refreshed by its needsRendering and
+    // mapChanged signals, which are queued to the GUI thread. While the
+    // map is still loading we also arm a fallback timer that only fires
+    // when none of those signals arrived, backing off each time it does.
+    if (!m_warned) {
+        m_threadedRendering = window->openglContext()->thread() != QCoreApplication::instance()->thread();
+
+        if (m_threadedRendering) {
+            qWarning() << "Threaded rendering is not optimal in the Mapbox GL plugin.";
+        }
+
+        m_warned = true;
+    }
+
+    if (m_threadedRendering) {
+        // m_refresh 属于 GUI 线程，只能通过排队调用启动或者停止
+        if (!map->isFullyLoaded()) {
+            QMetaObject::invokeMethod(q_func(), "startRefresh", Qt::QueuedConnection);
+        } else {
+            QMetaObject::invokeMethod(q_func(), "stopRefresh", Qt::QueuedConnection);
+        }
+    }
+}
+
+/**
+ * @brief 地图开始加载，启动后备刷新定时器
+ * 
+ */
+void QGeoMapMapboxGLPrivate::startRefresh()
+{
+    if (m_refresh.isActive())
+        return;
+
+    m_refreshInterval = FALLBACK_REFRESH_INTERVAL_MIN;
+    m_fallbackRefreshesInPeriod = 0;
+    m_refreshLoading.start();
+    m_refresh.start(m_refreshInterval);
+}
+
+/**
+ * @brief 地图加载完成，停止后备刷新定时器并统计节省的渲染次数
+ * 
+ */
+void QGeoMapMapboxGLPrivate::stopRefresh()
+{
+    if (!m_refresh.isActive())
+        return;
+
+    m_refresh.stop();
+
+    const quint64 legacyRefreshes = quint64(m_refreshLoading.elapsed()) / LEGACY_REFRESH_INTERVAL;
+    if (legacyRefreshes > m_fallbackRefreshesInPeriod)
+        m_avoidedRefreshes += legacyRefreshes - m_fallbackRefreshesInPeriod;
+}
+
+/**
+ * @brief 由地图信号触发的刷新，推迟后备定时器
+ * 
+ */
+void QGeoMapMapboxGLPrivate::refreshFromSignal()
+{
+    Q_Q(QGeoMapMapboxGL);
+
+    if (m_refresh.isActive()) {
+        ++m_signalRefreshes;
+        m_refreshInterval = FALLBACK_REFRESH_INTERVAL_MIN;
+        m_refresh.start(m_refreshInterval);
+    }
+
+    m_renderPending = true;
+    m_renderRequested = true;
+    emit q->sgNodeChanged();
+}
+
+/**
+ * @brief 后备定时器触发的刷新，间隔加倍
+ * 
+ */
+void QGeoMapMapboxGLPrivate::refreshFromFallback()
+{
+    Q_Q(QGeoMapMapboxGL);
+
+    ++m_fallbackRefreshes;
+    ++m_fallbackRefreshesInPeriod;
+
+    m_refreshInterval = qMin(m_refreshInterval * 2, FALLBACK_REFRESH_INTERVAL_MAX);
+    m_refresh.start(m_refreshInterval);
+
+    m_renderPending = true;
+    emit q->sgNodeChanged();
+}
+
+/*
+ * QGeoMapMapboxGL implementation
+ */
+
+QGeoMapMapboxGL::QGeoMapMapboxGL(QGeoMappingManagerEngineMapboxGL *engine, QObject *parent)
+    :   QGeoMap(*new QGeoMapMapboxGLPrivate(engine), parent), m_engine(engine)
+{
+    Q_D(QGeoMapMapboxGL);
+
+    connect(&d->m_refresh, &QTimer::timeout, this, &QGeoMapMapboxGL::onRefreshTimeout);
+    d->m_refresh.setSingleShot(true);
+
+    connect(&d->m_throttle, &QTimer::timeout, this, &QGeoMap::sgNodeChanged);
+    d->m_throttle.setSingleShot(true);
+
+    connect(&d->m_frameTimingLog, &QTimer::timeout, this, &QGeoMapMapboxGL::onFrameTimingLog);
+
+    d->m_capture.setTimerType(Qt::PreciseTimer);
+    connect(&d->m_capture, &QTimer::timeout, this, &QGeoMapMapboxGL::grabFrame);
+
+    connect(&d->m_cameraSettle, &QTimer::timeout, this, &QGeoMapMapboxGL::onCameraSettled);
+    d->m_cameraSettle.setSingleShot(true);
+
+
+    // 标记图层同时绘制 markers 类型参数给出的点，不依赖 MapQuickItem
+    d->m_markers.reset(new QMapboxGLMarkerLayer);
+    connect(d->m_markers.data(), &QMapboxGLMarkerLayer::changed, this, &QGeoMap::sgNodeChanged);
+
+    connect(&d->m_memoryUpdate, &QTimer::timeout, this, &QGeoMapMapboxGL::onMemoryUpdate);
+    d->m_memoryUpdate.setInterval(MEMORY_UPDATE_INTERVAL);
+    d->m_memoryUpdate.setSingleShot(true);
+
+    d->m_created.start();
+}
+
+QGeoMapMapboxGL::~QGeoMapMapboxGL()
+{
+}
+
+
+/**
+ * @brief 样式表
+ * 
+ * @return QString 
+ */
+QString QGeoMapMapboxGL::copyrightsStyleSheet() const
+{
+    return QStringLiteral("* { vertical-align: middle; font-weight: normal }");
+}
+
+
+/**
+ * @brief 设置mapboxgl设置
+ * 
+ * @param settings 
+ * @param useChinaEndpoint 
+ */
+void QGeoMapMapboxGL::setMapboxGLSettings(const QMapboxGLSettings& settings, bool useChinaEndpoint)
+{
+    Q_D(QGeoMapMapboxGL);
+
+    d->m_settings = settings;
+
+    // If the access token is not set, use the development access token. 使用开发者token
+    // This will only affect mapbox:// styles.
+    // Mapbox China requires a China-specific access token. // 中国需要特殊的token
+    if (d->m_settings.accessToken().isEmpty()) {
+        if (useChinaEndpoint) {         
+            qWarning("Mapbox China requires an access token: https://www.mapbox.com/contact/sales");
+        } else {
+            d->m_settings.setAccessToken(developmentToken);
+        }
+    }
+}
+
+void QGeoMapMapboxGL::setMapPool(QMapboxGLMapPool *pool)
+{
+    Q_D(QGeoMapMapboxGL);
+    d->m_mapPool = pool;
+}
+
+void QGeoMapMapboxGL::setUseFBO(bool useFBO)
+{
+    Q_D(QGeoMapMapboxGL);
+    d->m_useFBO = useFBO;
+}
+
+void QGeoMapMapboxGL::setMapItemsBefore(const QString &before)
+{
+    Q_D(QGeoMapMapboxGL);
+    d->m_mapItemsBefore = before;
+}
+
+/**
+ * @brief 设置是否用符号图层绘制代理为图片的 MapQuickItem
+ * 
+ * @param enabled 
+ * @param allowOverlap 为 false 时重叠的标记由碰撞检测隐藏
+ */
+void QGeoMapMapboxGL::setQuickItemsAsSymbols(bool enabled, bool allowOverlap)
+{
+    Q_D(QGeoMapMapboxGL);
+
+    d->m_quickItemsAsSymbols = enabled;
+    d->m_markers->setAllowOverlap(allowOverlap);
+}
+
+/**
+ * @brief 设置标记聚合，聚合在 Mapbox GL 的工作线程中完成
+ * 
+ * @param enabled 
+ * @param radius 聚合半径，单位为像素
+ * @param maxZoom 超过该缩放级别不再聚合
+ */
+void QGeoMapMapboxGL::setMarkerClustering(bool enabled, int radius, int maxZoom, const QStringList &font)
+{
+    Q_D(QGeoMapMapboxGL);
+
+    d->m_markers->setClustering(enabled, radius, maxZoom);
+    if (!font.isEmpty())
+        d->m_markers->setClusterFont(font);
+}
+
+void QGeoMapMapboxGL::setMaximumFrameRate(int frameRate)
+{
+    Q_D(QGeoMapMapboxGL);
+    d->m_maximumFrameRate = frameRate;
+}
+
+void QGeoMapMapboxGL::setIdleThrottling(int timeout, int frameRate)
+{
+    Q_D(QGeoMapMapboxGL);
+    d->m_idleTimeout = timeout;
+    d->m_idleFrameRate = frameRate;
+}
+
+void QGeoMapMapboxGL::setAdaptiveResolution(bool enabled, qreal minimumScale, int targetFrameTime)
+{
+    Q_D(QGeoMapMapboxGL);
+    d->m_adaptiveResolution = enabled;
+    d->m_minimumRenderScale = minimumScale;
+    d->m_targetFrameTime = targetFrameTime;
+}
+
+void QGeoMapMapboxGL::setPrefetching(QMapboxGLPrefetchers *prefetchers, int lookahead, int budget)
+{
+    Q_D(QGeoMapMapboxGL);
+    d->m_prefetchers = prefetchers;
+    d->m_prefetchLookahead = lookahead;
+    d->m_prefetchBudget = budget;
+}
+
+void QGeoMapMapboxGL::setRequestScheduler(const QSharedPointer<QMapboxGLRequestScheduler> &scheduler)
+{
+    Q_D(QGeoMapMapboxGL);
+    d->m_requestScheduler = scheduler;
+    d->publishViewport();
+}
+
+void QGeoMapMapboxGL::setPreloadedStyles(const QStringList &styleUrls)
+{
+    Q_D(QGeoMapMapboxGL);
+    d->m_preloadedStyles = styleUrls;
+}
+
+QGeoMap::Capabilities QGeoMapMapboxGL::capabilities() const
+{
+    return Capabilities(SupportsVisibleRegion
+                        | SupportsSetBearing
+                        | SupportsAnchoringCoordinate
+                        | SupportsVisibleArea );
+}
+
+/**
+ * @brief 渲染统计信息
+ * 
+ * @return QVariantMap 
+ */
+QVariantMap QGeoMapMapboxGL::renderStatistics() const
+{
+    Q_D(const QGeoMapMapboxGL);
+
+    QVariantMap statistics;
+    statistics[QStringLiteral("signalRefreshes")] = d->m_signalRefreshes;
+    statistics[QStringLiteral("fallbackRefreshes")] = d->m_fallbackRefreshes;
+    statistics[QStringLiteral("avoidedRefreshes")] = d->m_avoidedRefreshes;
+    statistics[QStringLiteral("throttledFrames")] = d->m_throttledFrames;
+    statistics[QStringLiteral("renderScale")] = d->m_renderScale;
+    statistics[QStringLiteral("cameraSyncs")] = d->m_cameraSyncs;
+    statistics[QStringLiteral("cameraSyncsSkipped")] = d->m_cameraSyncsSkipped;
+    statistics[QStringLiteral("cameraSyncTime")] = d->m_cameraSyncs ? d->m_cameraSyncTime / d->m_cameraSyncs : 0;
+    statistics[QStringLiteral("prefetches")] = d->m_prefetches;
+    statistics[QStringLiteral("prefetchHits")] = d->m_prefetchHits;
+    statistics[QStringLiteral("prefetchMisses")] = d->m_prefetchMisses;
+    statistics[QStringLiteral("prefetchHitRate")] = (d->m_prefetchHits + d->m_prefetchMisses)
+            ? double(d->m_prefetchHits) / (d->m_prefetchHits + d->m_prefetchMisses) : 0.0;
+    statistics[QStringLiteral("styleLoadLatency")] = d->m_styleLoadLatency;
+    statistics[QStringLiteral("firstFrameLatency")] = d->m_firstFrameLatency;
+    statistics[QStringLiteral("styleSwitches")] = d->m_styleSwitches;
+    statistics[QStringLiteral("instantStyleSwitches")] = d->m_instantStyleSwitches;
+    statistics[QStringLiteral("markers")] = d->m_markers->statistics();
+
+    return statistics;
+}
+
+void QGeoMapMapboxGL::setFrameTiming(bool enabled, bool gpuTiming, int logInterval)
+{
+    Q_D(QGeoMapMapboxGL);
+
+    d->m_frameTiming.reset(enabled ? new QMapboxGLFrameTiming : nullptr);
+    d->m_gpuTiming = gpuTiming;
+
+    if (enabled && logInterval > 0) {
+        d->m_frameTimingLog.start(logInterval);
+    } else {
+        d->m_frameTimingLog.stop();
+    }
+}
+
+QVariantMap QGeoMapMapboxGL::frameTimings() const
+{
+    Q_D(const QGeoMapMapboxGL);
+    return d->m_frameTiming ? d->m_frameTiming->statistics() : QVariantMap();
+}
+
+void QGeoMapMapboxGL::onFrameTimingLog()
+{
+    Q_D(QGeoMapMapboxGL);
+
+    if (d->m_frameTiming)
+        qInfo("MapboxGL frame timing p50/p95/p99 ms: %s", qPrintable(d->m_frameTiming->summary()));
+}
+
+void QGeoMapMapboxGL::setSessionRecording(const QString &fileName)
+{
+    Q_D(QGeoMapMapboxGL);
+    d->m_recorder.reset(fileName.isEmpty() ? nullptr : new QMapboxGLSessionRecorder(fileName));
+}
+
+void QGeoMapMapboxGL::grabFrame()
+{
+    Q_D(QGeoMapMapboxGL);
+
+    if (!d->m_useFBO) {
+        qWarning("Frame capture needs mapboxgl.mapping.use_fbo enabled.");
+        return;
+    }
+
+    d->m_captureRequested = true;
+    d->scheduleMemoryUpdate();
+    emit sgNodeChanged();
+}
+
+void QGeoMapMapboxGL::setCaptureFrameRate(int frameRate)
+{
+    Q_D(QGeoMapMapboxGL);
+
+    if (frameRate > 0) {
+        d->m_capture.start(1000 / frameRate);
+    } else {
+        d->m_capture.stop();
+    }
+}
+
+QVariantMap QGeoMapMapboxGL::memoryStatistics() const
+{
+    Q_D(const QGeoMapMapboxGL);
+
+    // 帧缓冲和备用地图的大小由渲染线程在同步时记录
+    const qint64 framebufferBytes = d->m_framebufferBytes;
+    const qint64 standbyMapBytes = d->m_standbyMapBytes;
+
+    int sources = 0;
+    int layers = 0;
+    qint64 managedBytes = 0;
+
+    // 每个图元对应一个数据源和一个图层
+    for (QDeclarativeGeoMapItemBase *item : d->m_mapItems) {
+        const qint64 bytes = estimateMapItemBytes(item);
+        if (bytes) {
+            ++sources;
+            ++layers;
+            managedBytes += bytes;
+        }
+    }
+
+    for (const QGeoMapMapboxGLPrivate::ParameterBytes &estimate : d->m_parameterBytes) {
+        managedBytes += estimate.bytes;
+        sources += estimate.sources;
+        layers += estimate.layers;
+    }
+
+    // 所有标记共用一个数据源和一个图层，图标只注册一次
+    if (d->m_markers->count()) {
+        ++sources;
+        ++layers;
+        managedBytes += MANAGED_SOURCE_OVERHEAD + MANAGED_LAYER_OVERHEAD
+                + qint64(d->m_markers->count()) * COORDINATE_BYTES + d->m_markers->iconBytes();
+    }
+
+    // 瓦片缓存数据库由所有地图共用，不计入总量
+    const QString cachePath = d->m_settings.cacheDatabasePath();
+    const qint64 cacheBytes = cachePath == QStringLiteral(":memory:") ? 0 : QFileInfo(cachePath).size();
+
+    QVariantMap statistics;
+    statistics[QStringLiteral("framebufferBytes")] = framebufferBytes;
+    statistics[QStringLiteral("managedSources")] = sources;
+    statistics[QStringLiteral("managedLayers")] = layers;
+    statistics[QStringLiteral("managedBytes")] = managedBytes;
+    statistics[QStringLiteral("standbyMaps")] = d->m_standbyMaps;
+    statistics[QStringLiteral("standbyMapBytes")] = standbyMapBytes;
+    statistics[QStringLiteral("pendingStyleChanges")] = d->m_styleChanges.size();
+    statistics[QStringLiteral("cacheDatabaseBytes")] = cacheBytes;
+    statistics[QStringLiteral("total")] = framebufferBytes + standbyMapBytes + managedBytes;
+    if (d->m_memoryLimit > 0)
+        statistics[QStringLiteral("limit")] = d->m_memoryLimit;
+
+    return statistics;
+}
+
+QVariantMap QGeoMapMapboxGL::memoryUsage() const
+{
+    Q_D(const QGeoMapMapboxGL);
+    return d->m_memoryUsage;
+}
+
+/**
+ * @brief 设置内存上限，超过时输出警告，0表示不限制
+ * 
+ * @param bytes 
+ */
+void QGeoMapMapboxGL::setMemoryLimit(qint64 bytes)
+{
+    Q_D(QGeoMapMapboxGL);
+
+    d->m_memoryLimit = qMax(bytes, qint64(0));
+    d->m_memoryLimitExceeded = false;
+    d->scheduleMemoryUpdate();
+}
+
+/**
+ * @brief 刷新内存统计，有变化时发出通知
+ * 
+ */
+void QGeoMapMapboxGL::onMemoryUpdate()
+{
+    Q_D(QGeoMapMapboxGL);
+
+    const QVariantMap usage = memoryStatistics();
+
+    // 超过上限时只警告一次，回落到上限以下后重新计算
+    const qint64 total = usage.value(QStringLiteral("total")).toLongLong();
+    const bool exceeded = d->m_memoryLimit > 0 && total > d->m_memoryLimit;
+    if (exceeded && !d->m_memoryLimitExceeded) {
+        qWarning("MapboxGL map uses %lld bytes, above the configured limit of %lld bytes "
+                 "(framebuffers %lld, standby maps %lld, managed sources and layers %lld).",
+                 total, d->m_memoryLimit,
+                 usage.value(QStringLiteral("framebufferBytes")).toLongLong(),
+                 usage.value(QStringLiteral("standbyMapBytes")).toLongLong(),
+                 usage.value(QStringLiteral("managedBytes")).toLongLong());
+    }
+    d->m_memoryLimitExceeded = exceeded;
+
+    if (usage != d->m_memoryUsage) {
+        d->m_memoryUsage = usage;
+        emit memoryUsageChanged();
+
+        for (QGeoMapParameter *param : qAsConst(d->m_mapParameters)) {
+            if (param->type() == QStringLiteral("memoryUsage"))
+                d->publishMemoryUsage(param);
+        }
+    }
+}
+
+/**
+ * @brief 以直线插值的方式把相机移动到目标位置
+ * 
+ * @param cameraData 目标相机
+ * @param duration 动画时长（毫秒）
+ * @param easing 
+ */
+void QGeoMapMapboxGL::easeTo(const QGeoCameraData &cameraData, int duration, const QEasingCurve &easing)
+{
+    Q_D(QGeoMapMapboxGL);
+
+    // Continue from where a running animation currently is.
+    const QGeoCameraData from = d->m_cameraAnimation ? d->m_cameraAnimation->cameraData() : d->m_cameraData;
+    d->startCameraAnimation(new QMapboxGLCameraAnimation(QMapboxGLCameraAnimation::EaseTo,
+            from, cameraData, qMax(duration, 0), easing, d->m_viewportSize));
+}
+
+/**
+ * @brief 以先缩小再放大的飞行曲线把相机移动到目标位置
+ * 
+ * @param cameraData 目标相机
+ * @param duration 动画时长（毫秒），小于 0 时根据飞行距离计算
+ * @param easing 
+ */
+void QGeoMapMapboxGL::flyTo(const QGeoCameraData &cameraData, int duration, const QEasingCurve &easing)
+{
+    Q_D(QGeoMapMapboxGL);
+
+    const QGeoCameraData from = d->m_cameraAnimation ? d->m_cameraAnimation->cameraData() : d->m_cameraData;
+    d->startCameraAnimation(new QMapboxGLCameraAnimation(QMapboxGLCameraAnimation::FlyTo,
+            from, cameraData, duration, easing, d->m_viewportSize));
+}
+
+void QGeoMapMapboxGL::cancelCameraAnimation()
+{
+    Q_D(QGeoMapMapboxGL);
+
+    if (!d->m_cameraAnimation)
+        return;
+
+    // Keep the map where the animation currently is.
+    d->publishCameraData(d->m_cameraAnimation->cameraData());
+    d->stopCameraAnimation(true);
+}
+
+bool QGeoMapMapboxGL::isCameraAnimating() const
+{
+    Q_D(const QGeoMapMapboxGL);
+    return !d->m_cameraAnimation.isNull();
+}
+
+QSGNode *QGeoMapMapboxGL::updateSceneGraph(QSGNode *oldNode, QQuickWindow *window)
+{
+    Q_D(QGeoMapMapboxGL);
+    return d->updateSceneGraph(oldNode, window);
+}
+
+
+/**
+ * @brief 当地图发生变化时执行的槽函数
+ * 
+ * @param change 
+ */
+void QGeoMapMapboxGL::onMapChanged(QMapboxGL::MapChange change)
+{
+    Q_D(QGeoMapMapboxGL);
+
+    if (QMapboxGLTrace::isEnabled()) {
+        switch (change) {
+        case QMapboxGL::MapChangeWillStartLoadingMap:
+            QMapboxGLTrace::instant("willStartLoadingMap", "map");
+            break;
+        case QMapboxGL::MapChangeDidFinishLoadingStyle:
+            QMapboxGLTrace::instant("didFinishLoadingStyle", "map");
+            break;
+        case QMapboxGL::MapChangeDidFinishLoadingMap:
+            QMapboxGLTrace::instant("didFinishLoadingMap", "map");
+            break;
+        case QMapboxGL::MapChangeDidFailLoadingMap:
+            QMapboxGLTrace::instant("didFailLoadingMap", "map");
+            break;
+        case QMapboxGL::MapChangeSourceDidChange:
+            QMapboxGLTrace::instant("sourceDidChange", "map");
+            break;
+        default:
+            break;
+        }
+    }
+
+    // 从创建地图到样式加载完成、到第一帧完整渲染的时间
+    if (change == QMapboxGL::MapChangeDidFinishLoadingStyle && d->m_styleLoadLatency < 0) {
+        d->m_styleLoadLatency = d->m_created.elapsed();
+    } else if (change == QMapboxGL::MapChangeDidFinishRenderingMapFullyRendered && d->m_firstFrameLatency < 0) {
+        d->m_firstFrameLatency = d->m_created.elapsed();
+        QMapboxGLTrace::instant("firstFrame", "map");
+    }
+
+    if (change == QMapboxGL::MapChangeDidFinishLoadingStyle || change == QMapboxGL::MapChangeDidFailLoadingMap) {
+        d->m_styleLoaded = true;
+    } else if (change == QMapboxGL::MapChangeWillStartLoadingMap) {
+        d->m_styleLoaded = false;
+        d->m_styleChanges.clear();
+
+        for (QDeclarativeGeoMapItemBase *item : d->m_mapItems)
+            d->enqueueStyleChanges(QMapboxGLStyleChange::addMapItem(item, d->m_mapItemsBefore));
+
+        for (QGeoMapParameter *param : d->m_mapParameters)
+            d->enqueueStyleChanges(QMapboxGLStyleChange::addMapParameter(param));
+
+        d->m_markers->reset();
+    }
+
+    switch (change) {
+    case QMapboxGL::MapChangeDidFinishLoadingStyle:
+    case QMapboxGL::MapChangeDidFinishLoadingMap:
+    case QMapboxGL::MapChangeSourceDidChange:
+        d->refreshFromSignal();
+        break;
+    default:
+        break;
+    }
+}
+
+void QGeoMapMapboxGL::onMapNeedsRendering()
+{
+    Q_D(QGeoMapMapboxGL);
+    d->refreshFromSignal();
+}
+
+void QGeoMapMapboxGL::onRefreshTimeout()
+{
+    Q_D(QGeoMapMapboxGL);
+
+    QMapboxGLTrace::instant("refreshTimeout", "refresh");
+    d->refreshFromFallback();
+}
+
+void QGeoMapMapboxGL::startRefresh()
+{
+    Q_D(QGeoMapMapboxGL);
+    d->startRefresh();
+}
+
+void QGeoMapMapboxGL::stopRefresh()
+{
+    Q_D(QGeoMapMapboxGL);
+    d->stopRefresh();
+}
+
+void QGeoMapMapboxGL::scheduleThrottledRender(int msec)
+{
+    Q_D(QGeoMapMapboxGL);
+
+    if (!d->m_throttle.isActive())
+        d->m_throttle.start(msec);
+}
+
+void QGeoMapMapboxGL::onCameraAnimationFinished()
+{
+    Q_D(QGeoMapMapboxGL);
+
+    if (d->m_cameraAnimation && d->m_cameraAnimation->isFinished())
+        d->stopCameraAnimation(false);
+}
+
+void QGeoMapMapboxGL::onCameraAnimationSync()
+{
+    Q_D(QGeoMapMapboxGL);
+
+    if (d->m_cameraAnimation)
+        d->publishCameraData(d->m_cameraAnimation->cameraData());
+}
+
+void QGeoMapMapboxGL::onCameraSettled()
+{
+    Q_D(QGeoMapMapboxGL);
+
+    if (!d->m_preloadedStyles.isEmpty())
+        d->m_standbyRefresh = true;
+
+    if (d->m_renderScale < 1.0 || d->m_standbyRefresh) {
+        d->m_renderPending = true;
+        emit sgNodeChanged();
     }
 }
 
@@ -572,8 +1993,8 @@ void QGeoMapMapboxGL::onMapItemPropertyChanged()
     Q_D(QGeoMapMapboxGL);
 
     QDeclarativeGeoMapItemBase *item = static_cast<QDeclarativeGeoMapItemBase *>(sender());
-    d->m_styleChanges << QMapboxGLStyleSetPaintProperty::fromMapItem(item);
-    d->m_styleChanges << QMapboxGLStyleSetLayoutProperty::fromMapItem(item);
+    d->enqueueStyleChanges(QMapboxGLStyleSetPaintProperty::fromMapItem(item));
+    d->enqueueStyleChanges(QMapboxGLStyleSetLayoutProperty::fromMapItem(item));
 
     emit sgNodeChanged();
 }
@@ -583,7 +2004,7 @@ void QGeoMapMapboxGL::onMapItemSubPropertyChanged()
     Q_D(QGeoMapMapboxGL);
 
     QDeclarativeGeoMapItemBase *item = static_cast<QDeclarativeGeoMapItemBase *>(sender()->parent());
-    d->m_styleChanges << QMapboxGLStyleSetPaintProperty::fromMapItem(item);
+    d->enqueueStyleChanges(QMapboxGLStyleSetPaintProperty::fromMapItem(item));
 
     emit sgNodeChanged();
 }
@@ -599,7 +2020,7 @@ void QGeoMapMapboxGL::onMapItemGeometryChanged()
     Q_D(QGeoMapMapboxGL);
 
     QDeclarativeGeoMapItemBase *item = static_cast<QDeclarativeGeoMapItemBase *>(sender());
-    d->m_styleChanges << QMapboxGLStyleAddSource::fromMapItem(item);
+    d->enqueueStyleChanges({ QMapboxGLStyleAddSource::fromMapItem(item) });
 
     emit sgNodeChanged();
 }
@@ -608,7 +2029,23 @@ void QGeoMapMapboxGL::onParameterPropertyUpdated(QGeoMapParameter *param, const
 {
     Q_D(QGeoMapMapboxGL);
 
-    d->m_styleChanges.append(QMapboxGLStyleChange::addMapParameter(param));
+    if (param->type() == QStringLiteral("camera")) {
+        d->applyCameraParameter(param);
+        return;
+    }
+
+    // Written by the map itself.
+    if (param->type() == QStringLiteral("memoryUsage"))
+        return;
+
+    if (param->type() == QStringLiteral("markers")) {
+        d->applyMarkersParameter(param);
+        return;
+    }
+
+    d->updateParameterBytes(param);
+
+    d->enqueueStyleChanges(QMapboxGLStyleChange::addMapParameter(param));
 
     emit sgNodeChanged();
 }
@@ -42,12 +42,20 @@
 #include <QtLocation/private/qgeomap_p.h>
 #include <QtLocation/private/qgeomapparameter_p.h>
 
+#include <QtCore/QEasingCurve>
+#include <QtCore/QSharedPointer>
+#include <QtGui/QImage>
+
 class QGeoMapMapboxGLPrivate;
+class QMapboxGLMapPool;
+class QMapboxGLPrefetchers;
+class QMapboxGLRequestScheduler;
 
 class QGeoMapMapboxGL : public QGeoMap
 {
     Q_OBJECT
     Q_DECLARE_PRIVATE(QGeoMapMapboxGL)
+    Q_PROPERTY(QVariantMap memoryUsage READ memoryUsage NOTIFY memoryUsageChanged)
 
 public:
     QGeoMapMapboxGL(QGeoMappingManagerEngineMapboxGL *engine, QObject *parent);
@@ -56,12 +64,86 @@ public:
     QString copyrightsStyleSheet() const override;
     void setMapboxGLSettings(const QMapboxGLSettings &, bool useChinaEndpoint);
     void setUseFBO(bool);
+    void setMapPool(QMapboxGLMapPool *);
     void setMapItemsBefore(const QString &);
+
+    // Draws MapQuickItems with a plain Image delegate as one symbol layer,
+    // must be set before items are added.
+    void setQuickItemsAsSymbols(bool enabled, bool allowOverlap);
+    // Also clusters the points of MapParameters of type "markers".
+    void setMarkerClustering(bool enabled, int radius, int maxZoom, const QStringList &font);
+    void setMaximumFrameRate(int);
+    void setIdleThrottling(int timeout, int frameRate);
+    void setAdaptiveResolution(bool enabled, qreal minimumScale, int targetFrameTime);
+    // Prefetchers shared by the maps of the engine, or nullptr.
+    void setPrefetching(QMapboxGLPrefetchers *prefetchers, int lookahead, int budget);
+    void setRequestScheduler(const QSharedPointer<QMapboxGLRequestScheduler> &);
+
+    // Styles kept loaded in standby maps, must be set before the map is
+    // first rendered. Only used with the framebuffer object render path.
+    void setPreloadedStyles(const QStringList &styleUrls);
     Capabilities capabilities() const override;
 
+    // Invokable, so tools and benchmarks holding the QGeoMap can read it.
+    Q_INVOKABLE QVariantMap renderStatistics() const;
+    QVariantMap memoryStatistics() const;
+
+    // Last memoryStatistics() snapshot, refreshed at most twice a second.
+    // QML reads it through a MapParameter of type "memoryUsage", which gets
+    // every statistic it declares a property for, or all of them in usage.
+    QVariantMap memoryUsage() const;
+    void setMemoryLimit(qint64 bytes);
+
+    // Must be set before the map is first rendered.
+    void setFrameTiming(bool enabled, bool gpuTiming, int logInterval);
+    QVariantMap frameTimings() const;
+
+    // Must be set before the map is first rendered.
+    void setSessionRecording(const QString &fileName);
+
+    // Also driven from QML through a MapParameter of type "camera".
+    Q_INVOKABLE void easeTo(const QGeoCameraData &cameraData, int duration,
+                            const QEasingCurve &easing = QEasingCurve(QEasingCurve::InOutQuad));
+    Q_INVOKABLE void flyTo(const QGeoCameraData &cameraData, int duration = -1,
+                           const QEasingCurve &easing = QEasingCurve(QEasingCurve::InOutQuad));
+    Q_INVOKABLE void cancelCameraAnimation();
+    Q_INVOKABLE bool isCameraAnimating() const;
+
+    // Frames are read back asynchronously on the render thread and delivered
+    // through frameCaptured() on the GUI thread.
+    void grabFrame();
+    void setCaptureFrameRate(int frameRate);
+
+Q_SIGNALS:
+    void cameraAnimationFinished(bool cancelled);
+    void frameCaptured(const QImage &image);
+    void memoryUsageChanged();
+
 private Q_SLOTS:
     // QMapboxGL
     void onMapChanged(QMapboxGL::MapChange);
+    void onMapNeedsRendering();
+
+    // Fallback refresh for threaded rendering
+    void onRefreshTimeout();
+    void startRefresh();
+    void stopRefresh();
+
+    // Deferred render of frames skipped by the frame rate limit
+    void scheduleThrottledRender(int msec);
+
+    // Full resolution frame once the camera stopped moving
+    void onCameraSettled();
+
+    // Camera animations interpolated on the render side
+    void onCameraAnimationFinished();
+    void onCameraAnimationSync();
+
+    // Periodic frame timing summary
+    void onFrameTimingLog();
+
+    // Coalesced memory accounting refresh
+    void onMemoryUpdate();
 
     // QDeclarativeGeoMapItemBase
     void onMapItemPropertyChanged();
@@ -38,17 +38,32 @@
 #ifndef QGEOMAPMAPBOXGL_P_H
 #define QGEOMAPMAPBOXGL_P_H
 
+#include <QtCore/QElapsedTimer>
 #include <QtCore/QHash>
 #include <QtCore/QList>
+#include <QtCore/QMargins>
 #include <QtCore/QSharedPointer>
+#include <QtCore/QStringList>
 #include <QtCore/QTimer>
 #include <QtCore/QVariant>
 #include <QtCore/QRectF>
+#include <QtCore/QScopedPointer>
 #include <QtLocation/private/qgeomap_p_p.h>
 #include <QtLocation/private/qgeomapparameter_p.h>
+#include <QtPositioning/QGeoCoordinate>
+#include <QtPositioning/private/qdoublevector2d_p.h>
 
 class QMapboxGL;
+class QMapboxGLCameraAnimation;
+class QMapboxGLFrameTiming;
+class QMapboxGLMapPool;
+class QMapboxGLMarkerLayer;
+class QMapboxGLPrefetcher;
+class QMapboxGLPrefetchers;
+class QMapboxGLRequestScheduler;
+class QMapboxGLSessionRecorder;
 class QMapboxGLStyleChange;
+class QSGMapboxGLTextureNode;
 
 class QGeoMapMapboxGLPrivate : public QGeoMapPrivate
 {
@@ -68,6 +83,22 @@ public:
     void addMapItem(QDeclarativeGeoMapItemBase *item) override;
     void removeMapItem(QDeclarativeGeoMapItemBase *item) override;
 
+    void startRefresh();
+    void stopRefresh();
+    void refreshFromSignal();
+    void refreshFromFallback();
+
+    void applyCameraParameter(QGeoMapParameter *param);
+    void applyMarkersParameter(QGeoMapParameter *param);
+    void startCameraAnimation(QMapboxGLCameraAnimation *animation);
+    void stopCameraAnimation(bool cancelled);
+    void publishCameraData(const QGeoCameraData &cameraData);
+    void enqueueStyleChanges(const QList<QSharedPointer<QMapboxGLStyleChange>> &changes);
+    void updateParameterBytes(QGeoMapParameter *param);
+    void publishMemoryUsage(QGeoMapParameter *param);
+    void scheduleMemoryUpdate();
+    void publishViewport();
+
     /* Data members */
     enum SyncState : int {
         NoSync = 0,
@@ -80,10 +111,109 @@ public:
 
     QMapboxGLSettings m_settings;
     bool m_useFBO = true;
+    qreal m_pixelRatio = 1.0;
+    QMapboxGLMapPool *m_mapPool = nullptr;
+
+    QTimer m_capture;
+    bool m_captureRequested = false;
+
+    QScopedPointer<QMapboxGLFrameTiming> m_frameTiming;
+    bool m_gpuTiming = false;
+    QTimer m_frameTimingLog;
+
+    QScopedPointer<QMapboxGLSessionRecorder> m_recorder;
+    QSharedPointer<QMapboxGLRequestScheduler> m_requestScheduler;
+
+    QElapsedTimer m_created;
+    qint64 m_styleLoadLatency = -1;
+    qint64 m_firstFrameLatency = -1;
+
+    QTimer m_memoryUpdate;
+    QVariantMap m_memoryUsage;
+    qint64 m_framebufferBytes = 0;
+    int m_standbyMaps = 0;
+    qint64 m_standbyMapBytes = 0;
+
+    struct ParameterBytes {
+        qint64 bytes = 0;
+        int sources = 0;
+        int layers = 0;
+    };
+    QHash<QGeoMapParameter *, ParameterBytes> m_parameterBytes;
+    qint64 m_memoryLimit = 0;
+    bool m_memoryLimitExceeded = false;
     bool m_developmentMode = false;
     QString m_mapItemsBefore;
+    bool m_quickItemsAsSymbols = false;
+    QScopedPointer<QMapboxGLMarkerLayer> m_markers;
+
+    QStringList m_preloadedStyles;
+    QString m_styleUrl;
+    bool m_standbyRefresh = false;
+    quint64 m_styleSwitches = 0;
+    quint64 m_instantStyleSwitches = 0;
 
     QTimer m_refresh;                               // 
+    int m_refreshInterval = 0;
+    QElapsedTimer m_refreshLoading;
+    quint64 m_signalRefreshes = 0;
+    quint64 m_fallbackRefreshes = 0;
+    quint64 m_fallbackRefreshesInPeriod = 0;
+    quint64 m_avoidedRefreshes = 0;
+
+    QTimer m_throttle;
+    int m_maximumFrameRate = 0;
+    int m_idleTimeout = 0;
+    int m_idleFrameRate = 0;
+    bool m_renderPending = true;
+    bool m_renderRequested = false;
+    QElapsedTimer m_lastRender;
+    QElapsedTimer m_lastActivity;
+    quint64 m_throttledFrames = 0;
+
+    QTimer m_cameraSettle;
+    bool m_adaptiveResolution = false;
+    qreal m_minimumRenderScale = 0.5;
+    int m_targetFrameTime = 16;
+    qreal m_renderScale = 1.0;
+    qint64 m_lastFrameTime = 0;
+    QElapsedTimer m_lastCameraChange;
+
+    bool m_cameraApplied = false;
+    QGeoCoordinate m_appliedCenter;
+    double m_appliedZoom = 0.0;
+    double m_appliedBearing = 0.0;
+    double m_appliedPitch = 0.0;
+    QMargins m_appliedMargins;
+    quint64 m_cameraSyncs = 0;
+    quint64 m_cameraSyncsSkipped = 0;
+    qint64 m_cameraSyncTime = 0;
+
+    QSharedPointer<QMapboxGLCameraAnimation> m_cameraAnimation;
+    QGeoCameraData m_publishedCamera;
+    bool m_applyingAnimatedCamera = false;
+
+    struct PrefetchPrediction {
+        QDoubleVector2D position;
+        double zoom;
+        qint64 deadline;
+    };
+
+    QMapboxGLPrefetchers *m_prefetchers = nullptr;
+    int m_prefetchLookahead = 500;
+    int m_prefetchBudget = 4;
+    QElapsedTimer m_cameraMotionClock;
+    QDoubleVector2D m_cameraPosition;
+    double m_cameraZoom = 0.0;
+    QDoubleVector2D m_cameraVelocity;
+    double m_zoomVelocity = 0.0;
+    QElapsedTimer m_lastPrefetch;
+    QElapsedTimer m_prefetchClock;
+    QList<PrefetchPrediction> m_prefetchPredictions;
+    quint64 m_prefetches = 0;
+    quint64 m_prefetchHits = 0;
+    quint64 m_prefetchMisses = 0;
+
     bool m_shouldRefresh = true;
     bool m_warned = false;
     bool m_threadedRendering = false;
@@ -105,6 +235,15 @@ private:
     Q_DISABLE_COPY(QGeoMapMapboxGLPrivate);
 
     void syncStyleChanges(QMapboxGL *map);
+    bool switchToStandbyMap(QSGMapboxGLTextureNode *node, const QString &styleUrl);
+    void syncCamera(QMapboxGL *map, const QGeoCameraData &cameraData);
+    bool throttleRender(QMapboxGL *map, bool changed);
+    void updateRenderScale(QSGMapboxGLTextureNode *node);
+    void captureFrames(QSGMapboxGLTextureNode *node);
+    void trackCameraMotion();
+    bool predictCameraData(QGeoCameraData *predicted) const;
+    void schedulePrefetch(QMapboxGLPrefetcher *prefetcher);
+    void updatePrefetchStatistics(const QGeoCameraData &cameraData);
     void threadedRenderingHack(QQuickWindow *window, QMapboxGL *map);
 
     QRectF m_visibleArea;
@@ -37,13 +37,30 @@
 
 #include "qgeomappingmanagerenginemapboxgl.h"
 #include "qgeomapmapboxgl.h"
+#include "qmapboxglcachedatabase_p.h"
+#include "qmapboxglcachemaintainer_p.h"
+#include "qmapboxglcachewarmer_p.h"
+#include "qmapboxglofflinedownloader.h"
+#include "qmapboxgltilearchive_p.h"
+#include "qmapboxgltrace_p.h"
 
+#include <QtCore/QFileInfo>
+#include <QtCore/QUrl>
 #include <QtCore/qstandardpaths.h>
 #include <QtLocation/private/qabstractgeotilecache_p.h>
 #include <QtLocation/private/qgeocameracapabilities_p.h>
 #include <QtLocation/private/qgeomaptype_p.h>
 
+#include <QDebug>
 #include <QDir>
+#include <QGuiApplication>
+
+namespace {
+
+// Cache usage asked for is measured again when older than this.
+const int cacheStatisticsMaximumAge = 5000;
+
+} // namespace
 
 QT_BEGIN_NAMESPACE
 
@@ -53,6 +70,22 @@ QGeoMappingManagerEngineMapboxGL::QGeoMappingManagerEngineMapboxGL(const QVarian
     *error = QGeoServiceProvider::NoError;
     errorString->clear();
 
+    // Before the tile server first starts, for archive styles below. On by
+    // default, so the maps of the engine share requests in flight.
+    if (!parameters.contains(QStringLiteral("mapboxgl.mapping.network.scheduling"))
+            || parameters.value(QStringLiteral("mapboxgl.mapping.network.scheduling")).toBool()) {
+        int connectionsPerHost = 4;
+        if (parameters.contains(QStringLiteral("mapboxgl.mapping.network.max_connections_per_host"))) {
+            bool ok = false;
+            int connections = parameters.value(QStringLiteral("mapboxgl.mapping.network.max_connections_per_host")).toString().toInt(&ok);
+
+            if (ok && connections > 0)
+                connectionsPerHost = connections;
+        }
+
+        m_tileServer.setScheduling(connectionsPerHost);
+    }
+
     QGeoCameraCapabilities cameraCaps;
     cameraCaps.setMinimumZoomLevel(0.0);
     cameraCaps.setMaximumZoomLevel(20.0);
@@ -122,20 +155,34 @@ QGeoMappingManagerEngineMapboxGL::QGeoMappingManagerEngineMapboxGL(const QVarian
         const QStringList idList = ids.split(',', Qt::SkipEmptyParts);
 
         for (auto it = idList.crbegin(), end = idList.crend(); it != end; ++it) {
-            if ((*it).isEmpty())
-                continue;
-            if ((*it).startsWith(QStringLiteral("http:")))
+            // Local archives get a default style served next to their tiles.
+            QString styleUrl = *it;
+            if (QMapboxGLTileArchive::isArchiveUrl(styleUrl))
+                styleUrl = QMapboxGLTileServer::styleUrl(styleUrl);
+
+            if (styleUrl.startsWith(QStringLiteral("http:")))
                 metadata["isHTTPS"] = false;
             else
                 metadata["isHTTPS"] = true;
 
-            mapTypes.prepend(QGeoMapType(QGeoMapType::CustomMap, *it,
+            mapTypes.prepend(QGeoMapType(QGeoMapType::CustomMap, styleUrl,
                     tr("User provided style"), false, false, ++mapId, pluginName, cameraCaps, metadata));
         }
     }
 
     setSupportedMapTypes(mapTypes);
 
+    // Styles kept loaded next to the active one, e.g. day and night variants.
+    if (parameters.contains(QStringLiteral("mapboxgl.mapping.preload_styles"))) {
+        const QString styles = parameters.value(QStringLiteral("mapboxgl.mapping.preload_styles")).toString();
+        const QStringList styleList = styles.split(',', Qt::SkipEmptyParts);
+
+        for (const QGeoMapType &mapType : mapTypes) {
+            if (styleList.contains(QStringLiteral("all")) || styleList.contains(mapType.name()))
+                m_preloadedStyles.append(mapType.name());
+        }
+    }
+
     if (parameters.contains(QStringLiteral("mapboxgl.access_token"))) {
         m_settings.setAccessToken(parameters.value(QStringLiteral("mapboxgl.access_token")).toString());
     }
@@ -165,6 +212,128 @@ QGeoMappingManagerEngineMapboxGL::QGeoMappingManagerEngineMapboxGL(const QVarian
             m_settings.setCacheDatabaseMaximumSize(cacheSize);
     }
 
+    if (parameters.contains(QStringLiteral("mapboxgl.mapping.cache.sqlite.journal_mode"))) {
+        m_cacheTuning.journalMode = parameters.value(QStringLiteral("mapboxgl.mapping.cache.sqlite.journal_mode")).toString();
+    }
+
+    if (parameters.contains(QStringLiteral("mapboxgl.mapping.cache.sqlite.page_size"))) {
+        m_cacheTuning.pageSize = parameters.value(QStringLiteral("mapboxgl.mapping.cache.sqlite.page_size")).toString().toInt();
+    }
+
+    if (parameters.contains(QStringLiteral("mapboxgl.mapping.cache.sqlite.cache_size"))) {
+        m_cacheTuning.cacheSize = parameters.value(QStringLiteral("mapboxgl.mapping.cache.sqlite.cache_size")).toString().toInt();
+    }
+
+    if (parameters.contains(QStringLiteral("mapboxgl.mapping.cache.sqlite.mmap_size"))) {
+        bool ok = false;
+        qint64 mmapSize = parameters.value(QStringLiteral("mapboxgl.mapping.cache.sqlite.mmap_size")).toString().toLongLong(&ok);
+
+        if (ok && mmapSize >= 0)
+            m_cacheTuning.mmapSize = mmapSize;
+    }
+
+    if (parameters.contains(QStringLiteral("mapboxgl.mapping.cache.sqlite.synchronous"))) {
+        m_cacheTuning.synchronous = parameters.value(QStringLiteral("mapboxgl.mapping.cache.sqlite.synchronous")).toString();
+    }
+
+    if (!QMapboxGLCacheDatabase::isValid(m_cacheTuning)) {
+        qWarning("Invalid mapboxgl.mapping.cache.sqlite parameters, the cache database is left untouched.");
+        m_cacheTuning = QMapboxGLCacheDatabase::Tuning();
+    }
+
+    if (!memoryCache)
+        m_cacheMaintainer.reset(new QMapboxGLCacheMaintainer(m_settings.cacheDatabasePath(), m_cacheTuning));
+
+    // Mapbox GL waits for the database while the file is rewritten.
+    if (m_cacheMaintainer && !m_cacheTuning.isNull())
+        m_cacheMaintainer->tune();
+
+    QMapboxGLCacheDatabase::EvictionPolicy evictionPolicy;
+    bool eviction = true;
+    if (parameters.contains(QStringLiteral("mapboxgl.mapping.cache.eviction.policy"))) {
+        const QString policy = parameters.value(QStringLiteral("mapboxgl.mapping.cache.eviction.policy")).toString().toLower();
+
+        if (policy == QStringLiteral("none"))
+            eviction = false;
+        else if (policy == QStringLiteral("expires"))
+            evictionPolicy.order = QMapboxGLCacheDatabase::EvictionPolicy::ExpiringFirst;
+        else if (policy != QStringLiteral("lru"))
+            qWarning() << "Unknown mapboxgl.mapping.cache.eviction.policy" << policy << ", using lru.";
+    }
+
+    if (parameters.contains(QStringLiteral("mapboxgl.mapping.cache.eviction.max_size"))) {
+        bool ok = false;
+        qint64 maximumSize = parameters.value(QStringLiteral("mapboxgl.mapping.cache.eviction.max_size")).toString().toLongLong(&ok);
+
+        if (ok && maximumSize > 0)
+            evictionPolicy.maximumSize = maximumSize;
+    }
+
+    // url_fragment=bytes,...
+    if (parameters.contains(QStringLiteral("mapboxgl.mapping.cache.eviction.source_quotas"))) {
+        const QStringList quotas = parameters.value(QStringLiteral("mapboxgl.mapping.cache.eviction.source_quotas")).toString().split(',', Qt::SkipEmptyParts);
+
+        for (const QString &quota : quotas) {
+            const int separator = quota.lastIndexOf(QLatin1Char('='));
+            bool ok = false;
+            const qint64 bytes = quota.mid(separator + 1).toLongLong(&ok);
+
+            if (separator > 0 && ok && bytes >= 0)
+                evictionPolicy.sourceQuotas.insert(quota.left(separator).trimmed(), bytes);
+            else
+                qWarning() << "Invalid mapboxgl.mapping.cache.eviction.source_quotas entry" << quota;
+        }
+    }
+
+    // north,west,south,east[,min_zoom,max_zoom];...
+    QList<QMapboxGLOfflineDownloader::Region> pinnedRegions;
+    if (parameters.contains(QStringLiteral("mapboxgl.mapping.cache.eviction.pinned_regions"))) {
+        const QStringList regions = parameters.value(QStringLiteral("mapboxgl.mapping.cache.eviction.pinned_regions")).toString().split(';', Qt::SkipEmptyParts);
+
+        for (const QString &entry : regions) {
+            const QStringList values = entry.split(QLatin1Char(','));
+            if (values.size() != 4 && values.size() != 6) {
+                qWarning() << "Invalid mapboxgl.mapping.cache.eviction.pinned_regions entry" << entry;
+                continue;
+            }
+
+            QMapboxGLOfflineDownloader::Region region;
+            region.bounds = QGeoRectangle(QGeoCoordinate(values.at(0).toDouble(), values.at(1).toDouble()),
+                                          QGeoCoordinate(values.at(2).toDouble(), values.at(3).toDouble()));
+            if (values.size() == 6) {
+                region.minZoom = values.at(4).toDouble();
+                region.maxZoom = values.at(5).toDouble();
+            }
+            region.name = QStringLiteral("mapboxgl.mapping.cache.eviction.pinned_regions");
+            pinnedRegions.append(region);
+        }
+    }
+
+    if (eviction && m_cacheMaintainer && (!evictionPolicy.isNull() || !pinnedRegions.isEmpty()))
+        m_cacheMaintainer->maintain(evictionPolicy, pinnedRegions);
+
+    if (parameters.contains(QStringLiteral("mapboxgl.mapping.cache.warmup"))
+            && parameters.value(QStringLiteral("mapboxgl.mapping.cache.warmup")).toBool()
+            && !memoryCache && !supportedMapTypes().isEmpty()) {
+        m_cacheWarmer.reset(new QMapboxGLCacheWarmer(m_settings.cacheDatabasePath(), supportedMapTypes().first().name()));
+        m_cacheWarmer->start();
+    }
+
+    // Only applies to what the offline downloader stores. Mapbox GL
+    // compresses the ambient cache entries it writes itself.
+    if (parameters.contains(QStringLiteral("mapboxgl.mapping.offline.compression"))
+            && parameters.value(QStringLiteral("mapboxgl.mapping.offline.compression")).toBool()) {
+        m_offlineCompressionLevel = 6;
+
+        if (parameters.contains(QStringLiteral("mapboxgl.mapping.offline.compression.level"))) {
+            bool ok = false;
+            int level = parameters.value(QStringLiteral("mapboxgl.mapping.offline.compression.level")).toString().toInt(&ok);
+
+            if (ok && level >= 1 && level <= 9)
+                m_offlineCompressionLevel = level;
+        }
+    }
+
     if (parameters.contains(QStringLiteral("mapboxgl.mapping.use_fbo"))) {
         m_useFBO = parameters.value(QStringLiteral("mapboxgl.mapping.use_fbo")).toBool();
     }
@@ -173,6 +342,169 @@ QGeoMappingManagerEngineMapboxGL::QGeoMappingManagerEngineMapboxGL(const QVarian
         m_mapItemsBefore = parameters.value(QStringLiteral("mapboxgl.mapping.items.insert_before")).toString();
     }
 
+    if (parameters.contains(QStringLiteral("mapboxgl.mapping.items.quick_items_as_symbols"))) {
+        m_quickItemsAsSymbols = parameters.value(QStringLiteral("mapboxgl.mapping.items.quick_items_as_symbols")).toBool();
+    }
+
+    if (parameters.contains(QStringLiteral("mapboxgl.mapping.items.quick_items_as_symbols.allow_overlap"))) {
+        m_markerAllowOverlap = parameters.value(QStringLiteral("mapboxgl.mapping.items.quick_items_as_symbols.allow_overlap")).toBool();
+    }
+
+    if (parameters.contains(QStringLiteral("mapboxgl.mapping.items.quick_items_as_symbols.cluster"))) {
+        m_markerClustering = parameters.value(QStringLiteral("mapboxgl.mapping.items.quick_items_as_symbols.cluster")).toBool();
+    }
+
+    if (parameters.contains(QStringLiteral("mapboxgl.mapping.items.quick_items_as_symbols.cluster_radius"))) {
+        bool ok = false;
+        int clusterRadius = parameters.value(QStringLiteral("mapboxgl.mapping.items.quick_items_as_symbols.cluster_radius")).toString().toInt(&ok);
+
+        if (ok && clusterRadius > 0)
+            m_markerClusterRadius = clusterRadius;
+    }
+
+    if (parameters.contains(QStringLiteral("mapboxgl.mapping.items.quick_items_as_symbols.cluster_max_zoom"))) {
+        bool ok = false;
+        int clusterMaxZoom = parameters.value(QStringLiteral("mapboxgl.mapping.items.quick_items_as_symbols.cluster_max_zoom")).toString().toInt(&ok);
+
+        if (ok && clusterMaxZoom >= 0)
+            m_markerClusterMaxZoom = clusterMaxZoom;
+    }
+
+    // Font stack of the cluster counts, has to be served by the glyphs URL
+    // of the style.
+    if (parameters.contains(QStringLiteral("mapboxgl.mapping.items.quick_items_as_symbols.cluster_font"))) {
+        const QStringList fonts = parameters.value(QStringLiteral("mapboxgl.mapping.items.quick_items_as_symbols.cluster_font")).toString().split(QLatin1Char(','), Qt::SkipEmptyParts);
+        for (const QString &font : fonts)
+            m_markerClusterFont << font.trimmed();
+    }
+
+    if (parameters.contains(QStringLiteral("mapboxgl.mapping.max_fps"))) {
+        bool ok = false;
+        int maximumFrameRate = parameters.value(QStringLiteral("mapboxgl.mapping.max_fps")).toString().toInt(&ok);
+
+        if (ok && maximumFrameRate >= 0)
+            m_maximumFrameRate = maximumFrameRate;
+    }
+
+    if (parameters.contains(QStringLiteral("mapboxgl.mapping.idle.timeout"))) {
+        bool ok = false;
+        int idleTimeout = parameters.value(QStringLiteral("mapboxgl.mapping.idle.timeout")).toString().toInt(&ok);
+
+        if (ok && idleTimeout >= 0)
+            m_idleTimeout = idleTimeout;
+    }
+
+    if (parameters.contains(QStringLiteral("mapboxgl.mapping.idle.fps"))) {
+        bool ok = false;
+        int idleFrameRate = parameters.value(QStringLiteral("mapboxgl.mapping.idle.fps")).toString().toInt(&ok);
+
+        if (ok && idleFrameRate >= 0)
+            m_idleFrameRate = idleFrameRate;
+    }
+
+    if (parameters.contains(QStringLiteral("mapboxgl.mapping.adaptive_resolution"))) {
+        m_adaptiveResolution = parameters.value(QStringLiteral("mapboxgl.mapping.adaptive_resolution")).toBool();
+    }
+
+    if (parameters.contains(QStringLiteral("mapboxgl.mapping.adaptive_resolution.minimum_scale"))) {
+        bool ok = false;
+        qreal minimumScale = parameters.value(QStringLiteral("mapboxgl.mapping.adaptive_resolution.minimum_scale")).toString().toDouble(&ok);
+
+        if (ok && minimumScale > 0.0 && minimumScale <= 1.0)
+            m_minimumRenderScale = minimumScale;
+    }
+
+    if (parameters.contains(QStringLiteral("mapboxgl.mapping.adaptive_resolution.target_frame_time"))) {
+        bool ok = false;
+        int targetFrameTime = parameters.value(QStringLiteral("mapboxgl.mapping.adaptive_resolution.target_frame_time")).toString().toInt(&ok);
+
+        if (ok && targetFrameTime > 0)
+            m_targetFrameTime = targetFrameTime;
+    }
+
+    if (parameters.contains(QStringLiteral("mapboxgl.mapping.prefetch"))) {
+        m_prefetch = parameters.value(QStringLiteral("mapboxgl.mapping.prefetch")).toBool();
+    }
+
+    if (parameters.contains(QStringLiteral("mapboxgl.mapping.prefetch.lookahead"))) {
+        bool ok = false;
+        int lookahead = parameters.value(QStringLiteral("mapboxgl.mapping.prefetch.lookahead")).toString().toInt(&ok);
+
+        if (ok && lookahead > 0)
+            m_prefetchLookahead = lookahead;
+    }
+
+    if (parameters.contains(QStringLiteral("mapboxgl.mapping.prefetch.budget"))) {
+        bool ok = false;
+        int budget = parameters.value(QStringLiteral("mapboxgl.mapping.prefetch.budget")).toString().toInt(&ok);
+
+        if (ok && budget >= 0)
+            m_prefetchBudget = budget;
+    }
+
+    if (parameters.contains(QStringLiteral("mapboxgl.mapping.pool.size"))) {
+        bool ok = false;
+        int poolSize = parameters.value(QStringLiteral("mapboxgl.mapping.pool.size")).toString().toInt(&ok);
+
+        if (ok && poolSize >= 0) {
+            m_mapPool.setMaximumSize(poolSize);
+            m_useMapPool = poolSize > 0;
+        }
+    }
+
+    if (parameters.contains(QStringLiteral("mapboxgl.mapping.pool.expiry"))) {
+        bool ok = false;
+        int expiry = parameters.value(QStringLiteral("mapboxgl.mapping.pool.expiry")).toString().toInt(&ok);
+
+        if (ok && expiry >= 0)
+            m_mapPool.setExpiryTime(expiry);
+    }
+
+    if (parameters.contains(QStringLiteral("mapboxgl.mapping.memory_limit"))) {
+        bool ok = false;
+        qint64 limit = parameters.value(QStringLiteral("mapboxgl.mapping.memory_limit")).toString().toLongLong(&ok);
+
+        if (ok && limit >= 0)
+            m_memoryLimit = limit;
+    }
+
+    if (parameters.contains(QStringLiteral("mapboxgl.diagnostics.frame_timing"))) {
+        m_frameTiming = parameters.value(QStringLiteral("mapboxgl.diagnostics.frame_timing")).toBool();
+    }
+
+    if (parameters.contains(QStringLiteral("mapboxgl.diagnostics.frame_timing.gpu"))) {
+        m_gpuTiming = parameters.value(QStringLiteral("mapboxgl.diagnostics.frame_timing.gpu")).toBool();
+    }
+
+    if (parameters.contains(QStringLiteral("mapboxgl.diagnostics.frame_timing.interval"))) {
+        bool ok = false;
+        int interval = parameters.value(QStringLiteral("mapboxgl.diagnostics.frame_timing.interval")).toString().toInt(&ok);
+
+        if (ok && interval >= 0)
+            m_frameTimingInterval = interval;
+    }
+
+    if (parameters.contains(QStringLiteral("mapboxgl.diagnostics.trace"))) {
+        QMapboxGLTrace::enable(parameters.value(QStringLiteral("mapboxgl.diagnostics.trace")).toString());
+    }
+
+    if (parameters.contains(QStringLiteral("mapboxgl.diagnostics.record"))) {
+        m_recordFile = parameters.value(QStringLiteral("mapboxgl.diagnostics.record")).toString();
+    }
+
+    // There is no portable low memory notification, going to the
+    // background is the closest thing to it.
+    connect(qApp, &QGuiApplication::applicationStateChanged, this, [this](Qt::ApplicationState state) {
+        if (state == Qt::ApplicationSuspended || state == Qt::ApplicationHidden)
+            trimMapPool();
+    });
+
+    m_tileServer.install(&m_settings);
+    m_sharedResources.install(&m_settings);
+
+    if (parameters.contains(QStringLiteral("mapboxgl.mapping.offline.region")))
+        startOfflineDownload(parameters);
+
     engineInitialized();
 }
 
@@ -185,9 +517,168 @@ QGeoMap *QGeoMappingManagerEngineMapboxGL::createMap()
     QGeoMapMapboxGL* map = new QGeoMapMapboxGL(this, 0);
     map->setMapboxGLSettings(m_settings, m_useChinaEndpoint);
     map->setUseFBO(m_useFBO);
+    map->setMapPool(m_useMapPool ? &m_mapPool : nullptr);
     map->setMapItemsBefore(m_mapItemsBefore);
+    map->setQuickItemsAsSymbols(m_quickItemsAsSymbols, m_markerAllowOverlap);
+    map->setMarkerClustering(m_markerClustering, m_markerClusterRadius, m_markerClusterMaxZoom, m_markerClusterFont);
+    map->setMaximumFrameRate(m_maximumFrameRate);
+    map->setIdleThrottling(m_idleTimeout, m_idleFrameRate);
+    map->setAdaptiveResolution(m_adaptiveResolution, m_minimumRenderScale, m_targetFrameTime);
+    map->setPrefetching(m_prefetch ? &m_prefetchers : nullptr, m_prefetchLookahead, m_prefetchBudget);
+    map->setRequestScheduler(m_tileServer.scheduler());
+    if (m_useFBO)
+        map->setPreloadedStyles(m_preloadedStyles);
+    map->setFrameTiming(m_frameTiming, m_gpuTiming, m_frameTimingInterval);
+    map->setMemoryLimit(m_memoryLimit);
+
+    if (!m_recordFile.isEmpty()) {
+        // One recording per map, numbered after the first one.
+        QString fileName = m_recordFile;
+        if (++m_recordedMaps > 1) {
+            const QFileInfo info(m_recordFile);
+            fileName = info.path() + QLatin1Char('/') + info.completeBaseName()
+                    + QLatin1Char('-') + QString::number(m_recordedMaps)
+                    + (info.suffix().isEmpty() ? QString() : QLatin1Char('.') + info.suffix());
+        }
+        map->setSessionRecording(fileName);
+    }
+
+    m_sharedResources.registerMap(map);
 
     return map;
 }
 
+QVariantMap QGeoMappingManagerEngineMapboxGL::cacheStatistics() const
+{
+    if (!m_cacheMaintainer)
+        return QVariantMap { { QStringLiteral("available"), false } };
+
+    QVariantMap statistics = m_cacheMaintainer->evictionStatistics();
+
+    // Measured on the maintenance thread, the numbers may be a few seconds
+    // old. None until the first measurement is done.
+    const QVariantMap usage = m_cacheMaintainer->usage(cacheStatisticsMaximumAge);
+    if (usage.isEmpty()) {
+        statistics[QStringLiteral("available")] = false;
+        return statistics;
+    }
+
+    for (auto it = usage.cbegin(); it != usage.cend(); ++it)
+        statistics.insert(it.key(), it.value());
+
+    // Mapbox GL updates the access time of everything it reads from or
+    // writes to the cache. What it used and was there before came from
+    // the cache, what it added came from the network. Entries count once
+    // however often they were used.
+    const qint64 added = usage.value(QStringLiteral("tilesAdded")).toLongLong()
+            + usage.value(QStringLiteral("resourcesAdded")).toLongLong();
+    const qint64 addedBytes = usage.value(QStringLiteral("tilesAddedBytes")).toLongLong()
+            + usage.value(QStringLiteral("resourcesAddedBytes")).toLongLong();
+    const qint64 used = usage.value(QStringLiteral("tilesUsed")).toLongLong()
+            + usage.value(QStringLiteral("resourcesUsed")).toLongLong();
+    const qint64 usedBytes = usage.value(QStringLiteral("tilesUsedBytes")).toLongLong()
+            + usage.value(QStringLiteral("resourcesUsedBytes")).toLongLong();
+    const qint64 hits = qMax(used - added, qint64(0));
+
+    statistics[QStringLiteral("available")] = true;
+    statistics[QStringLiteral("hits")] = hits;
+    statistics[QStringLiteral("misses")] = added;
+    statistics[QStringLiteral("hitRate")] = used ? double(hits) / used : 0.0;
+    statistics[QStringLiteral("cacheBytes")] = qMax(usedBytes - addedBytes, qint64(0));
+    statistics[QStringLiteral("networkBytes")] = addedBytes;
+
+    // As transferred, when requests go through the scheduling proxy.
+    const QVariantMap scheduling = m_tileServer.statistics().value(QStringLiteral("scheduling")).toMap();
+    if (!scheduling.isEmpty())
+        statistics[QStringLiteral("transferredBytes")] = scheduling.value(QStringLiteral("networkBytes"));
+
+    return statistics;
+}
+
+void QGeoMappingManagerEngineMapboxGL::startOfflineDownload(const QVariantMap &parameters)
+{
+    // north,west,south,east
+    const QStringList bounds = parameters.value(QStringLiteral("mapboxgl.mapping.offline.region")).toString().split(QLatin1Char(','));
+    if (bounds.size() != 4) {
+        qWarning("mapboxgl.mapping.offline.region expects north,west,south,east.");
+        return;
+    }
+
+    QMapboxGLOfflineDownloader::Region region;
+    region.bounds = QGeoRectangle(QGeoCoordinate(bounds.at(0).toDouble(), bounds.at(1).toDouble()),
+                                  QGeoCoordinate(bounds.at(2).toDouble(), bounds.at(3).toDouble()));
+    region.name = QStringLiteral("mapboxgl.mapping.offline.region");
+
+    // The downloader only speaks http and https, the first such map type
+    // is the default. The built-in mapbox:// styles are not.
+    if (parameters.contains(QStringLiteral("mapboxgl.mapping.offline.style"))) {
+        region.styleUrl = parameters.value(QStringLiteral("mapboxgl.mapping.offline.style")).toString();
+    } else {
+        for (const QGeoMapType &type : supportedMapTypes()) {
+            const QString scheme = QUrl(type.name()).scheme();
+            if (scheme == QStringLiteral("http") || scheme == QStringLiteral("https")) {
+                region.styleUrl = type.name();
+                break;
+            }
+        }
+    }
+
+    if (region.styleUrl.isEmpty()) {
+        qWarning("mapboxgl.mapping.offline.region needs mapboxgl.mapping.offline.style set to an http or https style URL.");
+        return;
+    }
+
+    if (parameters.contains(QStringLiteral("mapboxgl.mapping.offline.min_zoom")))
+        region.minZoom = parameters.value(QStringLiteral("mapboxgl.mapping.offline.min_zoom")).toDouble();
+
+    if (parameters.contains(QStringLiteral("mapboxgl.mapping.offline.max_zoom")))
+        region.maxZoom = parameters.value(QStringLiteral("mapboxgl.mapping.offline.max_zoom")).toDouble();
+
+    m_offlineDownloader.reset(createOfflineDownloader());
+
+    if (parameters.contains(QStringLiteral("mapboxgl.mapping.offline.concurrency"))) {
+        bool ok = false;
+        int concurrency = parameters.value(QStringLiteral("mapboxgl.mapping.offline.concurrency")).toString().toInt(&ok);
+
+        if (ok && concurrency > 0)
+            m_offlineDownloader->setConcurrency(concurrency);
+    }
+
+    if (!m_offlineDownloader->start(region))
+        qWarning("Unable to start the offline download of mapboxgl.mapping.offline.region.");
+}
+
+QMapboxGLOfflineDownloader *QGeoMappingManagerEngineMapboxGL::createOfflineDownloader(QObject *parent) const
+{
+    QMapboxGLOfflineDownloader *downloader = new QMapboxGLOfflineDownloader(m_settings, parent);
+    downloader->setCacheTuning(m_cacheTuning);
+    downloader->setCompressionLevel(m_offlineCompressionLevel);
+
+    return downloader;
+}
+
+QVariantMap QGeoMappingManagerEngineMapboxGL::resourceStatistics() const
+{
+    QVariantMap statistics = m_sharedResources.statistics();
+    statistics[QStringLiteral("pooledMaps")] = m_mapPool.size();
+    statistics[QStringLiteral("tileServer")] = m_tileServer.statistics();
+    statistics[QStringLiteral("cache")] = cacheStatistics();
+    if (m_cacheWarmer)
+        statistics[QStringLiteral("cacheWarmup")] = m_cacheWarmer->statistics();
+    if (m_offlineDownloader)
+        statistics[QStringLiteral("offlineDownload")] = m_offlineDownloader->statistics();
+
+    return statistics;
+}
+
+bool QGeoMappingManagerEngineMapboxGL::writeTrace(const QString &fileName) const
+{
+    return QMapboxGLTrace::write(fileName);
+}
+
+void QGeoMappingManagerEngineMapboxGL::trimMapPool()
+{
+    m_mapPool.trim();
+}
+
 QT_END_NAMESPACE
@@ -41,8 +41,20 @@
 #include <QtLocation/QGeoServiceProvider>
 #include <QtLocation/private/qgeomappingmanagerengine_p.h>
 
+#include <QtCore/QScopedPointer>
+
 #include <QMapboxGL>
 
+#include "qmapboxglcachedatabase_p.h"
+#include "qmapboxglmappool_p.h"
+#include "qmapboxglofflinedownloader.h"
+#include "qmapboxglprefetcher_p.h"
+#include "qmapboxglsharedresources_p.h"
+#include "qmapboxgltileserver_p.h"
+
+class QMapboxGLCacheMaintainer;
+class QMapboxGLCacheWarmer;
+
 QT_BEGIN_NAMESPACE
 
 class QGeoMappingManagerEngineMapboxGL : public QGeoMappingManagerEngine
@@ -55,12 +67,52 @@ public:
     ~QGeoMappingManagerEngineMapboxGL();
 
     QGeoMap *createMap() override;
+    QMapboxGLOfflineDownloader *createOfflineDownloader(QObject *parent = nullptr) const;
+
+    QVariantMap resourceStatistics() const;
+    void trimMapPool();
+    bool writeTrace(const QString &fileName) const;
 
 private:
+    QVariantMap cacheStatistics() const;
+    void startOfflineDownload(const QVariantMap &parameters);
+
     QMapboxGLSettings m_settings;
+    QMapboxGLSharedResources m_sharedResources;
+    QMapboxGLTileServer m_tileServer;
+    QScopedPointer<QMapboxGLCacheMaintainer> m_cacheMaintainer;
+    QScopedPointer<QMapboxGLCacheWarmer> m_cacheWarmer;
+    QScopedPointer<QMapboxGLOfflineDownloader> m_offlineDownloader;
+    QMapboxGLMapPool m_mapPool;
+    bool m_useMapPool = true;
+    bool m_frameTiming = false;
+    bool m_gpuTiming = false;
+    int m_frameTimingInterval = 10000;
+    QString m_recordFile;
+    int m_recordedMaps = 0;
     bool m_useFBO = true;
     bool m_useChinaEndpoint = false;
     QString m_mapItemsBefore;
+    bool m_quickItemsAsSymbols = false;
+    bool m_markerAllowOverlap = false;
+    bool m_markerClustering = false;
+    int m_markerClusterRadius = 50;
+    int m_markerClusterMaxZoom = 14;
+    QStringList m_markerClusterFont;
+    int m_maximumFrameRate = 0;
+    int m_idleTimeout = 0;
+    int m_idleFrameRate = 0;
+    bool m_adaptiveResolution = false;
+    qreal m_minimumRenderScale = 0.5;
+    int m_targetFrameTime = 16;
+    QMapboxGLPrefetchers m_prefetchers;
+    bool m_prefetch = false;
+    int m_prefetchLookahead = 500;
+    int m_prefetchBudget = 4;
+    QStringList m_preloadedStyles;
+    qint64 m_memoryLimit = 0;
+    QMapboxGLCacheDatabase::Tuning m_cacheTuning;
+    int m_offlineCompressionLevel = 0;
 };
 
 QT_END_NAMESPACE
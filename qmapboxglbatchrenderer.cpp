@@ -0,0 +1,201 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Copyright (C) 2017 Mapbox, Inc.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the QtLocation module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL3$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or later as published by the Free
+** Software Foundation and appearing in the file LICENSE.GPL included in
+** the packaging of this file. Please review the following information to
+** ensure the GNU General Public License version 2.0 requirements will be
+** met: http://www.gnu.org/licenses/gpl-2.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qmapboxglbatchrenderer.h"
+
+#include <QtCore/QTimer>
+#include <QtGui/QOpenGLContext>
+#include <QtGui/QOpenGLFramebufferObject>
+#include <QtGui/QOpenGLFunctions>
+
+QMapboxGLBatchRenderer::QMapboxGLBatchRenderer(const QMapboxGLSettings &settings, QObject *parent)
+    : QObject(parent)
+    , m_settings(settings)
+{
+    m_settings.setMapMode(QMapboxGLSettings::Static);
+}
+
+QMapboxGLBatchRenderer::~QMapboxGLBatchRenderer()
+{
+    // The map and the framebuffer own GL resources.
+    if (m_context.context() && m_context.makeCurrent()) {
+        m_map.reset();
+        m_fbo.reset();
+        m_context.doneCurrent();
+    }
+}
+
+int QMapboxGLBatchRenderer::enqueue(const Job &job)
+{
+    const int id = m_nextId++;
+    m_jobs.enqueue(qMakePair(id, job));
+
+    if (!m_running) {
+        m_running = true;
+        m_busy.start();
+        QTimer::singleShot(0, this, &QMapboxGLBatchRenderer::startNextJob);
+    }
+
+    return id;
+}
+
+void QMapboxGLBatchRenderer::clear()
+{
+    m_jobs.clear();
+}
+
+int QMapboxGLBatchRenderer::pendingJobs() const
+{
+    return m_jobs.size();
+}
+
+bool QMapboxGLBatchRenderer::isRunning() const
+{
+    return m_running;
+}
+
+QVariantMap QMapboxGLBatchRenderer::statistics() const
+{
+    const qint64 busyTime = m_busyTime + (m_running ? m_busy.elapsed() : 0);
+
+    QVariantMap statistics;
+    statistics[QStringLiteral("imagesRendered")] = m_rendered;
+    statistics[QStringLiteral("imagesFailed")] = m_failed;
+    statistics[QStringLiteral("busyTime")] = busyTime;
+    statistics[QStringLiteral("averageRenderTime")] = m_rendered ? double(m_renderTime) / m_rendered : 0.0;
+    statistics[QStringLiteral("imagesPerSecond")] = busyTime ? m_rendered * 1000.0 / busyTime : 0.0;
+
+    return statistics;
+}
+
+void QMapboxGLBatchRenderer::prepareMap(const Job &job)
+{
+    if (!m_map || !qFuzzyCompare(m_mapPixelRatio, job.pixelRatio)) {
+        m_map.reset(new QMapboxGL(nullptr, m_settings, job.size, job.pixelRatio));
+        m_mapPixelRatio = job.pixelRatio;
+        m_styleUrl.clear();
+        m_fbo.reset();
+
+        connect(m_map.data(), &QMapboxGL::needsRendering, this, &QMapboxGLBatchRenderer::onNeedsRendering);
+        connect(m_map.data(), &QMapboxGL::staticRenderFinished, this, &QMapboxGLBatchRenderer::onStaticRenderFinished);
+    }
+
+    const QSize fbSize = job.size * job.pixelRatio;
+    if (!m_fbo || m_fbo->size() != fbSize) {
+        m_map->resize(job.size);
+        m_fbo.reset(new QOpenGLFramebufferObject(fbSize, QOpenGLFramebufferObject::CombinedDepthStencil));
+        m_map->setFramebufferObject(m_fbo->handle(), fbSize);
+    }
+
+    // Keep the loaded style, and with it the sources and tiles, for as
+    // long as consecutive jobs ask for the same one.
+    if (m_styleUrl != job.styleUrl) {
+        m_styleUrl = job.styleUrl;
+        m_map->setStyleUrl(m_styleUrl);
+    }
+
+    m_map->jumpTo(job.camera);
+}
+
+void QMapboxGLBatchRenderer::startNextJob()
+{
+    if (m_jobs.isEmpty()) {
+        m_running = false;
+        m_busyTime += m_busy.elapsed();
+        emit finished();
+        return;
+    }
+
+    m_current = m_jobs.dequeue();
+
+    if (m_current.second.size.isEmpty() || !m_context.makeCurrent()) {
+        ++m_failed;
+        emit jobFailed(m_current.first, QStringLiteral("Unable to prepare offscreen rendering."));
+        QTimer::singleShot(0, this, &QMapboxGLBatchRenderer::startNextJob);
+        return;
+    }
+
+    prepareMap(m_current.second);
+
+    m_jobTimer.start();
+    m_map->startStaticRender();
+}
+
+void QMapboxGLBatchRenderer::onNeedsRendering()
+{
+    if (!m_fbo || !m_context.makeCurrent())
+        return;
+
+    QOpenGLFunctions *f = m_context.context()->functions();
+    f->glViewport(0, 0, m_fbo->width(), m_fbo->height());
+
+    m_fbo->bind();
+
+    f->glClearColor(0.f, 0.f, 0.f, 0.f);
+    f->glClear(GL_COLOR_BUFFER_BIT);
+
+    m_map->render();
+    m_fbo->release();
+}
+
+void QMapboxGLBatchRenderer::onStaticRenderFinished(const QString &error)
+{
+    const int id = m_current.first;
+
+    if (!error.isEmpty()) {
+        ++m_failed;
+        emit jobFailed(id, error);
+    } else if (!m_context.makeCurrent()) {
+        ++m_failed;
+        emit jobFailed(id, QStringLiteral("Unable to read back the rendered image."));
+    } else {
+        const QImage image = m_fbo->toImage();
+        const QString &fileName = m_current.second.fileName;
+
+        if (!fileName.isEmpty() && !image.save(fileName)) {
+            ++m_failed;
+            emit jobFailed(id, QStringLiteral("Unable to write %1.").arg(fileName));
+        } else {
+            m_renderTime += m_jobTimer.elapsed();
+            ++m_rendered;
+            emit imageRendered(id, image);
+        }
+    }
+
+    // Not from within the Mapbox GL callback.
+    QTimer::singleShot(0, this, &QMapboxGLBatchRenderer::startNextJob);
+}
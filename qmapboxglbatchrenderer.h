@@ -0,0 +1,116 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Copyright (C) 2017 Mapbox, Inc.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the QtLocation module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL3$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or later as published by the Free
+** Software Foundation and appearing in the file LICENSE.GPL included in
+** the packaging of this file. Please review the following information to
+** ensure the GNU General Public License version 2.0 requirements will be
+** met: http://www.gnu.org/licenses/gpl-2.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QMAPBOXGLBATCHRENDERER_H
+#define QMAPBOXGLBATCHRENDERER_H
+
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QObject>
+#include <QtCore/QQueue>
+#include <QtCore/QScopedPointer>
+#include <QtCore/QSize>
+#include <QtCore/QVariantMap>
+#include <QtGui/QImage>
+
+#include <QMapboxGL>
+
+#include "qmapboxgloffscreencontext_p.h"
+
+class QOpenGLFramebufferObject;
+
+// Renders still map images without a window. Jobs are rendered one after
+// the other on a single offscreen context and a single static mode map, so
+// the style and the tiles loaded for one job are reused by the next one.
+// Needs a running event loop on the thread the renderer lives in.
+class QMapboxGLBatchRenderer : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Job {
+        QString styleUrl;
+        QMapboxGLCameraOptions camera;
+        QSize size = QSize(512, 512);
+        qreal pixelRatio = 1.0;
+        QString fileName;
+    };
+
+    explicit QMapboxGLBatchRenderer(const QMapboxGLSettings &, QObject *parent = nullptr);
+    ~QMapboxGLBatchRenderer();
+
+    int enqueue(const Job &job);
+    void clear();
+
+    int pendingJobs() const;
+    bool isRunning() const;
+
+    QVariantMap statistics() const;
+
+Q_SIGNALS:
+    void imageRendered(int id, const QImage &image);
+    void jobFailed(int id, const QString &error);
+    void finished();
+
+private Q_SLOTS:
+    void startNextJob();
+    void onNeedsRendering();
+    void onStaticRenderFinished(const QString &error);
+
+private:
+    void prepareMap(const Job &job);
+
+    QMapboxGLSettings m_settings;
+    QMapboxGLOffscreenContext m_context;
+    QScopedPointer<QOpenGLFramebufferObject> m_fbo;
+    QScopedPointer<QMapboxGL> m_map;
+    qreal m_mapPixelRatio = 0.0;
+    QString m_styleUrl;
+
+    QQueue<QPair<int, Job>> m_jobs;
+    QPair<int, Job> m_current;
+    bool m_running = false;
+    int m_nextId = 0;
+
+    QElapsedTimer m_busy;
+    QElapsedTimer m_jobTimer;
+    qint64 m_busyTime = 0;
+    qint64 m_renderTime = 0;
+    quint64 m_rendered = 0;
+    quint64 m_failed = 0;
+};
+
+#endif // QMAPBOXGLBATCHRENDERER_H
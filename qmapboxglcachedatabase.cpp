@@ -0,0 +1,503 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Copyright (C) 2017 Mapbox, Inc.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the QtLocation module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL3$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or later as published by the Free
+** Software Foundation and appearing in the file LICENSE.GPL included in
+** the packaging of this file. Please review the following information to
+** ensure the GNU General Public License version 2.0 requirements will be
+** met: http://www.gnu.org/licenses/gpl-2.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qmapboxglcachedatabase_p.h"
+
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QFileInfo>
+#include <QtCore/QSet>
+#include <QtCore/QStringList>
+#include <QtSql/QSqlError>
+#include <QtSql/QSqlQuery>
+
+#include <QDebug>
+
+#include <zlib.h>
+
+bool QMapboxGLCacheDatabase::Tuning::isNull() const
+{
+    return journalMode.isEmpty() && !pageSize && !cacheSize && mmapSize < 0 && synchronous.isEmpty();
+}
+
+bool QMapboxGLCacheDatabase::EvictionPolicy::isNull() const
+{
+    return !maximumSize && sourceQuotas.isEmpty();
+}
+
+QMapboxGLCacheDatabase::QMapboxGLCacheDatabase(const QString &path)
+    : m_path(path)
+    , m_connectionName(QStringLiteral("qmapboxgl-cache-%1").arg(quintptr(this), 0, 16))
+{
+}
+
+QMapboxGLCacheDatabase::~QMapboxGLCacheDatabase()
+{
+    close();
+}
+
+bool QMapboxGLCacheDatabase::isValid(const Tuning &tuning)
+{
+    static const QStringList journalModes = QStringList()
+        << QStringLiteral("delete") << QStringLiteral("truncate") << QStringLiteral("persist")
+        << QStringLiteral("memory") << QStringLiteral("wal") << QStringLiteral("off");
+    static const QStringList synchronousLevels = QStringList()
+        << QStringLiteral("off") << QStringLiteral("normal") << QStringLiteral("full") << QStringLiteral("extra");
+
+    if (!tuning.journalMode.isEmpty() && !journalModes.contains(tuning.journalMode.toLower()))
+        return false;
+
+    if (!tuning.synchronous.isEmpty() && !synchronousLevels.contains(tuning.synchronous.toLower()))
+        return false;
+
+    // Powers of two between 512 and 65536.
+    if (tuning.pageSize && (tuning.pageSize < 512 || tuning.pageSize > 65536 || (tuning.pageSize & (tuning.pageSize - 1))))
+        return false;
+
+    return true;
+}
+
+bool QMapboxGLCacheDatabase::open(const Tuning &tuning)
+{
+    if (isOpen())
+        return true;
+
+    if (m_path.isEmpty() || m_path == QStringLiteral(":memory:"))
+        return false;
+
+    QSqlDatabase db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), m_connectionName);
+    db.setDatabaseName(m_path);
+
+    if (!db.open()) {
+        qWarning() << "Failed to open the cache database" << m_path << ":" << db.lastError().text();
+        db = QSqlDatabase();
+        QSqlDatabase::removeDatabase(m_connectionName);
+        return false;
+    }
+
+    // Mapbox GL waits forever on a busy database, be a bit more patient
+    // than the SQLite default of failing right away.
+    exec(QStringLiteral("PRAGMA busy_timeout = 5000"));
+
+    if (tuning.cacheSize)
+        exec(QStringLiteral("PRAGMA cache_size = %1").arg(tuning.cacheSize));
+
+    if (tuning.mmapSize >= 0)
+        exec(QStringLiteral("PRAGMA mmap_size = %1").arg(tuning.mmapSize));
+
+    if (!tuning.synchronous.isEmpty())
+        exec(QStringLiteral("PRAGMA synchronous = %1").arg(tuning.synchronous));
+
+    return true;
+}
+
+void QMapboxGLCacheDatabase::close()
+{
+    if (!QSqlDatabase::contains(m_connectionName))
+        return;
+
+    QSqlDatabase::database(m_connectionName, false).close();
+    QSqlDatabase::removeDatabase(m_connectionName);
+}
+
+bool QMapboxGLCacheDatabase::isOpen() const
+{
+    return QSqlDatabase::contains(m_connectionName) && database().isOpen();
+}
+
+QString QMapboxGLCacheDatabase::path() const
+{
+    return m_path;
+}
+
+QSqlDatabase QMapboxGLCacheDatabase::database() const
+{
+    return QSqlDatabase::database(m_connectionName, false);
+}
+
+bool QMapboxGLCacheDatabase::applyPersistentTuning(const Tuning &tuning)
+{
+    if (!isOpen())
+        return false;
+
+    bool ok = true;
+    const QString journalMode = pragma(QStringLiteral("journal_mode")).toString().toLower();
+
+    if (tuning.pageSize && pragma(QStringLiteral("page_size")).toInt() != tuning.pageSize) {
+        // The page size cannot change in WAL mode, and an existing file
+        // only picks up the new size when it is rebuilt.
+        if (journalMode == QStringLiteral("wal"))
+            ok &= exec(QStringLiteral("PRAGMA journal_mode = DELETE"));
+
+        ok &= exec(QStringLiteral("PRAGMA page_size = %1").arg(tuning.pageSize));
+        ok &= exec(QStringLiteral("VACUUM"));
+
+        if (journalMode == QStringLiteral("wal") && tuning.journalMode.isEmpty())
+            ok &= exec(QStringLiteral("PRAGMA journal_mode = WAL"));
+    }
+
+    if (!tuning.journalMode.isEmpty()) {
+        const QString mode = tuning.journalMode.toLower();
+        QSqlQuery query(database());
+        if (!query.exec(QStringLiteral("PRAGMA journal_mode = %1").arg(mode)) || !query.next()
+                || query.value(0).toString().toLower() != mode) {
+            qWarning() << "Cache database journal mode could not be set to" << mode;
+            ok = false;
+        }
+    }
+
+    return ok;
+}
+
+bool QMapboxGLCacheDatabase::ensureSchema()
+{
+    if (!isOpen())
+        return false;
+
+    // Version 6 of the Mapbox GL offline database, which refuses to open a
+    // file with tables but no version.
+    const int version = pragma(QStringLiteral("user_version")).toInt();
+    if (version == 6)
+        return true;
+
+    if (version != 0) {
+        qWarning() << "Unsupported cache database version" << version << "in" << m_path;
+        return false;
+    }
+
+    static const char *const schema[] = {
+        "CREATE TABLE resources ("
+        " id INTEGER NOT NULL PRIMARY KEY AUTOINCREMENT, url TEXT NOT NULL UNIQUE, kind INTEGER NOT NULL,"
+        " expires INTEGER, modified INTEGER, etag TEXT, data BLOB, compressed INTEGER NOT NULL DEFAULT 0,"
+        " accessed INTEGER NOT NULL, must_revalidate INTEGER NOT NULL DEFAULT 0)",
+        "CREATE TABLE tiles ("
+        " id INTEGER NOT NULL PRIMARY KEY AUTOINCREMENT, url_template TEXT NOT NULL, pixel_ratio INTEGER NOT NULL,"
+        " z INTEGER NOT NULL, x INTEGER NOT NULL, y INTEGER NOT NULL, expires INTEGER, modified INTEGER, etag TEXT,"
+        " data BLOB, compressed INTEGER NOT NULL DEFAULT 0, accessed INTEGER NOT NULL,"
+        " must_revalidate INTEGER NOT NULL DEFAULT 0, UNIQUE (url_template, pixel_ratio, z, x, y))",
+        "CREATE TABLE regions ("
+        " id INTEGER NOT NULL PRIMARY KEY AUTOINCREMENT, definition TEXT NOT NULL, description BLOB)",
+        "CREATE TABLE region_resources ("
+        " region_id INTEGER NOT NULL REFERENCES regions(id) ON DELETE CASCADE,"
+        " resource_id INTEGER NOT NULL REFERENCES resources(id), UNIQUE (region_id, resource_id))",
+        "CREATE TABLE region_tiles ("
+        " region_id INTEGER NOT NULL REFERENCES regions(id) ON DELETE CASCADE,"
+        " tile_id INTEGER NOT NULL REFERENCES tiles(id), UNIQUE (region_id, tile_id))",
+        "CREATE INDEX resources_accessed ON resources (accessed)",
+        "CREATE INDEX tiles_accessed ON tiles (accessed)",
+        "CREATE INDEX region_resources_resource_id ON region_resources (resource_id)",
+        "CREATE INDEX region_tiles_tile_id ON region_tiles (tile_id)",
+        "PRAGMA user_version = 6"
+    };
+
+    QSqlDatabase db = database();
+    db.transaction();
+
+    for (const char *statement : schema) {
+        if (!exec(QLatin1String(statement))) {
+            db.rollback();
+            return false;
+        }
+    }
+
+    return db.commit();
+}
+
+bool QMapboxGLCacheDatabase::readResource(const QString &url, QByteArray *data)
+{
+    QSqlQuery query(database());
+    query.setForwardOnly(true);
+    query.prepare(QStringLiteral("SELECT data, compressed FROM resources WHERE url = ?"));
+    query.addBindValue(url);
+
+    if (!query.exec() || !query.next())
+        return false;
+
+    *data = query.value(0).toByteArray();
+    if (query.value(1).toBool())
+        *data = inflate(*data);
+
+    return true;
+}
+
+QByteArray QMapboxGLCacheDatabase::inflate(const QByteArray &data)
+{
+    // Mapbox GL compresses with plain zlib, qUncompress() would want the
+    // size in front.
+    z_stream stream = {};
+    if (inflateInit(&stream) != Z_OK)
+        return QByteArray();
+
+    QByteArray result;
+    char buffer[16384];
+
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.constData()));
+    stream.avail_in = uInt(data.size());
+
+    int status = Z_OK;
+    while (status == Z_OK) {
+        stream.next_out = reinterpret_cast<Bytef *>(buffer);
+        stream.avail_out = sizeof(buffer);
+        status = ::inflate(&stream, Z_NO_FLUSH);
+        result.append(buffer, int(sizeof(buffer) - stream.avail_out));
+    }
+
+    inflateEnd(&stream);
+
+    return status == Z_STREAM_END ? result : QByteArray();
+}
+
+qint64 QMapboxGLCacheDatabase::region(const QString &definition, const QString &description)
+{
+    QSqlQuery query(database());
+    query.prepare(QStringLiteral("SELECT id FROM regions WHERE definition = ?"));
+    query.addBindValue(definition);
+    if (query.exec() && query.next())
+        return query.value(0).toLongLong();
+
+    query.prepare(QStringLiteral("INSERT INTO regions (definition, description) VALUES (?, ?)"));
+    query.addBindValue(definition);
+    query.addBindValue(description.toUtf8());
+    if (!query.exec())
+        return -1;
+
+    return query.lastInsertId().toLongLong();
+}
+
+int QMapboxGLCacheDatabase::pinTiles(qint64 regionId, int z, const QRect &range)
+{
+    QSqlQuery query(database());
+    query.prepare(QStringLiteral("INSERT OR IGNORE INTO region_tiles (region_id, tile_id) "
+                                 "SELECT ?, id FROM tiles WHERE z = ? AND x BETWEEN ? AND ? AND y BETWEEN ? AND ?"));
+    query.addBindValue(regionId);
+    query.addBindValue(z);
+    query.addBindValue(range.left());
+    query.addBindValue(range.right());
+    query.addBindValue(range.top());
+    query.addBindValue(range.bottom());
+
+    if (!query.exec()) {
+        qWarning() << "Failed to pin cached tiles:" << query.lastError().text();
+        return 0;
+    }
+
+    return query.numRowsAffected();
+}
+
+QVariantMap QMapboxGLCacheDatabase::evict(const EvictionPolicy &policy)
+{
+    QVariantMap result;
+    if (!isOpen() || policy.isNull())
+        return result;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    const QString order = policy.order == EvictionPolicy::ExpiringFirst
+            ? QStringLiteral("expiry DESC, accessed DESC") : QStringLiteral("accessed DESC");
+
+    // Newest first, everything past the budget goes.
+    QSet<qint64> tiles;
+    QSet<qint64> resources;
+    qint64 evictedBytes = 0;
+
+    const auto collect = [&](const QString &statement, const QVariant &bind, qint64 budget) {
+        QSqlQuery query(database());
+        query.setForwardOnly(true);
+        query.prepare(statement);
+        if (bind.isValid())
+            query.addBindValue(bind);
+
+        if (!query.exec()) {
+            qWarning() << "Cache eviction query failed:" << query.lastError().text();
+            return;
+        }
+
+        qint64 kept = 0;
+        while (query.next()) {
+            QSet<qint64> &evicted = query.value(0).toInt() ? tiles : resources;
+            const qint64 id = query.value(1).toLongLong();
+            const qint64 size = query.value(2).toLongLong();
+
+            // Already over a source quota, does not count towards the total.
+            if (evicted.contains(id))
+                continue;
+
+            if (kept + size <= budget) {
+                kept += size;
+                continue;
+            }
+
+            evicted.insert(id);
+            evictedBytes += size;
+        }
+    };
+
+    for (auto it = policy.sourceQuotas.cbegin(); it != policy.sourceQuotas.cend(); ++it) {
+        collect(QStringLiteral("SELECT 1, id, IFNULL(LENGTH(data), 0), accessed, IFNULL(expires, 0) AS expiry FROM tiles "
+                               "WHERE instr(url_template, ?) > 0 AND id NOT IN (SELECT tile_id FROM region_tiles) "
+                               "ORDER BY %1").arg(order), it.key(), it.value());
+    }
+
+    if (policy.maximumSize > 0) {
+        collect(QStringLiteral("SELECT 1, id, IFNULL(LENGTH(data), 0), accessed, IFNULL(expires, 0) AS expiry FROM tiles "
+                               "WHERE id NOT IN (SELECT tile_id FROM region_tiles) "
+                               "UNION ALL "
+                               "SELECT 0, id, IFNULL(LENGTH(data), 0), accessed, IFNULL(expires, 0) AS expiry FROM resources "
+                               "WHERE id NOT IN (SELECT resource_id FROM region_resources) "
+                               "ORDER BY %1").arg(order), QVariant(), policy.maximumSize);
+    }
+
+    QSqlDatabase db = database();
+    db.transaction();
+
+    const auto remove = [&](const QString &table, const QSet<qint64> &ids) {
+        QSqlQuery query(database());
+        query.prepare(QStringLiteral("DELETE FROM %1 WHERE id = ?").arg(table));
+        for (qint64 id : ids) {
+            query.bindValue(0, id);
+            query.exec();
+        }
+    };
+
+    remove(QStringLiteral("tiles"), tiles);
+    remove(QStringLiteral("resources"), resources);
+
+    if (!db.commit()) {
+        db.rollback();
+        return result;
+    }
+
+    // Mapbox GL creates the file with incremental auto vacuum, hand the
+    // freed pages back to the file system.
+    exec(QStringLiteral("PRAGMA incremental_vacuum"));
+
+    result[QStringLiteral("evictedTiles")] = tiles.size();
+    result[QStringLiteral("evictedResources")] = resources.size();
+    result[QStringLiteral("evictedBytes")] = evictedBytes;
+    result[QStringLiteral("evictionTime")] = timer.elapsed();
+
+    return result;
+}
+
+bool QMapboxGLCacheDatabase::lastIds(qint64 *tileId, qint64 *resourceId)
+{
+    QSqlQuery query(database());
+    if (!query.exec(QStringLiteral("SELECT (SELECT IFNULL(MAX(id), 0) FROM tiles), (SELECT IFNULL(MAX(id), 0) FROM resources)"))
+            || !query.next()) {
+        return false;
+    }
+
+    *tileId = query.value(0).toLongLong();
+    *resourceId = query.value(1).toLongLong();
+    return true;
+}
+
+QVariantMap QMapboxGLCacheDatabase::usage(const QDateTime &since, qint64 lastTileId, qint64 lastResourceId)
+{
+    QVariantMap result;
+    if (!isOpen())
+        return result;
+
+    // Statistics are not worth waiting for a lock.
+    QSqlQuery query(database());
+    query.exec(QStringLiteral("PRAGMA busy_timeout = 0"));
+
+    const auto measure = [&](const QString &table, const QString &regionTable, const QString &regionColumn, const QString &prefix, qint64 lastId) {
+        query.prepare(QStringLiteral("SELECT COUNT(*), IFNULL(SUM(LENGTH(data)), 0), "
+                                     "IFNULL(SUM(accessed >= ?), 0), IFNULL(SUM(CASE WHEN accessed >= ? THEN LENGTH(data) ELSE 0 END), 0), "
+                                     "(SELECT COUNT(DISTINCT %3) FROM %2), "
+                                     "IFNULL(SUM(id > ?), 0), IFNULL(SUM(CASE WHEN id > ? THEN LENGTH(data) ELSE 0 END), 0) "
+                                     "FROM %1").arg(table, regionTable, regionColumn));
+        query.addBindValue(since.toSecsSinceEpoch());
+        query.addBindValue(since.toSecsSinceEpoch());
+        query.addBindValue(lastId);
+        query.addBindValue(lastId);
+
+        if (!query.exec() || !query.next())
+            return false;
+
+        result[prefix] = query.value(0);
+        result[prefix + QStringLiteral("Bytes")] = query.value(1);
+        result[prefix + QStringLiteral("Used")] = query.value(2);
+        result[prefix + QStringLiteral("UsedBytes")] = query.value(3);
+        result[prefix + QStringLiteral("InRegions")] = query.value(4);
+        result[prefix + QStringLiteral("Added")] = query.value(5);
+        result[prefix + QStringLiteral("AddedBytes")] = query.value(6);
+        return true;
+    };
+
+    if (!measure(QStringLiteral("tiles"), QStringLiteral("region_tiles"), QStringLiteral("tile_id"), QStringLiteral("tiles"), lastTileId)
+            || !measure(QStringLiteral("resources"), QStringLiteral("region_resources"), QStringLiteral("resource_id"), QStringLiteral("resources"), lastResourceId)) {
+        return QVariantMap();
+    }
+
+    return result;
+}
+
+QByteArray QMapboxGLCacheDatabase::deflate(const QByteArray &data, int level)
+{
+    // Plain zlib, what Mapbox GL inflates entries marked as compressed with.
+    uLongf size = compressBound(uLong(data.size()));
+    QByteArray result(int(size), Qt::Uninitialized);
+
+    if (compress2(reinterpret_cast<Bytef *>(result.data()), &size,
+                  reinterpret_cast<const Bytef *>(data.constData()), uLong(data.size()), level) != Z_OK) {
+        return QByteArray();
+    }
+
+    result.resize(int(size));
+    return result;
+}
+
+bool QMapboxGLCacheDatabase::exec(const QString &statement)
+{
+    QSqlQuery query(database());
+    if (query.exec(statement))
+        return true;
+
+    qWarning() << "Cache database statement failed:" << statement << query.lastError().text();
+    return false;
+}
+
+QVariant QMapboxGLCacheDatabase::pragma(const QString &name)
+{
+    QSqlQuery query(database());
+    if (!query.exec(QStringLiteral("PRAGMA %1").arg(name)) || !query.next())
+        return QVariant();
+
+    return query.value(0);
+}
@@ -0,0 +1,141 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Copyright (C) 2017 Mapbox, Inc.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the QtLocation module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL3$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or later as published by the Free
+** Software Foundation and appearing in the file LICENSE.GPL included in
+** the packaging of this file. Please review the following information to
+** ensure the GNU General Public License version 2.0 requirements will be
+** met: http://www.gnu.org/licenses/gpl-2.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QMAPBOXGLCACHEDATABASE_P_H
+#define QMAPBOXGLCACHEDATABASE_P_H
+
+#include <QtCore/QDateTime>
+#include <QtCore/QHash>
+#include <QtCore/QRect>
+#include <QtCore/QString>
+#include <QtCore/QVariantMap>
+#include <QtSql/QSqlDatabase>
+
+// Direct access to the ambient cache database written by Mapbox GL.
+//
+// Mapbox GL opens the database through its own SQLite connection, so
+// nothing done here reaches that connection: only the settings stored in
+// the file itself (journal mode and page size) change how Mapbox GL reads
+// it. The per connection settings apply to the connections opened here.
+//
+// Once a map is open Mapbox GL may hold a lock on the database, which the
+// connections opened here wait up to five seconds for. Best used off the
+// GUI thread, see QMapboxGLCacheMaintainer.
+class QMapboxGLCacheDatabase
+{
+public:
+    // Journal mode and page size are stored in the file and reach Mapbox
+    // GL. The others are per connection: they only change the connections
+    // the plugin opens for downloading, warming, eviction and statistics,
+    // never the one Mapbox GL looks tiles up through.
+    struct Tuning {
+        QString journalMode;    // Empty keeps the mode stored in the file
+        int pageSize = 0;       // 0 keeps the page size stored in the file
+        int cacheSize = 0;      // SQLite semantics, negative values are KiB
+        qint64 mmapSize = -1;   // -1 keeps the SQLite default
+        QString synchronous;    // Empty keeps the SQLite default
+
+        bool isNull() const;
+    };
+
+    struct EvictionPolicy {
+        enum Order {
+            LeastRecentlyUsed,  // By the time Mapbox GL last read an entry
+            ExpiringFirst       // By the expiry time the server gave
+        };
+
+        Order order = LeastRecentlyUsed;
+        qint64 maximumSize = 0;                 // Ambient tiles and resources, 0 for no limit
+        QHash<QString, qint64> sourceQuotas;    // Tile URL template fragment to bytes
+
+        bool isNull() const;
+    };
+
+    explicit QMapboxGLCacheDatabase(const QString &path);
+    ~QMapboxGLCacheDatabase();
+
+    bool open(const Tuning &tuning = Tuning());
+    void close();
+    bool isOpen() const;
+
+    QString path() const;
+    QSqlDatabase database() const;
+
+    // Rewrites the file when the page size changes.
+    bool applyPersistentTuning(const Tuning &tuning);
+
+    // Creates the tables Mapbox GL expects in a database it never opened,
+    // so that it can be written to before the first map starts.
+    bool ensureSchema();
+
+    // Contents of a style, source, sprite or glyph resource, inflated when
+    // Mapbox GL stored it compressed.
+    bool readResource(const QString &url, QByteArray *data);
+
+    // Finds or adds the region with the given definition.
+    qint64 region(const QString &definition, const QString &description);
+
+    // Makes the cached tiles of one zoom level part of a region, which keeps
+    // them out of both evict() and the eviction done by Mapbox GL.
+    int pinTiles(qint64 regionId, int z, const QRect &range);
+
+    // Removes ambient tiles and resources until the policy holds, in the
+    // order it asks for. Anything belonging to a region stays.
+    QVariantMap evict(const EvictionPolicy &policy);
+
+    // Highest tile and resource ids, everything stored later gets a higher
+    // one.
+    bool lastIds(qint64 *tileId, qint64 *resourceId);
+
+    // Cache contents, the part of it Mapbox GL read or wrote since the
+    // given time, and the part of that it added after the given ids. Fails
+    // right away when Mapbox GL holds the database.
+    QVariantMap usage(const QDateTime &since, qint64 lastTileId, qint64 lastResourceId);
+
+    static bool isValid(const Tuning &tuning);
+    static QByteArray inflate(const QByteArray &data);
+    static QByteArray deflate(const QByteArray &data, int level);
+
+private:
+    bool exec(const QString &statement);
+    QVariant pragma(const QString &name);
+
+    QString m_path;
+    QString m_connectionName;
+};
+
+#endif // QMAPBOXGLCACHEDATABASE_P_H
@@ -0,0 +1,185 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Copyright (C) 2017 Mapbox, Inc.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the QtLocation module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL3$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or later as published by the Free
+** Software Foundation and appearing in the file LICENSE.GPL included in
+** the packaging of this file. Please review the following information to
+** ensure the GNU General Public License version 2.0 requirements will be
+** met: http://www.gnu.org/licenses/gpl-2.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qmapboxglcachemaintainer_p.h"
+
+#include <QtCore/QFileInfo>
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QJsonObject>
+#include <QtCore/QTimer>
+
+namespace {
+
+// Eviction and pinning run again after this many milliseconds.
+const int maintenanceInterval = 5 * 60 * 1000;
+
+// Mapbox GL only looks at the tiles linked to a region when evicting, the
+// definition is never read back. It is not one Mapbox GL could download
+// either: pinned tiles belong to every style using them.
+QString pinnedRegionDefinition(const QMapboxGLOfflineDownloader::Region &region)
+{
+    const QJsonObject definition {
+        { QStringLiteral("pinned"), true },
+        { QStringLiteral("bounds"), QJsonArray {
+            region.bounds.bottomRight().latitude(), region.bounds.topLeft().longitude(),
+            region.bounds.topLeft().latitude(), region.bounds.bottomRight().longitude() } },
+        { QStringLiteral("min_zoom"), region.minZoom },
+        { QStringLiteral("max_zoom"), region.maxZoom }
+    };
+
+    return QString::fromUtf8(QJsonDocument(definition).toJson(QJsonDocument::Compact));
+}
+
+} // namespace
+
+QMapboxGLCacheMaintainer::QMapboxGLCacheMaintainer(const QString &databasePath, const QMapboxGLCacheDatabase::Tuning &tuning)
+    : m_databasePath(databasePath)
+    , m_tuning(tuning)
+    , m_since(QDateTime::currentDateTimeUtc())
+{
+    m_context.moveToThread(&m_thread);
+    m_thread.setObjectName(QStringLiteral("QMapboxGLCacheMaintainer"));
+    m_thread.start(QThread::LowPriority);
+
+    // What is there now came from earlier runs, anything added later came
+    // from the network.
+    QMetaObject::invokeMethod(&m_context, [this] {
+        if (!QFileInfo::exists(m_databasePath))
+            return;
+
+        QMapboxGLCacheDatabase database(m_databasePath);
+        if (database.open())
+            database.lastIds(&m_lastTileId, &m_lastResourceId);
+    });
+}
+
+QMapboxGLCacheMaintainer::~QMapboxGLCacheMaintainer()
+{
+    m_thread.quit();
+    m_thread.wait();
+}
+
+void QMapboxGLCacheMaintainer::tune()
+{
+    QMetaObject::invokeMethod(&m_context, [this] {
+        QMapboxGLCacheDatabase database(m_databasePath);
+        if (database.open(m_tuning))
+            database.applyPersistentTuning(m_tuning);
+    });
+}
+
+void QMapboxGLCacheMaintainer::maintain(const QMapboxGLCacheDatabase::EvictionPolicy &policy,
+                                        const QList<QMapboxGLOfflineDownloader::Region> &pinnedRegions)
+{
+    QMetaObject::invokeMethod(&m_context, [this, policy, pinnedRegions] {
+        evict(policy, pinnedRegions);
+
+        QTimer *timer = new QTimer(&m_context);
+        QObject::connect(timer, &QTimer::timeout, &m_context, [this, policy, pinnedRegions] { evict(policy, pinnedRegions); });
+        timer->start(maintenanceInterval);
+    });
+}
+
+QVariantMap QMapboxGLCacheMaintainer::evictionStatistics() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_eviction;
+}
+
+QVariantMap QMapboxGLCacheMaintainer::usage(int maximumAge)
+{
+    QMutexLocker locker(&m_mutex);
+
+    if (!m_measuring && (!m_measured.isValid() || m_measured.elapsed() > maximumAge)) {
+        m_measuring = true;
+
+        QMetaObject::invokeMethod(&m_context, [this] {
+            QVariantMap usage;
+            if (QFileInfo::exists(m_databasePath)) {
+                QMapboxGLCacheDatabase database(m_databasePath);
+                if (database.open(m_tuning))
+                    usage = database.usage(m_since, m_lastTileId, m_lastResourceId);
+            }
+
+            QMutexLocker locker(&m_mutex);
+            m_usage = usage;
+            m_measured.start();
+            m_measuring = false;
+        });
+    }
+
+    return m_usage;
+}
+
+void QMapboxGLCacheMaintainer::evict(const QMapboxGLCacheDatabase::EvictionPolicy &policy,
+                                     const QList<QMapboxGLOfflineDownloader::Region> &pinnedRegions)
+{
+    // Nothing cached yet.
+    if (!QFileInfo::exists(m_databasePath))
+        return;
+
+    QMapboxGLCacheDatabase database(m_databasePath);
+    if (!database.open(m_tuning) || !database.ensureSchema())
+        return;
+
+    // Pinned areas become regions, which Mapbox GL does not evict either.
+    int pinnedTiles = 0;
+    for (const QMapboxGLOfflineDownloader::Region &region : pinnedRegions) {
+        const qint64 regionId = database.region(pinnedRegionDefinition(region), region.name);
+        if (regionId < 0)
+            continue;
+
+        for (int z = qMax(0, int(region.minZoom)); z <= int(region.maxZoom); ++z) {
+            const int n = 1 << z;
+            const QRect range = QMapboxGLOfflineDownloader::tileRange(region.bounds, z);
+
+            pinnedTiles += database.pinTiles(regionId, z, range.intersected(QRect(0, 0, n, n)));
+            if (range.right() >= n)
+                pinnedTiles += database.pinTiles(regionId, z, QRect(QPoint(0, range.top()), QPoint(range.right() - n, range.bottom())));
+        }
+    }
+
+    const QVariantMap eviction = database.evict(policy);
+
+    // Totals over all runs.
+    QMutexLocker locker(&m_mutex);
+    for (auto it = eviction.cbegin(); it != eviction.cend(); ++it)
+        m_eviction[it.key()] = m_eviction.value(it.key()).toLongLong() + it.value().toLongLong();
+    m_eviction[QStringLiteral("pinnedTiles")] = m_eviction.value(QStringLiteral("pinnedTiles")).toLongLong() + pinnedTiles;
+    m_eviction[QStringLiteral("evictionRuns")] = m_eviction.value(QStringLiteral("evictionRuns")).toLongLong() + 1;
+}
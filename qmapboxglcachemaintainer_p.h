@@ -0,0 +1,98 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Copyright (C) 2017 Mapbox, Inc.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the QtLocation module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL3$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or later as published by the Free
+** Software Foundation and appearing in the file LICENSE.GPL included in
+** the packaging of this file. Please review the following information to
+** ensure the GNU General Public License version 2.0 requirements will be
+** met: http://www.gnu.org/licenses/gpl-2.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QMAPBOXGLCACHEMAINTAINER_P_H
+#define QMAPBOXGLCACHEMAINTAINER_P_H
+
+#include <QtCore/QDateTime>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QObject>
+#include <QtCore/QString>
+#include <QtCore/QThread>
+#include <QtCore/QVariantMap>
+
+#include "qmapboxglcachedatabase_p.h"
+#include "qmapboxglofflinedownloader.h"
+
+// Runs the work the plugin does on the cache database itself on a thread
+// of its own, one job after the other in the order they were asked for.
+// Jobs still waiting when the maintainer goes are dropped.
+class QMapboxGLCacheMaintainer
+{
+public:
+    QMapboxGLCacheMaintainer(const QString &databasePath, const QMapboxGLCacheDatabase::Tuning &tuning);
+    ~QMapboxGLCacheMaintainer();
+
+    // Applies the persistent settings of the tuning, rewriting the file
+    // when the page size changes.
+    void tune();
+
+    // Applies the eviction policy and pins the cached tiles of the regions
+    // now and every few minutes after, which pins tiles cached since too.
+    void maintain(const QMapboxGLCacheDatabase::EvictionPolicy &policy,
+                  const QList<QMapboxGLOfflineDownloader::Region> &pinnedRegions);
+    QVariantMap evictionStatistics() const;
+
+    // Usage since the maintainer started, as last measured. A new
+    // measurement starts when that one is older than maximumAge.
+    QVariantMap usage(int maximumAge);
+
+private:
+    void evict(const QMapboxGLCacheDatabase::EvictionPolicy &policy,
+               const QList<QMapboxGLOfflineDownloader::Region> &pinnedRegions);
+
+    QString m_databasePath;
+    QMapboxGLCacheDatabase::Tuning m_tuning;
+    QDateTime m_since;
+
+    // Owned by the maintenance thread.
+    qint64 m_lastTileId = 0;
+    qint64 m_lastResourceId = 0;
+
+    mutable QMutex m_mutex;
+    QVariantMap m_eviction;
+    QVariantMap m_usage;
+    QElapsedTimer m_measured;
+    bool m_measuring = false;
+
+    QThread m_thread;
+    QObject m_context;
+};
+
+#endif // QMAPBOXGLCACHEMAINTAINER_P_H
@@ -0,0 +1,190 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Copyright (C) 2017 Mapbox, Inc.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the QtLocation module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL3$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or later as published by the Free
+** Software Foundation and appearing in the file LICENSE.GPL included in
+** the packaging of this file. Please review the following information to
+** ensure the GNU General Public License version 2.0 requirements will be
+** met: http://www.gnu.org/licenses/gpl-2.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qmapboxglcachewarmer_p.h"
+#include "qmapboxglcachedatabase_p.h"
+#include "qmapboxglstyleresources_p.h"
+
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QJsonObject>
+#include <QtCore/QThread>
+#include <QtGui/QGuiApplication>
+#include <QtSql/QSqlQuery>
+
+namespace {
+
+// Basic Latin and Latin-1, Latin Extended, General Punctuation.
+const int commonGlyphRanges[] = { 0, 256, 8192 };
+
+// Tiles up to this zoom level, at most 21 per source.
+const int maximumWarmZoom = 2;
+
+} // namespace
+
+QMapboxGLCacheWarmer::QMapboxGLCacheWarmer(const QString &databasePath, const QString &styleUrl, QObject *parent)
+    : QObject(parent)
+    , m_databasePath(databasePath)
+    , m_styleUrl(styleUrl)
+    , m_highDpi(qApp && qApp->devicePixelRatio() > 1.0)
+{
+}
+
+QMapboxGLCacheWarmer::~QMapboxGLCacheWarmer()
+{
+    if (m_thread) {
+        m_cancelled.storeRelease(1);
+        m_thread->wait();
+        delete m_thread;
+    }
+}
+
+void QMapboxGLCacheWarmer::start()
+{
+    if (m_thread)
+        return;
+
+    m_thread = QThread::create([this] { run(); });
+    m_thread->setObjectName(QStringLiteral("QMapboxGLCacheWarmer"));
+    connect(m_thread, &QThread::finished, this, &QMapboxGLCacheWarmer::finished);
+    m_thread->start(QThread::LowPriority);
+}
+
+QVariantMap QMapboxGLCacheWarmer::statistics() const
+{
+    QMutexLocker locker(&m_mutex);
+
+    QVariantMap statistics;
+    statistics[QStringLiteral("resources")] = m_resources;
+    statistics[QStringLiteral("tiles")] = m_tiles;
+    statistics[QStringLiteral("bytes")] = m_bytes;
+    statistics[QStringLiteral("elapsed")] = m_elapsed;
+
+    return statistics;
+}
+
+void QMapboxGLCacheWarmer::run()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    {
+        QMapboxGLCacheDatabase database(m_databasePath);
+        QByteArray style;
+        if (database.open() && warmResource(&database, m_styleUrl, &style))
+            warmStyle(&database, style);
+    }
+
+    QMutexLocker locker(&m_mutex);
+    m_elapsed = timer.elapsed();
+}
+
+void QMapboxGLCacheWarmer::warmStyle(QMapboxGLCacheDatabase *database, const QByteArray &data)
+{
+    const QJsonObject style = QJsonDocument::fromJson(data).object();
+
+    const QString sprite = style.value(QStringLiteral("sprite")).toString();
+    if (!sprite.isEmpty()) {
+        warmResource(database, QMapboxGLStyleResources::spriteUrl(sprite, QStringLiteral(".json"), m_highDpi));
+        warmResource(database, QMapboxGLStyleResources::spriteUrl(sprite, QStringLiteral(".png"), m_highDpi));
+    }
+
+    const QString glyphs = style.value(QStringLiteral("glyphs")).toString();
+    if (!glyphs.isEmpty()) {
+        const QStringList fontStacks = QMapboxGLStyleResources::fontStacks(style);
+        for (const QString &fontStack : fontStacks) {
+            for (int start : commonGlyphRanges)
+                warmResource(database, QMapboxGLStyleResources::glyphsUrl(glyphs, fontStack, start));
+        }
+    }
+
+    const QJsonObject sources = style.value(QStringLiteral("sources")).toObject();
+    for (auto it = sources.constBegin(); it != sources.constEnd(); ++it) {
+        QJsonObject source = it.value().toObject();
+
+        QByteArray tileJson;
+        if (source.contains(QStringLiteral("url")) && warmResource(database, source.value(QStringLiteral("url")).toString(), &tileJson))
+            source = QJsonDocument::fromJson(tileJson).object();
+
+        const QJsonArray tiles = source.value(QStringLiteral("tiles")).toArray();
+        if (!tiles.isEmpty())
+            warmTiles(database, tiles.first().toString());
+    }
+}
+
+void QMapboxGLCacheWarmer::warmTiles(QMapboxGLCacheDatabase *database, const QString &urlTemplate)
+{
+    if (m_cancelled.loadAcquire())
+        return;
+
+    QSqlQuery query(database->database());
+    query.setForwardOnly(true);
+    query.prepare(QStringLiteral("SELECT data FROM tiles WHERE url_template = ? AND z <= ?"));
+    query.addBindValue(urlTemplate);
+    query.addBindValue(maximumWarmZoom);
+
+    if (!query.exec())
+        return;
+
+    while (query.next() && !m_cancelled.loadAcquire()) {
+        const int size = query.value(0).toByteArray().size();
+
+        QMutexLocker locker(&m_mutex);
+        ++m_tiles;
+        m_bytes += size;
+    }
+}
+
+bool QMapboxGLCacheWarmer::warmResource(QMapboxGLCacheDatabase *database, const QString &url, QByteArray *data)
+{
+    if (m_cancelled.loadAcquire())
+        return false;
+
+    QByteArray contents;
+    if (!database->readResource(url, &contents))
+        return false;
+
+    if (data)
+        *data = contents;
+
+    QMutexLocker locker(&m_mutex);
+    ++m_resources;
+    m_bytes += contents.size();
+
+    return true;
+}
@@ -0,0 +1,91 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Copyright (C) 2017 Mapbox, Inc.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the QtLocation module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL3$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or later as published by the Free
+** Software Foundation and appearing in the file LICENSE.GPL included in
+** the packaging of this file. Please review the following information to
+** ensure the GNU General Public License version 2.0 requirements will be
+** met: http://www.gnu.org/licenses/gpl-2.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QMAPBOXGLCACHEWARMER_P_H
+#define QMAPBOXGLCACHEWARMER_P_H
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QMutex>
+#include <QtCore/QObject>
+#include <QtCore/QStringList>
+#include <QtCore/QVariantMap>
+
+class QMapboxGLCacheDatabase;
+class QThread;
+
+// Reads what the first map is going to ask for out of the cache database
+// on a background thread: the style, its sources, the sprite, the common
+// glyph ranges of its fonts and the lowest zoom tiles.
+//
+// Mapbox GL reads the database through its own connection, whose page
+// cache is not reachable from here. What gets warm is the operating system
+// file cache, which is where the time goes on slow flash storage.
+class QMapboxGLCacheWarmer : public QObject
+{
+    Q_OBJECT
+
+public:
+    QMapboxGLCacheWarmer(const QString &databasePath, const QString &styleUrl, QObject *parent = nullptr);
+    ~QMapboxGLCacheWarmer();
+
+    void start();
+    QVariantMap statistics() const;
+
+Q_SIGNALS:
+    void finished();
+
+private:
+    void run();
+    void warmStyle(QMapboxGLCacheDatabase *database, const QByteArray &data);
+    void warmTiles(QMapboxGLCacheDatabase *database, const QString &urlTemplate);
+    bool warmResource(QMapboxGLCacheDatabase *database, const QString &url, QByteArray *data = nullptr);
+
+    QString m_databasePath;
+    QString m_styleUrl;
+    bool m_highDpi = false;
+
+    QThread *m_thread = nullptr;
+    QAtomicInt m_cancelled;
+
+    mutable QMutex m_mutex;
+    int m_resources = 0;
+    int m_tiles = 0;
+    qint64 m_bytes = 0;
+    qint64 m_elapsed = -1;
+};
+
+#endif // QMAPBOXGLCACHEWARMER_P_H
@@ -0,0 +1,183 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Copyright (C) 2017 Mapbox, Inc.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the QtLocation module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL3$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or later as published by the Free
+** Software Foundation and appearing in the file LICENSE.GPL included in
+** the packaging of this file. Please review the following information to
+** ensure the GNU General Public License version 2.0 requirements will be
+** met: http://www.gnu.org/licenses/gpl-2.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+
+#include "qmapboxglcameraanimation_p.h"
+
+#include <QtPositioning/private/qwebmercator_p.h>
+
+#include <cmath>
+
+namespace {
+
+// Curvature of the flight path, same value as used by Mapbox GL flyTo.
+static const double rho = 1.42;
+static const double rho2 = rho * rho;
+
+// Average speed used when no duration is given, in screenfuls per second.
+static const double flightSpeed = 1.2;
+
+double interpolate(double from, double to, double t)
+{
+    return from + (to - from) * t;
+}
+
+} // namespace
+
+QMapboxGLCameraAnimation::QMapboxGLCameraAnimation(Type type, const QGeoCameraData &from, const QGeoCameraData &to,
+                                                   int duration, const QEasingCurve &easing, const QSizeF &viewportSize)
+    : m_type(type), m_from(from), m_to(to), m_duration(duration), m_easing(easing)
+{
+    m_fromMercator = QWebMercator::coordToMercator(from.center());
+    m_toMercator = QWebMercator::coordToMercator(to.center());
+
+    // Always travel the shortest way around the antimeridian.
+    const double dx = m_toMercator.x() - m_fromMercator.x();
+    if (dx > 0.5)
+        m_toMercator.setX(m_toMercator.x() - 1.0);
+    else if (dx < -0.5)
+        m_toMercator.setX(m_toMercator.x() + 1.0);
+
+    m_bearingDelta = std::fmod(to.bearing() - from.bearing() + 540.0, 360.0) - 180.0;
+
+    if (m_type == FlyTo)
+        setupFlight(viewportSize);
+
+    if (m_duration < 0)
+        m_duration = (m_type == FlyTo) ? int(1000.0 * m_flightLength / flightSpeed) : 0;
+}
+
+void QMapboxGLCameraAnimation::setupFlight(const QSizeF &viewportSize)
+{
+    // Distances are expressed in pixels at the starting zoom level.
+    const double worldSize = 256.0 * std::pow(2.0, m_from.zoomLevel());
+    const double w0 = qMax(qMax(viewportSize.width(), viewportSize.height()), 1.0);
+    const double w1 = w0 / std::pow(2.0, m_to.zoomLevel() - m_from.zoomLevel());
+    const double u1 = (m_toMercator - m_fromMercator).length() * worldSize;
+
+    m_w0 = w0;
+    m_u1 = u1;
+
+    auto r = [&](int i) {
+        const double b = (w1 * w1 - w0 * w0 + (i ? -1 : 1) * rho2 * rho2 * u1 * u1) / (2.0 * (i ? w1 : w0) * rho2 * u1);
+        return std::log(std::sqrt(b * b + 1.0) - b);
+    };
+
+    m_r0 = r(0);
+    m_flightLength = (r(1) - m_r0) / rho;
+
+    if (std::abs(u1) < 0.000001 || !std::isfinite(m_flightLength)) {
+        // Nothing to travel, only zoom in or out.
+        m_zoomOnly = true;
+        m_zoomDirection = w1 < w0 ? -1.0 : 1.0;
+        m_flightLength = std::abs(std::log(w1 / w0)) / rho;
+    }
+}
+
+double QMapboxGLCameraAnimation::flightPosition(double s) const
+{
+    if (m_zoomOnly)
+        return 0.0;
+
+    return m_w0 * (std::cosh(m_r0) * std::tanh(m_r0 + rho * s) - std::sinh(m_r0)) / rho2 / m_u1;
+}
+
+double QMapboxGLCameraAnimation::flightWidth(double s) const
+{
+    if (m_zoomOnly)
+        return std::exp(m_zoomDirection * rho * s);
+
+    return std::cosh(m_r0) / std::cosh(m_r0 + rho * s);
+}
+
+void QMapboxGLCameraAnimation::start()
+{
+    m_clock.start();
+}
+
+bool QMapboxGLCameraAnimation::isFinished() const
+{
+    return !m_clock.isValid() || m_clock.elapsed() >= m_duration;
+}
+
+int QMapboxGLCameraAnimation::duration() const
+{
+    return m_duration;
+}
+
+QGeoCameraData QMapboxGLCameraAnimation::targetCameraData() const
+{
+    return m_to;
+}
+
+QGeoCameraData QMapboxGLCameraAnimation::cameraData() const
+{
+    return cameraDataAt(m_clock.isValid() ? m_clock.elapsed() : m_duration);
+}
+
+QGeoCameraData QMapboxGLCameraAnimation::cameraDataAhead(qint64 msec) const
+{
+    return cameraDataAt((m_clock.isValid() ? m_clock.elapsed() : m_duration) + msec);
+}
+
+QGeoCameraData QMapboxGLCameraAnimation::cameraDataAt(qint64 elapsed) const
+{
+    if (elapsed >= m_duration || m_duration <= 0)
+        return m_to;
+
+    const double t = m_easing.valueForProgress(qreal(elapsed) / m_duration);
+
+    QGeoCameraData camera = m_to;
+    QDoubleVector2D center;
+
+    if (m_type == FlyTo) {
+        const double s = t * m_flightLength;
+        const double u = flightPosition(s);
+        center = m_fromMercator + (m_toMercator - m_fromMercator) * u;
+        camera.setZoomLevel(m_from.zoomLevel() + std::log2(1.0 / flightWidth(s)));
+    } else {
+        center = m_fromMercator + (m_toMercator - m_fromMercator) * t;
+        camera.setZoomLevel(interpolate(m_from.zoomLevel(), m_to.zoomLevel(), t));
+    }
+
+    center.setX(center.x() - std::floor(center.x()));
+    camera.setCenter(QWebMercator::mercatorToCoord(center));
+    camera.setBearing(std::fmod(m_from.bearing() + m_bearingDelta * t + 360.0, 360.0));
+    camera.setTilt(interpolate(m_from.tilt(), m_to.tilt(), t));
+
+    return camera;
+}
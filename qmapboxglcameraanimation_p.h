@@ -0,0 +1,93 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Copyright (C) 2017 Mapbox, Inc.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the QtLocation module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL3$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or later as published by the Free
+** Software Foundation and appearing in the file LICENSE.GPL included in
+** the packaging of this file. Please review the following information to
+** ensure the GNU General Public License version 2.0 requirements will be
+** met: http://www.gnu.org/licenses/gpl-2.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+
+#ifndef QMAPBOXGLCAMERAANIMATION_P_H
+#define QMAPBOXGLCAMERAANIMATION_P_H
+
+#include <QtCore/QEasingCurve>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QSizeF>
+#include <QtLocation/private/qgeocameradata_p.h>
+#include <QtPositioning/private/qdoublevector2d_p.h>
+
+class QMapboxGLCameraAnimation
+{
+public:
+    enum Type {
+        EaseTo,
+        FlyTo
+    };
+
+    QMapboxGLCameraAnimation(Type type, const QGeoCameraData &from, const QGeoCameraData &to,
+                             int duration, const QEasingCurve &easing, const QSizeF &viewportSize);
+
+    void start();
+    bool isFinished() const;
+
+    int duration() const;
+    QGeoCameraData targetCameraData() const;
+    QGeoCameraData cameraData() const;
+    QGeoCameraData cameraDataAt(qint64 elapsed) const;
+    QGeoCameraData cameraDataAhead(qint64 msec) const;
+
+private:
+    void setupFlight(const QSizeF &viewportSize);
+    double flightPosition(double s) const;
+    double flightWidth(double s) const;
+
+    Type m_type;
+    QGeoCameraData m_from;
+    QGeoCameraData m_to;
+    int m_duration;
+    QEasingCurve m_easing;
+    QElapsedTimer m_clock;
+
+    QDoubleVector2D m_fromMercator;
+    QDoubleVector2D m_toMercator;
+    double m_bearingDelta = 0.0;
+
+    // van Wijk and Nuij "Smooth and efficient zooming and panning"
+    double m_flightLength = 0.0;
+    double m_r0 = 0.0;
+    double m_u1 = 0.0;
+    double m_w0 = 1.0;
+    double m_zoomDirection = 0.0;
+    bool m_zoomOnly = false;
+};
+
+#endif // QMAPBOXGLCAMERAANIMATION_P_H
@@ -0,0 +1,184 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Copyright (C) 2017 Mapbox, Inc.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the QtLocation module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL3$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or later as published by the Free
+** Software Foundation and appearing in the file LICENSE.GPL included in
+** the packaging of this file. Please review the following information to
+** ensure the GNU General Public License version 2.0 requirements will be
+** met: http://www.gnu.org/licenses/gpl-2.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qmapboxglframereader_p.h"
+
+#include <QtGui/QOpenGLContext>
+#include <QtGui/QOpenGLFramebufferObject>
+
+QMapboxGLFrameReader::QMapboxGLFrameReader(int ringSize)
+    : m_slots(qMax(ringSize, 1))
+{
+}
+
+QMapboxGLFrameReader::~QMapboxGLFrameReader()
+{
+    QOpenGLContext *context = QOpenGLContext::currentContext();
+
+    for (Slot &slot : m_slots) {
+        if (slot.fence && context)
+            context->extraFunctions()->glDeleteSync(slot.fence);
+        slot.buffer.destroy();
+    }
+}
+
+bool QMapboxGLFrameReader::usePixelBuffers()
+{
+    if (m_usePixelBuffers < 0) {
+        // Pixel pack buffers and glMapBufferRange came with OpenGL 3.0 and
+        // OpenGL ES 3.0, but desktop OpenGL only has fences from 3.2 on or
+        // with GL_ARB_sync.
+        QOpenGLContext *context = QOpenGLContext::currentContext();
+        const QSurfaceFormat format = context->format();
+        const QPair<int, int> version = format.version();
+
+        if (context->isOpenGLES())
+            m_usePixelBuffers = version >= qMakePair(3, 0);
+        else
+            m_usePixelBuffers = version >= qMakePair(3, 2)
+                || (version >= qMakePair(3, 0) && context->hasExtension(QByteArrayLiteral("GL_ARB_sync")));
+    }
+
+    return m_usePixelBuffers;
+}
+
+void QMapboxGLFrameReader::read(QOpenGLFramebufferObject *fbo, const QSize &size)
+{
+    if (!usePixelBuffers()) {
+        // The framebuffer is bottom-up and toImage() flips it already.
+        const QImage image = fbo->toImage();
+        m_frames.append(image.copy(0, image.height() - size.height(), size.width(), size.height()));
+        return;
+    }
+
+    QOpenGLExtraFunctions *f = QOpenGLContext::currentContext()->extraFunctions();
+
+    // The ring is full: this one read has to wait for the GPU.
+    Slot &slot = m_slots[m_next];
+    if (slot.pending)
+        map(slot);
+
+    if (!slot.buffer.isCreated())
+        slot.buffer.create();
+
+    slot.buffer.bind();
+    if (slot.size != size) {
+        slot.buffer.setUsagePattern(QOpenGLBuffer::StreamRead);
+        slot.buffer.allocate(size.width() * size.height() * 4);
+        slot.size = size;
+    }
+
+    fbo->bind();
+    f->glReadPixels(0, 0, size.width(), size.height(), GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    fbo->release();
+    slot.buffer.release();
+
+    slot.fence = f->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.pending = true;
+
+    m_next = (m_next + 1) % m_slots.size();
+}
+
+void QMapboxGLFrameReader::map(Slot &slot)
+{
+    QOpenGLExtraFunctions *f = QOpenGLContext::currentContext()->extraFunctions();
+
+    if (slot.fence) {
+        f->glDeleteSync(slot.fence);
+        slot.fence = nullptr;
+    }
+
+    slot.buffer.bind();
+
+    const int bytes = slot.size.width() * slot.size.height() * 4;
+    const void *data = f->glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bytes, GL_MAP_READ_BIT);
+    if (data) {
+        QImage image(slot.size, QImage::Format_RGBA8888_Premultiplied);
+        memcpy(image.bits(), data, bytes);
+        f->glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        m_frames.append(image.mirrored());
+    }
+
+    slot.buffer.release();
+    slot.pending = false;
+}
+
+qint64 QMapboxGLFrameReader::bufferBytes() const
+{
+    qint64 bytes = 0;
+    for (const Slot &slot : m_slots) {
+        if (slot.buffer.isCreated())
+            bytes += qint64(slot.size.width()) * slot.size.height() * 4;
+    }
+
+    return bytes;
+}
+
+QList<QImage> QMapboxGLFrameReader::takeFrames()
+{
+    if (usePixelBuffers()) {
+        QOpenGLExtraFunctions *f = QOpenGLContext::currentContext()->extraFunctions();
+
+        // Oldest first, so frames come out in the order they were read.
+        for (int i = 0; i < m_slots.size(); ++i) {
+            Slot &slot = m_slots[(m_next + i) % m_slots.size()];
+            if (!slot.pending)
+                continue;
+
+            const GLenum status = f->glClientWaitSync(slot.fence, 0, 0);
+            if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+                break;
+
+            map(slot);
+        }
+    }
+
+    QList<QImage> frames;
+    frames.swap(m_frames);
+
+    return frames;
+}
+
+bool QMapboxGLFrameReader::hasPendingReads() const
+{
+    for (const Slot &slot : m_slots) {
+        if (slot.pending)
+            return true;
+    }
+
+    return false;
+}
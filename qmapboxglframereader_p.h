@@ -0,0 +1,87 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Copyright (C) 2017 Mapbox, Inc.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the QtLocation module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL3$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or later as published by the Free
+** Software Foundation and appearing in the file LICENSE.GPL included in
+** the packaging of this file. Please review the following information to
+** ensure the GNU General Public License version 2.0 requirements will be
+** met: http://www.gnu.org/licenses/gpl-2.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QMAPBOXGLFRAMEREADER_P_H
+#define QMAPBOXGLFRAMEREADER_P_H
+
+#include <QtCore/QList>
+#include <QtCore/QSize>
+#include <QtCore/QVector>
+#include <QtGui/QImage>
+#include <QtGui/QOpenGLBuffer>
+#include <QtGui/QOpenGLExtraFunctions>
+
+class QOpenGLFramebufferObject;
+
+// Reads framebuffer contents back without waiting for the GPU. Each read
+// goes into the next pixel buffer object of a small ring and is mapped
+// once the GPU signalled its fence, usually a frame or two later. Without
+// pixel buffer objects and fences (OpenGL ES 2, desktop OpenGL before 3.2
+// without GL_ARB_sync) reads fall back to a blocking
+// QOpenGLFramebufferObject::toImage().
+//
+// Must be used, and destroyed, with the same context current.
+class QMapboxGLFrameReader
+{
+public:
+    explicit QMapboxGLFrameReader(int ringSize = 3);
+    ~QMapboxGLFrameReader();
+
+    void read(QOpenGLFramebufferObject *fbo, const QSize &size);
+    QList<QImage> takeFrames();
+
+    bool hasPendingReads() const;
+    qint64 bufferBytes() const;
+
+private:
+    struct Slot {
+        QOpenGLBuffer buffer = QOpenGLBuffer(QOpenGLBuffer::PixelPackBuffer);
+        QSize size;
+        GLsync fence = nullptr;
+        bool pending = false;
+    };
+
+    bool usePixelBuffers();
+    void map(Slot &slot);
+
+    QVector<Slot> m_slots;
+    int m_next = 0;
+    int m_usePixelBuffers = -1;
+    QList<QImage> m_frames;
+};
+
+#endif // QMAPBOXGLFRAMEREADER_P_H
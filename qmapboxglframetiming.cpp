@@ -0,0 +1,242 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Copyright (C) 2017 Mapbox, Inc.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the QtLocation module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL3$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or later as published by the Free
+** Software Foundation and appearing in the file LICENSE.GPL included in
+** the packaging of this file. Please review the following information to
+** ensure the GNU General Public License version 2.0 requirements will be
+** met: http://www.gnu.org/licenses/gpl-2.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qmapboxglframetiming_p.h"
+
+#include <QtCore/QStringList>
+#if !defined(QT_OPENGL_ES_2)
+#include <QtGui/QOpenGLTimerQuery>
+#endif
+
+#include <algorithm>
+
+// QMapboxGLFrameTiming::Scope
+
+QMapboxGLFrameTiming::Scope::Scope(QMapboxGLFrameTiming *timing, Phase phase)
+    : m_timing(timing)
+    , m_phase(phase)
+{
+    if (m_timing)
+        m_timer.start();
+}
+
+QMapboxGLFrameTiming::Scope::~Scope()
+{
+    if (m_timing)
+        m_timing->add(m_phase, m_timer.nsecsElapsed());
+}
+
+// QMapboxGLFrameTiming::GpuTimer
+
+QMapboxGLFrameTiming::GpuTimer::GpuTimer(QMapboxGLFrameTiming *timing)
+    : m_timing(timing)
+{
+#if defined(QT_OPENGL_ES_2)
+    // Timer queries are a desktop OpenGL feature in Qt.
+    m_supported = false;
+#endif
+}
+
+QMapboxGLFrameTiming::GpuTimer::~GpuTimer()
+{
+#if !defined(QT_OPENGL_ES_2)
+    qDeleteAll(m_queries);
+#endif
+}
+
+void QMapboxGLFrameTiming::GpuTimer::begin()
+{
+#if !defined(QT_OPENGL_ES_2)
+    if (!m_supported)
+        return;
+
+    if (m_queries.isEmpty()) {
+        // Results are usually there after two frames, keep a few in flight.
+        for (int i = 0; i < 4; ++i) {
+            QOpenGLTimerQuery *query = new QOpenGLTimerQuery;
+            if (!query->create()) {
+                delete query;
+                qDeleteAll(m_queries);
+                m_queries.clear();
+                m_supported = false;
+                return;
+            }
+            m_queries.append(query);
+            m_pending.append(false);
+        }
+    }
+
+    QOpenGLTimerQuery *query = m_queries.at(m_next);
+    if (m_pending.at(m_next)) {
+        // Only read results that are ready, a late one is dropped rather
+        // than waited for.
+        if (query->isResultAvailable())
+            m_timing->addSample(GpuRender, query->waitForResult());
+        m_pending[m_next] = false;
+    }
+
+    query->begin();
+#endif
+}
+
+void QMapboxGLFrameTiming::GpuTimer::end()
+{
+#if !defined(QT_OPENGL_ES_2)
+    if (!m_supported || m_queries.isEmpty())
+        return;
+
+    m_queries.at(m_next)->end();
+    m_pending[m_next] = true;
+    m_next = (m_next + 1) % m_queries.size();
+#endif
+}
+
+// QMapboxGLFrameTiming
+
+QMapboxGLFrameTiming::QMapboxGLFrameTiming(int samples)
+    : m_samples(qMax(samples, 1))
+{
+}
+
+void QMapboxGLFrameTiming::add(Phase phase, qint64 nsecs)
+{
+    m_frame[phase] += nsecs;
+    m_frameHas[phase] = true;
+}
+
+void QMapboxGLFrameTiming::commitFrame()
+{
+    for (int phase = 0; phase < PhaseCount; ++phase) {
+        if (!m_frameHas[phase])
+            continue;
+
+        addSample(Phase(phase), m_frame[phase]);
+        m_frame[phase] = 0;
+        m_frameHas[phase] = false;
+    }
+}
+
+void QMapboxGLFrameTiming::addSample(Phase phase, qint64 nsecs)
+{
+    QMutexLocker locker(&m_mutex);
+
+    QVector<qint64> &history = m_history[phase];
+    if (history.size() < m_samples) {
+        history.append(nsecs);
+    } else {
+        history[m_next[phase]] = nsecs;
+        m_next[phase] = (m_next[phase] + 1) % m_samples;
+    }
+
+    ++m_count[phase];
+}
+
+QString QMapboxGLFrameTiming::phaseName(Phase phase)
+{
+    switch (phase) {
+    case NodeCreation:
+        return QStringLiteral("nodeCreation");
+    case StyleSync:
+        return QStringLiteral("styleSync");
+    case CameraSync:
+        return QStringLiteral("cameraSync");
+    case Resize:
+        return QStringLiteral("resize");
+    case Render:
+        return QStringLiteral("render");
+    case StateRestore:
+        return QStringLiteral("stateRestore");
+    case GpuRender:
+        return QStringLiteral("gpuRender");
+    case Total:
+        return QStringLiteral("total");
+    case PhaseCount:
+        break;
+    }
+
+    return QString();
+}
+
+QVariantMap QMapboxGLFrameTiming::statistics() const
+{
+    QMutexLocker locker(&m_mutex);
+
+    // Times in milliseconds.
+    QVariantMap statistics;
+    for (int phase = 0; phase < PhaseCount; ++phase) {
+        QVector<qint64> sorted = m_history[phase];
+        if (sorted.isEmpty())
+            continue;
+
+        std::sort(sorted.begin(), sorted.end());
+
+        auto percentile = [&sorted](int p) {
+            return sorted.at(qMin(sorted.size() - 1, sorted.size() * p / 100)) / 1e6;
+        };
+
+        QVariantMap timing;
+        timing[QStringLiteral("count")] = m_count[phase];
+        timing[QStringLiteral("p50")] = percentile(50);
+        timing[QStringLiteral("p95")] = percentile(95);
+        timing[QStringLiteral("p99")] = percentile(99);
+        timing[QStringLiteral("max")] = sorted.last() / 1e6;
+
+        statistics[phaseName(Phase(phase))] = timing;
+    }
+
+    return statistics;
+}
+
+QString QMapboxGLFrameTiming::summary() const
+{
+    const QVariantMap timings = statistics();
+
+    QStringList phases;
+    for (int phase = 0; phase < PhaseCount; ++phase) {
+        const QVariantMap timing = timings.value(phaseName(Phase(phase))).toMap();
+        if (timing.isEmpty())
+            continue;
+
+        phases << QStringLiteral("%1 %2/%3/%4")
+                  .arg(phaseName(Phase(phase)))
+                  .arg(timing.value(QStringLiteral("p50")).toDouble(), 0, 'f', 2)
+                  .arg(timing.value(QStringLiteral("p95")).toDouble(), 0, 'f', 2)
+                  .arg(timing.value(QStringLiteral("p99")).toDouble(), 0, 'f', 2);
+    }
+
+    return phases.join(QStringLiteral(", "));
+}
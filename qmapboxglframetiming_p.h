@@ -0,0 +1,122 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Copyright (C) 2017 Mapbox, Inc.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the QtLocation module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL3$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or later as published by the Free
+** Software Foundation and appearing in the file LICENSE.GPL included in
+** the packaging of this file. Please review the following information to
+** ensure the GNU General Public License version 2.0 requirements will be
+** met: http://www.gnu.org/licenses/gpl-2.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QMAPBOXGLFRAMETIMING_P_H
+#define QMAPBOXGLFRAMETIMING_P_H
+
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QMutex>
+#include <QtCore/QString>
+#include <QtCore/QVariantMap>
+#include <QtCore/QVector>
+
+class QOpenGLTimerQuery;
+
+// Rolling per-phase timings of the map's scene graph updates. Phases are
+// accumulated over one update and committed as one sample each, the last
+// few hundred samples per phase give the percentiles. Written on the
+// render thread, read on the GUI thread.
+class QMapboxGLFrameTiming
+{
+public:
+    enum Phase {
+        NodeCreation,
+        StyleSync,
+        CameraSync,
+        Resize,
+        Render,
+        StateRestore,
+        GpuRender,
+        Total,
+        PhaseCount
+    };
+
+    // Times the enclosing block into a phase, a no-op without timing.
+    class Scope
+    {
+    public:
+        Scope(QMapboxGLFrameTiming *timing, Phase phase);
+        ~Scope();
+
+    private:
+        QMapboxGLFrameTiming *m_timing;
+        Phase m_phase;
+        QElapsedTimer m_timer;
+    };
+
+    // GPU time of the work submitted between begin() and end(), read back
+    // a few frames later. Owns GL queries, so lives with the context.
+    class GpuTimer
+    {
+    public:
+        explicit GpuTimer(QMapboxGLFrameTiming *timing);
+        ~GpuTimer();
+
+        void begin();
+        void end();
+
+    private:
+        QMapboxGLFrameTiming *m_timing;
+        QVector<QOpenGLTimerQuery *> m_queries;
+        QVector<bool> m_pending;
+        int m_next = 0;
+        bool m_supported = true;
+    };
+
+    explicit QMapboxGLFrameTiming(int samples = 512);
+
+    void add(Phase phase, qint64 nsecs);
+    void commitFrame();
+
+    QVariantMap statistics() const;
+    QString summary() const;
+
+    static QString phaseName(Phase phase);
+
+private:
+    void addSample(Phase phase, qint64 nsecs);
+
+    mutable QMutex m_mutex;
+    int m_samples;
+    qint64 m_frame[PhaseCount] = {};
+    bool m_frameHas[PhaseCount] = {};
+    QVector<qint64> m_history[PhaseCount];
+    int m_next[PhaseCount] = {};
+    quint64 m_count[PhaseCount] = {};
+};
+
+#endif // QMAPBOXGLFRAMETIMING_P_H
@@ -0,0 +1,243 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Copyright (C) 2017 Mapbox, Inc.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the QtLocation module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL3$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or later as published by the Free
+** Software Foundation and appearing in the file LICENSE.GPL included in
+** the packaging of this file. Please review the following information to
+** ensure the GNU General Public License version 2.0 requirements will be
+** met: http://www.gnu.org/licenses/gpl-2.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qmapboxglmappool_p.h"
+
+#include <QtCore/QHash>
+#include <QtCore/QRunnable>
+#include <QtGui/QOpenGLContext>
+#include <QtQuick/QQuickWindow>
+
+#include <QMapboxGL>
+
+namespace {
+
+// Runs on the render thread of the window with its context current.
+class DeleteMapsJob : public QRunnable
+{
+public:
+    explicit DeleteMapsJob(const QList<QMapboxGL *> &maps) : m_maps(maps) {}
+
+    void run() override
+    {
+        qDeleteAll(m_maps);
+        m_maps.clear();
+    }
+
+private:
+    QList<QMapboxGL *> m_maps;
+};
+
+} // namespace
+
+QMapboxGLMapPool::QMapboxGLMapPool(QObject *parent)
+    : QObject(parent)
+{
+}
+
+QMapboxGLMapPool::~QMapboxGLMapPool()
+{
+    QMutexLocker locker(&m_mutex);
+
+    // The windows of whatever is left are still alive, their scene graph
+    // would have dropped the maps otherwise. Hidden windows get the job
+    // as well, it runs once they are shown again.
+    removeAll(false);
+
+    if (!m_entries.isEmpty())
+        qWarning("QMapboxGLMapPool destroyed with %d pooled maps.", m_entries.size());
+}
+
+void QMapboxGLMapPool::setMaximumSize(int size)
+{
+    QMutexLocker locker(&m_mutex);
+    m_maximumSize = size;
+}
+
+void QMapboxGLMapPool::setExpiryTime(int msec)
+{
+    QMutexLocker locker(&m_mutex);
+    m_expiryTime = msec;
+}
+
+QMapboxGL *QMapboxGLMapPool::acquire(const void *owner, qreal pixelRatio, bool *warm)
+{
+    QMutexLocker locker(&m_mutex);
+
+    *warm = false;
+
+    QOpenGLContext *context = QOpenGLContext::currentContext();
+    if (!context)
+        return nullptr;
+
+    expire(context);
+
+    // Prefer the map this owner had before, then the most recent one.
+    int match = -1;
+    for (int i = m_entries.size() - 1; i >= 0; --i) {
+        const Entry &entry = m_entries.at(i);
+        if (entry.context != context || !qFuzzyCompare(entry.pixelRatio, pixelRatio))
+            continue;
+
+        if (entry.owner == owner) {
+            match = i;
+            break;
+        }
+
+        if (match < 0)
+            match = i;
+    }
+
+    if (match < 0)
+        return nullptr;
+
+    const Entry entry = m_entries.takeAt(match);
+    *warm = entry.owner == owner && entry.styleLoaded;
+
+    return entry.map;
+}
+
+void QMapboxGLMapPool::release(const void *owner, QMapboxGL *map, qreal pixelRatio, bool styleLoaded, QQuickWindow *window)
+{
+    QMutexLocker locker(&m_mutex);
+
+    QOpenGLContext *context = QOpenGLContext::currentContext();
+    if (!context || m_maximumSize <= 0) {
+        delete map;
+        return;
+    }
+
+    connect(window, &QQuickWindow::sceneGraphInvalidated, this,
+            &QMapboxGLMapPool::onSceneGraphInvalidated,
+            static_cast<Qt::ConnectionType>(Qt::DirectConnection | Qt::UniqueConnection));
+
+    Entry entry;
+    entry.map = map;
+    entry.context = context;
+    entry.window = window;
+    entry.owner = owner;
+    entry.pixelRatio = pixelRatio;
+    entry.styleLoaded = styleLoaded;
+    entry.age.start();
+    m_entries.append(entry);
+
+    expire(context);
+
+    int count = 0;
+    for (const Entry &e : m_entries)
+        count += e.context == context;
+
+    for (auto it = m_entries.begin(); it != m_entries.end() && count > m_maximumSize;) {
+        if (it->context == context) {
+            delete it->map;
+            it = m_entries.erase(it);
+            --count;
+        } else {
+            ++it;
+        }
+    }
+}
+
+void QMapboxGLMapPool::trim()
+{
+    QMutexLocker locker(&m_mutex);
+    removeAll(true);
+}
+
+int QMapboxGLMapPool::size() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_entries.size();
+}
+
+void QMapboxGLMapPool::onSceneGraphInvalidated()
+{
+    QMutexLocker locker(&m_mutex);
+
+    // Emitted on the render thread with the dying context still current.
+    if (QOpenGLContext *context = QOpenGLContext::currentContext())
+        removeAll(context);
+}
+
+void QMapboxGLMapPool::expire(QOpenGLContext *context)
+{
+    for (auto it = m_entries.begin(); it != m_entries.end();) {
+        if (it->context == context && m_expiryTime > 0 && it->age.hasExpired(m_expiryTime)) {
+            delete it->map;
+            it = m_entries.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void QMapboxGLMapPool::removeAll(QOpenGLContext *context)
+{
+    for (auto it = m_entries.begin(); it != m_entries.end();) {
+        if (it->context == context) {
+            delete it->map;
+            it = m_entries.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void QMapboxGLMapPool::removeAll(bool onlyExposed)
+{
+    QOpenGLContext *current = QOpenGLContext::currentContext();
+    QHash<QQuickWindow *, QList<QMapboxGL *>> maps;
+
+    for (auto it = m_entries.begin(); it != m_entries.end();) {
+        if (it->context == current) {
+            delete it->map;
+            it = m_entries.erase(it);
+        } else if (it->window && (!onlyExposed || it->window->isExposed())) {
+            maps[it->window.data()].append(it->map);
+            it = m_entries.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    // The job runs with the next frame of the window, which may be on
+    // another thread than this one, so the frame is requested by event.
+    for (auto it = maps.constBegin(); it != maps.constEnd(); ++it) {
+        it.key()->scheduleRenderJob(new DeleteMapsJob(it.value()), QQuickWindow::AfterSynchronizingStage);
+        QMetaObject::invokeMethod(it.key(), "update", Qt::QueuedConnection);
+    }
+}
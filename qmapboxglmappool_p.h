@@ -0,0 +1,107 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Copyright (C) 2017 Mapbox, Inc.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the QtLocation module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL3$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or later as published by the Free
+** Software Foundation and appearing in the file LICENSE.GPL included in
+** the packaging of this file. Please review the following information to
+** ensure the GNU General Public License version 2.0 requirements will be
+** met: http://www.gnu.org/licenses/gpl-2.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QMAPBOXGLMAPPOOL_P_H
+#define QMAPBOXGLMAPPOOL_P_H
+
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QObject>
+#include <QtCore/QPointer>
+
+class QMapboxGL;
+class QOpenGLContext;
+class QQuickWindow;
+
+// Keeps the QMapboxGL of scene graph nodes that went away because their
+// map got hidden, so that the next node can pick it up with its style and
+// tiles still loaded instead of starting over.
+//
+// A map owns GL resources of the context it was rendered with, so it is
+// only handed out again, and only deleted, on the render thread with that
+// context current. Everything pooled for a context is dropped when the
+// window invalidates its scene graph, maps of other threads are handed to
+// a render job of their window.
+class QMapboxGLMapPool : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit QMapboxGLMapPool(QObject *parent = nullptr);
+    ~QMapboxGLMapPool();
+
+    void setMaximumSize(int size);
+    void setExpiryTime(int msec);
+
+    // Returns nullptr when nothing fits. warm is set when the map comes
+    // back to the owner that released it, with its style fully loaded.
+    QMapboxGL *acquire(const void *owner, qreal pixelRatio, bool *warm);
+    void release(const void *owner, QMapboxGL *map, qreal pixelRatio, bool styleLoaded, QQuickWindow *window);
+
+    // Frees the pooled maps, through a render job of their window unless
+    // their context is current here. Maps of hidden windows stay pooled
+    // until the window is shown or its scene graph goes away.
+    void trim();
+
+    int size() const;
+
+private Q_SLOTS:
+    void onSceneGraphInvalidated();
+
+private:
+    struct Entry {
+        QMapboxGL *map;
+        QOpenGLContext *context;
+        QPointer<QQuickWindow> window;
+        const void *owner;
+        qreal pixelRatio;
+        bool styleLoaded;
+        QElapsedTimer age;
+    };
+
+    void expire(QOpenGLContext *context);
+    void removeAll(QOpenGLContext *context);
+    void removeAll(bool onlyExposed);
+
+    mutable QMutex m_mutex;
+    QList<Entry> m_entries;
+    int m_maximumSize = 2;
+    int m_expiryTime = 60000;
+};
+
+#endif // QMAPBOXGLMAPPOOL_P_H
@@ -0,0 +1,528 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Copyright (C) 2017 Mapbox, Inc.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the QtLocation module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL3$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or later as published by the Free
+** Software Foundation and appearing in the file LICENSE.GPL included in
+** the packaging of this file. Please review the following information to
+** ensure the GNU General Public License version 2.0 requirements will be
+** met: http://www.gnu.org/licenses/gpl-2.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qmapboxglmarkerlayer_p.h"
+#include "qmapboxglstylechange_p.h"
+#include "qmapboxgltrace_p.h"
+
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QJsonObject>
+#include <QtLocation/private/qdeclarativegeomapquickitem_p.h>
+#include <QtQml/QQmlFile>
+#include <QtQuick/private/qquickimage_p.h>
+#include <QtQuick/private/qquickitem_p.h>
+
+#include <QDebug>
+
+namespace {
+
+const QString markerSourceId = QStringLiteral("QtLocation-markers");
+const QString markerLayerId = QStringLiteral("QtLocation-markers");
+const QString clusterLayerId = QStringLiteral("QtLocation-markers-clusters");
+const QString clusterCountLayerId = QStringLiteral("QtLocation-markers-cluster-count");
+
+QVariantList hasPointCount()
+{
+    return QVariantList { QStringLiteral("has"), QStringLiteral("point_count") };
+}
+
+} // namespace
+
+QMapboxGLMarkerLayer::QMapboxGLMarkerLayer(QObject *parent)
+    : QObject(parent)
+    , m_clusterFont({ QStringLiteral("Open Sans Regular"), QStringLiteral("Arial Unicode MS Regular") })
+{
+}
+
+QMapboxGLMarkerLayer::~QMapboxGLMarkerLayer()
+{
+    const auto items = m_delegates.keys();
+    for (QDeclarativeGeoMapQuickItem *item : items)
+        removeItem(item);
+}
+
+void QMapboxGLMarkerLayer::setAllowOverlap(bool allow)
+{
+    m_allowOverlap = allow;
+}
+
+void QMapboxGLMarkerLayer::setClustering(bool enabled, int radius, int maxZoom)
+{
+    m_clustering = enabled;
+    m_clusterRadius = radius;
+    m_clusterMaxZoom = maxZoom;
+}
+
+void QMapboxGLMarkerLayer::setClusterFont(const QStringList &fontStack)
+{
+    m_clusterFont = fontStack;
+}
+
+void QMapboxGLMarkerLayer::setPoints(const QObject *owner, const QByteArray &geoJson, const QString &iconFileName)
+{
+    removePoints(owner);
+
+    QJsonParseError error;
+    const QJsonObject object = QJsonDocument::fromJson(geoJson, &error).object();
+    if (error.error != QJsonParseError::NoError) {
+        qWarning() << "Invalid GeoJSON for markers:" << error.errorString();
+        return;
+    }
+
+    const QString icon = registerIcon(iconFileName, QSize());
+    if (icon.isEmpty())
+        return;
+
+    const QJsonArray input = object.value(QStringLiteral("type")).toString() == QStringLiteral("FeatureCollection")
+            ? object.value(QStringLiteral("features")).toArray() : QJsonArray { object };
+
+    // Same properties as the features of MapQuickItems, the symbol is
+    // centered on the point.
+    QJsonArray features;
+    for (const QJsonValue &value : input) {
+        QJsonObject feature = value.toObject();
+        if (feature.value(QStringLiteral("geometry")).toObject().value(QStringLiteral("type")).toString() != QStringLiteral("Point"))
+            continue;
+
+        QJsonObject properties = feature.value(QStringLiteral("properties")).toObject();
+        properties[QStringLiteral("icon")] = icon;
+        properties[QStringLiteral("offset")] = QJsonArray { 0.0, 0.0 };
+        if (!properties.contains(QStringLiteral("rotation")))
+            properties[QStringLiteral("rotation")] = 0.0;
+        if (!properties.contains(QStringLiteral("opacity")))
+            properties[QStringLiteral("opacity")] = 1.0;
+
+        feature[QStringLiteral("properties")] = properties;
+        features.append(feature);
+    }
+
+    if (features.isEmpty())
+        return;
+
+    m_points.insert(owner, features);
+    m_pointCount += features.size();
+
+    markDirty();
+}
+
+void QMapboxGLMarkerLayer::removePoints(const QObject *owner)
+{
+    auto it = m_points.find(owner);
+    if (it == m_points.end())
+        return;
+
+    m_pointCount -= it->size();
+    m_points.erase(it);
+
+    markDirty();
+}
+
+void QMapboxGLMarkerLayer::addItem(QDeclarativeGeoMapQuickItem *item)
+{
+    if (m_delegates.contains(item))
+        return;
+
+    m_delegates.insert(item, QPointer<QQuickImage>());
+
+    connect(item, &QDeclarativeGeoMapQuickItem::coordinateChanged, this, &QMapboxGLMarkerLayer::onItemChanged);
+    connect(item, &QDeclarativeGeoMapQuickItem::anchorPointChanged, this, &QMapboxGLMarkerLayer::onItemChanged);
+    connect(item, &QDeclarativeGeoMapQuickItem::sourceItemChanged, this, &QMapboxGLMarkerLayer::onItemChanged);
+    connect(item, &QDeclarativeGeoMapQuickItem::zoomLevelChanged, this, &QMapboxGLMarkerLayer::onItemChanged);
+    connect(item, &QQuickItem::visibleChanged, this, &QMapboxGLMarkerLayer::onItemChanged);
+    connect(item, &QQuickItem::rotationChanged, this, &QMapboxGLMarkerLayer::onItemChanged);
+    connect(item, &QDeclarativeGeoMapItemBase::mapItemOpacityChanged, this, &QMapboxGLMarkerLayer::onItemChanged);
+
+    update(item);
+}
+
+void QMapboxGLMarkerLayer::removeItem(QDeclarativeGeoMapQuickItem *item)
+{
+    auto it = m_delegates.find(item);
+    if (it == m_delegates.end())
+        return;
+
+    release(item);
+
+    if (QQuickImage *image = it.value()) {
+        disconnect(image, nullptr, this, nullptr);
+        m_items.remove(image);
+    }
+
+    disconnect(item, nullptr, this, nullptr);
+    m_delegates.erase(it);
+}
+
+int QMapboxGLMarkerLayer::count() const
+{
+    return m_markers.size() + m_pointCount;
+}
+
+qint64 QMapboxGLMarkerLayer::iconBytes() const
+{
+    qint64 bytes = 0;
+    for (const QImage &icon : m_icons)
+        bytes += icon.sizeInBytes();
+
+    return bytes;
+}
+
+void QMapboxGLMarkerLayer::reset()
+{
+    m_pendingIcons = m_icons.keys();
+    m_layerAdded = false;
+    m_dirty = true;
+}
+
+bool QMapboxGLMarkerLayer::isDirty() const
+{
+    return m_dirty || !m_pendingIcons.isEmpty();
+}
+
+QList<QSharedPointer<QMapboxGLStyleChange>> QMapboxGLMarkerLayer::takeChanges(const QString &before)
+{
+    QList<QSharedPointer<QMapboxGLStyleChange>> changes;
+
+    // Nothing to draw yet, the layer is added with the first marker.
+    if (count() == 0 && !m_layerAdded) {
+        m_dirty = false;
+        return changes;
+    }
+
+    QMapboxGLTrace::Scope trace("markers", "style");
+
+    for (const QString &name : qAsConst(m_pendingIcons))
+        changes << QMapboxGLStyleAddImage::fromImage(name, m_icons.value(name));
+    m_pendingIcons.clear();
+
+    if (m_dirty) {
+        changes << sourceChange();
+        m_dirty = false;
+        ++m_sourceUpdates;
+    }
+
+    if (!m_layerAdded) {
+        changes << layerChanges(before);
+        m_layerAdded = true;
+    }
+
+    return changes;
+}
+
+QList<QSharedPointer<QMapboxGLStyleChange>> QMapboxGLMarkerLayer::addChanges(const QString &before) const
+{
+    QList<QSharedPointer<QMapboxGLStyleChange>> changes;
+
+    if (!m_layerAdded)
+        return changes;
+
+    for (auto it = m_icons.cbegin(); it != m_icons.cend(); ++it)
+        changes << QMapboxGLStyleAddImage::fromImage(it.key(), it.value());
+
+    changes << sourceChange();
+    changes << layerChanges(before);
+
+    return changes;
+}
+
+QSharedPointer<QMapboxGLStyleChange> QMapboxGLMarkerLayer::sourceChange() const
+{
+    QVariantMap options;
+    if (m_clustering) {
+        options[QStringLiteral("cluster")] = true;
+        options[QStringLiteral("clusterRadius")] = m_clusterRadius;
+        options[QStringLiteral("clusterMaxZoom")] = m_clusterMaxZoom;
+    }
+
+    return QMapboxGLStyleAddSource::fromGeoJSON(markerSourceId, geoJson(), options);
+}
+
+QList<QSharedPointer<QMapboxGLStyleChange>> QMapboxGLMarkerLayer::layerChanges(const QString &before) const
+{
+    QList<QSharedPointer<QMapboxGLStyleChange>> changes;
+
+    QVariantMap layout;
+    layout[QStringLiteral("icon-image")] = QVariantList { QStringLiteral("get"), QStringLiteral("icon") };
+    layout[QStringLiteral("icon-offset")] = QVariantList { QStringLiteral("get"), QStringLiteral("offset") };
+    layout[QStringLiteral("icon-rotate")] = QVariantList { QStringLiteral("get"), QStringLiteral("rotation") };
+    layout[QStringLiteral("icon-allow-overlap")] = m_allowOverlap;
+    layout[QStringLiteral("icon-ignore-placement")] = m_allowOverlap;
+
+    QVariantMap paint;
+    paint[QStringLiteral("icon-opacity")] = QVariantList { QStringLiteral("get"), QStringLiteral("opacity") };
+
+    QVariantMap params;
+    params[QStringLiteral("id")] = markerLayerId;
+    params[QStringLiteral("type")] = QStringLiteral("symbol");
+    params[QStringLiteral("source")] = markerSourceId;
+    params[QStringLiteral("layout")] = layout;
+    params[QStringLiteral("paint")] = paint;
+    if (m_clustering)
+        params[QStringLiteral("filter")] = QVariantList { QStringLiteral("!"), hasPointCount() };
+
+    changes << QMapboxGLStyleAddLayer::fromParams(params, before);
+
+    // Default look of the clusters.
+    if (m_clustering) {
+        QVariantMap circlePaint;
+        circlePaint[QStringLiteral("circle-color")] = QStringLiteral("#51bbd6");
+        circlePaint[QStringLiteral("circle-radius")] = QVariantList {
+            QStringLiteral("step"), QVariantList { QStringLiteral("get"), QStringLiteral("point_count") },
+            15, 100, 20, 1000, 25
+        };
+        circlePaint[QStringLiteral("circle-stroke-color")] = QStringLiteral("#ffffff");
+        circlePaint[QStringLiteral("circle-stroke-width")] = 1;
+
+        QVariantMap circles;
+        circles[QStringLiteral("id")] = clusterLayerId;
+        circles[QStringLiteral("type")] = QStringLiteral("circle");
+        circles[QStringLiteral("source")] = markerSourceId;
+        circles[QStringLiteral("filter")] = hasPointCount();
+        circles[QStringLiteral("paint")] = circlePaint;
+
+        QVariantMap countLayout;
+        countLayout[QStringLiteral("text-field")] = QVariantList { QStringLiteral("get"), QStringLiteral("point_count_abbreviated") };
+        QVariantList font;
+        for (const QString &name : qAsConst(m_clusterFont))
+            font << name;
+        countLayout[QStringLiteral("text-font")] = font;
+        countLayout[QStringLiteral("text-size")] = 12;
+        countLayout[QStringLiteral("text-allow-overlap")] = true;
+
+        QVariantMap count;
+        count[QStringLiteral("id")] = clusterCountLayerId;
+        count[QStringLiteral("type")] = QStringLiteral("symbol");
+        count[QStringLiteral("source")] = markerSourceId;
+        count[QStringLiteral("filter")] = hasPointCount();
+        count[QStringLiteral("layout")] = countLayout;
+
+        changes << QMapboxGLStyleAddLayer::fromParams(circles, before);
+        changes << QMapboxGLStyleAddLayer::fromParams(count, before);
+    }
+
+    return changes;
+}
+
+QList<QSharedPointer<QMapboxGLStyleChange>> QMapboxGLMarkerLayer::removeChanges() const
+{
+    QList<QSharedPointer<QMapboxGLStyleChange>> changes;
+
+    if (m_layerAdded) {
+        if (m_clustering) {
+            changes << QSharedPointer<QMapboxGLStyleChange>(new QMapboxGLStyleRemoveLayer(clusterCountLayerId));
+            changes << QSharedPointer<QMapboxGLStyleChange>(new QMapboxGLStyleRemoveLayer(clusterLayerId));
+        }
+        changes << QSharedPointer<QMapboxGLStyleChange>(new QMapboxGLStyleRemoveLayer(markerLayerId));
+        changes << QSharedPointer<QMapboxGLStyleChange>(new QMapboxGLStyleRemoveSource(markerSourceId));
+    }
+
+    return changes;
+}
+
+QVariantMap QMapboxGLMarkerLayer::statistics() const
+{
+    QVariantMap statistics;
+    statistics[QStringLiteral("markers")] = m_markers.size();
+    statistics[QStringLiteral("points")] = m_pointCount;
+    statistics[QStringLiteral("unmanagedItems")] = m_delegates.size() - m_markers.size();
+    statistics[QStringLiteral("icons")] = m_icons.size();
+    statistics[QStringLiteral("iconBytes")] = iconBytes();
+    statistics[QStringLiteral("sourceUpdates")] = m_sourceUpdates;
+    statistics[QStringLiteral("clustering")] = m_clustering;
+
+    return statistics;
+}
+
+void QMapboxGLMarkerLayer::onItemChanged()
+{
+    update(static_cast<QDeclarativeGeoMapQuickItem *>(sender()));
+}
+
+void QMapboxGLMarkerLayer::onDelegateChanged()
+{
+    QDeclarativeGeoMapQuickItem *item = m_items.value(static_cast<QQuickImage *>(sender()));
+    if (item)
+        update(item);
+}
+
+void QMapboxGLMarkerLayer::update(QDeclarativeGeoMapQuickItem *item)
+{
+    QQuickImage *image = qobject_cast<QQuickImage *>(item->sourceItem());
+    QQuickImage *previous = m_delegates.value(item);
+
+    if (image != previous) {
+        release(item);
+
+        if (previous) {
+            disconnect(previous, nullptr, this, nullptr);
+            m_items.remove(previous);
+        }
+
+        if (image) {
+            connect(image, &QQuickImageBase::sourceChanged, this, &QMapboxGLMarkerLayer::onDelegateChanged);
+            connect(image, &QQuickItem::widthChanged, this, &QMapboxGLMarkerLayer::onDelegateChanged);
+            connect(image, &QQuickItem::heightChanged, this, &QMapboxGLMarkerLayer::onDelegateChanged);
+            connect(image, &QQuickItem::visibleChanged, this, &QMapboxGLMarkerLayer::onDelegateChanged);
+            m_items.insert(image, item);
+        }
+
+        m_delegates[item] = image;
+    }
+
+    // Markers scaled with the map zoom level keep going through QtLocation.
+    QString icon;
+    if (image && qFuzzyIsNull(item->zoomLevel())) {
+        const QSize size(qRound(image->width()), qRound(image->height()));
+        icon = registerIcon(QQmlFile::urlToLocalFileOrQrc(image->source()), size);
+    }
+
+    if (icon.isEmpty()) {
+        release(item);
+        return;
+    }
+
+    // Culling keeps the item out of the scene graph without touching its
+    // visible property, which may well be bound in QML.
+    auto it = m_markers.find(item);
+    if (it == m_markers.end()) {
+        it = m_markers.insert(item, Marker());
+        QQuickItemPrivate::get(item)->setCulled(true);
+    }
+
+    it->icon = icon;
+
+    markDirty();
+}
+
+void QMapboxGLMarkerLayer::release(QDeclarativeGeoMapQuickItem *item)
+{
+    auto it = m_markers.find(item);
+    if (it == m_markers.end())
+        return;
+
+    QQuickItemPrivate::get(item)->setCulled(false);
+    m_markers.erase(it);
+
+    markDirty();
+}
+
+void QMapboxGLMarkerLayer::markDirty()
+{
+    if (m_dirty)
+        return;
+
+    m_dirty = true;
+    emit changed();
+}
+
+QString QMapboxGLMarkerLayer::registerIcon(const QString &fileName, const QSize &size)
+{
+    // Remote images are not fetched here.
+    if (fileName.isEmpty())
+        return QString();
+
+    const QString key = fileName + QLatin1Char('@') + QString::number(size.width())
+            + QLatin1Char('x') + QString::number(size.height());
+
+    // Failed loads are remembered as well, so they are reported once.
+    auto it = m_iconNames.constFind(key);
+    if (it != m_iconNames.constEnd())
+        return it.value();
+
+    QImage image(fileName);
+    if (image.isNull()) {
+        qWarning() << "Failed to load marker icon" << fileName;
+        m_iconNames.insert(key, QString());
+        return QString();
+    }
+
+    if (!size.isEmpty() && size != image.size())
+        image = image.scaled(size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+
+    const QString name = QStringLiteral("QtLocation-marker-") + QString::number(m_icons.size());
+    m_icons.insert(name, image);
+    m_iconNames.insert(key, name);
+    m_pendingIcons << name;
+
+    return name;
+}
+
+QByteArray QMapboxGLMarkerLayer::geoJson() const
+{
+    QJsonArray features;
+
+    for (auto it = m_markers.cbegin(); it != m_markers.cend(); ++it) {
+        QDeclarativeGeoMapQuickItem *item = it.key();
+        const QGeoCoordinate coordinate = item->coordinate();
+        QQuickImage *image = m_delegates.value(item);
+        if (!item->isVisible() || !image || !image->isVisible() || !coordinate.isValid())
+            continue;
+
+        // Symbols are centered on the coordinate, QtLocation puts the
+        // anchor point there instead.
+        const QSize size = m_icons.value(it->icon).size();
+        const QPointF anchor = item->anchorPoint();
+
+        QJsonObject properties;
+        properties[QStringLiteral("icon")] = it->icon;
+        properties[QStringLiteral("offset")] = QJsonArray { size.width() / 2.0 - anchor.x(), size.height() / 2.0 - anchor.y() };
+        properties[QStringLiteral("rotation")] = item->rotation();
+        properties[QStringLiteral("opacity")] = item->mapItemOpacity();
+
+        QJsonObject geometry;
+        geometry[QStringLiteral("type")] = QStringLiteral("Point");
+        geometry[QStringLiteral("coordinates")] = QJsonArray { coordinate.longitude(), coordinate.latitude() };
+
+        QJsonObject feature;
+        feature[QStringLiteral("type")] = QStringLiteral("Feature");
+        feature[QStringLiteral("geometry")] = geometry;
+        feature[QStringLiteral("properties")] = properties;
+
+        features.append(feature);
+    }
+
+    for (const QJsonArray &points : m_points) {
+        for (const QJsonValue &point : points)
+            features.append(point);
+    }
+
+    QJsonObject collection;
+    collection[QStringLiteral("type")] = QStringLiteral("FeatureCollection");
+    collection[QStringLiteral("features")] = features;
+
+    return QJsonDocument(collection).toJson(QJsonDocument::Compact);
+}
@@ -0,0 +1,145 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Copyright (C) 2017 Mapbox, Inc.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the QtLocation module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL3$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or later as published by the Free
+** Software Foundation and appearing in the file LICENSE.GPL included in
+** the packaging of this file. Please review the following information to
+** ensure the GNU General Public License version 2.0 requirements will be
+** met: http://www.gnu.org/licenses/gpl-2.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QMAPBOXGLMARKERLAYER_P_H
+#define QMAPBOXGLMARKERLAYER_P_H
+
+#include <QtCore/QHash>
+#include <QtCore/QJsonArray>
+#include <QtCore/QList>
+#include <QtCore/QObject>
+#include <QtCore/QPointer>
+#include <QtCore/QSharedPointer>
+#include <QtCore/QSize>
+#include <QtCore/QStringList>
+#include <QtCore/QVariantMap>
+#include <QtGui/QImage>
+
+class QDeclarativeGeoMapQuickItem;
+class QMapboxGLStyleChange;
+class QQuickImage;
+
+// Draws MapQuickItems whose delegate is a plain Image as a single symbol
+// layer fed by a shared GeoJSON source. Every distinct icon is registered
+// once with addImage and the items are culled while the layer draws
+// them. Items it cannot draw are left to QtLocation. Points can also be
+// given as GeoJSON, which needs no QQuickItem per point at all. Optionally
+// the source clusters the markers, drawn as circles with a point count.
+// The count is a text label, so the style has to define glyphs with the
+// cluster font stack.
+class QMapboxGLMarkerLayer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit QMapboxGLMarkerLayer(QObject *parent = nullptr);
+    ~QMapboxGLMarkerLayer();
+
+    void setAllowOverlap(bool allow);
+
+    // Only takes effect when the layer is added to the style.
+    void setClustering(bool enabled, int radius, int maxZoom);
+    void setClusterFont(const QStringList &fontStack);
+
+    // Point features of a GeoJSON Feature or FeatureCollection drawn with
+    // iconFileName. Their rotation and opacity properties are kept.
+    void setPoints(const QObject *owner, const QByteArray &geoJson, const QString &iconFileName);
+    void removePoints(const QObject *owner);
+
+    void addItem(QDeclarativeGeoMapQuickItem *item);
+    void removeItem(QDeclarativeGeoMapQuickItem *item);
+
+    int count() const;
+    qint64 iconBytes() const;
+
+    // Everything has to be added again after a style reload.
+    void reset();
+
+    // Pending icons, the layer and one source update covering every
+    // marker change since the last call.
+    bool isDirty() const;
+    QList<QSharedPointer<QMapboxGLStyleChange>> takeChanges(const QString &before);
+    QList<QSharedPointer<QMapboxGLStyleChange>> removeChanges() const;
+
+    // What takeChanges() added so far, for another map showing the same
+    // markers. Leaves the pending changes alone.
+    QList<QSharedPointer<QMapboxGLStyleChange>> addChanges(const QString &before) const;
+
+    QVariantMap statistics() const;
+
+Q_SIGNALS:
+    void changed();
+
+private Q_SLOTS:
+    void onItemChanged();
+    void onDelegateChanged();
+
+private:
+    struct Marker {
+        QString icon;
+    };
+
+    void update(QDeclarativeGeoMapQuickItem *item);
+    void release(QDeclarativeGeoMapQuickItem *item);
+    void markDirty();
+    QString registerIcon(const QString &fileName, const QSize &size);
+    QByteArray geoJson() const;
+    QSharedPointer<QMapboxGLStyleChange> sourceChange() const;
+    QList<QSharedPointer<QMapboxGLStyleChange>> layerChanges(const QString &before) const;
+
+    bool m_allowOverlap = false;
+    bool m_clustering = false;
+    int m_clusterRadius = 50;
+    int m_clusterMaxZoom = 14;
+    QStringList m_clusterFont;
+
+    QHash<QDeclarativeGeoMapQuickItem *, QPointer<QQuickImage>> m_delegates;
+    QHash<QQuickImage *, QDeclarativeGeoMapQuickItem *> m_items;
+    QHash<QDeclarativeGeoMapQuickItem *, Marker> m_markers;
+    QHash<const QObject *, QJsonArray> m_points;
+    int m_pointCount = 0;
+
+    QHash<QString, QString> m_iconNames;
+    QHash<QString, QImage> m_icons;
+    QStringList m_pendingIcons;
+
+    bool m_layerAdded = false;
+    bool m_dirty = false;
+    quint64 m_sourceUpdates = 0;
+};
+
+#endif // QMAPBOXGLMARKERLAYER_P_H
@@ -0,0 +1,769 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Copyright (C) 2017 Mapbox, Inc.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the QtLocation module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL3$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or later as published by the Free
+** Software Foundation and appearing in the file LICENSE.GPL included in
+** the packaging of this file. Please review the following information to
+** ensure the GNU General Public License version 2.0 requirements will be
+** met: http://www.gnu.org/licenses/gpl-2.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qmapboxglofflinedownloader.h"
+#include "qmapboxglstyleresources_p.h"
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QDateTime>
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QUrl>
+#include <QtNetwork/QNetworkReply>
+#include <QtNetwork/QNetworkRequest>
+#include <QtSql/QSqlQuery>
+
+#include <QDebug>
+
+#include <cmath>
+
+namespace {
+
+// Failed requests are tried this many times before being given up on.
+const int maximumAttempts = 3;
+
+// Resources are looked for in the database in slices, which keeps the
+// number of round trips to its thread down when resuming a large region.
+const int maximumLookupsPerPump = 256;
+
+// Smaller resources do not gain enough from compression to be worth it.
+const int minimumCompressedSize = 256;
+
+// Stored compressed only when this much smaller.
+const double maximumCompressionRatio = 0.9;
+
+// Web Mercator stops short of the poles.
+const double maximumLatitude = 85.0511287798;
+
+int longitudeToTileX(double longitude, int z)
+{
+    const int n = 1 << z;
+    return qBound(0, int(std::floor((longitude + 180.0) / 360.0 * n)), n - 1);
+}
+
+int latitudeToTileY(double latitude, int z)
+{
+    const int n = 1 << z;
+    const double lat = qBound(-maximumLatitude, latitude, maximumLatitude) * M_PI / 180.0;
+    const double y = (1.0 - std::log(std::tan(lat) + 1.0 / std::cos(lat)) / M_PI) / 2.0;
+    return qBound(0, int(std::floor(y * n)), n - 1);
+}
+
+// Same rounding as Mapbox GL: source tiles are picked for the zoom level
+// of 512 pixel tiles, raster tiles snap to the nearest level.
+int coveringZoom(double zoom, bool raster, int tileSize)
+{
+    zoom += std::log2(512.0 / tileSize);
+    return raster ? int(std::round(zoom)) : int(std::floor(zoom));
+}
+
+QString replaceTileTokens(QString url, int z, int x, int y, int pixelRatio)
+{
+    QString quadKey;
+    for (int i = z; i > 0; --i) {
+        const int mask = 1 << (i - 1);
+        quadKey += QLatin1Char('0' + ((x & mask) ? 1 : 0) + ((y & mask) ? 2 : 0));
+    }
+
+    url.replace(QStringLiteral("{z}"), QString::number(z));
+    url.replace(QStringLiteral("{x}"), QString::number(x));
+    url.replace(QStringLiteral("{y}"), QString::number(y));
+    url.replace(QStringLiteral("{quadkey}"), quadKey);
+    url.replace(QStringLiteral("{prefix}"), QString::number(x % 16, 16) + QString::number(y % 16, 16));
+    url.replace(QStringLiteral("{ratio}"), pixelRatio > 1 ? QStringLiteral("@2x") : QString());
+
+    return url;
+}
+
+bool isImage(const QByteArray &data)
+{
+    return data.startsWith("\x89PNG") || data.startsWith("\xff\xd8\xff")
+            || (data.startsWith("RIFF") && data.mid(8, 4) == "WEBP");
+}
+
+bool isHttpUrl(const QString &url)
+{
+    return url.startsWith(QStringLiteral("http://")) || url.startsWith(QStringLiteral("https://"));
+}
+
+qint64 secondsSinceEpoch(const QDateTime &dateTime)
+{
+    return dateTime.isValid() ? dateTime.toMSecsSinceEpoch() / 1000 : 0;
+}
+
+} // namespace
+
+QMapboxGLOfflineDownloader::QMapboxGLOfflineDownloader(const QMapboxGLSettings &settings, QObject *parent)
+    : QObject(parent)
+    , m_settings(settings)
+{
+    m_databaseThread.setObjectName(QStringLiteral("QMapboxGLOfflineDownloader"));
+    m_databaseWorker.moveToThread(&m_databaseThread);
+
+    connect(&m_network, &QNetworkAccessManager::finished, this, &QMapboxGLOfflineDownloader::onReplyFinished);
+}
+
+QMapboxGLOfflineDownloader::~QMapboxGLOfflineDownloader()
+{
+    cancel();
+    stopDatabase();
+}
+
+void QMapboxGLOfflineDownloader::setConcurrency(int requests)
+{
+    m_concurrency = qMax(1, requests);
+}
+
+void QMapboxGLOfflineDownloader::setCacheTuning(const QMapboxGLCacheDatabase::Tuning &tuning)
+{
+    m_tuning = tuning;
+}
+
+void QMapboxGLOfflineDownloader::setCompressionLevel(int level)
+{
+    m_compressionLevel = qBound(0, level, 9);
+}
+
+bool QMapboxGLOfflineDownloader::start(const Region &region)
+{
+    if (m_running || !region.bounds.isValid() || region.minZoom > region.maxZoom)
+        return false;
+
+    if (!isHttpUrl(region.styleUrl)) {
+        qWarning() << "Offline regions need an http or https style URL, got" << region.styleUrl;
+        return false;
+    }
+
+    m_region = region;
+    m_resources.clear();
+    m_pyramids.clear();
+    m_downloads.clear();
+    m_seen.clear();
+    m_sources.clear();
+    m_lookingUp = false;
+    m_storing = 0;
+    m_total = m_completed = m_cached = m_failed = m_bytes = m_storedBytes = 0;
+    m_running = true;
+    m_timer.start();
+
+    enqueue(Style, region.styleUrl);
+
+    m_databaseThread.start(QThread::LowPriority);
+    QMetaObject::invokeMethod(&m_databaseWorker, [this] {
+        const bool opened = openDatabase();
+        QMetaObject::invokeMethod(this, [this, opened] { onDatabaseOpened(opened); }, Qt::QueuedConnection);
+    });
+
+    return true;
+}
+
+void QMapboxGLOfflineDownloader::cancel()
+{
+    if (!m_running)
+        return;
+
+    m_running = false;
+
+    const QList<QNetworkReply *> replies = m_pending.keys();
+    m_pending.clear();
+    for (QNetworkReply *reply : replies) {
+        reply->abort();
+        reply->deleteLater();
+    }
+
+    m_downloads.clear();
+    stopDatabase();
+
+    emit finished(false);
+}
+
+bool QMapboxGLOfflineDownloader::isRunning() const
+{
+    return m_running;
+}
+
+qint64 QMapboxGLOfflineDownloader::tileCount(const QGeoRectangle &bounds, int minZoom, int maxZoom)
+{
+    qint64 count = 0;
+    for (int z = qMax(0, minZoom); z <= maxZoom; ++z) {
+        TilePyramid pyramid;
+        pyramid.setZoom(z, bounds);
+        count += qint64(pyramid.x1 - pyramid.x0 + 1) * (pyramid.y1 - pyramid.y0 + 1);
+    }
+
+    return count;
+}
+
+QRect QMapboxGLOfflineDownloader::tileRange(const QGeoRectangle &bounds, int z)
+{
+    TilePyramid pyramid;
+    pyramid.setZoom(z, bounds);
+
+    return QRect(QPoint(pyramid.x0, pyramid.y0), QPoint(pyramid.x1, pyramid.y1));
+}
+
+QString QMapboxGLOfflineDownloader::regionDefinition(const Region &region)
+{
+    // Same definition Mapbox GL writes for a tile pyramid region, so the
+    // region shows up among its own and a restart finds it again.
+    const QJsonObject definition {
+        { QStringLiteral("style_url"), region.styleUrl },
+        { QStringLiteral("bounds"), QJsonArray {
+            region.bounds.bottomRight().latitude(), region.bounds.topLeft().longitude(),
+            region.bounds.topLeft().latitude(), region.bounds.bottomRight().longitude() } },
+        { QStringLiteral("min_zoom"), region.minZoom },
+        { QStringLiteral("max_zoom"), region.maxZoom },
+        { QStringLiteral("pixel_ratio"), region.pixelRatio }
+    };
+
+    return QString::fromUtf8(QJsonDocument(definition).toJson(QJsonDocument::Compact));
+}
+
+QVariantMap QMapboxGLOfflineDownloader::statistics() const
+{
+    QVariantMap statistics;
+    statistics[QStringLiteral("total")] = m_total;
+    statistics[QStringLiteral("completed")] = m_completed;
+    statistics[QStringLiteral("cached")] = m_cached;
+    statistics[QStringLiteral("failed")] = m_failed;
+    statistics[QStringLiteral("bytes")] = m_bytes;
+    statistics[QStringLiteral("storedBytes")] = m_storedBytes;
+    statistics[QStringLiteral("estimatedBytes")] = m_completed ? m_bytes * m_total / m_completed : 0;
+    statistics[QStringLiteral("elapsed")] = m_timer.isValid() ? m_timer.elapsed() : 0;
+
+    return statistics;
+}
+
+void QMapboxGLOfflineDownloader::TilePyramid::setZoom(int zoom, const QGeoRectangle &bounds)
+{
+    z = zoom;
+
+    const int n = 1 << z;
+    x0 = longitudeToTileX(bounds.topLeft().longitude(), z);
+    x1 = longitudeToTileX(bounds.bottomRight().longitude(), z);
+    if (x1 < x0)
+        x1 += n;    // Across the antimeridian, wrapped when requested.
+
+    y0 = latitudeToTileY(bounds.topLeft().latitude(), z);
+    y1 = latitudeToTileY(bounds.bottomRight().latitude(), z);
+
+    x = x0;
+    y = y0;
+}
+
+bool QMapboxGLOfflineDownloader::TilePyramid::next(Resource *tile, const QGeoRectangle &bounds)
+{
+    if (z > maxZoom)
+        return false;
+
+    const int n = 1 << z;
+
+    tile->kind = Tile;
+    tile->urlTemplate = urlTemplate;
+    tile->pixelRatio = pixelRatio;
+    tile->z = z;
+    tile->x = x % n;
+    tile->y = tms ? n - 1 - y : y;
+    tile->url = replaceTileTokens(urlTemplate, tile->z, tile->x, tile->y, pixelRatio);
+
+    if (++x > x1) {
+        x = x0;
+        if (++y > y1)
+            setZoom(z + 1, bounds);
+    }
+
+    return true;
+}
+
+bool QMapboxGLOfflineDownloader::takeNext(Resource *resource)
+{
+    // Style level resources first, they lead to more work.
+    if (!m_resources.isEmpty()) {
+        *resource = m_resources.dequeue();
+        return true;
+    }
+
+    while (!m_pyramids.isEmpty()) {
+        if (m_pyramids.first().next(resource, m_region.bounds))
+            return true;
+        m_pyramids.removeFirst();
+    }
+
+    return false;
+}
+
+void QMapboxGLOfflineDownloader::onDatabaseOpened(bool opened)
+{
+    if (!m_running)
+        return;
+
+    if (!opened) {
+        qWarning() << "Offline region" << m_region.name << "could not be recorded in" << m_settings.cacheDatabasePath();
+        cancel();
+        return;
+    }
+
+    pump();
+}
+
+void QMapboxGLOfflineDownloader::pump()
+{
+    if (!m_running)
+        return;
+
+    while (m_pending.size() < m_concurrency && !m_downloads.isEmpty()) {
+        const Resource resource = m_downloads.dequeue();
+
+        QNetworkRequest request((QUrl(resource.url)));
+        request.setAttribute(QNetworkRequest::FollowRedirectsAttribute, true);
+        m_pending.insert(m_network.get(request), resource);
+    }
+
+    // The next slice is looked up while the previous one downloads.
+    if (!m_lookingUp && m_downloads.size() < m_concurrency) {
+        QVector<Resource> resources;
+        Resource resource;
+        while (resources.size() < maximumLookupsPerPump && takeNext(&resource))
+            resources.append(resource);
+
+        if (!resources.isEmpty()) {
+            m_lookingUp = true;
+            QMetaObject::invokeMethod(&m_databaseWorker, [this, resources] { lookupAll(resources); });
+        }
+    }
+
+    const qint64 estimatedBytes = m_completed ? m_bytes * m_total / m_completed : 0;
+    emit progress(m_completed, m_total, m_bytes, estimatedBytes);
+
+    if (!m_lookingUp && !m_storing && m_pending.isEmpty() && m_downloads.isEmpty()
+            && m_resources.isEmpty() && m_pyramids.isEmpty())
+        finish();
+}
+
+void QMapboxGLOfflineDownloader::onLookedUp(const QVector<QPair<Resource, QByteArray>> &cached, const QVector<Resource> &missing)
+{
+    m_lookingUp = false;
+
+    for (const auto &resource : cached)
+        complete(resource.first, resource.second, true);
+
+    for (const Resource &resource : missing) {
+        if (isHttpUrl(resource.url)) {
+            m_downloads.enqueue(resource);
+        } else {
+            qWarning() << "Offline download skipped" << resource.url;
+            ++m_failed;
+            ++m_completed;
+        }
+    }
+
+    pump();
+}
+
+void QMapboxGLOfflineDownloader::onReplyFinished(QNetworkReply *reply)
+{
+    reply->deleteLater();
+
+    auto it = m_pending.find(reply);
+    if (it == m_pending.end())
+        return;
+
+    Resource resource = it.value();
+    m_pending.erase(it);
+
+    const int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    const bool noContent = status == 204 || (status == 404 && resource.kind == Tile);
+
+    if (reply->error() != QNetworkReply::NoError && !noContent) {
+        if (++resource.attempts < maximumAttempts) {
+            m_downloads.enqueue(resource);
+        } else {
+            qWarning() << "Offline download failed:" << resource.url << reply->errorString();
+            ++m_failed;
+            ++m_completed;
+        }
+        pump();
+        return;
+    }
+
+    const QByteArray data = noContent ? QByteArray() : reply->readAll();
+    const Validity freshness = validity(reply);
+
+    ++m_storing;
+    QMetaObject::invokeMethod(&m_databaseWorker, [this, resource, freshness, data] {
+        int size = 0;
+        const bool stored = store(resource, freshness, data, &size);
+        QMetaObject::invokeMethod(this, [this, resource, data, stored, size] {
+            if (stored)
+                m_storedBytes += size;
+            onStored(resource, data, stored);
+        }, Qt::QueuedConnection);
+    });
+
+    pump();
+}
+
+void QMapboxGLOfflineDownloader::onStored(const Resource &resource, const QByteArray &data, bool stored)
+{
+    --m_storing;
+
+    if (stored) {
+        complete(resource, data, false);
+    } else {
+        qWarning() << "Offline download could not be stored:" << resource.url;
+        ++m_failed;
+        ++m_completed;
+    }
+
+    pump();
+}
+
+void QMapboxGLOfflineDownloader::complete(const Resource &resource, const QByteArray &data, bool cached)
+{
+    ++m_completed;
+    m_bytes += data.size();
+    if (cached)
+        ++m_cached;
+
+    switch (resource.kind) {
+    case Style:
+        parseStyle(data);
+        break;
+    case Source:
+        parseSource(data, m_sources.value(resource.url));
+        break;
+    default:
+        break;
+    }
+}
+
+void QMapboxGLOfflineDownloader::enqueue(Kind kind, const QString &url)
+{
+    if (m_seen.contains(url))
+        return;
+
+    m_seen.insert(url);
+
+    Resource resource;
+    resource.kind = kind;
+    resource.url = url;
+    m_resources.enqueue(resource);
+    ++m_total;
+}
+
+void QMapboxGLOfflineDownloader::parseStyle(const QByteArray &data)
+{
+    const QJsonObject style = QJsonDocument::fromJson(data).object();
+    const bool highDpi = m_region.pixelRatio > 1.0;
+
+    const QJsonObject sources = style.value(QStringLiteral("sources")).toObject();
+    for (auto it = sources.constBegin(); it != sources.constEnd(); ++it) {
+        const QJsonObject source = it.value().toObject();
+        const QString type = source.value(QStringLiteral("type")).toString();
+        if (type != QStringLiteral("vector") && type != QStringLiteral("raster") && type != QStringLiteral("raster-dem"))
+            continue;
+
+        if (source.contains(QStringLiteral("url"))) {
+            const QString url = source.value(QStringLiteral("url")).toString();
+            m_sources.insert(url, source);
+            enqueue(Source, url);
+        } else {
+            enqueueTiles(source, source);
+        }
+    }
+
+    const QString sprite = style.value(QStringLiteral("sprite")).toString();
+    if (!sprite.isEmpty()) {
+        enqueue(SpriteJSON, QMapboxGLStyleResources::spriteUrl(sprite, QStringLiteral(".json"), highDpi));
+        enqueue(SpriteImage, QMapboxGLStyleResources::spriteUrl(sprite, QStringLiteral(".png"), highDpi));
+    }
+
+    // Every font stack named in the layers, in all 256 glyph ranges as
+    // there is no telling which characters the labels will use.
+    const QString glyphs = style.value(QStringLiteral("glyphs")).toString();
+    if (glyphs.isEmpty())
+        return;
+
+    const QStringList fontStacks = QMapboxGLStyleResources::fontStacks(style);
+    for (const QString &fontStack : fontStacks) {
+        for (int start = 0; start < 65536; start += 256)
+            enqueue(Glyphs, QMapboxGLStyleResources::glyphsUrl(glyphs, fontStack, start));
+    }
+}
+
+void QMapboxGLOfflineDownloader::parseSource(const QByteArray &data, const QJsonObject &source)
+{
+    enqueueTiles(QJsonDocument::fromJson(data).object(), source);
+}
+
+void QMapboxGLOfflineDownloader::enqueueTiles(const QJsonObject &tileJson, const QJsonObject &source)
+{
+    const QJsonArray tiles = tileJson.value(QStringLiteral("tiles")).toArray();
+    if (tiles.isEmpty())
+        return;
+
+    const bool raster = source.value(QStringLiteral("type")).toString() != QStringLiteral("vector");
+    const int tileSize = source.value(QStringLiteral("tileSize")).toInt(512);
+
+    TilePyramid pyramid;
+    pyramid.urlTemplate = tiles.first().toString();
+    pyramid.tms = tileJson.value(QStringLiteral("scheme")).toString() == QStringLiteral("tms");
+    pyramid.pixelRatio = pyramid.urlTemplate.contains(QStringLiteral("{ratio}")) && m_region.pixelRatio > 1.0 ? 2 : 1;
+    pyramid.minZoom = qMax(coveringZoom(m_region.minZoom, raster, tileSize), tileJson.value(QStringLiteral("minzoom")).toInt(0));
+    pyramid.maxZoom = qMin(coveringZoom(m_region.maxZoom, raster, tileSize), tileJson.value(QStringLiteral("maxzoom")).toInt(22));
+
+    if (pyramid.minZoom > pyramid.maxZoom)
+        return;
+
+    pyramid.setZoom(pyramid.minZoom, m_region.bounds);
+    m_pyramids.append(pyramid);
+    m_total += tileCount(m_region.bounds, pyramid.minZoom, pyramid.maxZoom);
+}
+
+QMapboxGLOfflineDownloader::Validity QMapboxGLOfflineDownloader::validity(QNetworkReply *reply)
+{
+    const QDateTime now = QDateTime::currentDateTimeUtc();
+    const QString cacheControl = QString::fromLatin1(reply->rawHeader("Cache-Control"));
+
+    Validity validity;
+    validity.accessed = secondsSinceEpoch(now);
+
+    validity.expires = QVariant(QVariant::LongLong);
+    const int maxAge = cacheControl.indexOf(QStringLiteral("max-age="));
+    if (maxAge >= 0)
+        validity.expires = validity.accessed + cacheControl.mid(maxAge + 8).section(QLatin1Char(','), 0, 0).toLongLong();
+    else if (reply->header(QNetworkRequest::ExpiresHeader).isValid())
+        validity.expires = secondsSinceEpoch(reply->header(QNetworkRequest::ExpiresHeader).toDateTime());
+
+    validity.modified = QVariant(QVariant::LongLong);
+    if (reply->header(QNetworkRequest::LastModifiedHeader).isValid())
+        validity.modified = secondsSinceEpoch(reply->header(QNetworkRequest::LastModifiedHeader).toDateTime());
+
+    validity.etag = reply->hasRawHeader("ETag") ? QVariant(QString::fromLatin1(reply->rawHeader("ETag"))) : QVariant(QVariant::String);
+    validity.mustRevalidate = cacheControl.contains(QStringLiteral("must-revalidate"))
+            || cacheControl.contains(QStringLiteral("no-cache"));
+
+    return validity;
+}
+
+bool QMapboxGLOfflineDownloader::openDatabase()
+{
+    m_database.reset(new QMapboxGLCacheDatabase(m_settings.cacheDatabasePath()));
+    if (m_database->open(m_tuning) && m_database->ensureSchema()) {
+        m_regionId = m_database->region(regionDefinition(m_region), m_region.name);
+        if (m_regionId >= 0)
+            return true;
+    }
+
+    m_database.reset();
+    return false;
+}
+
+void QMapboxGLOfflineDownloader::lookupAll(const QVector<Resource> &resources)
+{
+    QVector<QPair<Resource, QByteArray>> cached;
+    QVector<Resource> missing;
+
+    // One transaction for the whole slice, instead of one per link.
+    QSqlDatabase db = m_database->database();
+    db.transaction();
+
+    for (const Resource &resource : resources) {
+        QByteArray data;
+        if (lookup(resource, &data))
+            cached.append(qMakePair(resource, data));
+        else
+            missing.append(resource);
+    }
+
+    db.commit();
+
+    QMetaObject::invokeMethod(this, [this, cached, missing] { onLookedUp(cached, missing); }, Qt::QueuedConnection);
+}
+
+bool QMapboxGLOfflineDownloader::lookup(const Resource &resource, QByteArray *data)
+{
+    QSqlQuery query(m_database->database());
+
+    if (resource.kind == Tile) {
+        query.prepare(QStringLiteral("SELECT id, data, compressed FROM tiles "
+                "WHERE url_template = ? AND pixel_ratio = ? AND z = ? AND x = ? AND y = ?"));
+        query.addBindValue(resource.urlTemplate);
+        query.addBindValue(resource.pixelRatio);
+        query.addBindValue(resource.z);
+        query.addBindValue(resource.x);
+        query.addBindValue(resource.y);
+    } else {
+        query.prepare(QStringLiteral("SELECT id, data, compressed FROM resources WHERE url = ?"));
+        query.addBindValue(resource.url);
+    }
+
+    if (!query.exec() || !query.next())
+        return false;
+
+    // Style level resources are parsed and have to be inflated when Mapbox
+    // GL stored them compressed, tiles are never looked into.
+    *data = query.value(1).toByteArray();
+    if (resource.kind != Tile && query.value(2).toBool()) {
+        *data = QMapboxGLCacheDatabase::inflate(*data);
+        if (data->isEmpty())
+            return false;
+    }
+
+    link(resource.kind == Tile, query.value(0).toLongLong());
+
+    return true;
+}
+
+qint64 QMapboxGLOfflineDownloader::rowId(const Resource &resource)
+{
+    QSqlQuery query(m_database->database());
+
+    if (resource.kind == Tile) {
+        query.prepare(QStringLiteral("SELECT id FROM tiles "
+                "WHERE url_template = ? AND pixel_ratio = ? AND z = ? AND x = ? AND y = ?"));
+        query.addBindValue(resource.urlTemplate);
+        query.addBindValue(resource.pixelRatio);
+        query.addBindValue(resource.z);
+        query.addBindValue(resource.x);
+        query.addBindValue(resource.y);
+    } else {
+        query.prepare(QStringLiteral("SELECT id FROM resources WHERE url = ?"));
+        query.addBindValue(resource.url);
+    }
+
+    if (!query.exec() || !query.next())
+        return -1;
+
+    return query.value(0).toLongLong();
+}
+
+bool QMapboxGLOfflineDownloader::store(const Resource &resource, const Validity &validity, const QByteArray &data, int *size)
+{
+    // Compressed the way Mapbox GL compresses its own entries, which it
+    // inflates when reading them back. Images are compressed already.
+    QByteArray stored = data;
+    bool compressed = false;
+    if (m_compressionLevel && data.size() >= minimumCompressedSize && !isImage(data)) {
+        const QByteArray deflated = QMapboxGLCacheDatabase::deflate(data, m_compressionLevel);
+        if (!deflated.isEmpty() && deflated.size() <= data.size() * maximumCompressionRatio) {
+            stored = deflated;
+            compressed = true;
+        }
+    }
+
+    const QVariant blob = stored.isNull() ? QVariant(QVariant::ByteArray) : QVariant(stored);
+    const QString table = resource.kind == Tile ? QStringLiteral("tiles") : QStringLiteral("resources");
+
+    // Mapbox GL may have stored the same resource since it was looked up,
+    // or stored it unreadably. Its row is refreshed then, which keeps the
+    // links other regions have to it.
+    const qint64 existing = rowId(resource);
+
+    QSqlQuery query(m_database->database());
+    if (existing >= 0) {
+        query.prepare(QStringLiteral("UPDATE %1 SET expires = ?, modified = ?, etag = ?, data = ?, compressed = ?,"
+                " accessed = ?, must_revalidate = ? WHERE id = ?").arg(table));
+    } else if (resource.kind == Tile) {
+        query.prepare(QStringLiteral("INSERT INTO tiles (url_template, pixel_ratio, z, x, y, expires, modified, etag,"
+                " data, compressed, accessed, must_revalidate) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)"));
+        query.addBindValue(resource.urlTemplate);
+        query.addBindValue(resource.pixelRatio);
+        query.addBindValue(resource.z);
+        query.addBindValue(resource.x);
+        query.addBindValue(resource.y);
+    } else {
+        query.prepare(QStringLiteral("INSERT INTO resources (url, kind, expires, modified, etag,"
+                " data, compressed, accessed, must_revalidate) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?)"));
+        query.addBindValue(resource.url);
+        query.addBindValue(int(resource.kind));
+    }
+
+    query.addBindValue(validity.expires);
+    query.addBindValue(validity.modified);
+    query.addBindValue(validity.etag);
+    query.addBindValue(blob);
+    query.addBindValue(compressed);
+    query.addBindValue(validity.accessed);
+    query.addBindValue(validity.mustRevalidate);
+    if (existing >= 0)
+        query.addBindValue(existing);
+
+    if (!query.exec())
+        return false;
+
+    *size = stored.size();
+    link(resource.kind == Tile, existing >= 0 ? existing : query.lastInsertId().toLongLong());
+    return true;
+}
+
+void QMapboxGLOfflineDownloader::link(bool tile, qint64 id)
+{
+    QSqlQuery query(m_database->database());
+    query.prepare(tile ? QStringLiteral("INSERT OR IGNORE INTO region_tiles (region_id, tile_id) VALUES (?, ?)")
+                       : QStringLiteral("INSERT OR IGNORE INTO region_resources (region_id, resource_id) VALUES (?, ?)"));
+    query.addBindValue(m_regionId);
+    query.addBindValue(id);
+    query.exec();
+}
+
+void QMapboxGLOfflineDownloader::stopDatabase()
+{
+    if (!m_databaseThread.isRunning())
+        return;
+
+    // The connection belongs to the thread that opened it.
+    QMetaObject::invokeMethod(&m_databaseWorker, [this] { m_database.reset(); }, Qt::BlockingQueuedConnection);
+    m_databaseThread.quit();
+    m_databaseThread.wait();
+
+    // Whatever the thread finished in the meantime is of no use anymore.
+    QCoreApplication::removePostedEvents(this, QEvent::MetaCall);
+    m_lookingUp = false;
+    m_storing = 0;
+}
+
+void QMapboxGLOfflineDownloader::finish()
+{
+    m_running = false;
+    stopDatabase();
+
+    qInfo("MapboxGL offline region \"%s\": %lld of %lld resources, %lld already cached, %lld failed, %lld bytes in %lld ms.",
+          qPrintable(m_region.name), m_completed, m_total, m_cached, m_failed, m_bytes, m_timer.elapsed());
+
+    emit finished(m_failed == 0);
+}
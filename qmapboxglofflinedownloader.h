@@ -0,0 +1,226 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Copyright (C) 2017 Mapbox, Inc.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the QtLocation module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL3$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or later as published by the Free
+** Software Foundation and appearing in the file LICENSE.GPL included in
+** the packaging of this file. Please review the following information to
+** ensure the GNU General Public License version 2.0 requirements will be
+** met: http://www.gnu.org/licenses/gpl-2.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QMAPBOXGLOFFLINEDOWNLOADER_H
+#define QMAPBOXGLOFFLINEDOWNLOADER_H
+
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QHash>
+#include <QtCore/QJsonObject>
+#include <QtCore/QObject>
+#include <QtCore/QPair>
+#include <QtCore/QQueue>
+#include <QtCore/QRect>
+#include <QtCore/QScopedPointer>
+#include <QtCore/QSet>
+#include <QtCore/QThread>
+#include <QtCore/QVariantMap>
+#include <QtCore/QVector>
+#include <QtNetwork/QNetworkAccessManager>
+#include <QtPositioning/QGeoRectangle>
+
+#include <QMapboxGL>
+
+#include "qmapboxglcachedatabase_p.h"
+
+class QNetworkReply;
+
+// Downloads the style, sources, sprites, glyphs and tiles needed to show
+// a region into the cache database, where Mapbox GL finds them without
+// going to the network.
+//
+// The region is recorded the way Mapbox GL records its own offline
+// regions, which keeps the downloaded resources out of the ambient cache
+// eviction. Resources already in the database are not downloaded again,
+// so starting the same region after an interruption resumes it. The
+// database is only used from a thread of its own, the network from the
+// thread the downloader lives in.
+//
+// Only http and https resources are handled; mapbox:// URLs need the
+// canonicalization Mapbox GL does internally and are reported as failed.
+class QMapboxGLOfflineDownloader : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Region {
+        QString styleUrl;
+        QGeoRectangle bounds;
+        double minZoom = 0.0;
+        double maxZoom = 14.0;
+        qreal pixelRatio = 1.0;
+        QString name;
+    };
+
+    explicit QMapboxGLOfflineDownloader(const QMapboxGLSettings &, QObject *parent = nullptr);
+    ~QMapboxGLOfflineDownloader();
+
+    void setConcurrency(int requests);
+    void setCacheTuning(const QMapboxGLCacheDatabase::Tuning &tuning);
+
+    // zlib level resources are stored with, 0 stores them as received.
+    void setCompressionLevel(int level);
+
+    // Opening the database happens later on its thread, when that fails
+    // the download finishes unsuccessfully.
+    bool start(const Region &region);
+    void cancel();
+    bool isRunning() const;
+
+    // Tiles a region needs per source, before the sources are known.
+    static qint64 tileCount(const QGeoRectangle &bounds, int minZoom, int maxZoom);
+
+    // Tiles covering the bounds at one zoom level. Past the antimeridian the
+    // range goes beyond the last column and wraps around.
+    static QRect tileRange(const QGeoRectangle &bounds, int z);
+
+    // Region definition in the format Mapbox GL stores.
+    static QString regionDefinition(const Region &region);
+
+    QVariantMap statistics() const;
+
+Q_SIGNALS:
+    // The total grows while the style and its sources are being read.
+    void progress(qint64 completed, qint64 total, qint64 bytes, qint64 estimatedBytes);
+    void finished(bool complete);
+
+private Q_SLOTS:
+    void pump();
+    void onReplyFinished(QNetworkReply *reply);
+    void onDatabaseOpened(bool opened);
+
+private:
+    // Resource kinds as stored by Mapbox GL.
+    enum Kind {
+        Style = 1,
+        Source = 2,
+        Tile = 3,
+        Glyphs = 4,
+        SpriteImage = 5,
+        SpriteJSON = 6
+    };
+
+    struct Resource {
+        Kind kind;
+        QString url;
+        QString urlTemplate;
+        int pixelRatio = 1;
+        int z = 0;
+        int x = 0;
+        int y = 0;
+        int attempts = 0;
+    };
+
+    // Freshness of a downloaded resource, as Mapbox GL stores it.
+    struct Validity {
+        QVariant expires;
+        QVariant modified;
+        QVariant etag;
+        qint64 accessed = 0;
+        bool mustRevalidate = false;
+    };
+
+    // Tiles of one source, generated as they are requested since a large
+    // region holds millions of them.
+    struct TilePyramid {
+        QString urlTemplate;
+        int pixelRatio = 1;
+        bool tms = false;
+        int minZoom = 0;
+        int maxZoom = 0;
+        int z = 0;
+        int x = 0;
+        int y = 0;
+        int x0 = 0, x1 = 0, y0 = 0, y1 = 0;
+
+        void setZoom(int zoom, const QGeoRectangle &bounds);
+        bool next(Resource *tile, const QGeoRectangle &bounds);
+    };
+
+    bool takeNext(Resource *resource);
+    void enqueue(Kind kind, const QString &url);
+    void enqueueTiles(const QJsonObject &tileJson, const QJsonObject &source);
+    void parseStyle(const QByteArray &data);
+    void parseSource(const QByteArray &data, const QJsonObject &source);
+    void complete(const Resource &resource, const QByteArray &data, bool cached);
+    void onLookedUp(const QVector<QPair<Resource, QByteArray>> &cached, const QVector<Resource> &missing);
+    void onStored(const Resource &resource, const QByteArray &data, bool stored);
+    void stopDatabase();
+    void finish();
+
+    static Validity validity(QNetworkReply *reply);
+
+    // On the database thread.
+    bool openDatabase();
+    void lookupAll(const QVector<Resource> &resources);
+    bool lookup(const Resource &resource, QByteArray *data);
+    qint64 rowId(const Resource &resource);
+    bool store(const Resource &resource, const Validity &validity, const QByteArray &data, int *size);
+    void link(bool tile, qint64 id);
+
+    QMapboxGLSettings m_settings;
+    QMapboxGLCacheDatabase::Tuning m_tuning;
+    QScopedPointer<QMapboxGLCacheDatabase> m_database;
+    QThread m_databaseThread;
+    QObject m_databaseWorker;
+    QNetworkAccessManager m_network;
+    int m_concurrency = 4;
+    int m_compressionLevel = 0;
+
+    Region m_region;
+    qint64 m_regionId = -1;
+    bool m_running = false;
+
+    QQueue<Resource> m_resources;
+    QList<TilePyramid> m_pyramids;
+    QQueue<Resource> m_downloads;
+    QHash<QNetworkReply *, Resource> m_pending;
+    bool m_lookingUp = false;
+    int m_storing = 0;
+    QSet<QString> m_seen;
+    QHash<QString, QJsonObject> m_sources;
+
+    qint64 m_total = 0;
+    qint64 m_completed = 0;
+    qint64 m_cached = 0;
+    qint64 m_failed = 0;
+    qint64 m_bytes = 0;
+    qint64 m_storedBytes = 0;
+    QElapsedTimer m_timer;
+};
+
+#endif // QMAPBOXGLOFFLINEDOWNLOADER_H
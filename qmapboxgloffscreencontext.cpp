@@ -0,0 +1,78 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Copyright (C) 2017 Mapbox, Inc.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the QtLocation module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL3$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or later as published by the Free
+** Software Foundation and appearing in the file LICENSE.GPL included in
+** the packaging of this file. Please review the following information to
+** ensure the GNU General Public License version 2.0 requirements will be
+** met: http://www.gnu.org/licenses/gpl-2.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qmapboxgloffscreencontext_p.h"
+
+#include <QtGui/QOffscreenSurface>
+#include <QtGui/QOpenGLContext>
+
+QMapboxGLOffscreenContext::QMapboxGLOffscreenContext()
+{
+}
+
+QMapboxGLOffscreenContext::~QMapboxGLOffscreenContext()
+{
+}
+
+bool QMapboxGLOffscreenContext::makeCurrent()
+{
+    if (!m_context) {
+        m_context.reset(new QOpenGLContext);
+        if (!m_context->create()) {
+            qWarning("Unable to create an OpenGL context for offscreen map rendering.");
+            m_context.reset();
+            return false;
+        }
+
+        m_surface.reset(new QOffscreenSurface);
+        m_surface->setFormat(m_context->format());
+        m_surface->create();
+    }
+
+    return m_context->makeCurrent(m_surface.data());
+}
+
+void QMapboxGLOffscreenContext::doneCurrent()
+{
+    if (m_context)
+        m_context->doneCurrent();
+}
+
+QOpenGLContext *QMapboxGLOffscreenContext::context() const
+{
+    return m_context.data();
+}
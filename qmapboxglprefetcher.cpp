@@ -0,0 +1,159 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Copyright (C) 2017 Mapbox, Inc.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the QtLocation module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL3$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or later as published by the Free
+** Software Foundation and appearing in the file LICENSE.GPL included in
+** the packaging of this file. Please review the following information to
+** ensure the GNU General Public License version 2.0 requirements will be
+** met: http://www.gnu.org/licenses/gpl-2.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+
+#include "qmapboxglprefetcher_p.h"
+#include "qmapboxglstylechange_p.h"
+
+#include <QtGui/QOpenGLFunctions>
+
+// The framebuffer only needs to exist, the tile coverage follows
+// the logical size of the map.
+static const QSize prefetchTextureSize = QSize(64, 64);
+
+QMapboxGLPrefetcher::QMapboxGLPrefetcher(const QMapboxGLSettings &settings, qreal pixelRatio)
+{
+    m_map.reset(new QMapboxGL(nullptr, settings, prefetchTextureSize, pixelRatio));
+
+    // Emitted on the render thread, where the prefetcher lives.
+    QObject::connect(m_map.data(), &QMapboxGL::mapChanged, &m_styleTracking, [this](QMapboxGL::MapChange change) {
+        if (change == QMapboxGL::MapChangeWillStartLoadingMap) {
+            m_styleLoaded = false;
+        } else if (change == QMapboxGL::MapChangeDidFinishLoadingStyle) {
+            m_styleLoaded = true;
+            for (const auto &pending : qAsConst(m_pendingChanges))
+                pending->apply(m_map.data());
+            m_pendingChanges.clear();
+        }
+    });
+}
+
+QMapboxGLPrefetcher::~QMapboxGLPrefetcher()
+{
+}
+
+bool QMapboxGLPrefetcher::setOwner(const void *owner, const QString &styleUrl)
+{
+    if (owner == m_owner && styleUrl == m_styleUrl)
+        return false;
+
+    // Also clears what the previous owner added when the style is the same.
+    m_map->setStyleJson(QStringLiteral("{\"version\": 8, \"sources\": {}, \"layers\": []}"));
+    m_map->setStyleUrl(styleUrl);
+
+    m_owner = owner;
+    m_styleUrl = styleUrl;
+    m_styleLoaded = false;
+    m_pendingChanges.clear();
+
+    return true;
+}
+
+void QMapboxGLPrefetcher::release(const void *owner)
+{
+    if (owner == m_owner)
+        m_owner = nullptr;
+}
+
+void QMapboxGLPrefetcher::applyStyleChanges(const void *owner, const QString &styleUrl,
+                                            const QList<QSharedPointer<QMapboxGLStyleChange>> &changes)
+{
+    if (owner != m_owner || styleUrl != m_styleUrl)
+        return;
+
+    if (!m_styleLoaded) {
+        m_pendingChanges << changes;
+        return;
+    }
+
+    for (const auto &change : changes)
+        change->apply(m_map.data());
+}
+
+void QMapboxGLPrefetcher::prefetch(const QSize &size, const QMargins &margins, const QMapboxGLCameraOptions &camera)
+{
+    m_map->resize(size.expandedTo(prefetchTextureSize));
+    m_map->setMargins(margins);
+    m_map->jumpTo(camera);
+    m_pending = true;
+}
+
+void QMapboxGLPrefetcher::render(QOpenGLFunctions *f)
+{
+    if (!m_pending)
+        return;
+
+    if (!m_fbo) {
+        m_fbo.reset(new QOpenGLFramebufferObject(prefetchTextureSize, QOpenGLFramebufferObject::CombinedDepthStencil));
+        m_map->setFramebufferObject(m_fbo->handle(), prefetchTextureSize);
+    }
+
+    f->glViewport(0, 0, m_fbo->width(), m_fbo->height());
+
+    m_fbo->bind();
+    m_map->render();
+    m_fbo->release();
+
+    m_pending = false;
+}
+
+qint64 QMapboxGLPrefetcher::framebufferBytes() const
+{
+    return m_fbo ? qint64(m_fbo->width()) * m_fbo->height() * 8 : 0;
+}
+
+// QMapboxGLPrefetchers
+
+QSharedPointer<QMapboxGLPrefetcher> QMapboxGLPrefetchers::acquire(QOpenGLContext *context, const QMapboxGLSettings &settings, qreal pixelRatio)
+{
+    QMutexLocker locker(&m_mutex);
+
+    for (auto it = m_prefetchers.begin(); it != m_prefetchers.end();) {
+        if (it.value().isNull())
+            it = m_prefetchers.erase(it);
+        else
+            ++it;
+    }
+
+    QSharedPointer<QMapboxGLPrefetcher> prefetcher = m_prefetchers.value(context).toStrongRef();
+    if (!prefetcher) {
+        prefetcher.reset(new QMapboxGLPrefetcher(settings, pixelRatio));
+        m_prefetchers.insert(context, prefetcher);
+    }
+
+    return prefetcher;
+}
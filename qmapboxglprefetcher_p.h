@@ -0,0 +1,115 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Copyright (C) 2017 Mapbox, Inc.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the QtLocation module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL3$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or later as published by the Free
+** Software Foundation and appearing in the file LICENSE.GPL included in
+** the packaging of this file. Please review the following information to
+** ensure the GNU General Public License version 2.0 requirements will be
+** met: http://www.gnu.org/licenses/gpl-2.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+
+#ifndef QMAPBOXGLPREFETCHER_P_H
+#define QMAPBOXGLPREFETCHER_P_H
+
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QMargins>
+#include <QtCore/QMutex>
+#include <QtCore/QObject>
+#include <QtCore/QScopedPointer>
+#include <QtCore/QSharedPointer>
+#include <QtCore/QSize>
+#include <QtCore/QWeakPointer>
+#include <QtGui/QOpenGLFramebufferObject>
+
+#include <QMapboxGL>
+
+class QMapboxGLStyleChange;
+class QOpenGLContext;
+class QOpenGLFunctions;
+
+// Hidden map rendered into a tiny framebuffer at a predicted camera
+// position. Rendering makes Mapbox GL request the tiles covering that
+// viewport, which land in the shared ambient cache before the visible
+// map gets there.
+//
+// Shared by the maps of an engine rendering with the same context, it
+// prefetches for one of them at a time: the owner, whose style it shows
+// along with the owner's style changes, so sources added by map items
+// and parameters are prefetched as well.
+class QMapboxGLPrefetcher
+{
+public:
+    QMapboxGLPrefetcher(const QMapboxGLSettings &, qreal pixelRatio);
+    ~QMapboxGLPrefetcher();
+
+    // Returns true when the prefetcher changed owners or styles and loads
+    // the style again. The owner then has to pass all its style changes.
+    bool setOwner(const void *owner, const QString &styleUrl);
+    void release(const void *owner);
+
+    // Ignored unless they come from the owner for the style shown. Kept
+    // until the style has loaded.
+    void applyStyleChanges(const void *owner, const QString &styleUrl,
+                           const QList<QSharedPointer<QMapboxGLStyleChange>> &changes);
+
+    // Viewport size and margins of the owner.
+    void prefetch(const QSize &size, const QMargins &margins, const QMapboxGLCameraOptions &camera);
+    void render(QOpenGLFunctions *f);
+
+    qint64 framebufferBytes() const;
+
+private:
+    QScopedPointer<QMapboxGL> m_map;
+    QScopedPointer<QOpenGLFramebufferObject> m_fbo;
+    bool m_pending = false;
+
+    const void *m_owner = nullptr;
+    QString m_styleUrl;
+    bool m_styleLoaded = false;
+    QList<QSharedPointer<QMapboxGLStyleChange>> m_pendingChanges;
+    // Context of the style tracking connection, on the render thread.
+    QObject m_styleTracking;
+};
+
+// The prefetchers of an engine, one per OpenGL context. Each is deleted,
+// on its render thread, along with the last scene graph node using it.
+class QMapboxGLPrefetchers
+{
+public:
+    QSharedPointer<QMapboxGLPrefetcher> acquire(QOpenGLContext *context, const QMapboxGLSettings &settings, qreal pixelRatio);
+
+private:
+    QMutex m_mutex;
+    QHash<QOpenGLContext *, QWeakPointer<QMapboxGLPrefetcher>> m_prefetchers;
+};
+
+#endif // QMAPBOXGLPREFETCHER_P_H
@@ -0,0 +1,207 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Copyright (C) 2017 Mapbox, Inc.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the QtLocation module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL3$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or later as published by the Free
+** Software Foundation and appearing in the file LICENSE.GPL included in
+** the packaging of this file. Please review the following information to
+** ensure the GNU General Public License version 2.0 requirements will be
+** met: http://www.gnu.org/licenses/gpl-2.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qmapboxglrequestscheduler_p.h"
+
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QJsonObject>
+#include <QtCore/QRegularExpression>
+#include <QtCore/QtMath>
+
+#include <cmath>
+
+namespace {
+
+// Mapbox GL draws 512 pixel tiles, one zoom level above 256 pixel ones.
+const double tileSize = 512.0;
+
+// Web Mercator stops short of the poles.
+const double maximumLatitude = 85.0511287798;
+
+} // namespace
+
+void QMapboxGLRequestScheduler::setViewport(const void *map, const QGeoCoordinate &center, double zoom, const QSize &size)
+{
+    QMutexLocker locker(&m_mutex);
+
+    Viewport &viewport = m_viewports[map];
+    viewport.center = center;
+    viewport.zoom = zoom;
+    viewport.size = size;
+}
+
+void QMapboxGLRequestScheduler::removeViewport(const void *map)
+{
+    QMutexLocker locker(&m_mutex);
+    m_viewports.remove(map);
+}
+
+QMapboxGLRequestScheduler::Tile QMapboxGLRequestScheduler::tile(const QString &url) const
+{
+    Tile tile;
+    if (!parseTile(url, &tile.z, &tile.x, &tile.y)) {
+        tile.z = -1;
+        return tile;
+    }
+
+    QMutexLocker locker(&m_mutex);
+
+    for (const QString &prefix : m_tmsPrefixes) {
+        if (url.startsWith(prefix)) {
+            tile.y = (1 << tile.z) - 1 - tile.y;
+            break;
+        }
+    }
+
+    return tile;
+}
+
+QVector<double> QMapboxGLRequestScheduler::priorities(const QVector<Tile> &tiles) const
+{
+    QVector<double> priorities;
+    priorities.reserve(tiles.size());
+
+    QMutexLocker locker(&m_mutex);
+
+    for (const Tile &tile : tiles)
+        priorities.append(rank(tile));
+
+    return priorities;
+}
+
+double QMapboxGLRequestScheduler::priority(const QString &url) const
+{
+    const Tile parsed = tile(url);
+
+    QMutexLocker locker(&m_mutex);
+    return rank(parsed);
+}
+
+void QMapboxGLRequestScheduler::learnTileSchemes(const QByteArray &json)
+{
+    const QJsonObject document = QJsonDocument::fromJson(json).object();
+    if (document.isEmpty())
+        return;
+
+    // A TileJSON document is a source of its own.
+    QJsonArray sources = document.value(QStringLiteral("sources")).toObject().isEmpty()
+            ? QJsonArray { document } : QJsonArray();
+    const QJsonObject styleSources = document.value(QStringLiteral("sources")).toObject();
+    for (auto it = styleSources.constBegin(); it != styleSources.constEnd(); ++it)
+        sources.append(it.value());
+
+    QStringList prefixes;
+    for (const QJsonValue &value : qAsConst(sources)) {
+        const QJsonObject source = value.toObject();
+        if (source.value(QStringLiteral("scheme")).toString() != QStringLiteral("tms"))
+            continue;
+
+        // Everything up to the first placeholder, {z} or a {prefix}.
+        const QJsonArray tiles = source.value(QStringLiteral("tiles")).toArray();
+        for (const QJsonValue &tileUrl : tiles) {
+            const QString prefix = tileUrl.toString().section(QLatin1Char('{'), 0, 0);
+            if (!prefix.isEmpty())
+                prefixes.append(prefix);
+        }
+    }
+
+    if (prefixes.isEmpty())
+        return;
+
+    QMutexLocker locker(&m_mutex);
+    for (const QString &prefix : qAsConst(prefixes)) {
+        if (!m_tmsPrefixes.contains(prefix))
+            m_tmsPrefixes.append(prefix);
+    }
+}
+
+double QMapboxGLRequestScheduler::rank(const Tile &tile) const
+{
+    if (!tile.isValid())
+        return nonTilePriority;
+
+    // Nothing on screen, keep the order requests came in.
+    if (m_viewports.isEmpty())
+        return 0.0;
+
+    const int z = tile.z;
+    const int x = tile.x;
+    const int y = tile.y;
+
+    const double n = std::pow(2.0, z);
+    double best = qInf();
+
+    for (const Viewport &viewport : m_viewports) {
+        const double latitude = qDegreesToRadians(qBound(-maximumLatitude, viewport.center.latitude(), maximumLatitude));
+        const double centerX = (viewport.center.longitude() + 180.0) / 360.0 * n;
+        const double centerY = (1.0 - std::log(std::tan(latitude) + 1.0 / std::cos(latitude)) / M_PI) / 2.0 * n;
+
+        // Shortest way around the antimeridian.
+        double dx = std::fabs(x + 0.5 - centerX);
+        dx = qMin(dx, n - dx);
+        const double dy = y + 0.5 - centerY;
+
+        // Half the viewport diagonal, in tiles of this zoom level.
+        const double tilePixels = tileSize * std::pow(2.0, viewport.zoom - z);
+        const double radius = qMax(std::hypot(viewport.size.width(), viewport.size.height()) / 2.0 / tilePixels, 0.5);
+
+        // Raster sources of 256 pixel tiles load one level above the map.
+        const int ideal = int(std::floor(viewport.zoom));
+        const int zoomDistance = z < ideal ? ideal - z : qMax(0, z - ideal - 1);
+
+        best = qMin(best, std::hypot(dx, dy) / radius + zoomDistance);
+    }
+
+    return best;
+}
+
+bool QMapboxGLRequestScheduler::parseTile(const QString &url, int *z, int *x, int *y)
+{
+    // .../14/8192/5448.vector.pbf, .../14/8192/5448@2x.png or .../14/8192/5448
+    static const QRegularExpression tilePath(QStringLiteral("/(\\d{1,2})/(\\d+)/(\\d+)(?:@\\d(?:\\.\\d+)?x)?(?:\\.[\\w.]+)?(?:[?#]|$)"));
+
+    const QRegularExpressionMatch match = tilePath.match(url);
+    if (!match.hasMatch())
+        return false;
+
+    *z = match.capturedRef(1).toInt();
+    *x = match.capturedRef(2).toInt();
+    *y = match.capturedRef(3).toInt();
+
+    return *z <= 30 && *x < (1 << *z) && *y < (1 << *z);
+}
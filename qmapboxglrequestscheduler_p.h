@@ -0,0 +1,108 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Copyright (C) 2017 Mapbox, Inc.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the QtLocation module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL3$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or later as published by the Free
+** Software Foundation and appearing in the file LICENSE.GPL included in
+** the packaging of this file. Please review the following information to
+** ensure the GNU General Public License version 2.0 requirements will be
+** met: http://www.gnu.org/licenses/gpl-2.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QMAPBOXGLREQUESTSCHEDULER_P_H
+#define QMAPBOXGLREQUESTSCHEDULER_P_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
+#include <QtCore/QSize>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+#include <QtCore/QVector>
+#include <QtPositioning/QGeoCoordinate>
+
+// Ranks network requests by how much the maps on screen need them.
+//
+// Each map publishes where its camera is. Tiles are recognized by the
+// z/x/y at the end of their URL path and ranked by their distance from the
+// closest viewport center, in viewport radii, plus the number of zoom
+// levels they are away from what that viewport draws. Anything else, like
+// styles, sources, sprites and glyphs, goes first since tiles wait on it.
+//
+// Sources with the TMS scheme count rows from the south. They are learned
+// from the styles and TileJSON documents going through the tile server,
+// and their tile rows are flipped back before ranking.
+//
+// Thread safe: maps update it from the GUI thread, the tile server ranks
+// its queue on its own thread.
+class QMapboxGLRequestScheduler
+{
+public:
+    // Rank of requests that are not tiles.
+    static constexpr double nonTilePriority = -1.0;
+
+    struct Tile {
+        int z = -1;
+        int x = 0;
+        int y = 0;
+
+        bool isValid() const { return z >= 0; }
+    };
+
+    void setViewport(const void *map, const QGeoCoordinate &center, double zoom, const QSize &size);
+    void removeViewport(const void *map);
+
+    // Parsed once per request, in XYZ rows.
+    Tile tile(const QString &url) const;
+
+    // Lower goes first. Ranks a whole queue under one lock.
+    QVector<double> priorities(const QVector<Tile> &tiles) const;
+    double priority(const QString &url) const;
+
+    // Picks up the tile URL templates of TMS sources from a style or a
+    // TileJSON document.
+    void learnTileSchemes(const QByteArray &json);
+
+    static bool parseTile(const QString &url, int *z, int *x, int *y);
+
+private:
+    struct Viewport {
+        QGeoCoordinate center;
+        double zoom = 0.0;
+        QSize size;
+    };
+
+    double rank(const Tile &tile) const;
+
+    mutable QMutex m_mutex;
+    QHash<const void *, Viewport> m_viewports;
+    QStringList m_tmsPrefixes;
+};
+
+#endif // QMAPBOXGLREQUESTSCHEDULER_P_H
@@ -0,0 +1,124 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Copyright (C) 2017 Mapbox, Inc.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the QtLocation module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL3$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or later as published by the Free
+** Software Foundation and appearing in the file LICENSE.GPL included in
+** the packaging of this file. Please review the following information to
+** ensure the GNU General Public License version 2.0 requirements will be
+** met: http://www.gnu.org/licenses/gpl-2.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qmapboxglsessionrecorder_p.h"
+#include "qmapboxglstylechange_p.h"
+
+QMapboxGLSessionRecorder::QMapboxGLSessionRecorder(const QString &fileName)
+    : m_file(fileName)
+{
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning("Unable to record the map session to %s.", qPrintable(fileName));
+        return;
+    }
+
+    m_stream.setDevice(&m_file);
+    m_stream.setVersion(QDataStream::Qt_5_9);
+    m_stream << magic << version;
+
+    m_clock.start();
+}
+
+QMapboxGLSessionRecorder::~QMapboxGLSessionRecorder()
+{
+    m_file.close();
+}
+
+bool QMapboxGLSessionRecorder::isOpen() const
+{
+    return m_file.isOpen();
+}
+
+void QMapboxGLSessionRecorder::beginRecord(RecordType type)
+{
+    m_stream << quint8(type) << qint64(m_clock.elapsed());
+}
+
+void QMapboxGLSessionRecorder::recordStyleUrl(const QString &url)
+{
+    if (!isOpen())
+        return;
+
+    beginRecord(StyleUrl);
+    m_stream << url;
+}
+
+void QMapboxGLSessionRecorder::recordViewport(const QSize &size, qreal pixelRatio)
+{
+    if (!isOpen())
+        return;
+
+    beginRecord(Viewport);
+    m_stream << size << double(pixelRatio);
+}
+
+void QMapboxGLSessionRecorder::recordMargins(const QMargins &margins)
+{
+    if (!isOpen())
+        return;
+
+    beginRecord(Margins);
+    m_stream << margins;
+}
+
+void QMapboxGLSessionRecorder::recordCamera(double latitude, double longitude, double zoom, double bearing, double pitch)
+{
+    if (!isOpen())
+        return;
+
+    beginRecord(Camera);
+    m_stream << latitude << longitude << zoom << bearing << pitch;
+}
+
+void QMapboxGLSessionRecorder::recordStyleChanges(const QList<QSharedPointer<QMapboxGLStyleChange>> &changes)
+{
+    if (!isOpen() || changes.isEmpty())
+        return;
+
+    beginRecord(StyleChanges);
+    m_stream << qint32(changes.size());
+    for (const auto &change : changes)
+        QMapboxGLStyleChange::write(m_stream, *change);
+}
+
+void QMapboxGLSessionRecorder::recordFrame()
+{
+    if (!isOpen())
+        return;
+
+    beginRecord(Frame);
+}
@@ -0,0 +1,93 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Copyright (C) 2017 Mapbox, Inc.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the QtLocation module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL3$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or later as published by the Free
+** Software Foundation and appearing in the file LICENSE.GPL included in
+** the packaging of this file. Please review the following information to
+** ensure the GNU General Public License version 2.0 requirements will be
+** met: http://www.gnu.org/licenses/gpl-2.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QMAPBOXGLSESSIONRECORDER_P_H
+#define QMAPBOXGLSESSIONRECORDER_P_H
+
+#include <QtCore/QDataStream>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QFile>
+#include <QtCore/QList>
+#include <QtCore/QMargins>
+#include <QtCore/QSharedPointer>
+#include <QtCore/QSize>
+
+class QMapboxGLStyleChange;
+
+// Records what a map applies to its QMapboxGL during scene graph updates,
+// style changes, camera jumps, viewport and margin changes, and which of
+// the updates rendered a frame, so the session can be replayed offscreen
+// by QMapboxGLSessionReplayer.
+//
+// File layout: magic, version, then records of a type byte, a timestamp
+// in milliseconds since the start of the recording and a payload.
+class QMapboxGLSessionRecorder
+{
+public:
+    enum RecordType : quint8 {
+        StyleUrl = 1,
+        Viewport,
+        Margins,
+        Camera,
+        StyleChanges,
+        Frame
+    };
+
+    static const quint32 magic = 0x4d42474c; // "MBGL"
+    static const quint32 version = 1;
+
+    explicit QMapboxGLSessionRecorder(const QString &fileName);
+    ~QMapboxGLSessionRecorder();
+
+    bool isOpen() const;
+
+    void recordStyleUrl(const QString &url);
+    void recordViewport(const QSize &size, qreal pixelRatio);
+    void recordMargins(const QMargins &margins);
+    void recordCamera(double latitude, double longitude, double zoom, double bearing, double pitch);
+    void recordStyleChanges(const QList<QSharedPointer<QMapboxGLStyleChange>> &changes);
+    void recordFrame();
+
+private:
+    void beginRecord(RecordType type);
+
+    QFile m_file;
+    QDataStream m_stream;
+    QElapsedTimer m_clock;
+};
+
+#endif // QMAPBOXGLSESSIONRECORDER_P_H
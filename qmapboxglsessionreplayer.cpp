@@ -0,0 +1,298 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Copyright (C) 2017 Mapbox, Inc.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the QtLocation module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL3$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or later as published by the Free
+** Software Foundation and appearing in the file LICENSE.GPL included in
+** the packaging of this file. Please review the following information to
+** ensure the GNU General Public License version 2.0 requirements will be
+** met: http://www.gnu.org/licenses/gpl-2.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qmapboxglsessionreplayer.h"
+#include "qmapboxglsessionrecorder_p.h"
+#include "qmapboxglstylechange_p.h"
+
+#include <QtCore/QMargins>
+#include <QtCore/QTimer>
+#include <QtGui/QOpenGLContext>
+#include <QtGui/QOpenGLFramebufferObject>
+#include <QtGui/QOpenGLFunctions>
+
+QMapboxGLSessionReplayer::QMapboxGLSessionReplayer(const QMapboxGLSettings &settings, QObject *parent)
+    : QObject(parent)
+    , m_settings(settings)
+{
+}
+
+QMapboxGLSessionReplayer::~QMapboxGLSessionReplayer()
+{
+    // The map and the framebuffer own GL resources.
+    if (m_context.context() && m_context.makeCurrent()) {
+        m_map.reset();
+        m_fbo.reset();
+        m_context.doneCurrent();
+    }
+}
+
+bool QMapboxGLSessionReplayer::open(const QString &fileName)
+{
+    m_file.close();
+    m_file.setFileName(fileName);
+
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        qWarning("Unable to open the map session %s.", qPrintable(fileName));
+        return false;
+    }
+
+    m_stream.setDevice(&m_file);
+    m_stream.setVersion(QDataStream::Qt_5_9);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    m_stream >> magic >> version;
+
+    if (magic != QMapboxGLSessionRecorder::magic || version != QMapboxGLSessionRecorder::version) {
+        qWarning("%s is not a map session recording.", qPrintable(fileName));
+        m_file.close();
+        return false;
+    }
+
+    m_hasRecord = false;
+
+    return true;
+}
+
+void QMapboxGLSessionReplayer::setMaximumSpeed(bool maximumSpeed)
+{
+    m_maximumSpeed = maximumSpeed;
+}
+
+void QMapboxGLSessionReplayer::start()
+{
+    if (m_running || !m_file.isOpen())
+        return;
+
+    m_running = true;
+    m_clock.start();
+
+    QTimer::singleShot(0, this, &QMapboxGLSessionReplayer::step);
+}
+
+bool QMapboxGLSessionReplayer::isRunning() const
+{
+    return m_running;
+}
+
+QVariantMap QMapboxGLSessionReplayer::statistics() const
+{
+    const qint64 duration = m_running ? m_clock.elapsed() : m_duration;
+
+    QVariantMap statistics;
+    statistics[QStringLiteral("frames")] = m_frames;
+    statistics[QStringLiteral("styleChanges")] = m_styleChanges;
+    statistics[QStringLiteral("duration")] = duration;
+    statistics[QStringLiteral("framesPerSecond")] = duration ? m_frames * 1000.0 / duration : 0.0;
+    statistics[QStringLiteral("frameTimings")] = m_timing.statistics();
+
+    return statistics;
+}
+
+bool QMapboxGLSessionReplayer::readRecordHeader()
+{
+    if (m_stream.atEnd())
+        return false;
+
+    m_stream >> m_recordType >> m_recordTime;
+    m_hasRecord = m_stream.status() == QDataStream::Ok;
+
+    return m_hasRecord;
+}
+
+void QMapboxGLSessionReplayer::step()
+{
+    while (m_running) {
+        if (!m_hasRecord && !readRecordHeader()) {
+            finish();
+            return;
+        }
+
+        // Style changes only ever reached the live map with its style loaded.
+        if (m_recordType == QMapboxGLSessionRecorder::StyleChanges && !m_styleLoaded) {
+            m_waitingForStyle = true;
+            return;
+        }
+
+        if (!m_maximumSpeed && m_recordTime > m_clock.elapsed()) {
+            QTimer::singleShot(int(m_recordTime - m_clock.elapsed()), this, &QMapboxGLSessionReplayer::step);
+            return;
+        }
+
+        m_hasRecord = false;
+        processRecord();
+
+        if (m_stream.status() != QDataStream::Ok) {
+            qWarning("The map session recording is truncated or corrupt.");
+            finish();
+            return;
+        }
+
+        // Give Mapbox GL the event loop between frames, tiles and
+        // style resources arrive through it.
+        if (m_recordType == QMapboxGLSessionRecorder::Frame) {
+            QTimer::singleShot(0, this, &QMapboxGLSessionReplayer::step);
+            return;
+        }
+    }
+}
+
+void QMapboxGLSessionReplayer::processRecord()
+{
+    switch (m_recordType) {
+    case QMapboxGLSessionRecorder::StyleUrl:
+        m_stream >> m_styleUrl;
+        m_styleLoaded = false;
+        if (m_map)
+            m_map->setStyleUrl(m_styleUrl);
+        break;
+    case QMapboxGLSessionRecorder::Viewport: {
+        QSize size;
+        double pixelRatio = 1.0;
+        m_stream >> size >> pixelRatio;
+        resize(size, pixelRatio);
+    } break;
+    case QMapboxGLSessionRecorder::Margins: {
+        QMargins margins;
+        m_stream >> margins;
+        if (m_map)
+            m_map->setMargins(margins);
+    } break;
+    case QMapboxGLSessionRecorder::Camera: {
+        double latitude, longitude, zoom, bearing, pitch;
+        m_stream >> latitude >> longitude >> zoom >> bearing >> pitch;
+
+        QMapboxGLCameraOptions camera;
+        camera.center = QVariant::fromValue(QMapbox::Coordinate(latitude, longitude));
+        camera.zoom = zoom;
+        camera.bearing = bearing;
+        camera.pitch = pitch;
+
+        if (m_map)
+            m_map->jumpTo(camera);
+    } break;
+    case QMapboxGLSessionRecorder::StyleChanges: {
+        qint32 count = 0;
+        m_stream >> count;
+
+        for (qint32 i = 0; i < count && m_stream.status() == QDataStream::Ok; ++i) {
+            QSharedPointer<QMapboxGLStyleChange> change = QMapboxGLStyleChange::read(m_stream);
+            if (change && m_map)
+                change->apply(m_map.data());
+            ++m_styleChanges;
+        }
+    } break;
+    case QMapboxGLSessionRecorder::Frame:
+        renderFrame();
+        break;
+    default:
+        m_stream.setStatus(QDataStream::ReadCorruptData);
+        break;
+    }
+}
+
+void QMapboxGLSessionReplayer::resize(const QSize &size, qreal pixelRatio)
+{
+    if (size.isEmpty() || !m_context.makeCurrent())
+        return;
+
+    // The pixel ratio is fixed for the lifetime of a QMapboxGL.
+    if (!m_map || !qFuzzyCompare(m_pixelRatio, pixelRatio)) {
+        m_map.reset(new QMapboxGL(nullptr, m_settings, size, pixelRatio));
+        m_pixelRatio = pixelRatio;
+        m_styleLoaded = false;
+
+        connect(m_map.data(), &QMapboxGL::mapChanged, this, &QMapboxGLSessionReplayer::onMapChanged);
+
+        if (!m_styleUrl.isEmpty())
+            m_map->setStyleUrl(m_styleUrl);
+    }
+
+    const QSize fbSize = size * pixelRatio;
+    m_map->resize(size);
+    m_fbo.reset(new QOpenGLFramebufferObject(fbSize, QOpenGLFramebufferObject::CombinedDepthStencil));
+    m_map->setFramebufferObject(m_fbo->handle(), fbSize);
+}
+
+void QMapboxGLSessionReplayer::renderFrame()
+{
+    if (!m_map || !m_fbo || !m_context.makeCurrent())
+        return;
+
+    QOpenGLFunctions *f = m_context.context()->functions();
+    f->glViewport(0, 0, m_fbo->width(), m_fbo->height());
+
+    m_fbo->bind();
+
+    f->glClearColor(0.f, 0.f, 0.f, 0.f);
+    f->glClear(GL_COLOR_BUFFER_BIT);
+
+    {
+        QMapboxGLFrameTiming::Scope scope(&m_timing, QMapboxGLFrameTiming::Render);
+        m_map->render();
+
+        // Nothing presents these frames, wait for the GPU so the
+        // measured time covers all of the work.
+        f->glFinish();
+    }
+
+    m_fbo->release();
+
+    m_timing.commitFrame();
+    ++m_frames;
+}
+
+void QMapboxGLSessionReplayer::onMapChanged(QMapboxGL::MapChange change)
+{
+    if (change != QMapboxGL::MapChangeDidFinishLoadingStyle && change != QMapboxGL::MapChangeDidFailLoadingMap)
+        return;
+
+    m_styleLoaded = true;
+
+    if (m_waitingForStyle) {
+        m_waitingForStyle = false;
+        QTimer::singleShot(0, this, &QMapboxGLSessionReplayer::step);
+    }
+}
+
+void QMapboxGLSessionReplayer::finish()
+{
+    m_running = false;
+    m_duration = m_clock.elapsed();
+    emit finished();
+}
@@ -0,0 +1,115 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Copyright (C) 2017 Mapbox, Inc.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the QtLocation module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL3$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or later as published by the Free
+** Software Foundation and appearing in the file LICENSE.GPL included in
+** the packaging of this file. Please review the following information to
+** ensure the GNU General Public License version 2.0 requirements will be
+** met: http://www.gnu.org/licenses/gpl-2.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QMAPBOXGLSESSIONREPLAYER_H
+#define QMAPBOXGLSESSIONREPLAYER_H
+
+#include <QtCore/QDataStream>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QFile>
+#include <QtCore/QObject>
+#include <QtCore/QScopedPointer>
+#include <QtCore/QVariantMap>
+
+#include <QMapboxGL>
+
+#include "qmapboxglframetiming_p.h"
+#include "qmapboxgloffscreencontext_p.h"
+
+class QOpenGLFramebufferObject;
+
+// Plays a session written by QMapboxGLSessionRecorder back into an
+// offscreen QMapboxGL, either with the recorded timing or as fast as
+// possible, and measures the frames. Style changes are held back until the
+// replayed style has loaded, like the live map does. Needs a running event
+// loop on the thread the replayer lives in.
+class QMapboxGLSessionReplayer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit QMapboxGLSessionReplayer(const QMapboxGLSettings &, QObject *parent = nullptr);
+    ~QMapboxGLSessionReplayer();
+
+    bool open(const QString &fileName);
+
+    void setMaximumSpeed(bool maximumSpeed);
+    void start();
+
+    bool isRunning() const;
+    QVariantMap statistics() const;
+
+Q_SIGNALS:
+    void finished();
+
+private Q_SLOTS:
+    void step();
+    void onMapChanged(QMapboxGL::MapChange);
+
+private:
+    bool readRecordHeader();
+    void processRecord();
+    void resize(const QSize &size, qreal pixelRatio);
+    void renderFrame();
+    void finish();
+
+    QMapboxGLSettings m_settings;
+    QMapboxGLOffscreenContext m_context;
+    QScopedPointer<QMapboxGL> m_map;
+    QScopedPointer<QOpenGLFramebufferObject> m_fbo;
+    qreal m_pixelRatio = 0.0;
+    QString m_styleUrl;
+    bool m_styleLoaded = false;
+
+    QFile m_file;
+    QDataStream m_stream;
+    bool m_hasRecord = false;
+    quint8 m_recordType = 0;
+    qint64 m_recordTime = 0;
+
+    bool m_maximumSpeed = false;
+    bool m_running = false;
+    bool m_waitingForStyle = false;
+    QElapsedTimer m_clock;
+    qint64 m_duration = 0;
+
+    QMapboxGLFrameTiming m_timing;
+    quint64 m_frames = 0;
+    quint64 m_styleChanges = 0;
+};
+
+#endif // QMAPBOXGLSESSIONREPLAYER_H
@@ -0,0 +1,110 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Copyright (C) 2017 Mapbox, Inc.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the QtLocation module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL3$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or later as published by the Free
+** Software Foundation and appearing in the file LICENSE.GPL included in
+** the packaging of this file. Please review the following information to
+** ensure the GNU General Public License version 2.0 requirements will be
+** met: http://www.gnu.org/licenses/gpl-2.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qmapboxglsharedresources_p.h"
+#include "qgeomapmapboxgl.h"
+
+// Forget the URLs seen so far once this many are tracked.
+static const int maximumTrackedUrls = 20000;
+
+QMapboxGLSharedResources::QMapboxGLSharedResources()
+    : m_requests(new RequestLog)
+{
+}
+
+void QMapboxGLSharedResources::install(QMapboxGLSettings *settings)
+{
+    // Called from the file source thread, possibly after the engine is
+    // gone, hence the log is captured by value.
+    QSharedPointer<RequestLog> requests = m_requests;
+    std::function<std::string(const std::string &&)> transform = settings->resourceTransform();
+
+    settings->setResourceTransform([requests, transform](const std::string &&url) -> std::string {
+        std::string result = transform ? transform(std::move(url)) : url;
+        requests->record(QString::fromStdString(result));
+        return result;
+    });
+}
+
+void QMapboxGLSharedResources::RequestLog::record(const QString &url)
+{
+    QMutexLocker locker(&mutex);
+
+    ++networkRequests;
+
+    if (urls.size() >= maximumTrackedUrls)
+        urls.clear();
+
+    int &count = urls[url];
+    if (count++)
+        ++repeatedNetworkRequests;
+}
+
+void QMapboxGLSharedResources::registerMap(QGeoMapMapboxGL *map)
+{
+    m_maps.removeAll(QPointer<QGeoMapMapboxGL>());
+    m_maps.append(map);
+}
+
+QVariantMap QMapboxGLSharedResources::statistics() const
+{
+    QVariantMap statistics;
+
+    {
+        QMutexLocker locker(&m_requests->mutex);
+        statistics[QStringLiteral("networkRequests")] = m_requests->networkRequests;
+        statistics[QStringLiteral("repeatedNetworkRequests")] = m_requests->repeatedNetworkRequests;
+        statistics[QStringLiteral("uniqueUrls")] = m_requests->urls.size();
+    }
+
+    QVariantList maps;
+    qint64 totalMemory = 0;
+
+    for (const QPointer<QGeoMapMapboxGL> &map : m_maps) {
+        if (!map)
+            continue;
+
+        const QVariantMap memory = map->memoryStatistics();
+        totalMemory += memory.value(QStringLiteral("total")).toLongLong();
+        maps.append(memory);
+    }
+
+    statistics[QStringLiteral("maps")] = maps;
+    statistics[QStringLiteral("totalMemory")] = totalMemory;
+
+    return statistics;
+}
@@ -0,0 +1,89 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Copyright (C) 2017 Mapbox, Inc.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the QtLocation module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL3$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or later as published by the Free
+** Software Foundation and appearing in the file LICENSE.GPL included in
+** the packaging of this file. Please review the following information to
+** ensure the GNU General Public License version 2.0 requirements will be
+** met: http://www.gnu.org/licenses/gpl-2.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QMAPBOXGLSHAREDRESOURCES_P_H
+#define QMAPBOXGLSHAREDRESOURCES_P_H
+
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QPointer>
+#include <QtCore/QSharedPointer>
+#include <QtCore/QVariantMap>
+
+#include <QMapboxGL>
+
+class QGeoMapMapboxGL;
+
+// Resources shared by all maps of one engine.
+//
+// Mapbox GL keeps a single file source, and therefore a single cache
+// database connection, per cache path; all maps created by the engine use
+// the same settings so they end up on that one connection. The resource
+// transform installed here observes the requests going to the network,
+// which tells how many of them are repeated across maps.
+//
+// Requests Mapbox GL answers from its cache never reach the transform, so
+// they are not counted; see the cache statistics of the engine for those.
+// The transform can only rewrite URLs, so it cannot merge requests in
+// flight either. The tile server does that, with request scheduling on,
+// which is the default.
+class QMapboxGLSharedResources
+{
+public:
+    QMapboxGLSharedResources();
+
+    void install(QMapboxGLSettings *settings);
+
+    void registerMap(QGeoMapMapboxGL *map);
+    QVariantMap statistics() const;
+
+private:
+    struct RequestLog {
+        void record(const QString &url);
+
+        mutable QMutex mutex;
+        QHash<QString, int> urls;
+        quint64 networkRequests = 0;
+        quint64 repeatedNetworkRequests = 0;
+    };
+
+    QSharedPointer<RequestLog> m_requests;
+    QList<QPointer<QGeoMapMapboxGL>> m_maps;
+};
+
+#endif // QMAPBOXGLSHAREDRESOURCES_P_H
@@ -35,6 +35,7 @@
 ****************************************************************************/
 
 #include "qmapboxglstylechange_p.h"
+#include "qmapboxgltrace_p.h"
 
 #include <QtCore/QDebug>
 #include <QtCore/QMetaProperty>
@@ -44,6 +45,7 @@
 #include <QtPositioning/QGeoPolygon>
 #include <QtQml/QJSValue>
 #include <QtLocation/private/qdeclarativecirclemapitem_p_p.h>
+#include <QtLocation/private/qgeoprojection_p.h>
 
 namespace {
 
@@ -65,6 +67,61 @@ QString getId(QDeclarativeGeoMapItemBase *mapItem)
             ((mapItem->objectName().isEmpty()) ? QString::number(quint64(mapItem)) : mapItem->objectName());
 }
 
+// QVariant streams everything the style changes hold except for
+// QMapbox::Feature, which has no stream operators of its own.
+void writeValue(QDataStream &stream, const QVariant &value)
+{
+    if (value.userType() == qMetaTypeId<QMapbox::Feature>()) {
+        const QMapbox::Feature feature = value.value<QMapbox::Feature>();
+        stream << true << qint32(feature.type) << feature.geometry << feature.properties << feature.id;
+    } else {
+        stream << false << value;
+    }
+}
+
+QVariant readValue(QDataStream &stream)
+{
+    bool isFeature = false;
+    stream >> isFeature;
+
+    if (!isFeature) {
+        QVariant value;
+        stream >> value;
+        return value;
+    }
+
+    qint32 type = 0;
+    QMapbox::Feature feature;
+    stream >> type >> feature.geometry >> feature.properties >> feature.id;
+    feature.type = QMapbox::Feature::Type(type);
+
+    return QVariant::fromValue<QMapbox::Feature>(feature);
+}
+
+void writeMap(QDataStream &stream, const QVariantMap &map)
+{
+    stream << qint32(map.size());
+    for (auto it = map.cbegin(); it != map.cend(); ++it) {
+        stream << it.key();
+        writeValue(stream, it.value());
+    }
+}
+
+QVariantMap readMap(QDataStream &stream)
+{
+    qint32 size = 0;
+    stream >> size;
+
+    QVariantMap map;
+    for (qint32 i = 0; i < size && stream.status() == QDataStream::Ok; ++i) {
+        QString key;
+        stream >> key;
+        map[key] = readValue(stream);
+    }
+
+    return map;
+}
+
 // Mapbox GL supports geometry segments that spans above 180 degrees in
 // longitude. To keep visual expectations in parity with Qt, we need to adapt
 // the coordinates to always use the shortest path when in ambiguity.
@@ -91,7 +148,10 @@ QMapbox::Feature featureFromMapRectangle(QDeclarativeRectangleMapItem *mapItem)
 QMapbox::Feature featureFromMapCircle(QDeclarativeCircleMapItem *mapItem)
 {
     static const int circleSamples = 128;
-    const QGeoProjectionWebMercator &p = static_cast<const QGeoProjectionWebMercator&>(mapItem->map()->geoProjection());
+
+    // Only the projection math is used, so the circle does not have to be
+    // on a map yet.
+    static const QGeoProjectionWebMercator p;
     QList<QGeoCoordinate> path;
     QGeoCoordinate leftBound;
     QDeclarativeCircleMapItemPrivateCPU::calculatePeripheralPoints(path, mapItem->center(), mapItem->radius(), circleSamples, leftBound);
@@ -165,6 +225,8 @@ QMapbox::Feature featureFromMapPolyline(QDeclarativePolylineMapItem *mapItem)
 
 QMapbox::Feature featureFromMapItem(QDeclarativeGeoMapItemBase *item)
 {
+    QMapboxGLTrace::Scope trace("featureFromMapItem", "style");
+
     switch (item->itemType()) {
     case QGeoMap::MapRectangle:
         return featureFromMapRectangle(static_cast<QDeclarativeRectangleMapItem *>(item));
@@ -199,7 +261,8 @@ QList<QSharedPointer<QMapboxGLStyleChange>> QMapboxGLStyleChange::addMapParamete
 {
     static const QStringList acceptedParameterTypes = QStringList()
         << QStringLiteral("paint") << QStringLiteral("layout") << QStringLiteral("filter")
-        << QStringLiteral("layer") << QStringLiteral("source") << QStringLiteral("image");
+        << QStringLiteral("layer") << QStringLiteral("source") << QStringLiteral("image")
+        << QStringLiteral("camera") << QStringLiteral("memoryUsage") << QStringLiteral("markers");
 
     QList<QSharedPointer<QMapboxGLStyleChange>> changes;
 
@@ -225,6 +288,10 @@ QList<QSharedPointer<QMapboxGLStyleChange>> QMapboxGLStyleChange::addMapParamete
     case 5: // image
         changes << QMapboxGLStyleAddImage::fromMapParameter(param);
         break;
+    case 6: // camera, handled by the map
+    case 7: // memoryUsage, handled by the map
+    case 8: // markers, handled by the map
+        break;
     }
 
     return changes;
@@ -240,6 +307,9 @@ QList<QSharedPointer<QMapboxGLStyleChange>> QMapboxGLStyleChange::addMapItem(QDe
     case QGeoMap::MapPolygon:
     case QGeoMap::MapPolyline:
         break;
+    case QGeoMap::MapQuickItem:
+        // Drawn together by QMapboxGLMarkerLayer.
+        return changes;
     default:
         qWarning() << "Unsupported QGeoMap item type: " << item->itemType();
         return changes;
@@ -259,7 +329,8 @@ QList<QSharedPointer<QMapboxGLStyleChange>> QMapboxGLStyleChange::removeMapParam
 {
     static const QStringList acceptedParameterTypes = QStringList()
         << QStringLiteral("paint") << QStringLiteral("layout") << QStringLiteral("filter")
-        << QStringLiteral("layer") << QStringLiteral("source") << QStringLiteral("image");
+        << QStringLiteral("layer") << QStringLiteral("source") << QStringLiteral("image")
+        << QStringLiteral("camera") << QStringLiteral("memoryUsage") << QStringLiteral("markers");
 
     QList<QSharedPointer<QMapboxGLStyleChange>> changes;
 
@@ -278,6 +349,9 @@ QList<QSharedPointer<QMapboxGLStyleChange>> QMapboxGLStyleChange::removeMapParam
         changes << QSharedPointer<QMapboxGLStyleChange>(new QMapboxGLStyleRemoveSource(param->property("name").toString()));
         break;
     case 5: // image
+    case 6: // camera
+    case 7: // memoryUsage
+    case 8: // markers
         break;
     }
 
@@ -288,6 +362,9 @@ QList<QSharedPointer<QMapboxGLStyleChange>> QMapboxGLStyleChange::removeMapItem(
 {
     QList<QSharedPointer<QMapboxGLStyleChange>> changes;
 
+    if (item->itemType() == QGeoMap::MapQuickItem)
+        return changes;
+
     const QString id = getId(item);
 
     changes << QSharedPointer<QMapboxGLStyleChange>(new QMapboxGLStyleRemoveLayer(id));
@@ -296,6 +373,40 @@ QList<QSharedPointer<QMapboxGLStyleChange>> QMapboxGLStyleChange::removeMapItem(
     return changes;
 }
 
+void QMapboxGLStyleChange::write(QDataStream &stream, const QMapboxGLStyleChange &change)
+{
+    stream << QByteArray(change.kind());
+    change.save(stream);
+}
+
+QSharedPointer<QMapboxGLStyleChange> QMapboxGLStyleChange::read(QDataStream &stream)
+{
+    QByteArray kind;
+    stream >> kind;
+
+    if (kind == "setLayoutProperty")
+        return QMapboxGLStyleSetLayoutProperty::fromStream(stream);
+    if (kind == "setPaintProperty")
+        return QMapboxGLStyleSetPaintProperty::fromStream(stream);
+    if (kind == "addLayer")
+        return QMapboxGLStyleAddLayer::fromStream(stream);
+    if (kind == "removeLayer")
+        return QMapboxGLStyleRemoveLayer::fromStream(stream);
+    if (kind == "addSource")
+        return QMapboxGLStyleAddSource::fromStream(stream);
+    if (kind == "removeSource")
+        return QMapboxGLStyleRemoveSource::fromStream(stream);
+    if (kind == "setFilter")
+        return QMapboxGLStyleSetFilter::fromStream(stream);
+    if (kind == "addImage")
+        return QMapboxGLStyleAddImage::fromStream(stream);
+
+    qWarning() << "Unknown style change in stream:" << kind;
+    stream.setStatus(QDataStream::ReadCorruptData);
+
+    return QSharedPointer<QMapboxGLStyleChange>();
+}
+
 // QMapboxGLStyleSetLayoutProperty
 
 void QMapboxGLStyleSetLayoutProperty::apply(QMapboxGL *map)
@@ -303,6 +414,21 @@ void QMapboxGLStyleSetLayoutProperty::apply(QMapboxGL *map)
     map->setLayoutProperty(m_layer, m_property, m_value);
 }
 
+void QMapboxGLStyleSetLayoutProperty::save(QDataStream &stream) const
+{
+    stream << m_layer << m_property;
+    writeValue(stream, m_value);
+}
+
+QSharedPointer<QMapboxGLStyleChange> QMapboxGLStyleSetLayoutProperty::fromStream(QDataStream &stream)
+{
+    auto layout = new QMapboxGLStyleSetLayoutProperty();
+    stream >> layout->m_layer >> layout->m_property;
+    layout->m_value = readValue(stream);
+
+    return QSharedPointer<QMapboxGLStyleChange>(layout);
+}
+
 QList<QSharedPointer<QMapboxGLStyleChange>> QMapboxGLStyleSetLayoutProperty::fromMapParameter(QGeoMapParameter *param)
 {
     Q_ASSERT(param->type() == "layout");
@@ -380,6 +506,21 @@ void QMapboxGLStyleSetPaintProperty::apply(QMapboxGL *map)
     map->setPaintProperty(m_layer, m_property, m_value);
 }
 
+void QMapboxGLStyleSetPaintProperty::save(QDataStream &stream) const
+{
+    stream << m_layer << m_property;
+    writeValue(stream, m_value);
+}
+
+QSharedPointer<QMapboxGLStyleChange> QMapboxGLStyleSetPaintProperty::fromStream(QDataStream &stream)
+{
+    auto paint = new QMapboxGLStyleSetPaintProperty();
+    stream >> paint->m_layer >> paint->m_property;
+    paint->m_value = readValue(stream);
+
+    return QSharedPointer<QMapboxGLStyleChange>(paint);
+}
+
 QList<QSharedPointer<QMapboxGLStyleChange>> QMapboxGLStyleSetPaintProperty::fromMapParameter(QGeoMapParameter *param)
 {
     Q_ASSERT(param->type() == "paint");
@@ -499,6 +640,21 @@ void QMapboxGLStyleAddLayer::apply(QMapboxGL *map)
     map->addLayer(m_params, m_before);
 }
 
+void QMapboxGLStyleAddLayer::save(QDataStream &stream) const
+{
+    writeMap(stream, m_params);
+    stream << m_before;
+}
+
+QSharedPointer<QMapboxGLStyleChange> QMapboxGLStyleAddLayer::fromStream(QDataStream &stream)
+{
+    auto layer = new QMapboxGLStyleAddLayer();
+    layer->m_params = readMap(stream);
+    stream >> layer->m_before;
+
+    return QSharedPointer<QMapboxGLStyleChange>(layer);
+}
+
 QSharedPointer<QMapboxGLStyleChange> QMapboxGLStyleAddLayer::fromMapParameter(QGeoMapParameter *param)
 {
     Q_ASSERT(param->type() == "layer");
@@ -557,6 +713,15 @@ QSharedPointer<QMapboxGLStyleChange> QMapboxGLStyleAddLayer::fromFeature(const Q
     return QSharedPointer<QMapboxGLStyleChange>(layer);
 }
 
+QSharedPointer<QMapboxGLStyleChange> QMapboxGLStyleAddLayer::fromParams(const QVariantMap &params, const QString &before)
+{
+    auto layer = new QMapboxGLStyleAddLayer();
+    layer->m_params = params;
+    layer->m_before = before;
+
+    return QSharedPointer<QMapboxGLStyleChange>(layer);
+}
+
 
 // QMapboxGLStyleRemoveLayer
 
@@ -565,6 +730,19 @@ void QMapboxGLStyleRemoveLayer::apply(QMapboxGL *map)
     map->removeLayer(m_id);
 }
 
+void QMapboxGLStyleRemoveLayer::save(QDataStream &stream) const
+{
+    stream << m_id;
+}
+
+QSharedPointer<QMapboxGLStyleChange> QMapboxGLStyleRemoveLayer::fromStream(QDataStream &stream)
+{
+    auto layer = new QMapboxGLStyleRemoveLayer();
+    stream >> layer->m_id;
+
+    return QSharedPointer<QMapboxGLStyleChange>(layer);
+}
+
 QMapboxGLStyleRemoveLayer::QMapboxGLStyleRemoveLayer(const QString &id) : m_id(id)
 {
 }
@@ -577,6 +755,21 @@ void QMapboxGLStyleAddSource::apply(QMapboxGL *map)
     map->updateSource(m_id, m_params);
 }
 
+void QMapboxGLStyleAddSource::save(QDataStream &stream) const
+{
+    stream << m_id;
+    writeMap(stream, m_params);
+}
+
+QSharedPointer<QMapboxGLStyleChange> QMapboxGLStyleAddSource::fromStream(QDataStream &stream)
+{
+    auto source = new QMapboxGLStyleAddSource();
+    stream >> source->m_id;
+    source->m_params = readMap(stream);
+
+    return QSharedPointer<QMapboxGLStyleChange>(source);
+}
+
 QSharedPointer<QMapboxGLStyleChange> QMapboxGLStyleAddSource::fromMapParameter(QGeoMapParameter *param)
 {
     Q_ASSERT(param->type() == "source");
@@ -608,6 +801,23 @@ QSharedPointer<QMapboxGLStyleChange> QMapboxGLStyleAddSource::fromMapParameter(Q
         } else {
             source->m_params[QStringLiteral("data")] = data.toUtf8();
         }
+
+        // Clustering runs on the Mapbox GL worker threads, the options are
+        // only read when the source is first added.
+        static const QStringList clusterProperties = QStringList()
+            << QStringLiteral("cluster") << QStringLiteral("clusterRadius")
+            << QStringLiteral("clusterMaxZoom") << QStringLiteral("clusterProperties");
+
+        for (const QString &propertyName : clusterProperties) {
+            QVariant value = param->property(propertyName.toLatin1());
+            if (!value.isValid())
+                continue;
+
+            if (value.canConvert<QJSValue>())
+                value = value.value<QJSValue>().toVariant();
+
+            source->m_params[propertyName] = value;
+        }
     } break;
     case 4: { // image
         source->m_params[QStringLiteral("url")] = param->property("url");
@@ -634,6 +844,19 @@ QSharedPointer<QMapboxGLStyleChange> QMapboxGLStyleAddSource::fromMapItem(QDecla
     return fromFeature(featureFromMapItem(item));
 }
 
+QSharedPointer<QMapboxGLStyleChange> QMapboxGLStyleAddSource::fromGeoJSON(const QString &id, const QByteArray &data,
+                                                                          const QVariantMap &options)
+{
+    auto source = new QMapboxGLStyleAddSource();
+
+    source->m_id = id;
+    source->m_params = options;
+    source->m_params[QStringLiteral("type")] = QStringLiteral("geojson");
+    source->m_params[QStringLiteral("data")] = data;
+
+    return QSharedPointer<QMapboxGLStyleChange>(source);
+}
+
 
 // QMapboxGLStyleRemoveSource
 
@@ -642,6 +865,19 @@ void QMapboxGLStyleRemoveSource::apply(QMapboxGL *map)
     map->removeSource(m_id);
 }
 
+void QMapboxGLStyleRemoveSource::save(QDataStream &stream) const
+{
+    stream << m_id;
+}
+
+QSharedPointer<QMapboxGLStyleChange> QMapboxGLStyleRemoveSource::fromStream(QDataStream &stream)
+{
+    auto source = new QMapboxGLStyleRemoveSource();
+    stream >> source->m_id;
+
+    return QSharedPointer<QMapboxGLStyleChange>(source);
+}
+
 QMapboxGLStyleRemoveSource::QMapboxGLStyleRemoveSource(const QString &id) : m_id(id)
 {
 }
@@ -654,6 +890,21 @@ void QMapboxGLStyleSetFilter::apply(QMapboxGL *map)
     map->setFilter(m_layer, m_filter);
 }
 
+void QMapboxGLStyleSetFilter::save(QDataStream &stream) const
+{
+    stream << m_layer;
+    writeValue(stream, m_filter);
+}
+
+QSharedPointer<QMapboxGLStyleChange> QMapboxGLStyleSetFilter::fromStream(QDataStream &stream)
+{
+    auto filter = new QMapboxGLStyleSetFilter();
+    stream >> filter->m_layer;
+    filter->m_filter = readValue(stream);
+
+    return QSharedPointer<QMapboxGLStyleChange>(filter);
+}
+
 QSharedPointer<QMapboxGLStyleChange> QMapboxGLStyleSetFilter::fromMapParameter(QGeoMapParameter *param)
 {
     Q_ASSERT(param->type() == "filter");
@@ -673,6 +924,19 @@ void QMapboxGLStyleAddImage::apply(QMapboxGL *map)
     map->addImage(m_name, m_sprite);
 }
 
+void QMapboxGLStyleAddImage::save(QDataStream &stream) const
+{
+    stream << m_name << m_sprite;
+}
+
+QSharedPointer<QMapboxGLStyleChange> QMapboxGLStyleAddImage::fromStream(QDataStream &stream)
+{
+    auto image = new QMapboxGLStyleAddImage();
+    stream >> image->m_name >> image->m_sprite;
+
+    return QSharedPointer<QMapboxGLStyleChange>(image);
+}
+
 QSharedPointer<QMapboxGLStyleChange> QMapboxGLStyleAddImage::fromMapParameter(QGeoMapParameter *param)
 {
     Q_ASSERT(param->type() == "image");
@@ -683,3 +947,12 @@ QSharedPointer<QMapboxGLStyleChange> QMapboxGLStyleAddImage::fromMapParameter(QG
 
     return QSharedPointer<QMapboxGLStyleChange>(image);
 }
+
+QSharedPointer<QMapboxGLStyleChange> QMapboxGLStyleAddImage::fromImage(const QString &name, const QImage &sprite)
+{
+    auto image = new QMapboxGLStyleAddImage();
+    image->m_name = name;
+    image->m_sprite = sprite;
+
+    return QSharedPointer<QMapboxGLStyleChange>(image);
+}
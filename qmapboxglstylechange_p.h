@@ -37,6 +37,7 @@
 #ifndef QQMAPBOXGLSTYLECHANGE_P_H
 #define QQMAPBOXGLSTYLECHANGE_P_H
 
+#include <QtCore/QDataStream>
 #include <QtCore/QList>
 #include <QtCore/QSharedPointer>
 #include <QtCore/QString>
@@ -62,7 +63,13 @@ public:
     static QList<QSharedPointer<QMapboxGLStyleChange>> removeMapParameter(QGeoMapParameter *);
     static QList<QSharedPointer<QMapboxGLStyleChange>> removeMapItem(QDeclarativeGeoMapItemBase *);
 
+    // Binary form used to record and replay style change streams.
+    static void write(QDataStream &stream, const QMapboxGLStyleChange &change);
+    static QSharedPointer<QMapboxGLStyleChange> read(QDataStream &stream);
+
     virtual void apply(QMapboxGL *map) = 0;
+    virtual const char *kind() const = 0;
+    virtual void save(QDataStream &stream) const = 0;
 };
 
 class QMapboxGLStyleSetLayoutProperty : public QMapboxGLStyleChange
@@ -70,8 +77,11 @@ class QMapboxGLStyleSetLayoutProperty : public QMapboxGLStyleChange
 public:
     static QList<QSharedPointer<QMapboxGLStyleChange>> fromMapParameter(QGeoMapParameter *);
     static QList<QSharedPointer<QMapboxGLStyleChange>> fromMapItem(QDeclarativeGeoMapItemBase *);
+    static QSharedPointer<QMapboxGLStyleChange> fromStream(QDataStream &stream);
 
     void apply(QMapboxGL *map) override;
+    const char *kind() const override { return "setLayoutProperty"; }
+    void save(QDataStream &stream) const override;
 
 private:
     static QList<QSharedPointer<QMapboxGLStyleChange>> fromMapItem(QDeclarativePolylineMapItem *);
@@ -89,8 +99,11 @@ class QMapboxGLStyleSetPaintProperty : public QMapboxGLStyleChange
 public:
     static QList<QSharedPointer<QMapboxGLStyleChange>> fromMapParameter(QGeoMapParameter *);
     static QList<QSharedPointer<QMapboxGLStyleChange>> fromMapItem(QDeclarativeGeoMapItemBase *);
+    static QSharedPointer<QMapboxGLStyleChange> fromStream(QDataStream &stream);
 
     void apply(QMapboxGL *map) override;
+    const char *kind() const override { return "setPaintProperty"; }
+    void save(QDataStream &stream) const override;
 
 private:
     static QList<QSharedPointer<QMapboxGLStyleChange>> fromMapItem(QDeclarativeRectangleMapItem *);
@@ -111,8 +124,12 @@ class QMapboxGLStyleAddLayer : public QMapboxGLStyleChange
 public:
     static QSharedPointer<QMapboxGLStyleChange> fromMapParameter(QGeoMapParameter *);
     static QSharedPointer<QMapboxGLStyleChange> fromFeature(const QMapbox::Feature &feature, const QString &before);
+    static QSharedPointer<QMapboxGLStyleChange> fromParams(const QVariantMap &params, const QString &before);
+    static QSharedPointer<QMapboxGLStyleChange> fromStream(QDataStream &stream);
 
     void apply(QMapboxGL *map) override;
+    const char *kind() const override { return "addLayer"; }
+    void save(QDataStream &stream) const override;
 
 private:
     QMapboxGLStyleAddLayer() = default;
@@ -126,7 +143,11 @@ class QMapboxGLStyleRemoveLayer : public QMapboxGLStyleChange
 public:
     explicit QMapboxGLStyleRemoveLayer(const QString &id);
 
+    static QSharedPointer<QMapboxGLStyleChange> fromStream(QDataStream &stream);
+
     void apply(QMapboxGL *map) override;
+    const char *kind() const override { return "removeLayer"; }
+    void save(QDataStream &stream) const override;
 
 private:
     QMapboxGLStyleRemoveLayer() = default;
@@ -140,8 +161,13 @@ public:
     static QSharedPointer<QMapboxGLStyleChange> fromMapParameter(QGeoMapParameter *);
     static QSharedPointer<QMapboxGLStyleChange> fromFeature(const QMapbox::Feature &feature);
     static QSharedPointer<QMapboxGLStyleChange> fromMapItem(QDeclarativeGeoMapItemBase *);
+    static QSharedPointer<QMapboxGLStyleChange> fromGeoJSON(const QString &id, const QByteArray &data,
+                                                           const QVariantMap &options = QVariantMap());
+    static QSharedPointer<QMapboxGLStyleChange> fromStream(QDataStream &stream);
 
     void apply(QMapboxGL *map) override;
+    const char *kind() const override { return "addSource"; }
+    void save(QDataStream &stream) const override;
 
 private:
     QMapboxGLStyleAddSource() = default;
@@ -155,7 +181,11 @@ class QMapboxGLStyleRemoveSource : public QMapboxGLStyleChange
 public:
     explicit QMapboxGLStyleRemoveSource(const QString &id);
 
+    static QSharedPointer<QMapboxGLStyleChange> fromStream(QDataStream &stream);
+
     void apply(QMapboxGL *map) override;
+    const char *kind() const override { return "removeSource"; }
+    void save(QDataStream &stream) const override;
 
 private:
     QMapboxGLStyleRemoveSource() = default;
@@ -167,8 +197,11 @@ class QMapboxGLStyleSetFilter : public QMapboxGLStyleChange
 {
 public:
     static QSharedPointer<QMapboxGLStyleChange> fromMapParameter(QGeoMapParameter *);
+    static QSharedPointer<QMapboxGLStyleChange> fromStream(QDataStream &stream);
 
     void apply(QMapboxGL *map) override;
+    const char *kind() const override { return "setFilter"; }
+    void save(QDataStream &stream) const override;
 
 private:
     QMapboxGLStyleSetFilter() = default;
@@ -181,8 +214,12 @@ class QMapboxGLStyleAddImage : public QMapboxGLStyleChange
 {
 public:
     static QSharedPointer<QMapboxGLStyleChange> fromMapParameter(QGeoMapParameter *);
+    static QSharedPointer<QMapboxGLStyleChange> fromImage(const QString &name, const QImage &sprite);
+    static QSharedPointer<QMapboxGLStyleChange> fromStream(QDataStream &stream);
 
     void apply(QMapboxGL *map) override;
+    const char *kind() const override { return "addImage"; }
+    void save(QDataStream &stream) const override;
 
 private:
     QMapboxGLStyleAddImage() = default;
@@ -0,0 +1,80 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Copyright (C) 2017 Mapbox, Inc.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the QtLocation module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL3$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or later as published by the Free
+** Software Foundation and appearing in the file LICENSE.GPL included in
+** the packaging of this file. Please review the following information to
+** ensure the GNU General Public License version 2.0 requirements will be
+** met: http://www.gnu.org/licenses/gpl-2.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qmapboxglstyleresources_p.h"
+
+#include <QtCore/QJsonArray>
+#include <QtCore/QSet>
+#include <QtCore/QUrl>
+
+QString QMapboxGLStyleResources::spriteUrl(const QString &base, const QString &extension, bool highDpi)
+{
+    const int query = base.indexOf(QLatin1Char('?'));
+    const QString path = query < 0 ? base : base.left(query);
+    const QString suffix = query < 0 ? QString() : base.mid(query);
+
+    return path + (highDpi ? QStringLiteral("@2x") : QString()) + extension + suffix;
+}
+
+QStringList QMapboxGLStyleResources::fontStacks(const QJsonObject &style)
+{
+    QSet<QString> fontStacks;
+    for (const QJsonValue &layer : style.value(QStringLiteral("layers")).toArray()) {
+        const QJsonArray fonts = layer.toObject().value(QStringLiteral("layout")).toObject()
+                .value(QStringLiteral("text-font")).toArray();
+
+        QStringList names;
+        for (const QJsonValue &font : fonts) {
+            if (font.isString())
+                names << font.toString();
+        }
+
+        if (!names.isEmpty() && names.size() == fonts.size())
+            fontStacks.insert(names.join(QLatin1Char(',')));
+    }
+
+    return fontStacks.values();
+}
+
+QString QMapboxGLStyleResources::glyphsUrl(const QString &glyphs, const QString &fontStack, int start)
+{
+    QString url = glyphs;
+    url.replace(QStringLiteral("{fontstack}"), QString::fromLatin1(QUrl::toPercentEncoding(fontStack)));
+    url.replace(QStringLiteral("{range}"), QStringLiteral("%1-%2").arg(start).arg(start + 255));
+
+    return url;
+}
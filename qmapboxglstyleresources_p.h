@@ -0,0 +1,61 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Copyright (C) 2017 Mapbox, Inc.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the QtLocation module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL3$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or later as published by the Free
+** Software Foundation and appearing in the file LICENSE.GPL included in
+** the packaging of this file. Please review the following information to
+** ensure the GNU General Public License version 2.0 requirements will be
+** met: http://www.gnu.org/licenses/gpl-2.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QMAPBOXGLSTYLERESOURCES_P_H
+#define QMAPBOXGLSTYLERESOURCES_P_H
+
+#include <QtCore/QJsonObject>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+
+// URLs of the resources a style refers to besides its sources, built the
+// way Mapbox GL builds them when loading the style.
+class QMapboxGLStyleResources
+{
+public:
+    // sprite.png -> sprite@2x.png, keeping any query string at the end.
+    static QString spriteUrl(const QString &base, const QString &extension, bool highDpi);
+
+    // Font stacks named in the text-font of the layers, joined by commas.
+    // Stacks given as expressions are left out.
+    static QStringList fontStacks(const QJsonObject &style);
+
+    // One 256 character range of a font stack.
+    static QString glyphsUrl(const QString &glyphs, const QString &fontStack, int start);
+};
+
+#endif // QMAPBOXGLSTYLERESOURCES_P_H
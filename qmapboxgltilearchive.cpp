@@ -0,0 +1,483 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Copyright (C) 2017 Mapbox, Inc.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the QtLocation module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL3$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or later as published by the Free
+** Software Foundation and appearing in the file LICENSE.GPL included in
+** the packaging of this file. Please review the following information to
+** ensure the GNU General Public License version 2.0 requirements will be
+** met: http://www.gnu.org/licenses/gpl-2.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qmapboxgltilearchive_p.h"
+
+#include <QtCore/QFileInfo>
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QUrl>
+#include <QtSql/QSqlDatabase>
+
+#include <QDebug>
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace {
+
+// PMTiles version 3 header layout.
+const int pmtilesHeaderSize = 127;
+
+enum PMTilesCompression {
+    UnknownCompression = 0,
+    NoCompression = 1,
+    GzipCompression = 2
+};
+
+enum PMTilesTileType {
+    UnknownTileType = 0,
+    VectorTileType = 1,
+    PngTileType = 2,
+    JpegTileType = 3,
+    WebpTileType = 4
+};
+
+// Leaf directories nest at most this deep below the root.
+const int pmtilesMaximumDepth = 4;
+
+// Decoded leaf directories kept around, a few hundred kilobytes each at most.
+const int pmtilesMaximumCachedLeaves = 256;
+
+quint64 readUInt64(const uchar *data)
+{
+    quint64 value = 0;
+    for (int i = 7; i >= 0; --i)
+        value = (value << 8) | data[i];
+    return value;
+}
+
+qint32 readInt32(const uchar *data)
+{
+    return qint32(quint32(data[0]) | quint32(data[1]) << 8 | quint32(data[2]) << 16 | quint32(data[3]) << 24);
+}
+
+bool readVarint(const uchar **data, const uchar *end, quint64 *value)
+{
+    *value = 0;
+    for (int shift = 0; shift < 64 && *data < end; shift += 7) {
+        const uchar byte = *(*data)++;
+        *value |= quint64(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+bool isGzip(const QByteArray &data)
+{
+    return data.size() > 2 && uchar(data[0]) == 0x1f && uchar(data[1]) == 0x8b;
+}
+
+// Tiles of all lower zoom levels come first, then the tiles of the zoom
+// level along a Hilbert curve.
+quint64 tileId(int z, quint32 x, quint32 y)
+{
+    quint64 id = ((quint64(1) << (2 * z)) - 1) / 3;
+
+    for (quint32 s = (1u << z) >> 1; s > 0; s >>= 1) {
+        const quint32 rx = (x & s) ? 1 : 0;
+        const quint32 ry = (y & s) ? 1 : 0;
+        id += quint64(s) * s * ((3 * rx) ^ ry);
+
+        if (!ry) {
+            if (rx) {
+                x = s - 1 - x;
+                y = s - 1 - y;
+            }
+            qSwap(x, y);
+        }
+    }
+
+    return id;
+}
+
+QString fileNameFromUrl(const QString &url)
+{
+    return QUrl(url).path();
+}
+
+} // namespace
+
+// QMapboxGLTileArchive
+
+QMapboxGLTileArchive::~QMapboxGLTileArchive()
+{
+}
+
+bool QMapboxGLTileArchive::isArchiveUrl(const QString &url)
+{
+    return url.startsWith(QStringLiteral("mbtiles://")) || url.startsWith(QStringLiteral("pmtiles://"));
+}
+
+QMapboxGLTileArchive *QMapboxGLTileArchive::open(const QString &url)
+{
+    const QString fileName = fileNameFromUrl(url);
+
+    if (url.startsWith(QStringLiteral("mbtiles://"))) {
+        QMapboxGLMBTilesArchive *archive = new QMapboxGLMBTilesArchive(fileName);
+        if (archive->isValid())
+            return archive;
+        delete archive;
+    } else if (url.startsWith(QStringLiteral("pmtiles://"))) {
+        QMapboxGLPMTilesArchive *archive = new QMapboxGLPMTilesArchive(fileName);
+        if (archive->isValid())
+            return archive;
+        delete archive;
+    }
+
+    qWarning() << "Unable to open the tile archive" << url;
+    return nullptr;
+}
+
+QByteArray QMapboxGLTileArchive::gunzip(const QByteArray &data)
+{
+    z_stream stream = {};
+    if (inflateInit2(&stream, 16 + MAX_WBITS) != Z_OK)
+        return QByteArray();
+
+    QByteArray result;
+    char buffer[16384];
+
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.constData()));
+    stream.avail_in = uInt(data.size());
+
+    int status = Z_OK;
+    while (status == Z_OK) {
+        stream.next_out = reinterpret_cast<Bytef *>(buffer);
+        stream.avail_out = sizeof(buffer);
+        status = inflate(&stream, Z_NO_FLUSH);
+        result.append(buffer, int(sizeof(buffer) - stream.avail_out));
+    }
+
+    inflateEnd(&stream);
+
+    return status == Z_STREAM_END ? result : QByteArray();
+}
+
+QJsonObject QMapboxGLTileArchive::tileJson() const
+{
+    return m_tileJson;
+}
+
+bool QMapboxGLTileArchive::isVector() const
+{
+    return m_tileJson.value(QStringLiteral("format")).toString() == QStringLiteral("pbf");
+}
+
+// QMapboxGLMBTilesArchive
+
+QMapboxGLMBTilesArchive::QMapboxGLMBTilesArchive(const QString &fileName)
+    : m_connectionName(QStringLiteral("qmapboxgl-mbtiles-%1").arg(quintptr(this), 0, 16))
+{
+    if (!QFileInfo(fileName).isFile())
+        return;
+
+    QSqlDatabase db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), m_connectionName);
+    db.setDatabaseName(fileName);
+    db.setConnectOptions(QStringLiteral("QSQLITE_OPEN_READONLY"));
+    if (!db.open())
+        return;
+
+    QSqlQuery query(db);
+    query.exec(QStringLiteral("PRAGMA mmap_size = %1").arg(QFileInfo(fileName).size()));
+
+    if (!query.exec(QStringLiteral("SELECT name, value FROM metadata")))
+        return;
+
+    QString format = QStringLiteral("png");
+    while (query.next()) {
+        const QString name = query.value(0).toString();
+        const QString value = query.value(1).toString();
+
+        if (name == QStringLiteral("format")) {
+            format = value;
+        } else if (name == QStringLiteral("minzoom") || name == QStringLiteral("maxzoom")) {
+            m_tileJson[name] = value.toInt();
+        } else if (name == QStringLiteral("bounds") || name == QStringLiteral("center")) {
+            QJsonArray array;
+            for (const QString &number : value.split(QLatin1Char(',')))
+                array.append(number.trimmed().toDouble());
+            m_tileJson[name] = array;
+        } else if (name == QStringLiteral("json")) {
+            const QJsonObject json = QJsonDocument::fromJson(value.toUtf8()).object();
+            if (json.contains(QStringLiteral("vector_layers")))
+                m_tileJson[QStringLiteral("vector_layers")] = json.value(QStringLiteral("vector_layers"));
+        } else if (name == QStringLiteral("name") || name == QStringLiteral("attribution")) {
+            m_tileJson[name] = value;
+        }
+    }
+
+    m_tileJson[QStringLiteral("format")] = format;
+
+    m_query.reset(new QSqlQuery(db));
+    m_query->setForwardOnly(true);
+    m_valid = m_query->prepare(QStringLiteral("SELECT tile_data FROM tiles WHERE zoom_level = ? AND tile_column = ? AND tile_row = ?"));
+}
+
+QMapboxGLMBTilesArchive::~QMapboxGLMBTilesArchive()
+{
+    m_query.reset();
+
+    if (!QSqlDatabase::contains(m_connectionName))
+        return;
+
+    QSqlDatabase::database(m_connectionName, false).close();
+    QSqlDatabase::removeDatabase(m_connectionName);
+}
+
+bool QMapboxGLMBTilesArchive::isValid() const
+{
+    return m_valid;
+}
+
+bool QMapboxGLMBTilesArchive::tile(int z, int x, int y, QByteArray *data, bool *gzipped)
+{
+    if (z < 0 || z > 30)
+        return false;
+
+    m_query->bindValue(0, z);
+    m_query->bindValue(1, x);
+    m_query->bindValue(2, (1 << z) - 1 - y);    // TMS rows count from the south
+
+    const bool found = m_query->exec() && m_query->next();
+    if (found) {
+        *data = m_query->value(0).toByteArray();
+        *gzipped = isGzip(*data);
+    }
+
+    m_query->finish();
+
+    return found;
+}
+
+// QMapboxGLPMTilesArchive
+
+QMapboxGLPMTilesArchive::QMapboxGLPMTilesArchive(const QString &fileName)
+    : m_file(fileName)
+{
+    if (!m_file.open(QIODevice::ReadOnly))
+        return;
+
+    m_size = quint64(m_file.size());
+    if (m_size < quint64(pmtilesHeaderSize))
+        return;
+
+    m_data = m_file.map(0, m_file.size());
+    if (!m_data) {
+        qWarning() << "Unable to memory map" << fileName;
+        return;
+    }
+
+    if (memcmp(m_data, "PMTiles", 7) != 0 || m_data[7] != 3) {
+        qWarning() << fileName << "is not a version 3 PMTiles archive";
+        m_data = nullptr;
+        return;
+    }
+
+    const quint64 rootOffset = readUInt64(m_data + 8);
+    const quint64 rootLength = readUInt64(m_data + 16);
+    const quint64 metadataOffset = readUInt64(m_data + 24);
+    const quint64 metadataLength = readUInt64(m_data + 32);
+    m_leafDirectoryOffset = readUInt64(m_data + 40);
+    m_tileDataOffset = readUInt64(m_data + 56);
+    m_internalCompression = m_data[97];
+    m_tileCompression = m_data[98];
+
+    if (m_internalCompression != NoCompression && m_internalCompression != GzipCompression) {
+        qWarning() << fileName << "uses an unsupported directory compression";
+        m_data = nullptr;
+        return;
+    }
+
+    // Brotli and zstd tiles could only be passed on with a content encoding
+    // the network stack of Mapbox GL does not decode.
+    if (m_tileCompression != NoCompression && m_tileCompression != GzipCompression) {
+        qWarning() << fileName << "uses an unsupported tile compression";
+        m_data = nullptr;
+        return;
+    }
+
+    if (!readDirectory(rootOffset, rootLength, &m_root)) {
+        m_data = nullptr;
+        return;
+    }
+
+    QByteArray metadata = slice(metadataOffset, metadataLength);
+    if (m_internalCompression == GzipCompression)
+        metadata = gunzip(metadata);
+    const QJsonObject json = QJsonDocument::fromJson(metadata).object();
+
+    switch (m_data[99]) {
+    case VectorTileType:
+        m_tileJson[QStringLiteral("format")] = QStringLiteral("pbf");
+        break;
+    case JpegTileType:
+        m_tileJson[QStringLiteral("format")] = QStringLiteral("jpg");
+        break;
+    case WebpTileType:
+        m_tileJson[QStringLiteral("format")] = QStringLiteral("webp");
+        break;
+    default:
+        m_tileJson[QStringLiteral("format")] = QStringLiteral("png");
+        break;
+    }
+
+    m_tileJson[QStringLiteral("minzoom")] = int(m_data[100]);
+    m_tileJson[QStringLiteral("maxzoom")] = int(m_data[101]);
+    m_tileJson[QStringLiteral("bounds")] = QJsonArray {
+        readInt32(m_data + 102) / 1e7, readInt32(m_data + 106) / 1e7,
+        readInt32(m_data + 110) / 1e7, readInt32(m_data + 114) / 1e7 };
+    m_tileJson[QStringLiteral("center")] = QJsonArray {
+        readInt32(m_data + 119) / 1e7, readInt32(m_data + 123) / 1e7, int(m_data[118]) };
+
+    for (const QString &key : { QStringLiteral("vector_layers"), QStringLiteral("name"), QStringLiteral("attribution") }) {
+        if (json.contains(key))
+            m_tileJson[key] = json.value(key);
+    }
+}
+
+bool QMapboxGLPMTilesArchive::isValid() const
+{
+    return m_data != nullptr;
+}
+
+QByteArray QMapboxGLPMTilesArchive::slice(quint64 offset, quint64 length) const
+{
+    if (offset > m_size || length > m_size - offset || length > quint64(std::numeric_limits<int>::max()))
+        return QByteArray();
+
+    return QByteArray::fromRawData(reinterpret_cast<const char *>(m_data + offset), int(length));
+}
+
+bool QMapboxGLPMTilesArchive::readDirectory(quint64 offset, quint64 length, Directory *directory) const
+{
+    QByteArray bytes = slice(offset, length);
+    if (m_internalCompression == GzipCompression)
+        bytes = gunzip(bytes);
+
+    if (bytes.isEmpty())
+        return false;
+
+    const uchar *data = reinterpret_cast<const uchar *>(bytes.constData());
+    const uchar *end = data + bytes.size();
+
+    quint64 count = 0;
+    if (!readVarint(&data, end, &count) || count > quint64(bytes.size()))
+        return false;
+
+    directory->resize(int(count));
+
+    // Columns: tile id deltas, run lengths, lengths, offsets.
+    quint64 value = 0;
+    quint64 lastId = 0;
+    for (Entry &entry : *directory) {
+        if (!readVarint(&data, end, &value))
+            return false;
+        lastId += value;
+        entry.tileId = lastId;
+    }
+
+    for (Entry &entry : *directory) {
+        if (!readVarint(&data, end, &value))
+            return false;
+        entry.runLength = quint32(value);
+    }
+
+    for (Entry &entry : *directory) {
+        if (!readVarint(&data, end, &value))
+            return false;
+        entry.length = quint32(value);
+    }
+
+    for (int i = 0; i < directory->size(); ++i) {
+        if (!readVarint(&data, end, &value))
+            return false;
+
+        // Zero means right after the previous entry.
+        Entry &entry = (*directory)[i];
+        entry.offset = (value == 0 && i > 0) ? directory->at(i - 1).offset + directory->at(i - 1).length : value - 1;
+    }
+
+    return true;
+}
+
+bool QMapboxGLPMTilesArchive::tile(int z, int x, int y, QByteArray *data, bool *gzipped)
+{
+    if (z < 0 || z > 26 || x < 0 || y < 0 || x >= (1 << z) || y >= (1 << z))
+        return false;
+
+    const quint64 id = tileId(z, quint32(x), quint32(y));
+    const Directory *directory = &m_root;
+
+    for (int depth = 0; depth < pmtilesMaximumDepth; ++depth) {
+        // Last entry starting at or before the tile.
+        auto it = std::upper_bound(directory->cbegin(), directory->cend(), id,
+                [](quint64 id, const Entry &entry) { return id < entry.tileId; });
+        if (it == directory->cbegin())
+            return false;
+        const Entry &entry = *(it - 1);
+
+        if (entry.runLength > 0) {
+            if (id - entry.tileId >= entry.runLength)
+                return false;
+
+            *data = slice(m_tileDataOffset + entry.offset, entry.length);
+            *gzipped = m_tileCompression == GzipCompression;
+            return !data->isEmpty();
+        }
+
+        // A run length of zero points to a leaf directory.
+        const quint64 leafOffset = entry.offset;
+        auto leaf = m_leaves.find(leafOffset);
+        if (leaf == m_leaves.end()) {
+            Directory entries;
+            if (!readDirectory(m_leafDirectoryOffset + leafOffset, entry.length, &entries))
+                return false;
+            if (m_leaves.size() >= pmtilesMaximumCachedLeaves)
+                m_leaves.clear();
+            leaf = m_leaves.insert(leafOffset, entries);
+        }
+
+        directory = &leaf.value();
+    }
+
+    return false;
+}
@@ -0,0 +1,132 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Copyright (C) 2017 Mapbox, Inc.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the QtLocation module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL3$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or later as published by the Free
+** Software Foundation and appearing in the file LICENSE.GPL included in
+** the packaging of this file. Please review the following information to
+** ensure the GNU General Public License version 2.0 requirements will be
+** met: http://www.gnu.org/licenses/gpl-2.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QMAPBOXGLTILEARCHIVE_P_H
+#define QMAPBOXGLTILEARCHIVE_P_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QFile>
+#include <QtCore/QHash>
+#include <QtCore/QJsonObject>
+#include <QtCore/QScopedPointer>
+#include <QtCore/QString>
+#include <QtCore/QVector>
+#include <QtSql/QSqlQuery>
+
+// Read only access to a local tile archive, named by an mbtiles:// or
+// pmtiles:// URL followed by the absolute path of the file.
+//
+// Not thread safe, an archive has to be opened and read on one thread.
+class QMapboxGLTileArchive
+{
+public:
+    virtual ~QMapboxGLTileArchive();
+
+    static bool isArchiveUrl(const QString &url);
+    static QMapboxGLTileArchive *open(const QString &url);
+
+    // Returns false when the archive has no such tile. The data may point
+    // straight into the mapped file and stays valid as long as the archive.
+    virtual bool tile(int z, int x, int y, QByteArray *data, bool *gzipped) = 0;
+
+    // TileJSON fields: format, minzoom, maxzoom, bounds, center and,
+    // for vector tiles, vector_layers.
+    QJsonObject tileJson() const;
+    bool isVector() const;
+
+    static QByteArray gunzip(const QByteArray &data);
+
+protected:
+    QMapboxGLTileArchive() = default;
+
+    QJsonObject m_tileJson;
+};
+
+// MBTiles are SQLite databases, so tiles are read through SQLite with the
+// whole file memory mapped rather than sliced out of the file directly.
+class QMapboxGLMBTilesArchive : public QMapboxGLTileArchive
+{
+public:
+    explicit QMapboxGLMBTilesArchive(const QString &fileName);
+    ~QMapboxGLMBTilesArchive();
+
+    bool isValid() const;
+    bool tile(int z, int x, int y, QByteArray *data, bool *gzipped) override;
+
+private:
+    QString m_connectionName;
+    QScopedPointer<QSqlQuery> m_query;
+    bool m_valid = false;
+};
+
+// PMTiles version 3, with the file memory mapped and tiles returned as
+// slices of the mapping. The root directory is decoded up front, leaf
+// directories the first time a tile in them is asked for.
+class QMapboxGLPMTilesArchive : public QMapboxGLTileArchive
+{
+public:
+    explicit QMapboxGLPMTilesArchive(const QString &fileName);
+
+    bool isValid() const;
+    bool tile(int z, int x, int y, QByteArray *data, bool *gzipped) override;
+
+private:
+    struct Entry {
+        quint64 tileId;
+        quint64 offset;
+        quint32 length;
+        quint32 runLength;
+    };
+    typedef QVector<Entry> Directory;
+
+    bool readDirectory(quint64 offset, quint64 length, Directory *directory) const;
+    QByteArray slice(quint64 offset, quint64 length) const;
+
+    QFile m_file;
+    const uchar *m_data = nullptr;
+    quint64 m_size = 0;
+
+    quint64 m_leafDirectoryOffset = 0;
+    quint64 m_tileDataOffset = 0;
+    int m_internalCompression = 0;
+    int m_tileCompression = 0;
+
+    Directory m_root;
+    QHash<quint64, Directory> m_leaves;
+};
+
+#endif // QMAPBOXGLTILEARCHIVE_P_H
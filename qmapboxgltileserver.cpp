@@ -0,0 +1,802 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Copyright (C) 2017 Mapbox, Inc.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the QtLocation module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL3$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or later as published by the Free
+** Software Foundation and appearing in the file LICENSE.GPL included in
+** the packaging of this file. Please review the following information to
+** ensure the GNU General Public License version 2.0 requirements will be
+** met: http://www.gnu.org/licenses/gpl-2.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qmapboxgltileserver_p.h"
+#include "qmapboxglrequestscheduler_p.h"
+#include "qmapboxgltilearchive_p.h"
+
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QJsonObject>
+#include <QtCore/QMessageAuthenticationCode>
+#include <QtCore/QRandomGenerator>
+#include <QtNetwork/QHostAddress>
+#include <QtNetwork/QNetworkAccessManager>
+#include <QtNetwork/QNetworkReply>
+#include <QtNetwork/QTcpServer>
+#include <QtNetwork/QTcpSocket>
+
+#include <QDebug>
+
+#include <algorithm>
+
+namespace {
+
+// Requests are a single line and a few headers, anything bigger is not
+// coming from Mapbox GL.
+const int maximumRequestSize = 16384;
+
+// Qt opens at most six connections per host and port. Listening on a few
+// ports lets Mapbox GL hand over all of its concurrent requests, so that
+// the queue has something to rank.
+const int proxyPorts = 4;
+
+// Hop by hop headers, and the ones the network stack sets by itself.
+bool isForwardedHeader(const QByteArray &name)
+{
+    static const QList<QByteArray> skipped = QList<QByteArray>()
+        << "host" << "connection" << "keep-alive" << "proxy-connection" << "transfer-encoding"
+        << "content-length" << "content-encoding" << "accept-encoding" << "te" << "upgrade";
+
+    return !skipped.contains(name.toLower());
+}
+
+QByteArray contentType(const QString &format)
+{
+    if (format == QStringLiteral("pbf"))
+        return QByteArrayLiteral("application/x-protobuf");
+    if (format == QStringLiteral("jpg") || format == QStringLiteral("jpeg"))
+        return QByteArrayLiteral("image/jpeg");
+    if (format == QStringLiteral("webp"))
+        return QByteArrayLiteral("image/webp");
+    return QByteArrayLiteral("image/png");
+}
+
+// Something to look at for archives used directly as a map type: the
+// raster tiles as they are, or every vector layer drawn in one color.
+QJsonObject defaultStyle(const QMapboxGLTileArchive *archive, const QString &tileJsonUrl)
+{
+    const bool vector = archive->isVector();
+
+    QJsonObject source;
+    source[QStringLiteral("type")] = vector ? QStringLiteral("vector") : QStringLiteral("raster");
+    source[QStringLiteral("url")] = tileJsonUrl;
+    if (!vector)
+        source[QStringLiteral("tileSize")] = 256;
+
+    QJsonArray layers;
+    QJsonObject background;
+    background[QStringLiteral("id")] = QStringLiteral("background");
+    background[QStringLiteral("type")] = QStringLiteral("background");
+    background[QStringLiteral("paint")] = QJsonObject { { QStringLiteral("background-color"), QStringLiteral("#f8f4f0") } };
+    layers.append(background);
+
+    if (!vector) {
+        layers.append(QJsonObject {
+            { QStringLiteral("id"), QStringLiteral("archive") },
+            { QStringLiteral("type"), QStringLiteral("raster") },
+            { QStringLiteral("source"), QStringLiteral("archive") } });
+    }
+
+    const QJsonArray vectorLayers = archive->tileJson().value(QStringLiteral("vector_layers")).toArray();
+    for (const QJsonValue &vectorLayer : vectorLayers) {
+        const QString id = vectorLayer.toObject().value(QStringLiteral("id")).toString();
+
+        struct { const char *type; const char *geometry; const char *property; } kinds[] = {
+            { "fill", "Polygon", "fill-opacity" },
+            { "line", "LineString", "line-opacity" },
+            { "circle", "Point", "circle-opacity" }
+        };
+
+        for (const auto &kind : kinds) {
+            QJsonObject layer;
+            layer[QStringLiteral("id")] = id + QLatin1Char('-') + QLatin1String(kind.type);
+            layer[QStringLiteral("type")] = QLatin1String(kind.type);
+            layer[QStringLiteral("source")] = QStringLiteral("archive");
+            layer[QStringLiteral("source-layer")] = id;
+            layer[QStringLiteral("filter")] = QJsonArray { QStringLiteral("=="), QStringLiteral("$type"), QLatin1String(kind.geometry) };
+            layer[QStringLiteral("paint")] = QJsonObject { { QLatin1String(kind.property), 0.6 } };
+            layers.append(layer);
+        }
+    }
+
+    QJsonObject style;
+    style[QStringLiteral("version")] = 8;
+    style[QStringLiteral("sources")] = QJsonObject { { QStringLiteral("archive"), source } };
+    style[QStringLiteral("layers")] = layers;
+
+    return style;
+}
+
+// Takes the same time wherever the first difference is, so the signature
+// cannot be guessed byte by byte from response times.
+bool signaturesEqual(const QByteArray &a, const QByteArray &b)
+{
+    if (a.size() != b.size())
+        return false;
+
+    char difference = 0;
+    for (int i = 0; i < a.size(); ++i)
+        difference |= a.at(i) ^ b.at(i);
+
+    return difference == 0;
+}
+
+} // namespace
+
+QMapboxGLTileServer::QMapboxGLTileServer()
+    : m_state(new State)
+{
+    m_state->server = this;
+
+    quint32 secret[8];
+    QRandomGenerator::system()->fillRange(secret);
+    m_state->secret = QByteArray(reinterpret_cast<const char *>(secret), sizeof(secret));
+}
+
+QMapboxGLTileServer::~QMapboxGLTileServer()
+{
+    {
+        // The transform may outlive the server, let it pass URLs through.
+        QMutexLocker locker(&m_state->startMutex);
+        m_state->server = nullptr;
+    }
+
+    if (m_thread.isRunning()) {
+        QMetaObject::invokeMethod(m_context, [this] {
+            // Replies go with the network access manager, without finishing.
+            m_queue.clear();
+            m_proxyRequests.clear();
+            m_mergeableRequests.clear();
+            delete m_network;
+            m_buffers.clear();
+            qDeleteAll(m_proxyServers);
+            delete m_server;
+            m_archives.clear();
+        }, Qt::BlockingQueuedConnection);
+
+        m_thread.quit();
+        m_thread.wait();
+    }
+
+    delete m_context;
+}
+
+void QMapboxGLTileServer::setScheduling(int connectionsPerHost)
+{
+    m_state->scheduling = connectionsPerHost > 0;
+    m_connectionsPerHost = connectionsPerHost;
+    m_scheduler.reset(m_state->scheduling ? new QMapboxGLRequestScheduler : nullptr);
+}
+
+QSharedPointer<QMapboxGLRequestScheduler> QMapboxGLTileServer::scheduler() const
+{
+    return m_scheduler;
+}
+
+void QMapboxGLTileServer::install(QMapboxGLSettings *settings)
+{
+    // Called from the file source thread, possibly after the engine is
+    // gone, hence the state is captured by value.
+    QSharedPointer<State> state = m_state;
+    std::function<std::string(const std::string &&)> transform = settings->resourceTransform();
+
+    settings->setResourceTransform([state, transform](const std::string &&url) -> std::string {
+        std::string result = transform ? transform(std::move(url)) : url;
+
+        const QString resourceUrl = QString::fromStdString(result);
+        QString resolved;
+        if (QMapboxGLTileArchive::isArchiveUrl(resourceUrl))
+            resolved = state->resolve(resourceUrl);
+        else if (state->scheduling && !resourceUrl.startsWith(QStringLiteral("http://127.0.0.1:"))
+                 && (resourceUrl.startsWith(QStringLiteral("http://")) || resourceUrl.startsWith(QStringLiteral("https://"))))
+            resolved = state->proxy(resourceUrl);
+
+        if (!resolved.isEmpty())
+            result = resolved.toStdString();
+
+        return result;
+    });
+}
+
+QString QMapboxGLTileServer::tileJsonUrl(const QString &archiveUrl)
+{
+    return archiveUrl;
+}
+
+QString QMapboxGLTileServer::styleUrl(const QString &archiveUrl)
+{
+    return archiveUrl + QStringLiteral("?style");
+}
+
+QVariantMap QMapboxGLTileServer::statistics() const
+{
+    QMutexLocker locker(&m_state->mutex);
+
+    QVariantMap statistics;
+    statistics[QStringLiteral("archives")] = m_state->archiveUrls.size();
+    statistics[QStringLiteral("requests")] = m_state->requests;
+    statistics[QStringLiteral("tiles")] = m_state->tiles;
+    statistics[QStringLiteral("missingTiles")] = m_state->missingTiles;
+    statistics[QStringLiteral("bytes")] = m_state->bytes;
+    statistics[QStringLiteral("averageLookupTime")] = m_state->tiles ? double(m_state->lookupTime) / m_state->tiles / 1000.0 : 0.0;
+
+    if (m_state->scheduling) {
+        QVariantMap scheduling;
+        scheduling[QStringLiteral("forwardedRequests")] = m_state->forwardedRequests;
+        scheduling[QStringLiteral("cancelledRequests")] = m_state->cancelledRequests;
+        scheduling[QStringLiteral("failedRequests")] = m_state->failedRequests;
+        scheduling[QStringLiteral("rejectedRequests")] = m_state->rejectedRequests;
+        scheduling[QStringLiteral("mergedRequests")] = m_state->mergedRequests;
+        scheduling[QStringLiteral("networkBytes")] = m_state->networkBytes;
+        scheduling[QStringLiteral("queuedRequests")] = m_state->queuedRequests;
+        scheduling[QStringLiteral("maximumQueuedRequests")] = m_state->maximumQueuedRequests;
+        scheduling[QStringLiteral("averageQueueTime")] = m_state->forwardedRequests
+                ? double(m_state->queueTime) / m_state->forwardedRequests / 1000000.0 : 0.0;
+        scheduling[QStringLiteral("connectionsPerHost")] = m_connectionsPerHost;
+        statistics[QStringLiteral("scheduling")] = scheduling;
+    }
+
+    return statistics;
+}
+
+QString QMapboxGLTileServer::State::resolve(const QString &url)
+{
+    const int query = url.indexOf(QLatin1Char('?'));
+    const QString archiveUrl = url.left(query);
+    const QString parameter = query < 0 ? QString() : url.mid(query + 1);
+
+    QString resource;
+    if (query < 0)
+        resource = QStringLiteral("tile.json");
+    else if (parameter == QStringLiteral("style"))
+        resource = QStringLiteral("style.json");
+    else if (parameter.startsWith(QStringLiteral("tile=")))
+        resource = parameter.mid(5);
+    else
+        return QString();
+
+    {
+        // Starting blocks on the server thread, which takes the other mutex.
+        QMutexLocker locker(&startMutex);
+        if (!server || (!port && !server->listen()))
+            return QString();
+    }
+
+    QMutexLocker locker(&mutex);
+
+    int index = archiveUrls.indexOf(archiveUrl);
+    if (index < 0) {
+        index = archiveUrls.size();
+        archiveUrls.append(archiveUrl);
+    }
+
+    return QStringLiteral("http://127.0.0.1:%1/%2/%3").arg(port).arg(index).arg(resource);
+}
+
+QString QMapboxGLTileServer::State::proxy(const QString &url)
+{
+    {
+        QMutexLocker locker(&startMutex);
+        if (!server || (!port && !server->listen()))
+            return QString();
+    }
+
+    QMutexLocker locker(&mutex);
+
+    // The same URL always goes through the same port.
+    const quint16 proxyPort = proxyPorts.isEmpty() ? port : proxyPorts.at(int(qHash(url) % uint(proxyPorts.size())));
+    const QByteArray encoded = url.toUtf8().toBase64(QByteArray::Base64UrlEncoding | QByteArray::OmitTrailingEquals);
+
+    return QStringLiteral("http://127.0.0.1:%1/proxy/%2/%3").arg(proxyPort)
+            .arg(QString::fromLatin1(sign(encoded)), QString::fromLatin1(encoded));
+}
+
+QByteArray QMapboxGLTileServer::State::sign(const QByteArray &url) const
+{
+    // The secret is set once in the constructor, no locking needed.
+    return QMessageAuthenticationCode::hash(url, secret, QCryptographicHash::Sha256)
+            .toBase64(QByteArray::Base64UrlEncoding | QByteArray::OmitTrailingEquals);
+}
+
+bool QMapboxGLTileServer::listen()
+{
+    if (!m_context) {
+        m_context = new QObject;
+        m_context->moveToThread(&m_thread);
+        m_thread.setObjectName(QStringLiteral("QMapboxGLTileServer"));
+        m_thread.start();
+    }
+
+    quint16 port = 0;
+    QList<quint16> ports;
+    QMetaObject::invokeMethod(m_context, [this, &port, &ports] {
+        if (!m_server) {
+            m_server = new QTcpServer;
+            QObject::connect(m_server, &QTcpServer::newConnection, m_server, [this] { onNewConnection(m_server); });
+        }
+
+        if (m_server->isListening() || m_server->listen(QHostAddress::LocalHost))
+            port = m_server->serverPort();
+        else
+            qWarning() << "Unable to start the local tile server:" << m_server->errorString();
+
+        if (!port || !m_state->scheduling)
+            return;
+
+        ports.append(port);
+        while (m_proxyServers.size() < proxyPorts - 1) {
+            QTcpServer *server = new QTcpServer;
+            if (!server->listen(QHostAddress::LocalHost)) {
+                delete server;
+                break;
+            }
+
+            QObject::connect(server, &QTcpServer::newConnection, server, [this, server] { onNewConnection(server); });
+            m_proxyServers.append(server);
+        }
+
+        for (QTcpServer *server : qAsConst(m_proxyServers))
+            ports.append(server->serverPort());
+    }, Qt::BlockingQueuedConnection);
+
+    QMutexLocker locker(&m_state->mutex);
+    m_state->port = port;
+    m_state->proxyPorts = ports;
+
+    return port != 0;
+}
+
+void QMapboxGLTileServer::onNewConnection(QTcpServer *server)
+{
+    while (QTcpSocket *socket = server->nextPendingConnection()) {
+        m_buffers.insert(socket, QByteArray());
+
+        QObject::connect(socket, &QTcpSocket::readyRead, server, [this, socket] { onReadyRead(socket); });
+        QObject::connect(socket, &QTcpSocket::disconnected, server, [this, socket] {
+            cancel(socket);
+            m_buffers.remove(socket);
+            socket->deleteLater();
+        });
+    }
+}
+
+void QMapboxGLTileServer::onReadyRead(QTcpSocket *socket)
+{
+    QByteArray &buffer = m_buffers[socket];
+    buffer += socket->readAll();
+
+    // Responses go out in order, the next request waits for a forwarded one.
+    if (m_proxyRequests.contains(socket))
+        return;
+
+    // Several requests may come in one go on a kept alive connection.
+    int end;
+    while ((end = buffer.indexOf("\r\n\r\n")) >= 0) {
+        const QList<QByteArray> lines = buffer.left(end).split('\n');
+        buffer.remove(0, end + 4);
+
+        const QList<QByteArray> requestLine = lines.first().trimmed().split(' ');
+        if (requestLine.size() < 3 || requestLine.at(0) != "GET") {
+            socket->write("HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+            socket->disconnectFromHost();
+            return;
+        }
+
+        bool acceptsGzip = false;
+        bool keepAlive = requestLine.at(2) == "HTTP/1.1";
+        QByteArray host;
+        QList<QPair<QByteArray, QByteArray>> headers;
+        for (int i = 1; i < lines.size(); ++i) {
+            const QByteArray line = lines.at(i).trimmed();
+            const int colon = line.indexOf(':');
+            if (colon <= 0)
+                continue;
+
+            const QByteArray name = line.left(colon).trimmed();
+            const QByteArray value = line.mid(colon + 1).trimmed();
+            if (name.compare("accept-encoding", Qt::CaseInsensitive) == 0)
+                acceptsGzip = value.toLower().contains("gzip");
+            else if (name.compare("connection", Qt::CaseInsensitive) == 0)
+                keepAlive = value.toLower().contains("keep-alive");
+            else if (name.compare("host", Qt::CaseInsensitive) == 0)
+                host = value;
+
+            headers.append(qMakePair(name, value));
+        }
+
+        // Mapbox GL only knows the server by the URLs the transform gave it.
+        if (host != "127.0.0.1:" + QByteArray::number(socket->localPort())) {
+            {
+                QMutexLocker locker(&m_state->mutex);
+                ++m_state->rejectedRequests;
+            }
+
+            socket->write("HTTP/1.1 403 Forbidden\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+            socket->disconnectFromHost();
+            return;
+        }
+
+        if (requestLine.at(1).startsWith("/proxy/") && m_scheduler) {
+            enqueue(socket, requestLine.at(1), headers, keepAlive);
+            return;
+        }
+
+        respond(socket, requestLine.at(1), acceptsGzip, keepAlive);
+
+        if (!keepAlive) {
+            socket->disconnectFromHost();
+            return;
+        }
+    }
+
+    if (buffer.size() > maximumRequestSize)
+        socket->disconnectFromHost();
+}
+
+void QMapboxGLTileServer::respond(QTcpSocket *socket, const QByteArray &path, bool acceptsGzip, bool keepAlive)
+{
+    const QList<QByteArray> parts = path.mid(1).split('/');
+
+    QByteArray status = QByteArrayLiteral("404 Not Found");
+    QByteArray type = QByteArrayLiteral("text/plain");
+    QByteArray body;
+    bool gzipped = false;
+
+    bool ok = false;
+    const int index = parts.value(0).toInt(&ok);
+    QMapboxGLTileArchive *tiles = ok ? archive(index) : nullptr;
+
+    {
+        QMutexLocker locker(&m_state->mutex);
+        ++m_state->requests;
+    }
+
+    if (tiles && parts.size() == 2) {
+        QString archiveUrl;
+        {
+            QMutexLocker locker(&m_state->mutex);
+            archiveUrl = m_state->archiveUrls.value(index);
+        }
+
+        // Never the loopback URLs, the port changes from run to run.
+        if (parts.at(1) == "tile.json") {
+            QJsonObject tileJson = tiles->tileJson();
+            tileJson[QStringLiteral("tilejson")] = QStringLiteral("2.2.0");
+            tileJson[QStringLiteral("scheme")] = QStringLiteral("xyz");
+            tileJson[QStringLiteral("tiles")] = QJsonArray { archiveUrl + QStringLiteral("?tile={z}/{x}/{y}") };
+            body = QJsonDocument(tileJson).toJson(QJsonDocument::Compact);
+        } else if (parts.at(1) == "style.json") {
+            body = QJsonDocument(defaultStyle(tiles, tileJsonUrl(archiveUrl))).toJson(QJsonDocument::Compact);
+        }
+
+        if (!body.isEmpty()) {
+            status = QByteArrayLiteral("200 OK");
+            type = QByteArrayLiteral("application/json");
+        }
+    } else if (tiles && parts.size() == 4) {
+        QElapsedTimer timer;
+        timer.start();
+
+        const bool found = tiles->tile(parts.at(1).toInt(), parts.at(2).toInt(), parts.at(3).toInt(), &body, &gzipped);
+
+        // Sent as stored when possible, the network stack inflates it.
+        if (found && gzipped && !acceptsGzip) {
+            body = QMapboxGLTileArchive::gunzip(body);
+            gzipped = false;
+        }
+
+        const qint64 elapsed = timer.nsecsElapsed();
+
+        QMutexLocker locker(&m_state->mutex);
+        if (found) {
+            status = QByteArrayLiteral("200 OK");
+            type = contentType(tiles->tileJson().value(QStringLiteral("format")).toString());
+            ++m_state->tiles;
+            m_state->bytes += quint64(body.size());
+            m_state->lookupTime += elapsed;
+        } else {
+            ++m_state->missingTiles;
+        }
+    }
+
+    QByteArray header = "HTTP/1.1 " + status + "\r\n"
+            "Content-Type: " + type + "\r\n"
+            "Content-Length: " + QByteArray::number(body.size()) + "\r\n"
+            "Cache-Control: no-store\r\n";
+    if (gzipped)
+        header += "Content-Encoding: gzip\r\n";
+    header += keepAlive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n";
+
+    socket->write(header);
+    socket->write(body);
+}
+
+void QMapboxGLTileServer::enqueue(QTcpSocket *socket, const QByteArray &path, const QList<QPair<QByteArray, QByteArray>> &headers, bool keepAlive)
+{
+    const QList<QByteArray> parts = path.mid(int(qstrlen("/proxy/"))).split('/');
+
+    // Anything the transform did not sign is turned away, the server is
+    // no open proxy for other local processes.
+    if (parts.size() != 2 || !signaturesEqual(parts.at(0), m_state->sign(parts.at(1)))) {
+        {
+            QMutexLocker locker(&m_state->mutex);
+            ++m_state->rejectedRequests;
+        }
+
+        socket->write("HTTP/1.1 403 Forbidden\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+        socket->disconnectFromHost();
+        return;
+    }
+
+    QSharedPointer<ProxyRequest> request(new ProxyRequest);
+    request->socket = socket;
+    request->url = QUrl::fromEncoded(QByteArray::fromBase64(parts.at(1),
+            QByteArray::Base64UrlEncoding | QByteArray::OmitTrailingEquals));
+    request->keepAlive = keepAlive;
+    request->queued.start();
+
+    for (const auto &header : headers) {
+        if (isForwardedHeader(header.first))
+            request->headers.append(header);
+    }
+
+    if (!request->url.isValid() || request->url.host().isEmpty()) {
+        socket->write("HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+        socket->disconnectFromHost();
+        return;
+    }
+
+    request->key = request->url.toEncoded();
+    for (const auto &header : qAsConst(request->headers)) {
+        if (header.first.toLower().startsWith("if-"))
+            request->key += '\n' + header.first.toLower() + ": " + header.second;
+    }
+
+    m_proxyRequests.insert(socket, request);
+
+    const QSharedPointer<ProxyRequest> leader = m_mergeableRequests.value(request->key);
+    if (leader) {
+        request->leader = leader;
+        leader->followers.append(request);
+
+        QMutexLocker locker(&m_state->mutex);
+        ++m_state->mergedRequests;
+        return;
+    }
+
+    request->tile = m_scheduler->tile(request->url.toString());
+
+    m_mergeableRequests.insert(request->key, request);
+    m_queue.append(request);
+
+    {
+        QMutexLocker locker(&m_state->mutex);
+        m_state->maximumQueuedRequests = qMax(m_state->maximumQueuedRequests, ++m_state->queuedRequests);
+    }
+
+    dispatch();
+}
+
+void QMapboxGLTileServer::dispatch()
+{
+    if (m_queue.isEmpty())
+        return;
+
+    // Ranked again on every dispatch since the viewports keep moving, but
+    // only once for all the requests it forwards.
+    QVector<QMapboxGLRequestScheduler::Tile> tiles;
+    tiles.reserve(m_queue.size());
+    for (const QSharedPointer<ProxyRequest> &request : qAsConst(m_queue))
+        tiles.append(request->tile);
+
+    QVector<double> priorities = m_scheduler->priorities(tiles);
+
+    for (;;) {
+        int next = -1;
+        double best = qInf();
+
+        for (int i = 0; i < m_queue.size(); ++i) {
+            if (priorities.at(i) >= best)
+                continue;
+
+            if (m_hostConnections.value(m_queue.at(i)->url.host()) >= m_connectionsPerHost)
+                continue;
+
+            best = priorities.at(i);
+            next = i;
+        }
+
+        if (next < 0)
+            return;
+
+        priorities.remove(next);
+        forward(m_queue.takeAt(next));
+    }
+}
+
+void QMapboxGLTileServer::forward(const QSharedPointer<ProxyRequest> &request)
+{
+    if (!m_network)
+        m_network = new QNetworkAccessManager;
+
+    QNetworkRequest networkRequest(request->url);
+    networkRequest.setAttribute(QNetworkRequest::FollowRedirectsAttribute, true);
+    for (const auto &header : qAsConst(request->headers))
+        networkRequest.setRawHeader(header.first, header.second);
+
+    ++m_hostConnections[request->url.host()];
+
+    request->reply = m_network->get(networkRequest);
+    QObject::connect(request->reply, &QNetworkReply::finished, m_network, [this, request] { finish(request); });
+
+    QMutexLocker locker(&m_state->mutex);
+    --m_state->queuedRequests;
+    m_state->queueTime += request->queued.nsecsElapsed();
+}
+
+void QMapboxGLTileServer::finish(const QSharedPointer<ProxyRequest> &request)
+{
+    QNetworkReply *reply = request->reply;
+    request->reply = nullptr;
+    reply->deleteLater();
+
+    m_mergeableRequests.remove(request->key);
+
+    const QString host = request->url.host();
+    if (--m_hostConnections[host] <= 0)
+        m_hostConnections.remove(host);
+
+    QList<QSharedPointer<ProxyRequest>> recipients = request->followers;
+    recipients.prepend(request);
+    request->followers.clear();
+
+    // Cancelled by everyone, nothing to count.
+    const bool wanted = std::any_of(recipients.cbegin(), recipients.cend(),
+            [](const QSharedPointer<ProxyRequest> &recipient) { return recipient->socket != nullptr; });
+
+    const QVariant status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute);
+    QByteArray header;
+    QByteArray body;
+
+    if (status.isValid()) {
+        body = reply->readAll();
+
+        // Styles and TileJSON tell which sources count rows from the south.
+        if (status.toInt() == 200 && reply->header(QNetworkRequest::ContentTypeHeader).toString().contains(QStringLiteral("json")))
+            m_scheduler->learnTileSchemes(body);
+
+        header = "HTTP/1.1 " + QByteArray::number(status.toInt()) + ' '
+                + reply->attribute(QNetworkRequest::HttpReasonPhraseAttribute).toByteArray() + "\r\n";
+        for (const auto &pair : reply->rawHeaderPairs()) {
+            if (isForwardedHeader(pair.first))
+                header += pair.first + ": " + pair.second + "\r\n";
+        }
+        header += "Content-Length: " + QByteArray::number(body.size()) + "\r\n";
+    }
+
+    if (wanted) {
+        QMutexLocker locker(&m_state->mutex);
+        if (status.isValid()) {
+            ++m_state->forwardedRequests;
+            m_state->networkBytes += quint64(body.size());
+        } else {
+            ++m_state->failedRequests;
+        }
+    }
+
+    for (const QSharedPointer<ProxyRequest> &recipient : qAsConst(recipients)) {
+        QTcpSocket *socket = recipient->socket;
+        if (!socket)
+            continue;
+
+        m_proxyRequests.remove(socket);
+
+        if (status.isValid()) {
+            socket->write(header);
+            socket->write(recipient->keepAlive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n");
+            socket->write(body);
+        } else {
+            // No response at all, Mapbox GL treats a dropped connection as
+            // the network error it is.
+            socket->abort();
+        }
+
+        if (socket->state() == QAbstractSocket::ConnectedState) {
+            if (!recipient->keepAlive)
+                socket->disconnectFromHost();
+            else if (!m_buffers.value(socket).isEmpty())
+                onReadyRead(socket);
+        }
+    }
+
+    dispatch();
+}
+
+void QMapboxGLTileServer::cancel(QTcpSocket *socket)
+{
+    QSharedPointer<ProxyRequest> request = m_proxyRequests.take(socket);
+    if (!request)
+        return;
+
+    request->socket = nullptr;
+
+    {
+        QMutexLocker locker(&m_state->mutex);
+        ++m_state->cancelledRequests;
+    }
+
+    // The request shared with others goes only when nobody waits for it.
+    if (const QSharedPointer<ProxyRequest> leader = request->leader.toStrongRef()) {
+        leader->followers.removeOne(request);
+        request = leader;
+    }
+
+    if (request->socket || !request->followers.isEmpty())
+        return;
+
+    // Aborting finishes the reply right away, which frees its connection.
+    if (request->reply) {
+        request->reply->abort();
+    } else {
+        m_queue.removeOne(request);
+        m_mergeableRequests.remove(request->key);
+
+        QMutexLocker locker(&m_state->mutex);
+        --m_state->queuedRequests;
+    }
+}
+
+QMapboxGLTileArchive *QMapboxGLTileServer::archive(int index)
+{
+    auto it = m_archives.find(index);
+    if (it != m_archives.end())
+        return it->data();
+
+    QString url;
+    {
+        QMutexLocker locker(&m_state->mutex);
+        url = m_state->archiveUrls.value(index);
+    }
+
+    // Failures are remembered too, so a broken archive is reported once.
+    QSharedPointer<QMapboxGLTileArchive> archive(url.isEmpty() ? nullptr : QMapboxGLTileArchive::open(url));
+    m_archives.insert(index, archive);
+
+    return archive.data();
+}
@@ -0,0 +1,188 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Copyright (C) 2017 Mapbox, Inc.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the QtLocation module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL3$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or later as published by the Free
+** Software Foundation and appearing in the file LICENSE.GPL included in
+** the packaging of this file. Please review the following information to
+** ensure the GNU General Public License version 2.0 requirements will be
+** met: http://www.gnu.org/licenses/gpl-2.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QMAPBOXGLTILESERVER_P_H
+#define QMAPBOXGLTILESERVER_P_H
+
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QPair>
+#include <QtCore/QSharedPointer>
+#include <QtCore/QStringList>
+#include <QtCore/QThread>
+#include <QtCore/QUrl>
+#include <QtCore/QVariantMap>
+
+#include <QMapboxGL>
+
+#include "qmapboxglrequestscheduler_p.h"
+
+class QMapboxGLTileArchive;
+class QNetworkAccessManager;
+class QNetworkReply;
+class QTcpServer;
+class QTcpSocket;
+
+// Serves local tile archives to Mapbox GL over a loopback HTTP server,
+// the only way to feed it tiles the file source does not know about.
+//
+// The resource transform installed here rewrites mbtiles:// and
+// pmtiles:// URLs to the server, which listens on its own thread from the
+// first time such a URL shows up. Archives are opened, and read, on that
+// thread as well. Mapbox GL only ever sees the archive URLs, which name
+// the same resources across runs, and caches them by those:
+//
+//   <scheme>:///path/to/archive                    TileJSON for a style source url
+//   <scheme>:///path/to/archive?style              Default style showing the archive
+//   <scheme>:///path/to/archive?tile=<z>/<x>/<y>   Tiles
+//
+// With request scheduling, which is on unless the engine parameters turn
+// it off, http and https URLs are rewritten to the server as well, which
+// queues them and forwards them in the order the scheduler ranks them,
+// with a limit of connections per host. Mapbox GL aborts the
+// requests of tiles that left the viewport; the connection to the server
+// closes and the request is dropped from the queue, or aborted upstream.
+// Maps showing the same area ask for the same tiles at about the same
+// time: a request for a URL already queued or on its way, under the same
+// conditions, gets that one's response instead of going out again.
+// Only URLs the transform issued are forwarded: each carries a signature
+// keyed with a random per process secret. Requests must also name the
+// loopback address and port they came in on as their Host, which keeps
+// web pages from reaching the server through DNS rebinding.
+//
+//   /proxy/<signature>/<base64url of the URL>    Forwarded request
+class QMapboxGLTileServer
+{
+public:
+    QMapboxGLTileServer();
+    ~QMapboxGLTileServer();
+
+    // Must be called before install().
+    void setScheduling(int connectionsPerHost);
+    QSharedPointer<QMapboxGLRequestScheduler> scheduler() const;
+
+    void install(QMapboxGLSettings *settings);
+
+    // URLs of the TileJSON and the default style of an archive.
+    static QString tileJsonUrl(const QString &archiveUrl);
+    static QString styleUrl(const QString &archiveUrl);
+
+    QVariantMap statistics() const;
+
+private:
+    struct State {
+        QString resolve(const QString &url);
+        QString proxy(const QString &url);
+        QByteArray sign(const QByteArray &url) const;
+
+        QMutex startMutex;
+        QMapboxGLTileServer *server = nullptr;
+        bool scheduling = false;
+        QByteArray secret;
+
+        mutable QMutex mutex;
+        QStringList archiveUrls;
+        quint16 port = 0;
+        QList<quint16> proxyPorts;
+
+        quint64 requests = 0;
+        quint64 tiles = 0;
+        quint64 missingTiles = 0;
+        quint64 bytes = 0;
+        qint64 lookupTime = 0;
+
+        quint64 forwardedRequests = 0;
+        quint64 cancelledRequests = 0;
+        quint64 failedRequests = 0;
+        quint64 rejectedRequests = 0;
+        quint64 mergedRequests = 0;
+        quint64 networkBytes = 0;
+        qint64 queueTime = 0;
+        int queuedRequests = 0;
+        int maximumQueuedRequests = 0;
+    };
+
+    struct ProxyRequest {
+        QTcpSocket *socket = nullptr;   // Reset when the client went away
+        QUrl url;
+        QMapboxGLRequestScheduler::Tile tile;
+        QList<QPair<QByteArray, QByteArray>> headers;
+        QByteArray key;                 // URL and conditional headers
+        bool keepAlive = true;
+        QElapsedTimer queued;
+        QNetworkReply *reply = nullptr;
+
+        // Requests for the same key waiting on this one, or the one this
+        // request waits on.
+        QList<QSharedPointer<ProxyRequest>> followers;
+        QWeakPointer<ProxyRequest> leader;
+    };
+
+    bool listen();
+    void onNewConnection(QTcpServer *server);
+    void onReadyRead(QTcpSocket *socket);
+    void respond(QTcpSocket *socket, const QByteArray &path, bool acceptsGzip, bool keepAlive);
+    QMapboxGLTileArchive *archive(int index);
+
+    void enqueue(QTcpSocket *socket, const QByteArray &path, const QList<QPair<QByteArray, QByteArray>> &headers, bool keepAlive);
+    void dispatch();
+    void forward(const QSharedPointer<ProxyRequest> &request);
+    void finish(const QSharedPointer<ProxyRequest> &request);
+    void cancel(QTcpSocket *socket);
+
+    QSharedPointer<State> m_state;
+    QSharedPointer<QMapboxGLRequestScheduler> m_scheduler;
+    int m_connectionsPerHost = 4;
+
+    QThread m_thread;
+    QObject *m_context = nullptr;
+
+    // Owned by the server thread.
+    QTcpServer *m_server = nullptr;
+    QHash<QTcpSocket *, QByteArray> m_buffers;
+    QHash<int, QSharedPointer<QMapboxGLTileArchive>> m_archives;
+    QList<QTcpServer *> m_proxyServers;
+    QNetworkAccessManager *m_network = nullptr;
+    QList<QSharedPointer<ProxyRequest>> m_queue;
+    QHash<QTcpSocket *, QSharedPointer<ProxyRequest>> m_proxyRequests;
+    QHash<QByteArray, QSharedPointer<ProxyRequest>> m_mergeableRequests;
+    QHash<QString, int> m_hostConnections;
+};
+
+#endif // QMAPBOXGLTILESERVER_P_H
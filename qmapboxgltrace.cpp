@@ -0,0 +1,219 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Copyright (C) 2017 Mapbox, Inc.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the QtLocation module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL3$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or later as published by the Free
+** Software Foundation and appearing in the file LICENSE.GPL included in
+** the packaging of this file. Please review the following information to
+** ensure the GNU General Public License version 2.0 requirements will be
+** met: http://www.gnu.org/licenses/gpl-2.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qmapboxgltrace_p.h"
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QFile>
+#include <QtCore/QMutex>
+#include <QtCore/QTextStream>
+#include <QtCore/QThread>
+#include <QtCore/QVector>
+
+namespace {
+
+struct Event {
+    const char *name;
+    const char *category;
+    qint64 start;
+    qint64 duration; // -1 for instant events
+};
+
+// Written by its thread only; the count is published after the event.
+struct ThreadBuffer {
+    static const int capacity = 1 << 16;
+
+    Event events[capacity];
+    std::atomic<int> count{0};
+    quintptr threadId = 0;
+    QString threadName;
+};
+
+struct Registry {
+    QMutex mutex;
+    QVector<ThreadBuffer *> buffers;
+    QElapsedTimer clock;
+    QString fileName;
+};
+
+Registry *registry()
+{
+    // Never destroyed, threads may still record while the application exits.
+    static Registry *instance = new Registry;
+    return instance;
+}
+
+ThreadBuffer *threadBuffer()
+{
+    thread_local ThreadBuffer *buffer = nullptr;
+
+    if (!buffer) {
+        buffer = new ThreadBuffer;
+        buffer->threadId = quintptr(QThread::currentThreadId());
+        buffer->threadName = QThread::currentThread()->objectName();
+        if (buffer->threadName.isEmpty() && QCoreApplication::instance()
+                && QThread::currentThread() == QCoreApplication::instance()->thread())
+            buffer->threadName = QStringLiteral("main");
+
+        Registry *r = registry();
+        QMutexLocker locker(&r->mutex);
+        r->buffers.append(buffer);
+    }
+
+    return buffer;
+}
+
+void record(const Event &event)
+{
+    ThreadBuffer *buffer = threadBuffer();
+
+    const int index = buffer->count.load(std::memory_order_relaxed);
+    if (index >= ThreadBuffer::capacity)
+        return;
+
+    buffer->events[index] = event;
+    buffer->count.store(index + 1, std::memory_order_release);
+}
+
+void writeAtExit()
+{
+    const QString fileName = registry()->fileName;
+    if (!fileName.isEmpty())
+        QMapboxGLTrace::write(fileName);
+}
+
+QString escaped(const QString &string)
+{
+    QString result = string;
+    result.replace(QLatin1Char('\\'), QLatin1String("\\\\"));
+    result.replace(QLatin1Char('"'), QLatin1String("\\\""));
+    return result;
+}
+
+} // namespace
+
+std::atomic<bool> QMapboxGLTrace::s_enabled{false};
+
+void QMapboxGLTrace::enable(const QString &fileName)
+{
+    Registry *r = registry();
+
+    {
+        QMutexLocker locker(&r->mutex);
+
+        if (!r->clock.isValid())
+            r->clock.start();
+
+        if (!fileName.isEmpty() && r->fileName.isEmpty())
+            qAddPostRoutine(writeAtExit);
+
+        if (!fileName.isEmpty())
+            r->fileName = fileName;
+    }
+
+    s_enabled.store(true, std::memory_order_relaxed);
+}
+
+qint64 QMapboxGLTrace::now()
+{
+    return registry()->clock.nsecsElapsed();
+}
+
+void QMapboxGLTrace::instant(const char *name, const char *category)
+{
+    if (!isEnabled())
+        return;
+
+    record(Event{name, category, now(), -1});
+}
+
+void QMapboxGLTrace::complete(const char *name, const char *category, qint64 start, qint64 duration)
+{
+    if (!isEnabled())
+        return;
+
+    record(Event{name, category, start, duration});
+}
+
+bool QMapboxGLTrace::write(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+        qWarning("Unable to write the trace to %s.", qPrintable(fileName));
+        return false;
+    }
+
+    QTextStream out(&file);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+    const qint64 pid = QCoreApplication::applicationPid();
+    bool first = true;
+
+    Registry *r = registry();
+    QMutexLocker locker(&r->mutex);
+
+    for (const ThreadBuffer *buffer : qAsConst(r->buffers)) {
+        if (!buffer->threadName.isEmpty()) {
+            out << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid
+                << ",\"tid\":" << buffer->threadId
+                << ",\"args\":{\"name\":\"" << escaped(buffer->threadName) << "\"}}";
+            first = false;
+        }
+
+        const int count = buffer->count.load(std::memory_order_acquire);
+        for (int i = 0; i < count; ++i) {
+            const Event &event = buffer->events[i];
+
+            // Chrome traces count in microseconds.
+            out << (first ? "" : ",") << "\n{\"name\":\"" << event.name << "\",\"cat\":\"" << event.category
+                << "\",\"pid\":" << pid << ",\"tid\":" << buffer->threadId
+                << ",\"ts\":" << QString::number(event.start / 1000.0, 'f', 3);
+
+            if (event.duration < 0)
+                out << ",\"ph\":\"i\",\"s\":\"t\"}";
+            else
+                out << ",\"ph\":\"X\",\"dur\":" << QString::number(event.duration / 1000.0, 'f', 3) << "}";
+
+            first = false;
+        }
+    }
+
+    out << "\n]}\n";
+
+    return out.status() == QTextStream::Ok;
+}
@@ -0,0 +1,94 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Copyright (C) 2017 Mapbox, Inc.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the QtLocation module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL3$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or later as published by the Free
+** Software Foundation and appearing in the file LICENSE.GPL included in
+** the packaging of this file. Please review the following information to
+** ensure the GNU General Public License version 2.0 requirements will be
+** met: http://www.gnu.org/licenses/gpl-2.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QMAPBOXGLTRACE_P_H
+#define QMAPBOXGLTRACE_P_H
+
+#include <QtCore/QString>
+
+#include <atomic>
+
+// Opt-in event tracing written as Chrome trace JSON, which chrome://tracing
+// and Perfetto open. Every thread records into its own fixed buffer that
+// only it writes to, so recording takes no lock. A buffer that is full
+// drops further events. When tracing is off, each trace point costs one
+// branch on a flag.
+//
+// Event names and categories must be string literals, only the pointers
+// are stored.
+class QMapboxGLTrace
+{
+public:
+    static bool isEnabled() { return s_enabled.load(std::memory_order_relaxed); }
+
+    // Starts recording. A non-empty fileName is written at exit.
+    static void enable(const QString &fileName = QString());
+    static bool write(const QString &fileName);
+
+    static void instant(const char *name, const char *category);
+    static void complete(const char *name, const char *category, qint64 start, qint64 duration);
+    static qint64 now();
+
+    class Scope
+    {
+    public:
+        Scope(const char *name, const char *category)
+        {
+            if (isEnabled()) {
+                m_name = name;
+                m_category = category;
+                m_start = now();
+            }
+        }
+
+        ~Scope()
+        {
+            if (m_name)
+                complete(m_name, m_category, m_start, now() - m_start);
+        }
+
+    private:
+        const char *m_name = nullptr;
+        const char *m_category = nullptr;
+        qint64 m_start = 0;
+    };
+
+private:
+    static std::atomic<bool> s_enabled;
+};
+
+#endif // QMAPBOXGLTRACE_P_H
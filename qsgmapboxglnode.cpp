@@ -37,6 +37,9 @@
 
 #include "qsgmapboxglnode.h"
 #include "qgeomapmapboxgl.h"
+#include "qmapboxglframereader_p.h"
+#include "qmapboxglprefetcher_p.h"
+#include "qmapboxgltrace_p.h"
 
 #if QT_HAS_INCLUDE(<QtQuick/private/qsgplaintexture_p.h>)
 #include <QtQuick/private/qsgplaintexture_p.h>
@@ -49,27 +52,126 @@
 
 static const QSize minTextureSize = QSize(64, 64);
 
-QSGMapboxGLTextureNode::QSGMapboxGLTextureNode(const QMapboxGLSettings &settings, const QSize &size, qreal pixelRatio, QGeoMapMapboxGL *geoMap)
-        : QSGSimpleTextureNode()
+QSGMapboxGLTextureNode::QSGMapboxGLTextureNode(const QMapboxGLSettings &settings, const QSize &size, qreal pixelRatio, QGeoMapMapboxGL *geoMap, QMapboxGL *map)
+        : QSGSimpleTextureNode(), m_geoMap(geoMap)
 {
     setTextureCoordinatesTransform(QSGSimpleTextureNode::MirrorVertically);
     setFiltering(QSGTexture::Linear);
 
-    m_map.reset(new QMapboxGL(nullptr, settings, size.expandedTo(minTextureSize), pixelRatio));
+    m_map.reset(map ? map : new QMapboxGL(nullptr, settings, size.expandedTo(minTextureSize), pixelRatio));
+    trackStyleLoading(m_map.data());
 
-    QObject::connect(m_map.data(), &QMapboxGL::needsRendering, geoMap, &QGeoMap::sgNodeChanged);
     QObject::connect(m_map.data(), &QMapboxGL::copyrightsChanged, geoMap,
             static_cast<void (QGeoMap::*)(const QString &)>(&QGeoMapMapboxGL::copyrightsChanged));
 }
 
+QSGMapboxGLTextureNode::~QSGMapboxGLTextureNode()
+{
+    qDeleteAll(m_standbyMaps);
+
+    if (m_prefetcher)
+        m_prefetcher->release(m_geoMap);
+}
+
+void QSGMapboxGLTextureNode::trackStyleLoading(QMapboxGL *map)
+{
+    // Emitted on the render thread the map lives in, like the node.
+    QObject::connect(map, &QMapboxGL::mapChanged, &m_styleTracking, [this, map](QMapboxGL::MapChange change) {
+        if (change == QMapboxGL::MapChangeDidFinishLoadingStyle)
+            m_loadedStyles.insert(map);
+        else if (change == QMapboxGL::MapChangeWillStartLoadingMap)
+            m_loadedStyles.remove(map);
+    });
+}
+
+void QSGMapboxGLTextureNode::addStandbyMap(const QString &styleUrl, QMapboxGL *map)
+{
+    delete m_standbyMaps.take(styleUrl);
+
+    // Created at the viewport size, resized with the active map from now on.
+    trackStyleLoading(map);
+    m_standbyMaps.insert(styleUrl, map);
+}
+
+bool QSGMapboxGLTextureNode::hasStandbyMap(const QString &styleUrl) const
+{
+    return m_standbyMaps.contains(styleUrl);
+}
+
+int QSGMapboxGLTextureNode::standbyMapCount() const
+{
+    return m_standbyMaps.size();
+}
+
+QMapboxGL *QSGMapboxGLTextureNode::swapMap(const QString &styleUrl, const QString &previousStyleUrl, bool previousStyleLoaded)
+{
+    QMapboxGL *next = m_standbyMaps.take(styleUrl);
+    if (!next)
+        return nullptr;
+
+    QMapboxGL *previous = m_map.take();
+    if (previousStyleLoaded)
+        m_loadedStyles.insert(previous);
+    delete m_standbyMaps.take(previousStyleUrl);
+    m_standbyMaps.insert(previousStyleUrl, previous);
+
+    // Only the active map reports its attribution.
+    QObject::disconnect(previous, &QMapboxGL::copyrightsChanged, m_geoMap, nullptr);
+    QObject::connect(next, &QMapboxGL::copyrightsChanged, m_geoMap,
+            static_cast<void (QGeoMap::*)(const QString &)>(&QGeoMapMapboxGL::copyrightsChanged));
+
+    m_map.reset(next);
+
+    // Points the new map at the framebuffer.
+    if (m_fbo) {
+        m_renderSize = QSize();
+        updateRenderSize();
+    }
+
+    return previous;
+}
+
+bool QSGMapboxGLTextureNode::isStyleLoaded(QMapboxGL *map) const
+{
+    return m_loadedStyles.contains(map);
+}
+
+void QSGMapboxGLTextureNode::renderStandbyMaps(QQuickWindow *window, const QMapboxGLCameraOptions &camera, const QMargins &margins)
+{
+    if (!m_fbo || m_standbyMaps.isEmpty())
+        return;
+
+    QMapboxGLTrace::Scope trace("renderStandby", "render");
+
+    QOpenGLFunctions *f = window->openglContext()->functions();
+    f->glViewport(0, 0, m_renderSize.width(), m_renderSize.height());
+
+    m_fbo->bind();
+
+    for (QMapboxGL *map : qAsConst(m_standbyMaps)) {
+        map->setMargins(margins);
+        map->jumpTo(camera);
+        map->setFramebufferObject(m_fbo->handle(), m_renderSize);
+        map->render();
+    }
+
+    m_fbo->release();
+    window->resetOpenGLState();
+}
+
 void QSGMapboxGLTextureNode::resize(const QSize &size, qreal pixelRatio)
 {
+    QMapboxGLTrace::Scope trace("fboResize", "render");
+
     const QSize& minSize = size.expandedTo(minTextureSize);
     const QSize fbSize = minSize * pixelRatio;
     m_map->resize(minSize);
+    for (QMapboxGL *map : qAsConst(m_standbyMaps))
+        map->resize(minSize);
 
     m_fbo.reset(new QOpenGLFramebufferObject(fbSize, QOpenGLFramebufferObject::CombinedDepthStencil));
-    m_map->setFramebufferObject(m_fbo->handle(), fbSize);
+    m_renderSize = QSize();
+    updateRenderSize();
 
     QSGPlainTexture *fboTexture = static_cast<QSGPlainTexture *>(texture());
     if (!fboTexture) {
@@ -89,10 +191,36 @@ void QSGMapboxGLTextureNode::resize(const QSize &size, qreal pixelRatio)
     markDirty(QSGNode::DirtyGeometry);
 }
 
+void QSGMapboxGLTextureNode::setRenderScale(qreal scale)
+{
+    m_renderScale = qBound(qreal(0.1), scale, qreal(1.0));
+}
+
+void QSGMapboxGLTextureNode::setFrameTiming(QMapboxGLFrameTiming *timing, bool gpuTiming)
+{
+    m_frameTiming = timing;
+    m_gpuTimer.reset(timing && gpuTiming ? new QMapboxGLFrameTiming::GpuTimer(timing) : nullptr);
+}
+
+void QSGMapboxGLTextureNode::updateRenderSize()
+{
+    // A reduced render scale draws into the bottom-left part of the FBO,
+    // which is then stretched over the node through the source rect.
+    const QSize renderSize = (QSizeF(m_fbo->size()) * m_renderScale).toSize().expandedTo(QSize(1, 1));
+    if (renderSize == m_renderSize)
+        return;
+
+    m_renderSize = renderSize;
+    m_map->setFramebufferObject(m_fbo->handle(), m_renderSize);
+    setSourceRect(QRectF(QPointF(), m_renderSize));
+}
+
 void QSGMapboxGLTextureNode::render(QQuickWindow *window)
 {
+    updateRenderSize();
+
     QOpenGLFunctions *f = window->openglContext()->functions();
-    f->glViewport(0, 0, m_fbo->width(), m_fbo->height());
+    f->glViewport(0, 0, m_renderSize.width(), m_renderSize.height());
 
     GLint alignment;
     f->glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
@@ -103,28 +231,101 @@ void QSGMapboxGLTextureNode::render(QQuickWindow *window)
     f->glColorMask(true, true, true, true);
     f->glClear(GL_COLOR_BUFFER_BIT);
 
-    m_map->render();
+    {
+        QMapboxGLFrameTiming::Scope scope(m_frameTiming, QMapboxGLFrameTiming::Render);
+        QMapboxGLTrace::Scope trace("render", "render");
+
+        if (m_gpuTimer)
+            m_gpuTimer->begin();
+
+        m_map->render();
+
+        if (m_gpuTimer)
+            m_gpuTimer->end();
+    }
+
     m_fbo->release();
 
-    // QTBUG-62861
-    f->glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+    if (m_prefetcher) {
+        QMapboxGLTrace::Scope trace("prefetch", "render");
+        m_prefetcher->render(f);
+    }
+
+    {
+        QMapboxGLFrameTiming::Scope scope(m_frameTiming, QMapboxGLFrameTiming::StateRestore);
+
+        // QTBUG-62861
+        f->glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+
+        window->resetOpenGLState();
+    }
 
-    window->resetOpenGLState();
     markDirty(QSGNode::DirtyMaterial);
 }
 
+void QSGMapboxGLTextureNode::capture()
+{
+    if (!m_frameReader)
+        m_frameReader.reset(new QMapboxGLFrameReader);
+
+    m_frameReader->read(m_fbo.data(), m_renderSize);
+}
+
+QList<QImage> QSGMapboxGLTextureNode::takeCapturedFrames()
+{
+    return m_frameReader ? m_frameReader->takeFrames() : QList<QImage>();
+}
+
+bool QSGMapboxGLTextureNode::hasPendingCaptures() const
+{
+    return m_frameReader && m_frameReader->hasPendingReads();
+}
+
+qint64 QSGMapboxGLTextureNode::framebufferBytes() const
+{
+    // Color plus packed depth/stencil, 4 bytes each.
+    qint64 bytes = m_fbo ? qint64(m_fbo->width()) * m_fbo->height() * 8 : 0;
+
+    if (m_prefetcher)
+        bytes += m_prefetcher->framebufferBytes();
+
+    if (m_frameReader)
+        bytes += m_frameReader->bufferBytes();
+
+    return bytes;
+}
+
 QMapboxGL* QSGMapboxGLTextureNode::map() const
 {
     return m_map.data();
 }
 
+QMapboxGL* QSGMapboxGLTextureNode::takeMap()
+{
+    if (m_map) {
+        QObject::disconnect(m_map.data(), nullptr, &m_styleTracking, nullptr);
+        m_loadedStyles.remove(m_map.data());
+    }
+
+    return m_map.take();
+}
+
+QMapboxGLPrefetcher *QSGMapboxGLTextureNode::prefetcher() const
+{
+    return m_prefetcher.data();
+}
+
+void QSGMapboxGLTextureNode::setPrefetcher(const QSharedPointer<QMapboxGLPrefetcher> &prefetcher)
+{
+    m_prefetcher = prefetcher;
+}
+
 // QSGMapboxGLRenderNode
 
-QSGMapboxGLRenderNode::QSGMapboxGLRenderNode(const QMapboxGLSettings &settings, const QSize &size, qreal pixelRatio, QGeoMapMapboxGL *geoMap)
+QSGMapboxGLRenderNode::QSGMapboxGLRenderNode(const QMapboxGLSettings &settings, const QSize &size, qreal pixelRatio, QGeoMapMapboxGL *geoMap, QMapboxGL *map)
         : QSGRenderNode()
 {
-    m_map.reset(new QMapboxGL(nullptr, settings, size, pixelRatio));
-    QObject::connect(m_map.data(), &QMapboxGL::needsRendering, geoMap, &QGeoMap::sgNodeChanged);
+    m_map.reset(map ? map : new QMapboxGL(nullptr, settings, size, pixelRatio));
     QObject::connect(m_map.data(), &QMapboxGL::copyrightsChanged, geoMap,
             static_cast<void (QGeoMap::*)(const QString &)>(&QGeoMapMapboxGL::copyrightsChanged));
 }
@@ -134,6 +335,11 @@ QMapboxGL* QSGMapboxGLRenderNode::map() const
     return m_map.data();
 }
 
+QMapboxGL* QSGMapboxGLRenderNode::takeMap()
+{
+    return m_map.take();
+}
+
 void QSGMapboxGLRenderNode::render(const RenderState *state)
 {
     // QMapboxGL assumes we've prepared the viewport prior to render().
@@ -145,7 +351,10 @@ void QSGMapboxGLRenderNode::render(const RenderState *state)
     GLint alignment;
     f->glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
 
-    m_map->render();
+    {
+        QMapboxGLTrace::Scope trace("render", "render");
+        m_map->render();
+    }
 
     // QTBUG-62861
     f->glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
@@ -43,32 +43,87 @@
 #include <QtQuick/QSGSimpleTextureNode>
 #include <QtQuick/private/qsgtexture_p.h>
 #include <QtGui/QOpenGLFramebufferObject>
+#include <QtCore/QHash>
+#include <QtCore/QObject>
+#include <QtCore/QSet>
+#include <QtCore/QSharedPointer>
 
 #include <QMapboxGL>
 
+#include "qmapboxglframetiming_p.h"
+
 class QGeoMapMapboxGL;
+class QMapboxGLFrameReader;
+class QMapboxGLPrefetcher;
 
 class QSGMapboxGLTextureNode : public QSGSimpleTextureNode
 {
 public:
-    QSGMapboxGLTextureNode(const QMapboxGLSettings &, const QSize &, qreal pixelRatio, QGeoMapMapboxGL *geoMap);
+    QSGMapboxGLTextureNode(const QMapboxGLSettings &, const QSize &, qreal pixelRatio, QGeoMapMapboxGL *geoMap, QMapboxGL *map = nullptr);
+    ~QSGMapboxGLTextureNode();
 
     QMapboxGL* map() const;
+    QMapboxGL* takeMap();
+
+    // Shared with the other maps of the engine rendering with the context.
+    QMapboxGLPrefetcher *prefetcher() const;
+    void setPrefetcher(const QSharedPointer<QMapboxGLPrefetcher> &prefetcher);
 
     void resize(const QSize &size, qreal pixelRatio);
+    void setRenderScale(qreal scale);
+    void setFrameTiming(QMapboxGLFrameTiming *timing, bool gpuTiming);
     void render(QQuickWindow *);
 
+    // Maps kept with another style loaded, switched to instead of loading
+    // the style again. The node owns them.
+    void addStandbyMap(const QString &styleUrl, QMapboxGL *map);
+    bool hasStandbyMap(const QString &styleUrl) const;
+    int standbyMapCount() const;
+
+    // Makes the standby map of styleUrl the active one, and the active map
+    // the standby one of previousStyleUrl. Returns the previous map.
+    QMapboxGL *swapMap(const QString &styleUrl, const QString &previousStyleUrl, bool previousStyleLoaded);
+    bool isStyleLoaded(QMapboxGL *map) const;
+
+    // Moves the standby maps to the camera and draws them once, so they load
+    // its tiles. The active map draws over the result afterwards.
+    void renderStandbyMaps(QQuickWindow *, const QMapboxGLCameraOptions &camera, const QMargins &margins);
+
+    // Asynchronous readback of the last rendered frame
+    void capture();
+    QList<QImage> takeCapturedFrames();
+    bool hasPendingCaptures() const;
+
+    // GPU memory held by the framebuffers and readback buffers
+    qint64 framebufferBytes() const;
+
 private:
+    void updateRenderSize();
+    void trackStyleLoading(QMapboxGL *map);
+
+    QGeoMapMapboxGL *m_geoMap;
     QScopedPointer<QMapboxGL> m_map;
+    QHash<QString, QMapboxGL *> m_standbyMaps;
+    QSet<QMapboxGL *> m_loadedStyles;
+    // Context of the style tracking connections, so they end with the node
+    // even when its maps outlive it in the map pool.
+    QObject m_styleTracking;
     QScopedPointer<QOpenGLFramebufferObject> m_fbo;
+    QSharedPointer<QMapboxGLPrefetcher> m_prefetcher;
+    QScopedPointer<QMapboxGLFrameReader> m_frameReader;
+    QMapboxGLFrameTiming *m_frameTiming = nullptr;
+    QScopedPointer<QMapboxGLFrameTiming::GpuTimer> m_gpuTimer;
+    qreal m_renderScale = 1.0;
+    QSize m_renderSize;
 };
 
 class QSGMapboxGLRenderNode : public QSGRenderNode
 {
 public:
-    QSGMapboxGLRenderNode(const QMapboxGLSettings &, const QSize &, qreal pixelRatio, QGeoMapMapboxGL *geoMap);
+    QSGMapboxGLRenderNode(const QMapboxGLSettings &, const QSize &, qreal pixelRatio, QGeoMapMapboxGL *geoMap, QMapboxGL *map = nullptr);
 
     QMapboxGL* map() const;
+    QMapboxGL* takeMap();
 
     // QSGRenderNode
     void render(const RenderState *state) override;
@@ -0,0 +1,18 @@
+TARGET = tst_qmapboxglcachedatabase
+
+CONFIG += testcase
+
+QT += \
+    testlib \
+    sql
+
+INCLUDEPATH += $$PWD/../..
+
+HEADERS += \
+    ../../qmapboxglcachedatabase_p.h
+
+SOURCES += \
+    tst_qmapboxglcachedatabase.cpp \
+    ../../qmapboxglcachedatabase.cpp
+
+include(../../mapboxgl_dependency.pri)
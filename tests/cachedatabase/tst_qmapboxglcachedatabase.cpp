@@ -0,0 +1,242 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Copyright (C) 2017 Mapbox, Inc.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the QtLocation module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL3$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or later as published by the Free
+** Software Foundation and appearing in the file LICENSE.GPL included in
+** the packaging of this file. Please review the following information to
+** ensure the GNU General Public License version 2.0 requirements will be
+** met: http://www.gnu.org/licenses/gpl-2.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qmapboxglcachedatabase_p.h"
+
+#include <QtCore/QTemporaryDir>
+#include <QtSql/QSqlQuery>
+#include <QtTest/QtTest>
+
+namespace {
+
+const QString streets = QStringLiteral("https://tiles.example.com/streets/{z}/{x}/{y}.pbf");
+const QString terrain = QStringLiteral("https://tiles.example.com/terrain/{z}/{x}/{y}.png");
+
+// Every entry is this large, which makes budgets easy to count in.
+const int entrySize = 1000;
+
+} // namespace
+
+class tst_QMapboxGLCacheDatabase : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+
+    void evictsLeastRecentlyUsed();
+    void evictsExpiringFirst();
+    void countsResourcesTowardsTheLimit();
+    void keepsRegionTiles();
+    void appliesSourceQuotas();
+    void keepsEverythingWithinTheLimit();
+
+private:
+    void addTile(const QString &urlTemplate, int x, qint64 accessed, qint64 expires = 0);
+    void addResource(const QString &url, qint64 accessed);
+    QList<int> tiles(const QString &urlTemplate);
+
+    QScopedPointer<QTemporaryDir> m_dir;
+    QScopedPointer<QMapboxGLCacheDatabase> m_database;
+};
+
+void tst_QMapboxGLCacheDatabase::init()
+{
+    m_dir.reset(new QTemporaryDir);
+    QVERIFY(m_dir->isValid());
+
+    m_database.reset(new QMapboxGLCacheDatabase(m_dir->filePath(QStringLiteral("cache.db"))));
+    QVERIFY(m_database->open());
+    QVERIFY(m_database->ensureSchema());
+}
+
+void tst_QMapboxGLCacheDatabase::cleanup()
+{
+    m_database.reset();
+    m_dir.reset();
+}
+
+void tst_QMapboxGLCacheDatabase::addTile(const QString &urlTemplate, int x, qint64 accessed, qint64 expires)
+{
+    QSqlQuery query(m_database->database());
+    query.prepare(QStringLiteral("INSERT INTO tiles (url_template, pixel_ratio, z, x, y, expires, data, accessed) "
+                                 "VALUES (?, 1, 10, ?, 0, ?, ?, ?)"));
+    query.addBindValue(urlTemplate);
+    query.addBindValue(x);
+    query.addBindValue(expires ? QVariant(expires) : QVariant(QVariant::LongLong));
+    query.addBindValue(QByteArray(entrySize, 'x'));
+    query.addBindValue(accessed);
+    QVERIFY(query.exec());
+}
+
+void tst_QMapboxGLCacheDatabase::addResource(const QString &url, qint64 accessed)
+{
+    QSqlQuery query(m_database->database());
+    query.prepare(QStringLiteral("INSERT INTO resources (url, kind, data, accessed) VALUES (?, 1, ?, ?)"));
+    query.addBindValue(url);
+    query.addBindValue(QByteArray(entrySize, 'x'));
+    query.addBindValue(accessed);
+    QVERIFY(query.exec());
+}
+
+// Columns of the tiles left, in order.
+QList<int> tst_QMapboxGLCacheDatabase::tiles(const QString &urlTemplate)
+{
+    QList<int> columns;
+
+    QSqlQuery query(m_database->database());
+    query.prepare(QStringLiteral("SELECT x FROM tiles WHERE url_template = ? ORDER BY x"));
+    query.addBindValue(urlTemplate);
+    if (!query.exec())
+        return columns;
+
+    while (query.next())
+        columns << query.value(0).toInt();
+
+    return columns;
+}
+
+void tst_QMapboxGLCacheDatabase::evictsLeastRecentlyUsed()
+{
+    // Column 0 was read last.
+    for (int x = 0; x < 10; ++x)
+        addTile(streets, x, 100 - x);
+
+    QMapboxGLCacheDatabase::EvictionPolicy policy;
+    policy.maximumSize = 4 * entrySize;
+
+    const QVariantMap result = m_database->evict(policy);
+
+    QCOMPARE(tiles(streets), QList<int>() << 0 << 1 << 2 << 3);
+    QCOMPARE(result.value(QStringLiteral("evictedTiles")).toInt(), 6);
+    QCOMPARE(result.value(QStringLiteral("evictedBytes")).toLongLong(), qint64(6 * entrySize));
+}
+
+void tst_QMapboxGLCacheDatabase::evictsExpiringFirst()
+{
+    // Read in the opposite order of how long they stay valid.
+    for (int x = 0; x < 10; ++x)
+        addTile(streets, x, 100 + x, 1000 - x);
+
+    QMapboxGLCacheDatabase::EvictionPolicy policy;
+    policy.order = QMapboxGLCacheDatabase::EvictionPolicy::ExpiringFirst;
+    policy.maximumSize = 3 * entrySize;
+
+    m_database->evict(policy);
+
+    QCOMPARE(tiles(streets), QList<int>() << 0 << 1 << 2);
+}
+
+void tst_QMapboxGLCacheDatabase::countsResourcesTowardsTheLimit()
+{
+    for (int x = 0; x < 4; ++x)
+        addTile(streets, x, 10 + x);
+    addResource(QStringLiteral("https://example.com/style.json"), 20);
+    addResource(QStringLiteral("https://example.com/sprite.png"), 1);
+
+    QMapboxGLCacheDatabase::EvictionPolicy policy;
+    policy.maximumSize = 3 * entrySize;
+
+    const QVariantMap result = m_database->evict(policy);
+
+    // The style was read last, the sprite first.
+    QCOMPARE(tiles(streets), QList<int>() << 2 << 3);
+    QCOMPARE(result.value(QStringLiteral("evictedResources")).toInt(), 1);
+
+    QSqlQuery query(m_database->database());
+    QVERIFY(query.exec(QStringLiteral("SELECT url FROM resources")));
+    QVERIFY(query.next());
+    QCOMPARE(query.value(0).toString(), QStringLiteral("https://example.com/style.json"));
+    QVERIFY(!query.next());
+}
+
+void tst_QMapboxGLCacheDatabase::keepsRegionTiles()
+{
+    for (int x = 0; x < 10; ++x)
+        addTile(streets, x, 100 - x);
+
+    // The oldest two belong to a region.
+    const qint64 regionId = m_database->region(QStringLiteral("{}"), QStringLiteral("pinned"));
+    QVERIFY(regionId >= 0);
+    QCOMPARE(m_database->pinTiles(regionId, 10, QRect(QPoint(8, 0), QPoint(9, 0))), 2);
+
+    QMapboxGLCacheDatabase::EvictionPolicy policy;
+    policy.maximumSize = 3 * entrySize;
+
+    m_database->evict(policy);
+
+    // Region tiles do not count towards the limit either.
+    QCOMPARE(tiles(streets), QList<int>() << 0 << 1 << 2 << 8 << 9);
+}
+
+void tst_QMapboxGLCacheDatabase::appliesSourceQuotas()
+{
+    for (int x = 0; x < 6; ++x) {
+        addTile(streets, x, 100 - x);
+        addTile(terrain, x, 200 - x);
+    }
+
+    QMapboxGLCacheDatabase::EvictionPolicy policy;
+    policy.sourceQuotas.insert(QStringLiteral("/terrain/"), 2 * entrySize);
+    policy.maximumSize = 6 * entrySize;
+
+    m_database->evict(policy);
+
+    // Two terrain tiles stay within their quota and leave room for four of
+    // the streets tiles, which were all read before any terrain tile.
+    QCOMPARE(tiles(terrain), QList<int>() << 0 << 1);
+    QCOMPARE(tiles(streets), QList<int>() << 0 << 1 << 2 << 3);
+}
+
+void tst_QMapboxGLCacheDatabase::keepsEverythingWithinTheLimit()
+{
+    for (int x = 0; x < 5; ++x)
+        addTile(streets, x, x);
+
+    QMapboxGLCacheDatabase::EvictionPolicy policy;
+    policy.maximumSize = 5 * entrySize;
+
+    const QVariantMap result = m_database->evict(policy);
+
+    QCOMPARE(tiles(streets).size(), 5);
+    QCOMPARE(result.value(QStringLiteral("evictedTiles")).toInt(), 0);
+}
+
+QTEST_MAIN(tst_QMapboxGLCacheDatabase)
+
+#include "tst_qmapboxglcachedatabase.moc"
@@ -0,0 +1,24 @@
+TARGET = tst_qmapboxglofflinedownloader
+
+CONFIG += testcase
+
+QT += \
+    testlib \
+    network \
+    positioning \
+    sql
+
+INCLUDEPATH += $$PWD/../..
+
+HEADERS += \
+    ../../qmapboxglcachedatabase_p.h \
+    ../../qmapboxglofflinedownloader.h \
+    ../../qmapboxglstyleresources_p.h
+
+SOURCES += \
+    tst_qmapboxglofflinedownloader.cpp \
+    ../../qmapboxglcachedatabase.cpp \
+    ../../qmapboxglofflinedownloader.cpp \
+    ../../qmapboxglstyleresources.cpp
+
+include(../../mapboxgl_dependency.pri)
@@ -0,0 +1,270 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Copyright (C) 2017 Mapbox, Inc.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the QtLocation module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL3$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or later as published by the Free
+** Software Foundation and appearing in the file LICENSE.GPL included in
+** the packaging of this file. Please review the following information to
+** ensure the GNU General Public License version 2.0 requirements will be
+** met: http://www.gnu.org/licenses/gpl-2.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qmapboxglcachedatabase_p.h"
+#include "qmapboxglofflinedownloader.h"
+
+#include <QtCore/QPointer>
+#include <QtCore/QTemporaryDir>
+#include <QtCore/QTimer>
+#include <QtNetwork/QTcpServer>
+#include <QtNetwork/QTcpSocket>
+#include <QtSql/QSqlQuery>
+#include <QtTest/QtTest>
+
+namespace {
+
+// 4x4 tiles at zoom 2.
+const QGeoRectangle world(QGeoCoordinate(80.0, -170.0), QGeoCoordinate(-80.0, 170.0));
+
+} // namespace
+
+// Stand-in for a style and tile server. Every request is answered after a
+// delay, which keeps requests in flight long enough to count them. The
+// style has a single vector source, tiles answer with their own path.
+class TileServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit TileServer(bool tms = false) : m_tms(tms)
+    {
+        connect(&m_server, &QTcpServer::newConnection, this, &TileServer::onNewConnection);
+        m_server.listen(QHostAddress::LocalHost);
+    }
+
+    QString baseUrl() const
+    {
+        return QStringLiteral("http://127.0.0.1:%1").arg(m_server.serverPort());
+    }
+
+    QStringList paths;
+    int maximumInFlight = 0;
+
+private:
+    void onNewConnection()
+    {
+        while (QTcpSocket *socket = m_server.nextPendingConnection()) {
+            connect(socket, &QTcpSocket::readyRead, this, [this, socket] { onReadyRead(socket); });
+            connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+        }
+    }
+
+    void onReadyRead(QTcpSocket *socket)
+    {
+        QByteArray &buffer = m_buffers[socket];
+        buffer += socket->readAll();
+
+        int end;
+        while ((end = buffer.indexOf("\r\n\r\n")) >= 0) {
+            const QByteArray requestLine = buffer.left(buffer.indexOf("\r\n"));
+            buffer.remove(0, end + 4);
+
+            const QString path = QString::fromLatin1(requestLine.split(' ').value(1));
+            paths << path;
+            maximumInFlight = qMax(maximumInFlight, ++m_inFlight);
+
+            QPointer<QTcpSocket> guard(socket);
+            QTimer::singleShot(20, this, [this, guard, path] {
+                --m_inFlight;
+                if (guard)
+                    respond(guard, path);
+            });
+        }
+    }
+
+    void respond(QTcpSocket *socket, const QString &path)
+    {
+        QByteArray body;
+        if (path == QStringLiteral("/style.json")) {
+            body = "{\"version\": 8, \"sources\": {\"streets\": {\"type\": \"vector\", \"tiles\": [\""
+                    + baseUrl().toLatin1() + "/tiles/{z}/{x}/{y}.pbf\"], \"scheme\": \""
+                    + (m_tms ? "tms" : "xyz") + "\"}}, \"layers\": []}";
+        } else if (path.startsWith(QStringLiteral("/tiles/"))) {
+            body = path.toLatin1();
+        } else {
+            socket->write("HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n");
+            return;
+        }
+
+        socket->write("HTTP/1.1 200 OK\r\nContent-Length: " + QByteArray::number(body.size()) + "\r\n\r\n" + body);
+    }
+
+    QTcpServer m_server;
+    bool m_tms;
+    int m_inFlight = 0;
+    QHash<QTcpSocket *, QByteArray> m_buffers;
+};
+
+class tst_QMapboxGLOfflineDownloader : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+
+    void boundsConcurrency();
+    void resumesFromExistingRows();
+    void flipsTmsRows();
+    void rejectsMapboxStyles();
+
+private:
+    bool download(TileServer *server, const QGeoRectangle &bounds, int zoom, int concurrency = 4);
+    QString databasePath() const;
+
+    QScopedPointer<QTemporaryDir> m_dir;
+};
+
+void tst_QMapboxGLOfflineDownloader::init()
+{
+    m_dir.reset(new QTemporaryDir);
+    QVERIFY(m_dir->isValid());
+}
+
+void tst_QMapboxGLOfflineDownloader::cleanup()
+{
+    m_dir.reset();
+}
+
+QString tst_QMapboxGLOfflineDownloader::databasePath() const
+{
+    return m_dir->filePath(QStringLiteral("cache.db"));
+}
+
+bool tst_QMapboxGLOfflineDownloader::download(TileServer *server, const QGeoRectangle &bounds, int zoom, int concurrency)
+{
+    QMapboxGLSettings settings;
+    settings.setCacheDatabasePath(databasePath());
+
+    QMapboxGLOfflineDownloader downloader(settings);
+    downloader.setConcurrency(concurrency);
+
+    QMapboxGLOfflineDownloader::Region region;
+    region.styleUrl = server->baseUrl() + QStringLiteral("/style.json");
+    region.bounds = bounds;
+    region.minZoom = zoom;
+    region.maxZoom = zoom;
+    region.name = QStringLiteral("test");
+
+    QSignalSpy finished(&downloader, &QMapboxGLOfflineDownloader::finished);
+    if (!downloader.start(region))
+        return false;
+
+    if (finished.isEmpty() && !finished.wait(10000))
+        return false;
+
+    return finished.first().first().toBool();
+}
+
+void tst_QMapboxGLOfflineDownloader::boundsConcurrency()
+{
+    TileServer server;
+
+    QVERIFY(download(&server, world, 2, 2));
+
+    QCOMPARE(server.paths.size(), 1 + 16);
+    QCOMPARE(server.maximumInFlight, 2);
+}
+
+void tst_QMapboxGLOfflineDownloader::resumesFromExistingRows()
+{
+    TileServer server;
+    QVERIFY(download(&server, world, 2));
+
+    // As if the first run had been interrupted before the first column.
+    {
+        QMapboxGLCacheDatabase database(databasePath());
+        QVERIFY(database.open());
+
+        QSqlQuery query(database.database());
+        QVERIFY(query.exec(QStringLiteral("DELETE FROM region_tiles WHERE tile_id IN (SELECT id FROM tiles WHERE x = 0)")));
+        QVERIFY(query.exec(QStringLiteral("DELETE FROM tiles WHERE x = 0")));
+    }
+
+    server.paths.clear();
+    QVERIFY(download(&server, world, 2));
+
+    server.paths.sort();
+    QCOMPARE(server.paths, QStringList()
+             << QStringLiteral("/tiles/2/0/0.pbf") << QStringLiteral("/tiles/2/0/1.pbf")
+             << QStringLiteral("/tiles/2/0/2.pbf") << QStringLiteral("/tiles/2/0/3.pbf"));
+}
+
+void tst_QMapboxGLOfflineDownloader::flipsTmsRows()
+{
+    TileServer server(true);
+
+    // The north-western tile of zoom 1, which is the bottom row in TMS.
+    const QGeoRectangle bounds(QGeoCoordinate(80.0, -170.0), QGeoCoordinate(10.0, -10.0));
+    QVERIFY(download(&server, bounds, 1));
+
+    QCOMPARE(server.paths, QStringList()
+             << QStringLiteral("/style.json") << QStringLiteral("/tiles/1/0/1.pbf"));
+
+    // Stored under the row requested, like Mapbox GL does.
+    QMapboxGLCacheDatabase database(databasePath());
+    QVERIFY(database.open());
+
+    QSqlQuery query(database.database());
+    QVERIFY(query.exec(QStringLiteral("SELECT z, x, y, data FROM tiles")));
+    QVERIFY(query.next());
+    QCOMPARE(query.value(0).toInt(), 1);
+    QCOMPARE(query.value(1).toInt(), 0);
+    QCOMPARE(query.value(2).toInt(), 1);
+    QCOMPARE(query.value(3).toByteArray(), QByteArray("/tiles/1/0/1.pbf"));
+    QVERIFY(!query.next());
+}
+
+void tst_QMapboxGLOfflineDownloader::rejectsMapboxStyles()
+{
+    QMapboxGLSettings settings;
+    settings.setCacheDatabasePath(databasePath());
+
+    QMapboxGLOfflineDownloader downloader(settings);
+
+    QMapboxGLOfflineDownloader::Region region;
+    region.styleUrl = QStringLiteral("mapbox://styles/mapbox/streets-v10");
+    region.bounds = world;
+
+    QTest::ignoreMessage(QtWarningMsg, QRegularExpression(QStringLiteral("^Offline regions need an http or https style URL")));
+    QVERIFY(!downloader.start(region));
+}
+
+QTEST_MAIN(tst_QMapboxGLOfflineDownloader)
+
+#include "tst_qmapboxglofflinedownloader.moc"
@@ -0,0 +1,22 @@
+TARGET = tst_qmapboxglstylechange
+
+CONFIG += testcase
+
+QT += \
+    testlib \
+    quick-private \
+    location-private \
+    positioning-private
+
+INCLUDEPATH += $$PWD/../..
+
+HEADERS += \
+    ../../qmapboxglstylechange_p.h \
+    ../../qmapboxgltrace_p.h
+
+SOURCES += \
+    tst_qmapboxglstylechange.cpp \
+    ../../qmapboxglstylechange.cpp \
+    ../../qmapboxgltrace.cpp
+
+include(../../mapboxgl_dependency.pri)
@@ -0,0 +1,205 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Copyright (C) 2017 Mapbox, Inc.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the QtLocation module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL3$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or later as published by the Free
+** Software Foundation and appearing in the file LICENSE.GPL included in
+** the packaging of this file. Please review the following information to
+** ensure the GNU General Public License version 2.0 requirements will be
+** met: http://www.gnu.org/licenses/gpl-2.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qmapboxglstylechange_p.h"
+
+#include <QtLocation/private/qdeclarativepolylinemapitem_p.h>
+#include <QtLocation/private/qgeomapparameter_p.h>
+#include <QtPositioning/QGeoPath>
+#include <QtTest/QtTest>
+
+Q_DECLARE_METATYPE(QSharedPointer<QMapboxGLStyleChange>)
+
+namespace {
+
+QSharedPointer<QMapboxGLStyleChange> fromParameter(const QString &type, const QVariantMap &properties)
+{
+    QGeoMapParameter param;
+    param.setType(type);
+    for (auto it = properties.constBegin(); it != properties.constEnd(); ++it)
+        param.setProperty(it.key().toLatin1().constData(), it.value());
+
+    const QList<QSharedPointer<QMapboxGLStyleChange>> changes = QMapboxGLStyleChange::addMapParameter(&param);
+    return changes.value(0);
+}
+
+QByteArray serialize(const QMapboxGLStyleChange &change)
+{
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    QMapboxGLStyleChange::write(stream, change);
+
+    return data;
+}
+
+} // namespace
+
+// The recorder writes style changes with QMapboxGLStyleChange::write() and
+// the replayer reads them back. A change that comes back the same writes
+// the same bytes again.
+class tst_QMapboxGLStyleChange : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void roundTrip_data();
+    void roundTrip();
+    void rejectsUnknownKinds();
+    void stopsAtTruncatedData();
+};
+
+void tst_QMapboxGLStyleChange::roundTrip_data()
+{
+    QTest::addColumn<QSharedPointer<QMapboxGLStyleChange>>("change");
+    QTest::addColumn<QByteArray>("kind");
+
+    QTest::newRow("setLayoutProperty") << fromParameter(QStringLiteral("layout"), {
+        { QStringLiteral("layer"), QStringLiteral("road") },
+        { QStringLiteral("visibility"), QStringLiteral("none") } }) << QByteArray("setLayoutProperty");
+
+    QTest::newRow("setPaintProperty") << fromParameter(QStringLiteral("paint"), {
+        { QStringLiteral("layer"), QStringLiteral("road") },
+        { QStringLiteral("lineWidth"), 2.5 } }) << QByteArray("setPaintProperty");
+
+    // Nested lists and maps go through writeMap() and writeValue().
+    QTest::newRow("addLayer") << fromParameter(QStringLiteral("layer"), {
+        { QStringLiteral("name"), QStringLiteral("points") },
+        { QStringLiteral("layerType"), QStringLiteral("circle") },
+        { QStringLiteral("source"), QStringLiteral("points") },
+        { QStringLiteral("before"), QStringLiteral("labels") },
+        { QStringLiteral("minzoom"), 4 },
+        { QStringLiteral("metadata"), QVariantMap {
+            { QStringLiteral("group"), QStringLiteral("overlay") },
+            { QStringLiteral("order"), QVariantList { 1, 2.5, true } } } } }) << QByteArray("addLayer");
+
+    QTest::newRow("removeLayer") << QSharedPointer<QMapboxGLStyleChange>(new QMapboxGLStyleRemoveLayer(QStringLiteral("points")))
+                                 << QByteArray("removeLayer");
+
+    QTest::newRow("addSource, geojson") << fromParameter(QStringLiteral("source"), {
+        { QStringLiteral("name"), QStringLiteral("points") },
+        { QStringLiteral("sourceType"), QStringLiteral("geojson") },
+        { QStringLiteral("data"), QStringLiteral("{\"type\": \"FeatureCollection\", \"features\": []}") },
+        { QStringLiteral("cluster"), true },
+        { QStringLiteral("clusterRadius"), 40 } }) << QByteArray("addSource");
+
+    QTest::newRow("addSource, vector") << fromParameter(QStringLiteral("source"), {
+        { QStringLiteral("name"), QStringLiteral("streets") },
+        { QStringLiteral("sourceType"), QStringLiteral("vector") },
+        { QStringLiteral("url"), QStringLiteral("https://example.com/streets.json") } }) << QByteArray("addSource");
+
+    QTest::newRow("removeSource") << QSharedPointer<QMapboxGLStyleChange>(new QMapboxGLStyleRemoveSource(QStringLiteral("points")))
+                                  << QByteArray("removeSource");
+
+    QTest::newRow("setFilter") << fromParameter(QStringLiteral("filter"), {
+        { QStringLiteral("layer"), QStringLiteral("road") },
+        { QStringLiteral("filter"), QVariantList { QStringLiteral("=="), QStringLiteral("class"), QStringLiteral("street") } } })
+            << QByteArray("setFilter");
+
+    QImage sprite(4, 4, QImage::Format_ARGB32_Premultiplied);
+    sprite.fill(Qt::red);
+    QTest::newRow("addImage") << QMapboxGLStyleAddImage::fromImage(QStringLiteral("marker"), sprite)
+                              << QByteArray("addImage");
+
+    // A map item is a QMapbox::Feature source, which QVariant cannot
+    // stream by itself, plus its layer and properties.
+    QDeclarativePolylineMapItem polyline;
+    polyline.setObjectName(QStringLiteral("route"));
+    polyline.setGeoShape(QGeoPath(QList<QGeoCoordinate>()
+            << QGeoCoordinate(60.17, 24.94) << QGeoCoordinate(60.18, 24.96) << QGeoCoordinate(60.19, 24.93)));
+
+    const QList<QSharedPointer<QMapboxGLStyleChange>> item = QMapboxGLStyleChange::addMapItem(&polyline, QString());
+    for (int i = 0; i < item.size(); ++i) {
+        QTest::newRow(qPrintable(QStringLiteral("map item %1, %2").arg(i).arg(QLatin1String(item.at(i)->kind()))))
+                << item.at(i) << QByteArray(item.at(i)->kind());
+    }
+}
+
+void tst_QMapboxGLStyleChange::roundTrip()
+{
+    QFETCH(QSharedPointer<QMapboxGLStyleChange>, change);
+    QFETCH(QByteArray, kind);
+
+    QVERIFY(change);
+    QCOMPARE(QByteArray(change->kind()), kind);
+
+    const QByteArray data = serialize(*change);
+
+    QDataStream stream(data);
+    const QSharedPointer<QMapboxGLStyleChange> copy = QMapboxGLStyleChange::read(stream);
+
+    QVERIFY(copy);
+    QCOMPARE(stream.status(), QDataStream::Ok);
+    QVERIFY(stream.atEnd());
+    QCOMPARE(QByteArray(copy->kind()), kind);
+    QCOMPARE(serialize(*copy), data);
+}
+
+void tst_QMapboxGLStyleChange::rejectsUnknownKinds()
+{
+    QByteArray data;
+    {
+        QDataStream stream(&data, QIODevice::WriteOnly);
+        stream << QByteArray("setTerrain") << QString();
+    }
+
+    QDataStream stream(data);
+
+    QTest::ignoreMessage(QtWarningMsg, QRegularExpression(QStringLiteral("^Unknown style change in stream:")));
+    QVERIFY(!QMapboxGLStyleChange::read(stream));
+    QCOMPARE(stream.status(), QDataStream::ReadCorruptData);
+}
+
+void tst_QMapboxGLStyleChange::stopsAtTruncatedData()
+{
+    const QSharedPointer<QMapboxGLStyleChange> change = fromParameter(QStringLiteral("layer"), {
+        { QStringLiteral("name"), QStringLiteral("points") },
+        { QStringLiteral("layerType"), QStringLiteral("circle") },
+        { QStringLiteral("source"), QStringLiteral("points") } });
+    QVERIFY(change);
+
+    QByteArray data = serialize(*change);
+    data.chop(data.size() / 2);
+
+    QDataStream stream(data);
+    QMapboxGLStyleChange::read(stream);
+
+    QVERIFY(stream.status() != QDataStream::Ok);
+}
+
+QTEST_MAIN(tst_QMapboxGLStyleChange)
+
+#include "tst_qmapboxglstylechange.moc"
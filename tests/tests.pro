@@ -0,0 +1,8 @@
+TEMPLATE = subdirs
+
+SUBDIRS += \
+    cachedatabase \
+    offlinedownloader \
+    stylechange \
+    tilearchive \
+    tileserver
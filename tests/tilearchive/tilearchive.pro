@@ -0,0 +1,18 @@
+TARGET = tst_qmapboxgltilearchive
+
+CONFIG += testcase
+
+QT += \
+    testlib \
+    sql
+
+INCLUDEPATH += $$PWD/../..
+
+HEADERS += \
+    ../../qmapboxgltilearchive_p.h
+
+SOURCES += \
+    tst_qmapboxgltilearchive.cpp \
+    ../../qmapboxgltilearchive.cpp
+
+include(../../mapboxgl_dependency.pri)
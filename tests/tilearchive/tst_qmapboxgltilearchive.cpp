@@ -0,0 +1,525 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Copyright (C) 2017 Mapbox, Inc.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the QtLocation module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL3$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or later as published by the Free
+** Software Foundation and appearing in the file LICENSE.GPL included in
+** the packaging of this file. Please review the following information to
+** ensure the GNU General Public License version 2.0 requirements will be
+** met: http://www.gnu.org/licenses/gpl-2.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qmapboxgltilearchive_p.h"
+
+#include <QtCore/QFile>
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QTemporaryDir>
+#include <QtSql/QSqlDatabase>
+#include <QtSql/QSqlQuery>
+#include <QtTest/QtTest>
+
+#include <zlib.h>
+
+namespace {
+
+struct Tile {
+    quint64 tileId;
+    QByteArray data;
+    quint32 runLength;
+};
+
+struct DirectoryEntry {
+    quint64 tileId;
+    quint64 offset;
+    quint64 length;
+    quint32 runLength;
+};
+
+QByteArray gzip(const QByteArray &data)
+{
+    z_stream stream = {};
+    deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+
+    QByteArray result(int(deflateBound(&stream, uLong(data.size()))) + 32, Qt::Uninitialized);
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.constData()));
+    stream.avail_in = uInt(data.size());
+    stream.next_out = reinterpret_cast<Bytef *>(result.data());
+    stream.avail_out = uInt(result.size());
+    deflate(&stream, Z_FINISH);
+    result.resize(int(stream.total_out));
+    deflateEnd(&stream);
+
+    return result;
+}
+
+void appendVarint(QByteArray *bytes, quint64 value)
+{
+    while (value >= 0x80) {
+        bytes->append(char((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    bytes->append(char(value));
+}
+
+void appendLittleEndian(QByteArray *bytes, quint64 value, int size)
+{
+    for (int i = 0; i < size; ++i)
+        bytes->append(char((value >> (8 * i)) & 0xff));
+}
+
+// Offsets right after the previous entry are written as zero, the way
+// the reference writer does.
+QByteArray encodeDirectory(const QVector<DirectoryEntry> &entries)
+{
+    QByteArray bytes;
+    appendVarint(&bytes, quint64(entries.size()));
+
+    quint64 lastId = 0;
+    for (const DirectoryEntry &entry : entries) {
+        appendVarint(&bytes, entry.tileId - lastId);
+        lastId = entry.tileId;
+    }
+    for (const DirectoryEntry &entry : entries)
+        appendVarint(&bytes, entry.runLength);
+    for (const DirectoryEntry &entry : entries)
+        appendVarint(&bytes, entry.length);
+    for (int i = 0; i < entries.size(); ++i) {
+        const bool contiguous = i > 0 && entries[i].offset == entries[i - 1].offset + entries[i - 1].length;
+        appendVarint(&bytes, contiguous ? 0 : entries[i].offset + 1);
+    }
+
+    return bytes;
+}
+
+// A PMTiles version 3 archive of uncompressed vector tiles. With a leaf
+// size, the root directory only points to leaf directories holding that
+// many tiles each.
+QByteArray pmtiles(const QVector<Tile> &tiles, int leafSize = 0, bool gzipDirectories = false)
+{
+    QByteArray tileData;
+    QVector<DirectoryEntry> entries;
+    for (const Tile &tile : tiles) {
+        entries.append({ tile.tileId, quint64(tileData.size()), quint64(tile.data.size()), tile.runLength });
+        tileData.append(tile.data);
+    }
+
+    const auto compress = [gzipDirectories](const QByteArray &bytes) {
+        return gzipDirectories ? gzip(bytes) : bytes;
+    };
+
+    QByteArray root;
+    QByteArray leaves;
+    if (leafSize > 0) {
+        QVector<DirectoryEntry> rootEntries;
+        for (int i = 0; i < entries.size(); i += leafSize) {
+            const QByteArray leaf = compress(encodeDirectory(entries.mid(i, leafSize)));
+            rootEntries.append({ entries[i].tileId, quint64(leaves.size()), quint64(leaf.size()), 0 });
+            leaves.append(leaf);
+        }
+        root = compress(encodeDirectory(rootEntries));
+    } else {
+        root = compress(encodeDirectory(entries));
+    }
+
+    const QByteArray metadata = compress(QJsonDocument(QJsonObject {
+        { QStringLiteral("name"), QStringLiteral("Test") },
+        { QStringLiteral("vector_layers"), QJsonArray { QJsonObject { { QStringLiteral("id"), QStringLiteral("roads") } } } },
+    }).toJson(QJsonDocument::Compact));
+
+    const quint64 headerSize = 127;
+    const quint64 rootOffset = headerSize;
+    const quint64 metadataOffset = rootOffset + quint64(root.size());
+    const quint64 leavesOffset = metadataOffset + quint64(metadata.size());
+    const quint64 tileDataOffset = leavesOffset + quint64(leaves.size());
+
+    QByteArray header("PMTiles");
+    header.append(char(3));
+    appendLittleEndian(&header, rootOffset, 8);
+    appendLittleEndian(&header, quint64(root.size()), 8);
+    appendLittleEndian(&header, metadataOffset, 8);
+    appendLittleEndian(&header, quint64(metadata.size()), 8);
+    appendLittleEndian(&header, leavesOffset, 8);
+    appendLittleEndian(&header, quint64(leaves.size()), 8);
+    appendLittleEndian(&header, tileDataOffset, 8);
+    appendLittleEndian(&header, quint64(tileData.size()), 8);
+    appendLittleEndian(&header, quint64(tiles.size()), 8);     // addressed tiles
+    appendLittleEndian(&header, quint64(tiles.size()), 8);     // tile entries
+    appendLittleEndian(&header, quint64(tiles.size()), 8);     // tile contents
+    header.append(char(1));                                     // clustered
+    header.append(char(gzipDirectories ? 2 : 1));               // internal compression
+    header.append(char(1));                                     // tile compression
+    header.append(char(1));                                     // vector tiles
+    header.append(char(0));                                     // minimum zoom
+    header.append(char(14));                                    // maximum zoom
+    appendLittleEndian(&header, quint32(qint32(-1800000000)), 4);
+    appendLittleEndian(&header, quint32(qint32(-850000000)), 4);
+    appendLittleEndian(&header, quint32(qint32(1800000000)), 4);
+    appendLittleEndian(&header, quint32(qint32(850000000)), 4);
+    header.append(char(3));                                     // center zoom
+    appendLittleEndian(&header, quint32(qint32(105000000)), 4);
+    appendLittleEndian(&header, quint32(qint32(-202500000)), 4);
+    Q_ASSERT(quint64(header.size()) == headerSize);
+
+    return header + root + metadata + leaves + tileData;
+}
+
+QByteArray tileData(quint64 tileId)
+{
+    return QByteArray("tile ") + QByteArray::number(tileId);
+}
+
+// Every tile from zoom level 0 to 4, with its id as the data.
+QVector<Tile> pyramid()
+{
+    QVector<Tile> tiles;
+    for (quint64 id = 0; id <= 340; ++id)
+        tiles.append({ id, tileData(id), 1 });
+    return tiles;
+}
+
+} // namespace
+
+class tst_QMapboxGLTileArchive : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+
+    void parsesPMTilesHeader();
+    void findsTilesAlongTheHilbertCurve_data();
+    void findsTilesAlongTheHilbertCurve();
+    void readsLeafDirectories_data();
+    void readsLeafDirectories();
+    void expandsRunLengths();
+    void reportsMissingPMTiles();
+    void rejectsOtherPMTilesVersions();
+
+    void parsesMBTilesMetadata();
+    void flipsMBTilesRows();
+    void reportsMissingMBTiles();
+
+private:
+    QString write(const QString &name, const QByteArray &data);
+    QString mbtiles(const QString &name);
+
+    QScopedPointer<QTemporaryDir> m_dir;
+};
+
+void tst_QMapboxGLTileArchive::init()
+{
+    m_dir.reset(new QTemporaryDir);
+    QVERIFY(m_dir->isValid());
+}
+
+QString tst_QMapboxGLTileArchive::write(const QString &name, const QByteArray &data)
+{
+    const QString fileName = m_dir->filePath(name);
+
+    QFile file(fileName);
+    file.open(QIODevice::WriteOnly);
+    file.write(data);
+
+    return fileName;
+}
+
+// Two tiles of zoom level 2 in the same column, at TMS rows 3 (north) and
+// 0 (south), plus a gzipped one.
+QString tst_QMapboxGLTileArchive::mbtiles(const QString &name)
+{
+    const QString fileName = m_dir->filePath(name);
+    const QString connectionName = QStringLiteral("tst-mbtiles-") + name;
+
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), connectionName);
+        db.setDatabaseName(fileName);
+        db.open();
+
+        QSqlQuery query(db);
+        query.exec(QStringLiteral("CREATE TABLE metadata (name TEXT, value TEXT)"));
+        query.exec(QStringLiteral("CREATE TABLE tiles (zoom_level INTEGER, tile_column INTEGER, tile_row INTEGER, tile_data BLOB)"));
+
+        const QVector<QPair<QString, QString>> metadata = {
+            { QStringLiteral("format"), QStringLiteral("pbf") },
+            { QStringLiteral("minzoom"), QStringLiteral("1") },
+            { QStringLiteral("maxzoom"), QStringLiteral("12") },
+            { QStringLiteral("bounds"), QStringLiteral("-10.5,-20,30,40.25") },
+            { QStringLiteral("json"), QStringLiteral("{\"vector_layers\":[{\"id\":\"water\"}]}") },
+        };
+        query.prepare(QStringLiteral("INSERT INTO metadata VALUES (?, ?)"));
+        for (const auto &pair : metadata) {
+            query.addBindValue(pair.first);
+            query.addBindValue(pair.second);
+            query.exec();
+        }
+
+        const QVector<std::tuple<int, int, int, QByteArray>> tiles = {
+            std::make_tuple(2, 1, 3, QByteArray("north")),
+            std::make_tuple(2, 1, 0, QByteArray("south")),
+            std::make_tuple(2, 3, 1, gzip("compressed")),
+        };
+        query.prepare(QStringLiteral("INSERT INTO tiles VALUES (?, ?, ?, ?)"));
+        for (const auto &tile : tiles) {
+            query.addBindValue(std::get<0>(tile));
+            query.addBindValue(std::get<1>(tile));
+            query.addBindValue(std::get<2>(tile));
+            query.addBindValue(std::get<3>(tile));
+            query.exec();
+        }
+
+        db.close();
+    }
+    QSqlDatabase::removeDatabase(connectionName);
+
+    return fileName;
+}
+
+void tst_QMapboxGLTileArchive::parsesPMTilesHeader()
+{
+    const QString fileName = write(QStringLiteral("header.pmtiles"), pmtiles(pyramid()));
+
+    QScopedPointer<QMapboxGLTileArchive> archive(QMapboxGLTileArchive::open(QStringLiteral("pmtiles://") + fileName));
+    QVERIFY(archive);
+    QVERIFY(archive->isVector());
+
+    const QJsonObject tileJson = archive->tileJson();
+    QCOMPARE(tileJson.value(QStringLiteral("format")).toString(), QStringLiteral("pbf"));
+    QCOMPARE(tileJson.value(QStringLiteral("minzoom")).toInt(), 0);
+    QCOMPARE(tileJson.value(QStringLiteral("maxzoom")).toInt(), 14);
+    QCOMPARE(tileJson.value(QStringLiteral("bounds")).toArray(), (QJsonArray { -180.0, -85.0, 180.0, 85.0 }));
+    QCOMPARE(tileJson.value(QStringLiteral("center")).toArray(), (QJsonArray { 10.5, -20.25, 3 }));
+    QCOMPARE(tileJson.value(QStringLiteral("name")).toString(), QStringLiteral("Test"));
+    QCOMPARE(tileJson.value(QStringLiteral("vector_layers")).toArray().first().toObject().value(QStringLiteral("id")).toString(),
+             QStringLiteral("roads"));
+}
+
+void tst_QMapboxGLTileArchive::findsTilesAlongTheHilbertCurve_data()
+{
+    QTest::addColumn<int>("z");
+    QTest::addColumn<int>("x");
+    QTest::addColumn<int>("y");
+    QTest::addColumn<quint64>("tileId");
+
+    // Test vectors of the PMTiles specification.
+    QTest::newRow("0/0/0") << 0 << 0 << 0 << quint64(0);
+    QTest::newRow("1/0/0") << 1 << 0 << 0 << quint64(1);
+    QTest::newRow("1/0/1") << 1 << 0 << 1 << quint64(2);
+    QTest::newRow("1/1/1") << 1 << 1 << 1 << quint64(3);
+    QTest::newRow("1/1/0") << 1 << 1 << 0 << quint64(4);
+    QTest::newRow("2/0/0") << 2 << 0 << 0 << quint64(5);
+    QTest::newRow("12/3423/1763") << 12 << 3423 << 1763 << quint64(19078479);
+
+    // The curve turns the other way on every other zoom level.
+    QTest::newRow("2/1/0") << 2 << 1 << 0 << quint64(6);
+    QTest::newRow("2/0/3") << 2 << 0 << 3 << quint64(10);
+    QTest::newRow("2/3/0") << 2 << 3 << 0 << quint64(20);
+}
+
+void tst_QMapboxGLTileArchive::findsTilesAlongTheHilbertCurve()
+{
+    QFETCH(int, z);
+    QFETCH(int, x);
+    QFETCH(int, y);
+    QFETCH(quint64, tileId);
+
+    QVector<Tile> tiles = pyramid();
+    tiles.append({ 19078479, tileData(19078479), 1 });
+
+    const QString fileName = write(QStringLiteral("hilbert.pmtiles"), pmtiles(tiles));
+    QScopedPointer<QMapboxGLTileArchive> archive(QMapboxGLTileArchive::open(QStringLiteral("pmtiles://") + fileName));
+    QVERIFY(archive);
+
+    QByteArray data;
+    bool gzipped = true;
+    QVERIFY(archive->tile(z, x, y, &data, &gzipped));
+    QCOMPARE(data, tileData(tileId));
+    QVERIFY(!gzipped);
+}
+
+void tst_QMapboxGLTileArchive::readsLeafDirectories_data()
+{
+    QTest::addColumn<bool>("gzipDirectories");
+
+    QTest::newRow("uncompressed") << false;
+    QTest::newRow("gzip") << true;
+}
+
+void tst_QMapboxGLTileArchive::readsLeafDirectories()
+{
+    QFETCH(bool, gzipDirectories);
+
+    // 341 tiles in leaves of 16, the last one only partly filled.
+    const QString fileName = write(QStringLiteral("leaves.pmtiles"), pmtiles(pyramid(), 16, gzipDirectories));
+    QScopedPointer<QMapboxGLTileArchive> archive(QMapboxGLTileArchive::open(QStringLiteral("pmtiles://") + fileName));
+    QVERIFY(archive);
+    QCOMPARE(archive->tileJson().value(QStringLiteral("name")).toString(), QStringLiteral("Test"));
+
+    const QVector<std::tuple<int, int, int, quint64>> lookups = {
+        std::make_tuple(0, 0, 0, quint64(0)),       // first entry of the first leaf
+        std::make_tuple(2, 3, 0, quint64(20)),
+        std::make_tuple(3, 0, 0, quint64(21)),
+        std::make_tuple(3, 5, 2, quint64(76)),
+        std::make_tuple(4, 0, 0, quint64(85)),
+        std::make_tuple(4, 0, 15, quint64(170)),
+        std::make_tuple(4, 7, 9, quint64(211)),
+        std::make_tuple(4, 15, 15, quint64(255)),
+        std::make_tuple(4, 15, 0, quint64(340)),    // last entry of the last leaf
+    };
+
+    // Twice, the second time from the cached leaves.
+    for (int pass = 0; pass < 2; ++pass) {
+        for (const auto &lookup : lookups) {
+            QByteArray data;
+            bool gzipped = true;
+            QVERIFY(archive->tile(std::get<0>(lookup), std::get<1>(lookup), std::get<2>(lookup), &data, &gzipped));
+            QCOMPARE(data, tileData(std::get<3>(lookup)));
+        }
+    }
+}
+
+void tst_QMapboxGLTileArchive::expandsRunLengths()
+{
+    // Tiles 9 to 12 of zoom level 2 share their data, like ocean tiles do.
+    const QVector<Tile> tiles = {
+        { 0, tileData(0), 1 },
+        { 9, QByteArray("ocean"), 4 },
+        { 13, tileData(13), 1 },
+    };
+
+    const QString fileName = write(QStringLiteral("runs.pmtiles"), pmtiles(tiles));
+    QScopedPointer<QMapboxGLTileArchive> archive(QMapboxGLTileArchive::open(QStringLiteral("pmtiles://") + fileName));
+    QVERIFY(archive);
+
+    QByteArray data;
+    bool gzipped = false;
+    for (const QPoint &tile : { QPoint(0, 2), QPoint(0, 3), QPoint(1, 3), QPoint(1, 2) }) {
+        QVERIFY(archive->tile(2, tile.x(), tile.y(), &data, &gzipped));
+        QCOMPARE(data, QByteArray("ocean"));
+    }
+
+    QVERIFY(archive->tile(2, 2, 2, &data, &gzipped));
+    QCOMPARE(data, tileData(13));
+}
+
+void tst_QMapboxGLTileArchive::reportsMissingPMTiles()
+{
+    // Tiles 1 and 2 form a run, 3 to 5 are missing, 6 is the last one.
+    const QVector<Tile> tiles = {
+        { 1, tileData(1), 2 },
+        { 6, tileData(6), 1 },
+    };
+
+    for (int leafSize : { 0, 1 }) {
+        const QString fileName = write(QStringLiteral("missing-%1.pmtiles").arg(leafSize), pmtiles(tiles, leafSize));
+        QScopedPointer<QMapboxGLTileArchive> archive(QMapboxGLTileArchive::open(QStringLiteral("pmtiles://") + fileName));
+        QVERIFY(archive);
+
+        QByteArray data;
+        bool gzipped = false;
+        QVERIFY(!archive->tile(0, 0, 0, &data, &gzipped));     // before the first entry
+        QVERIFY(archive->tile(1, 0, 1, &data, &gzipped));
+        QVERIFY(!archive->tile(1, 1, 1, &data, &gzipped));     // past the run
+        QVERIFY(!archive->tile(2, 0, 0, &data, &gzipped));     // between entries
+        QVERIFY(!archive->tile(2, 1, 1, &data, &gzipped));     // past the last entry
+        QVERIFY(!archive->tile(1, 2, 0, &data, &gzipped));     // outside the zoom level
+        QVERIFY(!archive->tile(1, 0, -1, &data, &gzipped));
+        QVERIFY(!archive->tile(27, 0, 0, &data, &gzipped));
+    }
+}
+
+void tst_QMapboxGLTileArchive::rejectsOtherPMTilesVersions()
+{
+    QByteArray bytes = pmtiles(pyramid());
+    bytes[7] = 2;
+
+    const QString fileName = write(QStringLiteral("version2.pmtiles"), bytes);
+
+    QTest::ignoreMessage(QtWarningMsg, QRegularExpression(QStringLiteral("is not a version 3 PMTiles archive")));
+    QTest::ignoreMessage(QtWarningMsg, QRegularExpression(QStringLiteral("Unable to open the tile archive")));
+    QVERIFY(!QMapboxGLTileArchive::open(QStringLiteral("pmtiles://") + fileName));
+}
+
+void tst_QMapboxGLTileArchive::parsesMBTilesMetadata()
+{
+    const QString fileName = mbtiles(QStringLiteral("metadata.mbtiles"));
+
+    QScopedPointer<QMapboxGLTileArchive> archive(QMapboxGLTileArchive::open(QStringLiteral("mbtiles://") + fileName));
+    QVERIFY(archive);
+    QVERIFY(archive->isVector());
+
+    const QJsonObject tileJson = archive->tileJson();
+    QCOMPARE(tileJson.value(QStringLiteral("minzoom")).toInt(), 1);
+    QCOMPARE(tileJson.value(QStringLiteral("maxzoom")).toInt(), 12);
+    QCOMPARE(tileJson.value(QStringLiteral("bounds")).toArray(), (QJsonArray { -10.5, -20.0, 30.0, 40.25 }));
+    QCOMPARE(tileJson.value(QStringLiteral("vector_layers")).toArray().first().toObject().value(QStringLiteral("id")).toString(),
+             QStringLiteral("water"));
+}
+
+void tst_QMapboxGLTileArchive::flipsMBTilesRows()
+{
+    const QString fileName = mbtiles(QStringLiteral("rows.mbtiles"));
+    QScopedPointer<QMapboxGLTileArchive> archive(QMapboxGLTileArchive::open(QStringLiteral("mbtiles://") + fileName));
+    QVERIFY(archive);
+
+    QByteArray data;
+    bool gzipped = true;
+    QVERIFY(archive->tile(2, 1, 0, &data, &gzipped));
+    QCOMPARE(data, QByteArray("north"));
+    QVERIFY(!gzipped);
+
+    QVERIFY(archive->tile(2, 1, 3, &data, &gzipped));
+    QCOMPARE(data, QByteArray("south"));
+
+    // Row 1 from the south is row 2 from the north.
+    QVERIFY(archive->tile(2, 3, 2, &data, &gzipped));
+    QVERIFY(gzipped);
+    QCOMPARE(QMapboxGLTileArchive::gunzip(data), QByteArray("compressed"));
+}
+
+void tst_QMapboxGLTileArchive::reportsMissingMBTiles()
+{
+    const QString fileName = mbtiles(QStringLiteral("missing.mbtiles"));
+    QScopedPointer<QMapboxGLTileArchive> archive(QMapboxGLTileArchive::open(QStringLiteral("mbtiles://") + fileName));
+    QVERIFY(archive);
+
+    QByteArray data;
+    bool gzipped = false;
+    QVERIFY(!archive->tile(2, 1, 1, &data, &gzipped));
+    QVERIFY(!archive->tile(2, 3, 1, &data, &gzipped));     // only there as a TMS row
+    QVERIFY(!archive->tile(1, 1, 0, &data, &gzipped));
+    QVERIFY(!archive->tile(31, 0, 0, &data, &gzipped));
+
+    QTest::ignoreMessage(QtWarningMsg, QRegularExpression(QStringLiteral("Unable to open the tile archive")));
+    QVERIFY(!QMapboxGLTileArchive::open(QStringLiteral("mbtiles://") + m_dir->filePath(QStringLiteral("absent.mbtiles"))));
+}
+
+QTEST_MAIN(tst_QMapboxGLTileArchive)
+
+#include "tst_qmapboxgltilearchive.moc"
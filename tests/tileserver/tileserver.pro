@@ -0,0 +1,24 @@
+TARGET = tst_qmapboxgltileserver
+
+CONFIG += testcase
+
+QT += \
+    testlib \
+    network \
+    positioning \
+    sql
+
+INCLUDEPATH += $$PWD/../..
+
+HEADERS += \
+    ../../qmapboxglrequestscheduler_p.h \
+    ../../qmapboxgltilearchive_p.h \
+    ../../qmapboxgltileserver_p.h
+
+SOURCES += \
+    tst_qmapboxgltileserver.cpp \
+    ../../qmapboxglrequestscheduler.cpp \
+    ../../qmapboxgltilearchive.cpp \
+    ../../qmapboxgltileserver.cpp
+
+include(../../mapboxgl_dependency.pri)
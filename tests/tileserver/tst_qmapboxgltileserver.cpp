@@ -0,0 +1,285 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Copyright (C) 2017 Mapbox, Inc.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the QtLocation module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL3$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or later as published by the Free
+** Software Foundation and appearing in the file LICENSE.GPL included in
+** the packaging of this file. Please review the following information to
+** ensure the GNU General Public License version 2.0 requirements will be
+** met: http://www.gnu.org/licenses/gpl-2.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qmapboxglrequestscheduler_p.h"
+#include "qmapboxgltileserver_p.h"
+
+#include <QtCore/QPointer>
+#include <QtCore/QQueue>
+#include <QtCore/QTimer>
+#include <QtNetwork/QNetworkAccessManager>
+#include <QtNetwork/QNetworkReply>
+#include <QtNetwork/QTcpServer>
+#include <QtNetwork/QTcpSocket>
+#include <QtTest/QtTest>
+
+// Stand-in for a tile server behind a slow link. It answers one request
+// at a time, each after a delay, and records the order they arrive in.
+class ThrottledServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ThrottledServer(int delay) : m_delay(delay)
+    {
+        connect(&m_server, &QTcpServer::newConnection, this, &ThrottledServer::onNewConnection);
+        m_server.listen(QHostAddress::LocalHost);
+    }
+
+    QString baseUrl() const
+    {
+        // Not 127.0.0.1, that is where the tile server itself lives.
+        return QStringLiteral("http://localhost:%1").arg(m_server.serverPort());
+    }
+
+    QStringList paths;
+
+private:
+    void onNewConnection()
+    {
+        while (QTcpSocket *socket = m_server.nextPendingConnection()) {
+            connect(socket, &QTcpSocket::readyRead, this, [this, socket] { onReadyRead(socket); });
+            connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+        }
+    }
+
+    void onReadyRead(QTcpSocket *socket)
+    {
+        QByteArray &buffer = m_buffers[socket];
+        buffer += socket->readAll();
+
+        int end;
+        while ((end = buffer.indexOf("\r\n\r\n")) >= 0) {
+            const QByteArray requestLine = buffer.left(buffer.indexOf("\r\n"));
+            buffer.remove(0, end + 4);
+
+            paths << QString::fromLatin1(requestLine.split(' ').value(1));
+            m_pending.enqueue(socket);
+        }
+
+        if (!m_busy)
+            respondNext();
+    }
+
+    void respondNext()
+    {
+        if (m_pending.isEmpty())
+            return;
+
+        m_busy = true;
+        QPointer<QTcpSocket> socket = m_pending.dequeue();
+
+        QTimer::singleShot(m_delay, this, [this, socket] {
+            if (socket)
+                socket->write("HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nContent-Length: 2\r\n\r\nok");
+
+            m_busy = false;
+            respondNext();
+        });
+    }
+
+    QTcpServer m_server;
+    int m_delay;
+    bool m_busy = false;
+    QHash<QTcpSocket *, QByteArray> m_buffers;
+    QQueue<QPointer<QTcpSocket>> m_pending;
+};
+
+class tst_QMapboxGLTileServer : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+
+    void forwardsByViewportPriority();
+    void mergesRequestsInFlight();
+    void flipsTmsRows();
+    void rejectsUnsignedRequests();
+    void rejectsForeignHosts();
+
+private:
+    QString transform(const QString &url) const;
+    QByteArray rawRequest(const QString &url, const QByteArray &host);
+
+    QScopedPointer<QMapboxGLTileServer> m_server;
+    QScopedPointer<QMapboxGLSettings> m_settings;
+};
+
+void tst_QMapboxGLTileServer::init()
+{
+    m_server.reset(new QMapboxGLTileServer);
+    m_server->setScheduling(1);
+
+    m_settings.reset(new QMapboxGLSettings);
+    m_server->install(m_settings.data());
+}
+
+void tst_QMapboxGLTileServer::cleanup()
+{
+    m_server.reset();
+    m_settings.reset();
+}
+
+QString tst_QMapboxGLTileServer::transform(const QString &url) const
+{
+    return QString::fromStdString(m_settings->resourceTransform()(url.toStdString()));
+}
+
+QByteArray tst_QMapboxGLTileServer::rawRequest(const QString &url, const QByteArray &host)
+{
+    const QUrl proxied(url);
+
+    QTcpSocket socket;
+    socket.connectToHost(QHostAddress::LocalHost, quint16(proxied.port()));
+    if (!socket.waitForConnected(5000))
+        return QByteArray();
+
+    socket.write("GET " + proxied.path().toLatin1() + " HTTP/1.1\r\nHost: " + host + "\r\n\r\n");
+
+    QByteArray response;
+    while (!response.contains("\r\n\r\n") && socket.waitForReadyRead(5000))
+        response += socket.readAll();
+
+    return response.left(response.indexOf("\r\n"));
+}
+
+void tst_QMapboxGLTileServer::forwardsByViewportPriority()
+{
+    ThrottledServer upstream(200);
+
+    // Zoom 4 around 0,0 draws tile 8/8 in the middle.
+    m_server->scheduler()->setViewport(this, QGeoCoordinate(0.0, 0.0), 4.0, QSize(512, 512));
+
+    QNetworkAccessManager network;
+    QList<QNetworkReply *> replies;
+
+    // Holds the only upstream connection while the tiles queue up.
+    replies << network.get(QNetworkRequest(QUrl(transform(upstream.baseUrl() + QStringLiteral("/style.json")))));
+    QTRY_COMPARE(upstream.paths.size(), 1);
+
+    const QStringList farToNear = QStringList()
+        << QStringLiteral("/4/0/0.pbf") << QStringLiteral("/4/2/13.pbf")
+        << QStringLiteral("/4/5/5.pbf") << QStringLiteral("/4/8/8.pbf");
+    for (const QString &path : farToNear)
+        replies << network.get(QNetworkRequest(QUrl(transform(upstream.baseUrl() + path))));
+
+    QTRY_COMPARE_WITH_TIMEOUT(upstream.paths.size(), 5, 10000);
+
+    QStringList nearToFar = farToNear;
+    std::reverse(nearToFar.begin(), nearToFar.end());
+    QCOMPARE(upstream.paths.mid(1), nearToFar);
+
+    for (QNetworkReply *reply : qAsConst(replies))
+        QTRY_VERIFY(reply->isFinished());
+    qDeleteAll(replies);
+
+    const QVariantMap scheduling = m_server->statistics().value(QStringLiteral("scheduling")).toMap();
+    QCOMPARE(scheduling.value(QStringLiteral("forwardedRequests")).toInt(), 5);
+}
+
+void tst_QMapboxGLTileServer::mergesRequestsInFlight()
+{
+    ThrottledServer upstream(200);
+
+    QNetworkAccessManager network;
+    QList<QNetworkReply *> replies;
+
+    replies << network.get(QNetworkRequest(QUrl(transform(upstream.baseUrl() + QStringLiteral("/style.json")))));
+    QTRY_COMPARE(upstream.paths.size(), 1);
+
+    // Two maps asking for the same tile while it is on its way.
+    const QUrl tile(transform(upstream.baseUrl() + QStringLiteral("/4/8/8.pbf")));
+    replies << network.get(QNetworkRequest(tile));
+    replies << network.get(QNetworkRequest(tile));
+
+    for (QNetworkReply *reply : qAsConst(replies))
+        QTRY_VERIFY_WITH_TIMEOUT(reply->isFinished(), 10000);
+
+    QCOMPARE(replies.at(1)->readAll(), QByteArrayLiteral("ok"));
+    QCOMPARE(replies.at(2)->readAll(), QByteArrayLiteral("ok"));
+    qDeleteAll(replies);
+
+    QCOMPARE(upstream.paths, QStringList() << QStringLiteral("/style.json") << QStringLiteral("/4/8/8.pbf"));
+
+    const QVariantMap scheduling = m_server->statistics().value(QStringLiteral("scheduling")).toMap();
+    QCOMPARE(scheduling.value(QStringLiteral("mergedRequests")).toInt(), 1);
+}
+
+void tst_QMapboxGLTileServer::flipsTmsRows()
+{
+    QMapboxGLRequestScheduler *scheduler = m_server->scheduler().data();
+
+    scheduler->learnTileSchemes(QByteArrayLiteral(
+        "{\"tilejson\": \"2.2.0\", \"scheme\": \"tms\", \"tiles\": [\"https://tms.example/{z}/{x}/{y}.png\"]}"));
+
+    const QMapboxGLRequestScheduler::Tile tms = scheduler->tile(QStringLiteral("https://tms.example/4/3/2.png"));
+    QCOMPARE(tms.z, 4);
+    QCOMPARE(tms.x, 3);
+    QCOMPARE(tms.y, 13);
+
+    const QMapboxGLRequestScheduler::Tile xyz = scheduler->tile(QStringLiteral("https://xyz.example/4/3/2.png"));
+    QCOMPARE(xyz.y, 2);
+}
+
+void tst_QMapboxGLTileServer::rejectsUnsignedRequests()
+{
+    const QUrl proxied(transform(QStringLiteral("http://localhost:1/4/8/8.pbf")));
+    const QByteArray host = "127.0.0.1:" + QByteArray::number(proxied.port());
+
+    // Same target, signature of another URL.
+    const QUrl other(transform(QStringLiteral("http://localhost:1/4/0/0.pbf")));
+    QString forged = proxied.toString();
+    forged.replace(proxied.path().section(QLatin1Char('/'), 2, 2), other.path().section(QLatin1Char('/'), 2, 2));
+
+    QCOMPARE(rawRequest(forged, host), QByteArrayLiteral("HTTP/1.1 403 Forbidden"));
+
+    const QString unsignedUrl = QStringLiteral("http://127.0.0.1:%1/proxy/%2").arg(proxied.port())
+            .arg(proxied.path().section(QLatin1Char('/'), 3, 3));
+    QCOMPARE(rawRequest(unsignedUrl, host), QByteArrayLiteral("HTTP/1.1 403 Forbidden"));
+}
+
+void tst_QMapboxGLTileServer::rejectsForeignHosts()
+{
+    const QString proxied = transform(QStringLiteral("http://localhost:1/4/8/8.pbf"));
+    QCOMPARE(rawRequest(proxied, QByteArrayLiteral("attacker.example:80")), QByteArrayLiteral("HTTP/1.1 403 Forbidden"));
+}
+
+QTEST_MAIN(tst_QMapboxGLTileServer)
+
+#include "tst_qmapboxgltileserver.moc"
@@ -0,0 +1,23 @@
+TARGET = qmapboxgl-batchrenderer
+
+CONFIG += console
+CONFIG -= app_bundle
+
+QT += \
+    gui \
+    location-private \
+    network \
+    sql
+
+INCLUDEPATH += $$PWD/../..
+
+HEADERS += \
+    ../../qmapboxglbatchrenderer.h \
+    ../../qmapboxgloffscreencontext_p.h
+
+SOURCES += \
+    main.cpp \
+    ../../qmapboxglbatchrenderer.cpp \
+    ../../qmapboxgloffscreencontext.cpp
+
+include(../../mapboxgl_dependency.pri)
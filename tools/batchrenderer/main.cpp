@@ -0,0 +1,164 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Copyright (C) 2017 Mapbox, Inc.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the QtLocation module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL3$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or later as published by the Free
+** Software Foundation and appearing in the file LICENSE.GPL included in
+** the packaging of this file. Please review the following information to
+** ensure the GNU General Public License version 2.0 requirements will be
+** met: http://www.gnu.org/licenses/gpl-2.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qmapboxglbatchrenderer.h"
+
+#include <QtCore/QCommandLineParser>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QJsonObject>
+#include <QtGui/QGuiApplication>
+#include <QtLocation/private/qabstractgeotilecache_p.h>
+
+#include <cstdio>
+
+// Renders the still images described by a JSON job file, for example
+//
+//   [ { "style": "mapbox://styles/mapbox/streets-v10",
+//       "latitude": 60.17, "longitude": 24.94, "zoom": 12,
+//       "bearing": 0, "pitch": 0,
+//       "width": 512, "height": 512, "pixelRatio": 1,
+//       "output": "helsinki.png" } ]
+//
+// Missing keys fall back to the command line options. Jobs are rendered in
+// file order, keep jobs with the same style next to each other so that the
+// style and its tiles are reused.
+int main(int argc, char *argv[])
+{
+    QGuiApplication app(argc, argv);
+    QCoreApplication::setApplicationName(QStringLiteral("qmapboxgl-batchrenderer"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Renders map images without a window."));
+    parser.addHelpOption();
+    parser.addPositionalArgument(QStringLiteral("jobs"), QStringLiteral("JSON file with the images to render."));
+
+    const QCommandLineOption styleOption(QStringLiteral("style"), QStringLiteral("Default style URL."), QStringLiteral("url"));
+    const QCommandLineOption sizeOption(QStringLiteral("size"), QStringLiteral("Default image size, as WIDTHxHEIGHT."), QStringLiteral("size"), QStringLiteral("512x512"));
+    const QCommandLineOption pixelRatioOption(QStringLiteral("pixel-ratio"), QStringLiteral("Default pixel ratio."), QStringLiteral("ratio"), QStringLiteral("1"));
+    const QCommandLineOption outputOption(QStringLiteral("output-directory"), QStringLiteral("Directory for relative output file names."), QStringLiteral("path"), QStringLiteral("."));
+    const QCommandLineOption tokenOption(QStringLiteral("access-token"), QStringLiteral("Mapbox access token."), QStringLiteral("token"));
+    const QCommandLineOption apiBaseUrlOption(QStringLiteral("api-base-url"), QStringLiteral("Mapbox API base URL."), QStringLiteral("url"));
+    const QCommandLineOption cacheOption(QStringLiteral("cache-database"), QStringLiteral("Tile cache database, shared with the map plugin by default."), QStringLiteral("path"));
+    parser.addOptions({ styleOption, sizeOption, pixelRatioOption, outputOption, tokenOption, apiBaseUrlOption, cacheOption });
+    parser.process(app);
+
+    if (parser.positionalArguments().size() != 1)
+        parser.showHelp(1);
+
+    QFile file(parser.positionalArguments().first());
+    if (!file.open(QIODevice::ReadOnly)) {
+        fprintf(stderr, "Unable to read %s.\n", qPrintable(file.fileName()));
+        return 1;
+    }
+
+    QJsonParseError error;
+    const QJsonDocument document = QJsonDocument::fromJson(file.readAll(), &error);
+    if (!document.isArray()) {
+        fprintf(stderr, "%s is not a JSON array of jobs: %s\n", qPrintable(file.fileName()), qPrintable(error.errorString()));
+        return 1;
+    }
+
+    QMapboxGLSettings settings;
+    if (parser.isSet(tokenOption))
+        settings.setAccessToken(parser.value(tokenOption));
+    else
+        settings.setAccessToken(qgetenv("MAPBOX_ACCESS_TOKEN"));
+    if (parser.isSet(apiBaseUrlOption))
+        settings.setApiBaseUrl(parser.value(apiBaseUrlOption));
+
+    // Same default location as the plugin, so that maps and images share
+    // their tiles.
+    if (parser.isSet(cacheOption)) {
+        settings.setCacheDatabasePath(parser.value(cacheOption));
+    } else {
+        const QString cacheDirectory = QAbstractGeoTileCache::baseLocationCacheDirectory() + QStringLiteral("mapboxgl/");
+        QDir::root().mkpath(cacheDirectory);
+        settings.setCacheDatabasePath(cacheDirectory + QLatin1String("/mapboxgl.db"));
+    }
+
+    const QStringList size = parser.value(sizeOption).split(QLatin1Char('x'));
+    const QSize defaultSize = size.size() == 2 ? QSize(size.at(0).toInt(), size.at(1).toInt()) : QSize();
+    const qreal defaultPixelRatio = parser.value(pixelRatioOption).toDouble();
+    const QDir outputDirectory(parser.value(outputOption));
+
+    QMapboxGLBatchRenderer renderer(settings);
+
+    const QJsonArray jobs = document.array();
+    for (int i = 0; i < jobs.size(); ++i) {
+        const QJsonObject object = jobs.at(i).toObject();
+
+        QMapboxGLBatchRenderer::Job job;
+        job.styleUrl = object.value(QStringLiteral("style")).toString(parser.value(styleOption));
+        job.camera.center = QVariant::fromValue(QMapbox::Coordinate(
+                object.value(QStringLiteral("latitude")).toDouble(),
+                object.value(QStringLiteral("longitude")).toDouble()));
+        job.camera.zoom = object.value(QStringLiteral("zoom")).toDouble();
+        job.camera.bearing = object.value(QStringLiteral("bearing")).toDouble();
+        job.camera.pitch = object.value(QStringLiteral("pitch")).toDouble();
+        job.size = QSize(object.value(QStringLiteral("width")).toInt(defaultSize.width()),
+                         object.value(QStringLiteral("height")).toInt(defaultSize.height()));
+        job.pixelRatio = object.value(QStringLiteral("pixelRatio")).toDouble(defaultPixelRatio);
+
+        const QString output = object.value(QStringLiteral("output")).toString(QStringLiteral("%1.png").arg(i));
+        job.fileName = outputDirectory.absoluteFilePath(output);
+
+        renderer.enqueue(job);
+    }
+
+    // Job ids are handed out in order, starting at 0.
+    QObject::connect(&renderer, &QMapboxGLBatchRenderer::jobFailed, [](int id, const QString &error) {
+        fprintf(stderr, "Job %d failed: %s\n", id, qPrintable(error));
+    });
+
+    QObject::connect(&renderer, &QMapboxGLBatchRenderer::finished, &app, &QCoreApplication::quit);
+
+    if (!jobs.isEmpty())
+        app.exec();
+
+    const QVariantMap statistics = renderer.statistics();
+    printf("%llu images rendered, %llu failed in %lld ms (%.2f images/s, %.1f ms per image).\n",
+           statistics.value(QStringLiteral("imagesRendered")).toULongLong(),
+           statistics.value(QStringLiteral("imagesFailed")).toULongLong(),
+           statistics.value(QStringLiteral("busyTime")).toLongLong(),
+           statistics.value(QStringLiteral("imagesPerSecond")).toDouble(),
+           statistics.value(QStringLiteral("averageRenderTime")).toDouble());
+
+    return statistics.value(QStringLiteral("imagesFailed")).toULongLong() ? 1 : 0;
+}
@@ -0,0 +1,117 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Copyright (C) 2017 Mapbox, Inc.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the QtLocation module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL3$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPLv3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or later as published by the Free
+** Software Foundation and appearing in the file LICENSE.GPL included in
+** the packaging of this file. Please review the following information to
+** ensure the GNU General Public License version 2.0 requirements will be
+** met: http://www.gnu.org/licenses/gpl-2.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "qmapboxglsessionreplayer.h"
+
+#include <QtCore/QCommandLineParser>
+#include <QtCore/QDir>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QJsonObject>
+#include <QtCore/QSaveFile>
+#include <QtGui/QGuiApplication>
+#include <QtLocation/private/qabstractgeotilecache_p.h>
+
+#include <cstdio>
+
+// Plays back a session recorded with mapboxgl.diagnostics.record and
+// prints the frame statistics as JSON, for comparing builds and settings
+// on the same recorded interaction.
+int main(int argc, char *argv[])
+{
+    QGuiApplication app(argc, argv);
+    QCoreApplication::setApplicationName(QStringLiteral("qmapboxgl-replayer"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Replays a recorded map session offscreen."));
+    parser.addHelpOption();
+    parser.addPositionalArgument(QStringLiteral("session"), QStringLiteral("Recorded map session."));
+
+    const QCommandLineOption maximumSpeedOption(QStringLiteral("maximum-speed"), QStringLiteral("Ignore the recorded timing and render as fast as possible."));
+    const QCommandLineOption outputOption(QStringLiteral("output"), QStringLiteral("Write the statistics to this file instead of the standard output."), QStringLiteral("file"));
+    const QCommandLineOption tokenOption(QStringLiteral("access-token"), QStringLiteral("Mapbox access token."), QStringLiteral("token"));
+    const QCommandLineOption apiBaseUrlOption(QStringLiteral("api-base-url"), QStringLiteral("Mapbox API base URL."), QStringLiteral("url"));
+    const QCommandLineOption cacheOption(QStringLiteral("cache-database"), QStringLiteral("Tile cache database, shared with the map plugin by default."), QStringLiteral("path"));
+    parser.addOptions({ maximumSpeedOption, outputOption, tokenOption, apiBaseUrlOption, cacheOption });
+    parser.process(app);
+
+    if (parser.positionalArguments().size() != 1)
+        parser.showHelp(1);
+
+    QMapboxGLSettings settings;
+    if (parser.isSet(tokenOption))
+        settings.setAccessToken(parser.value(tokenOption));
+    else
+        settings.setAccessToken(qgetenv("MAPBOX_ACCESS_TOKEN"));
+    if (parser.isSet(apiBaseUrlOption))
+        settings.setApiBaseUrl(parser.value(apiBaseUrlOption));
+
+    // A warm cache keeps the network out of the measurement.
+    if (parser.isSet(cacheOption)) {
+        settings.setCacheDatabasePath(parser.value(cacheOption));
+    } else {
+        const QString cacheDirectory = QAbstractGeoTileCache::baseLocationCacheDirectory() + QStringLiteral("mapboxgl/");
+        QDir::root().mkpath(cacheDirectory);
+        settings.setCacheDatabasePath(cacheDirectory + QStringLiteral("/mapboxgl.db"));
+    }
+
+    QMapboxGLSessionReplayer replayer(settings);
+    if (!replayer.open(parser.positionalArguments().first()))
+        return 1;
+
+    replayer.setMaximumSpeed(parser.isSet(maximumSpeedOption));
+
+    QObject::connect(&replayer, &QMapboxGLSessionReplayer::finished, &app, &QCoreApplication::quit);
+    replayer.start();
+    app.exec();
+
+    const QByteArray statistics = QJsonDocument(QJsonObject::fromVariantMap(replayer.statistics())).toJson();
+
+    if (!parser.isSet(outputOption)) {
+        fwrite(statistics.constData(), 1, statistics.size(), stdout);
+        return 0;
+    }
+
+    QSaveFile file(parser.value(outputOption));
+    if (!file.open(QIODevice::WriteOnly)) {
+        fprintf(stderr, "Unable to write %s.\n", qPrintable(file.fileName()));
+        return 1;
+    }
+
+    file.write(statistics);
+
+    return file.commit() ? 0 : 1;
+}
@@ -0,0 +1,31 @@
+TARGET = qmapboxgl-replayer
+
+CONFIG += console
+CONFIG -= app_bundle
+
+QT += \
+    gui \
+    location-private \
+    positioning \
+    network \
+    sql
+
+INCLUDEPATH += $$PWD/../..
+
+HEADERS += \
+    ../../qmapboxglframetiming_p.h \
+    ../../qmapboxgloffscreencontext_p.h \
+    ../../qmapboxglsessionrecorder_p.h \
+    ../../qmapboxglsessionreplayer.h \
+    ../../qmapboxglstylechange_p.h \
+    ../../qmapboxgltrace_p.h
+
+SOURCES += \
+    main.cpp \
+    ../../qmapboxglframetiming.cpp \
+    ../../qmapboxgloffscreencontext.cpp \
+    ../../qmapboxglsessionreplayer.cpp \
+    ../../qmapboxglstylechange.cpp \
+    ../../qmapboxgltrace.cpp
+
+include(../../mapboxgl_dependency.pri)